@@ -0,0 +1,342 @@
+/** @file
+ * Program mierzący wydajność programu phone_forward na skryptach poleceń.
+ *
+ * Wywołanie: @p phfwd_bench [@p -r @p n] [@p -l @p etykieta]
+ * [@p -a @p argument] @p program @p skrypt. Skrypt dzielony jest na fazy
+ * komentarzami @p $$ @p phase @p nazwa @p ops=n @p $$ (zob. script_gen.c).
+ * Dla każdej fazy program uruchamiany jest na prefiksie skryptu kończącym
+ * się na tej fazie, a czas fazy to różnica czasów kolejnych prefiksów. Każdy
+ * pomiar powtarzany jest @p n razy (domyślnie 3) i brany jest najkrótszy
+ * czas. Standardowe wyjście programu jest odrzucane.
+ *
+ * Argumenty @p -a przekazywane są programowi w podanej kolejności, więc tryb
+ * @p --lookup mierzy wywołanie z @p -a @p --lookup @p -a @p baza na strumieniu
+ * numerów z phfwd_bench_gen @p -o @p baza. Faza @p load to wtedy czas
+ * wczytania bazy, a faza @p lookup podaje MB/s i ops/s samych zapytań.
+ *
+ * Wyniki wypisywane są po jednym wierszu na fazę i wiersz @p total, z
+ * etykietą (np. skrótem commita) w pierwszej kolumnie, aby wyniki kolejnych
+ * commitów można było łączyć w jednej tabeli (zob. bench/compare.sh).
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "../src/read_all.h"
+
+#define BENCH_MAX_PHASES 64  ///< Maksymalna liczba faz skryptu.
+#define BENCH_MAX_ARGS 16    ///< Maksymalna liczba argumentów programu.
+#define BENCH_NAME_LENGTH 31 ///< Maksymalna długość nazwy fazy.
+
+/** Faza skryptu.
+ */
+struct phase {
+    char name[BENCH_NAME_LENGTH + 1]; ///< Nazwa fazy.
+    size_t start;                     ///< Pozycja początku fazy w skrypcie.
+    unsigned long ops;                ///< Liczba poleceń fazy.
+};
+
+/** Wynik uruchomienia programu.
+ */
+struct runResult {
+    double seconds; ///< Czas działania w sekundach.
+    long maxRss;    ///< Maksymalny rozmiar zbioru roboczego w kB.
+    bool ok;        ///< Czy program zakończył się kodem 0.
+};
+
+/** @brief Wyszukuje fazy skryptu.
+ * Tekst przed pierwszym znacznikiem należy do fazy @p prologue.
+ * @param[in] script   –  Wskaźnik na skrypt;
+ * @param[in] length   –  Długość skryptu;
+ * @param[out] phases  –  Wskaźnik na tablicę faz.
+ * @return Liczba faz.
+ */
+static size_t findPhases (const char* script, size_t length,
+                          struct phase* phases) {
+    static const char marker[] = "$$ phase ";
+    size_t count = 0;
+    size_t pos = 0;
+
+    while (count < BENCH_MAX_PHASES && pos < length) {
+        const char* line = script + pos;
+        const char* end = memchr(line, '\n', length - pos);
+        size_t lineLength = end == NULL ? length - pos : (size_t)(end - line);
+
+        if (lineLength > sizeof(marker) - 1 &&
+            memcmp(line, marker, sizeof(marker) - 1) == 0) {
+            struct phase* phase = &phases[count];
+            const char* name = line + sizeof(marker) - 1;
+            size_t nameLength = strcspn(name, " \n");
+
+            if (nameLength > BENCH_NAME_LENGTH)
+                nameLength = BENCH_NAME_LENGTH;
+
+            // Tekst przed pierwszym znacznikiem traktujemy jako osobną fazę.
+            if (count == 0 && pos > 0) {
+                strcpy(phases[0].name, "prologue");
+                phases[0].start = 0;
+                phases[0].ops = 0;
+                phase = &phases[++count];
+            }
+
+            memcpy(phase->name, name, nameLength);
+            phase->name[nameLength] = '\0';
+            phase->start = pos;
+
+            const char* ops = strstr(name, "ops=");
+            phase->ops = ops != NULL && ops < line + lineLength ?
+                         strtoul(ops + 4, NULL, 10) : 0;
+            count++;
+        }
+
+        pos += lineLength + 1;
+    }
+
+    if (count == 0) {
+        strcpy(phases[0].name, "all");
+        phases[0].start = 0;
+        phases[0].ops = 0;
+        count = 1;
+    }
+
+    return count;
+}
+
+/** @brief Uruchamia program na prefiksie skryptu.
+ * @param[in] argv    –  Tablica argumentów programu zakończona NULL;
+ * @param[in] input   –  Wskaźnik na dane wejściowe;
+ * @param[in] length  –  Długość danych wejściowych.
+ * @return Wynik uruchomienia; pole @p ok ma wartość @p false także wtedy,
+ *         gdy nie udało się uruchomić programu.
+ */
+static struct runResult runOnce (char* const* argv, const char* input,
+                                 size_t length) {
+    struct runResult result = {0.0, 0, false};
+    int fds[2];
+
+    if (pipe(fds) != 0)
+        return result;
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+
+        close(fds[1]);
+        dup2(fds[0], STDIN_FILENO);
+
+        if (null >= 0)
+            dup2(null, STDOUT_FILENO);
+
+        execv(argv[0], argv);
+        _exit(127);
+    }
+
+    close(fds[0]);
+
+    if (pid < 0) {
+        close(fds[1]);
+        return result;
+    }
+
+    size_t written = 0;
+
+    while (written < length) {
+        ssize_t got = write(fds[1], input + written, length - written);
+
+        if (got < 0 && errno == EINTR)
+            continue;
+
+        // Program zakończył się przed wczytaniem całego wejścia.
+        if (got < 0)
+            break;
+
+        written += (size_t)got;
+    }
+
+    close(fds[1]);
+
+    int status;
+    struct rusage usage;
+
+    while (wait4(pid, &status, 0, &usage) < 0) {
+        if (errno != EINTR)
+            return result;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    result.seconds = (double)(end.tv_sec - begin.tv_sec) +
+                     (double)(end.tv_nsec - begin.tv_nsec) / 1e9;
+    result.maxRss = usage.ru_maxrss;
+    result.ok = written == length && WIFEXITED(status) &&
+                WEXITSTATUS(status) == 0;
+
+    return result;
+}
+
+/** @brief Mierzy program na prefiksie skryptu.
+ * @param[in] argv     –  Tablica argumentów programu zakończona NULL;
+ * @param[in] input    –  Wskaźnik na dane wejściowe;
+ * @param[in] length   –  Długość danych wejściowych;
+ * @param[in] repeats  –  Liczba powtórzeń.
+ * @return Najkrótszy czas i największy rozmiar zbioru roboczego powtórzeń.
+ */
+static struct runResult measure (char* const* argv, const char* input,
+                                 size_t length, unsigned repeats) {
+    struct runResult best = {0.0, 0, true};
+
+    for (unsigned i = 0; best.ok && i < repeats; i++) {
+        struct runResult run = runOnce(argv, input, length);
+
+        if (i == 0 || run.seconds < best.seconds)
+            best.seconds = run.seconds;
+
+        if (run.maxRss > best.maxRss)
+            best.maxRss = run.maxRss;
+
+        best.ok = run.ok;
+    }
+
+    return best;
+}
+
+/** @brief Wypisuje wiersz wyników.
+ * @param[in] label    –  Wskaźnik na etykietę;
+ * @param[in] name     –  Wskaźnik na nazwę fazy;
+ * @param[in] bytes    –  Liczba bajtów wejścia;
+ * @param[in] ops      –  Liczba poleceń;
+ * @param[in] seconds  –  Czas w sekundach;
+ * @param[in] maxRss   –  Maksymalny rozmiar zbioru roboczego w kB.
+ */
+static void printRow (const char* label, const char* name, size_t bytes,
+                      unsigned long ops, double seconds, long maxRss) {
+    // Różnica czasów prefiksów może wyjść ujemna dla bardzo krótkich faz.
+    if (seconds < 0.0)
+        seconds = 0.0;
+
+    double mbps = seconds > 0.0 ? (double)bytes / 1e6 / seconds : 0.0;
+    double opsps = seconds > 0.0 ? (double)ops / seconds : 0.0;
+
+    printf("%-12s %-10s %12zu %10lu %10.4f %10.2f %12.0f %10ld\n", label, name,
+           bytes, ops, seconds, mbps, opsps, maxRss);
+}
+
+/** Wypisuje sposób użycia programu.
+ * @param[in] name  –  Nazwa programu.
+ */
+static void usage (const char* name) {
+    fprintf(stderr, "usage: %s [-r repeats] [-l label] [-a arg]... PROGRAM"
+                    " SCRIPT\n", name);
+}
+
+/** Mierzy wydajność programu na skrypcie.
+ * @param[in] argc  –  Liczba argumentów programu;
+ * @param[in] argv  –  Tablica argumentów programu.
+ * @return Wartość 0, gdy wykonano wszystkie pomiary. Wartość 1, gdy wystąpił
+ *         błąd lub mierzony program zakończył się błędem.
+ */
+int main (int argc, char* argv[]) {
+    unsigned repeats = 3;
+    const char* label = "-";
+    char* args[BENCH_MAX_ARGS + 2];
+    size_t argCount = 1;
+    int i = 1;
+
+    while (i + 1 < argc && argv[i][0] == '-') {
+        if (strcmp(argv[i], "-r") == 0)
+            repeats = (unsigned)strtoul(argv[i + 1], NULL, 10);
+
+        else if (strcmp(argv[i], "-l") == 0)
+            label = argv[i + 1];
+
+        else if (strcmp(argv[i], "-a") == 0 && argCount <= BENCH_MAX_ARGS)
+            args[argCount++] = argv[i + 1];
+
+        else
+            break;
+
+        i += 2;
+    }
+
+    if (argc - i != 2 || repeats == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    args[0] = argv[i];
+    args[argCount] = NULL;
+
+    size_t length = 0;
+    FILE* file = fopen(argv[i + 1], "rb");
+    char* script = NULL;
+
+    if (file != NULL) {
+        script = readAll(file, &length);
+        fclose(file);
+    }
+
+    // Za danymi jest miejsce na znak '\0' (zob. readAll).
+    if (script != NULL)
+        script[length] = '\0';
+
+    if (script == NULL) {
+        fprintf(stderr, "ERROR cannot read %s\n", argv[i + 1]);
+        return 1;
+    }
+
+    // Zapis do zakończonego programu nie może przerwać pomiarów.
+    signal(SIGPIPE, SIG_IGN);
+
+    struct phase phases[BENCH_MAX_PHASES + 1];
+    size_t count = findPhases(script, length, phases);
+    double previous = 0.0;
+    unsigned long totalOps = 0;
+    bool ok = true;
+
+    printf("%-12s %-10s %12s %10s %10s %10s %12s %10s\n", "label", "phase",
+           "bytes", "ops", "seconds", "MB/s", "ops/s", "maxrss_kB");
+
+    for (size_t k = 0; ok && k < count; k++) {
+        size_t end = k + 1 < count ? phases[k + 1].start : length;
+        struct runResult run = measure(args, script, end, repeats);
+
+        if (!run.ok) {
+            fprintf(stderr, "ERROR %s failed in phase %s\n", args[0],
+                    phases[k].name);
+            ok = false;
+            break;
+        }
+
+        printRow(label, phases[k].name, end - phases[k].start, phases[k].ops,
+                 run.seconds - previous, run.maxRss);
+
+        totalOps += phases[k].ops;
+        previous = run.seconds;
+
+        if (k + 1 == count)
+            printRow(label, "total", length, totalOps, run.seconds, run.maxRss);
+    }
+
+    free(script);
+
+    return ok ? 0 : 1;
+}
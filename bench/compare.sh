@@ -0,0 +1,54 @@
+#!/bin/sh
+# Porównanie wydajności programu phone_forward w kolejnych commitach.
+#
+# Użycie: bench/compare.sh SKRYPT REWIZJA...
+#
+# Każda rewizja budowana jest w osobnym drzewie roboczym git (w katalogu
+# $BENCH_DIR, domyślnie /tmp/phfwd-bench), a następnie mierzona programem
+# phfwd_bench z bieżącego drzewa na tym samym skrypcie (zob. phfwd_bench_gen).
+# Program phfwd_bench wskazuje zmienna $BENCH (domyślnie build/phfwd_bench),
+# a dodatkowe opcje phfwd_bench zmienna $BENCH_OPTS (np. tryb --lookup:
+# BENCH_OPTS="-a --lookup -a BAZA" ze skryptem z phfwd_bench_gen -o BAZA,
+# przy czym ścieżka BAZA musi być bezwzględna). Przypadki skrajne (bardzo
+# długie numery, zapytania odwrotne z milionami wyników) mierzy skrypt z
+# phfwd_bench_gen -x, np. -x 4096 -l 2000000 -b 1. Wiersze wyników
+# wszystkich rewizji wypisywane są w jednej tabeli. Zbudowane drzewa robocze
+# są używane ponownie; usuwa je git worktree remove.
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 SCRIPT REV..." >&2
+    exit 1
+fi
+
+script=$(realpath "$1")
+shift
+
+root=$(git rev-parse --show-toplevel)
+bench=$(realpath "${BENCH:-$root/build/phfwd_bench}")
+dir=${BENCH_DIR:-/tmp/phfwd-bench}
+header=yes
+
+mkdir -p "$dir"
+
+for rev in "$@"; do
+    hash=$(git -C "$root" rev-parse --short "$rev")
+    tree="$dir/$hash"
+
+    if [ ! -x "$tree/build/phone_forward" ]; then
+        rm -rf "$tree"
+        git -C "$root" worktree add --detach "$tree" "$hash" >/dev/null 2>&1
+        cmake -S "$tree" -B "$tree/build" -DCMAKE_BUILD_TYPE=Release >/dev/null
+        cmake --build "$tree/build" --target phone_forward >/dev/null
+    fi
+
+    # Nagłówek tabeli wypisujemy tylko raz.
+    if [ $header = yes ]; then
+        "$bench" $BENCH_OPTS -l "$hash" "$tree/build/phone_forward" "$script"
+        header=no
+    else
+        "$bench" $BENCH_OPTS -l "$hash" "$tree/build/phone_forward" "$script" |
+            tail -n +2
+    fi
+done
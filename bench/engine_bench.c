@@ -0,0 +1,277 @@
+/** @file
+ * Program mierzący wydajność silników przechowywania przekierowań.
+ *
+ * Wywołanie: @p phfwd_engine_bench [@p -n @p przekierowania]
+ * [@p -q @p zapytania] [@p -r @p zapytania] [@p -s @p ziarno]
+ * [@p -l @p etykieta]. Dla każdego wariantu (silnik @p trie bez dodatków, z
+ * tablicą skoków i zamrożony oraz silnik @p hash) dodawane są te same losowe
+ * przekierowania prefiksów długości 4-12 (domyślnie 200000), a następnie
+ * wykonywane te same zapytania: @ref phfwdGet o numery długości 9-15
+ * (domyślnie 1000000) i @ref phfwdReverseCount o numery długości 4-12
+ * (domyślnie 100, bo każde przegląda wszystkie przekierowania).
+ *
+ * Wyniki wypisywane są po jednym wierszu na operację, z etykietą w pierwszej
+ * kolumnie, tak jak w phfwd_bench, aby wyniki kolejnych commitów można było
+ * łączyć w jednej tabeli. Wiersz @p memory podaje @p totalBytes ze
+ * statystyk (zob. @ref phfwdStats) po dodaniu przekierowań.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/phone_forward.h"
+
+#define BENCH_NUMBER_LENGTH 15 ///< Maksymalna długość losowanego numeru.
+
+/** Wariant silnika.
+ */
+struct variant {
+    const char* engine; ///< Nazwa silnika.
+    const char* name;   ///< Nazwa wariantu.
+    size_t jumpDepth;   ///< Głębokość tablicy skoków lub 0.
+    bool freeze;        ///< Czy zamrozić strukturę przed zapytaniami.
+};
+
+/** Mierzone warianty. */
+static const struct variant variants[] = {
+    {"trie", "plain", 0, false},
+    {"trie", "jump4", 4, false},
+    {"trie", "frozen", 0, true},
+    {"hash", "plain", 0, false}
+};
+
+/** Stan generatora liczb pseudolosowych. */
+static uint64_t randomState;
+
+/** Losuje liczbę (xorshift64).
+ * @return Kolejna liczba pseudolosowa.
+ */
+static uint64_t randomNext (void) {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+
+    return randomState;
+}
+
+/** Tworzy tablicę losowych numerów w jednym bloku pamięci.
+ * @param[in] count      –  Liczba numerów;
+ * @param[in] minLength  –  Najmniejsza długość numeru;
+ * @param[in] maxLength  –  Największa długość numeru, co najwyżej
+ *                          BENCH_NUMBER_LENGTH.
+ * @return Wskaźnik na tablicę @p count napisów po BENCH_NUMBER_LENGTH + 1
+ *         znaków lub NULL, jeśli nie udało się zaalokować pamięci.
+ */
+static char* randomNumbers (size_t count, size_t minLength, size_t maxLength) {
+    char* nums = malloc(count * (BENCH_NUMBER_LENGTH + 1));
+
+    if (nums == NULL)
+        return NULL;
+
+    for (size_t k = 0; k < count; k++) {
+        char* num = nums + k * (BENCH_NUMBER_LENGTH + 1);
+        size_t length = minLength + randomNext() % (maxLength - minLength + 1);
+
+        for (size_t i = 0; i < length; i++)
+            num[i] = (char)('0' + randomNext() % 10);
+
+        num[length] = '\0';
+    }
+
+    return nums;
+}
+
+/** Wyznacza bieżący czas.
+ * @return Czas monotoniczny w sekundach.
+ */
+static double now (void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/** @brief Wypisuje wiersz wyników.
+ * @param[in] label    –  Wskaźnik na etykietę;
+ * @param[in] v        –  Wskaźnik na wariant;
+ * @param[in] op       –  Wskaźnik na nazwę operacji;
+ * @param[in] ops      –  Liczba operacji;
+ * @param[in] seconds  –  Czas w sekundach.
+ */
+static void printRow (const char* label, const struct variant* v,
+                      const char* op, size_t ops, double seconds) {
+    double opsps = seconds > 0.0 ? (double)ops / seconds : 0.0;
+    double nsPerOp = ops > 0 ? seconds * 1e9 / (double)ops : 0.0;
+
+    printf("%-12s %-6s %-8s %-8s %10zu %10.4f %12.0f %10.1f\n", label,
+           v->engine, v->name, op, ops, seconds, opsps, nsPerOp);
+}
+
+/** @brief Mierzy jeden wariant.
+ * @param[in] label     –  Wskaźnik na etykietę;
+ * @param[in] v         –  Wskaźnik na wariant;
+ * @param[in] keys      –  Wskaźnik na prefiksy przekierowywane;
+ * @param[in] targets   –  Wskaźnik na przekierowania;
+ * @param[in] forwards  –  Liczba przekierowań;
+ * @param[in] gets      –  Wskaźnik na numery zapytań @ref phfwdGet;
+ * @param[in] queries   –  Liczba zapytań @ref phfwdGet;
+ * @param[in] reverses  –  Wskaźnik na numery zapytań @ref phfwdReverseCount;
+ * @param[in] rqueries  –  Liczba zapytań @ref phfwdReverseCount.
+ * @return Wartość @p true, jeśli wykonano wszystkie operacje.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool measure (const char* label, const struct variant* v,
+                     const char* keys, const char* targets, size_t forwards,
+                     const char* gets, size_t queries, const char* reverses,
+                     size_t rqueries) {
+    PhoneFwd pf = phfwdNewEngine(v->engine);
+
+    if (pf == NULL)
+        return false;
+
+    if (v->jumpDepth > 0)
+        phfwdSetJumpDepth(pf, v->jumpDepth);
+
+    double begin = now();
+
+    for (size_t k = 0; k < forwards; k++)
+        phfwdAdd(pf, keys + k * (BENCH_NUMBER_LENGTH + 1),
+                 targets + k * (BENCH_NUMBER_LENGTH + 1));
+
+    printRow(label, v, "insert", forwards, now() - begin);
+
+    if (v->freeze) {
+        begin = now();
+        phfwdFreeze(pf);
+        printRow(label, v, "freeze", 1, now() - begin);
+    }
+
+    // Porzucone drzewo zwalniamy przed pomiarem, żeby nie liczyć go w pamięci.
+    while (phfwdMaintain(pf, SIZE_MAX));
+
+    struct PhoneForwardStats stats;
+    bool ok = phfwdStats(pf, &stats);
+
+    if (ok)
+        printf("%-12s %-6s %-8s %-8s %10zu bytes\n", label, v->engine, v->name,
+               "memory", stats.totalBytes);
+
+    // Suma długości wyników nie pozwala kompilatorowi pominąć zapytań.
+    size_t checksum = 0;
+
+    begin = now();
+
+    for (size_t k = 0; ok && k < queries; k++) {
+        const PhoneNum* res = phfwdGet(pf, gets + k * (BENCH_NUMBER_LENGTH + 1));
+
+        ok = res != NULL;
+
+        if (ok)
+            checksum += strlen(phnumGet(res, 0));
+
+        phnumDelete(res);
+    }
+
+    if (ok)
+        printRow(label, v, "get", queries, now() - begin);
+
+    begin = now();
+
+    for (size_t k = 0; ok && k < rqueries; k++)
+        checksum += phfwdReverseCount(pf, reverses + k * (BENCH_NUMBER_LENGTH + 1));
+
+    if (ok)
+        printRow(label, v, "rcount", rqueries, now() - begin);
+
+    phfwdDelete(pf);
+    fprintf(stderr, "%s/%s checksum %zu\n", v->engine, v->name, checksum);
+
+    return ok;
+}
+
+/** Wypisuje sposób użycia programu.
+ * @param[in] name  –  Nazwa programu.
+ */
+static void usage (const char* name) {
+    fprintf(stderr, "usage: %s [-n forwards] [-q queries] [-r reverses]"
+                    " [-s seed] [-l label]\n", name);
+}
+
+/** Mierzy wydajność wszystkich wariantów silników.
+ * @param[in] argc  –  Liczba argumentów programu;
+ * @param[in] argv  –  Tablica argumentów programu.
+ * @return Wartość 0, gdy wykonano wszystkie pomiary. Wartość 1, gdy wystąpił
+ *         błąd.
+ */
+int main (int argc, char* argv[]) {
+    size_t forwards = 200000;
+    size_t queries = 1000000;
+    size_t rqueries = 100;
+    uint64_t seed = 42;
+    const char* label = "-";
+    int i = 1;
+
+    while (i + 1 < argc && argv[i][0] == '-') {
+        if (strcmp(argv[i], "-n") == 0)
+            forwards = strtoul(argv[i + 1], NULL, 10);
+
+        else if (strcmp(argv[i], "-q") == 0)
+            queries = strtoul(argv[i + 1], NULL, 10);
+
+        else if (strcmp(argv[i], "-r") == 0)
+            rqueries = strtoul(argv[i + 1], NULL, 10);
+
+        else if (strcmp(argv[i], "-s") == 0)
+            seed = strtoull(argv[i + 1], NULL, 10);
+
+        else if (strcmp(argv[i], "-l") == 0)
+            label = argv[i + 1];
+
+        else
+            break;
+
+        i += 2;
+    }
+
+    if (i != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Generator xorshift nie może zaczynać od zera.
+    randomState = seed * 0x9E3779B97F4A7C15ull + 1;
+
+    char* keys = randomNumbers(forwards, 4, 12);
+    char* targets = randomNumbers(forwards, 4, 12);
+    char* gets = randomNumbers(queries, 9, 15);
+    char* reverses = randomNumbers(rqueries, 4, 12);
+    bool ok = keys != NULL && targets != NULL && gets != NULL &&
+              reverses != NULL;
+
+    if (ok)
+        printf("%-12s %-6s %-8s %-8s %10s %10s %12s %10s\n", "label", "engine",
+               "variant", "op", "ops", "seconds", "ops/s", "ns/op");
+
+    for (size_t k = 0; ok && k < sizeof(variants) / sizeof(variants[0]); k++)
+        ok = measure(label, &variants[k], keys, targets, forwards, gets,
+                     queries, reverses, rqueries);
+
+    if (!ok)
+        fprintf(stderr, "MEMORY ERROR\n");
+
+    free(keys);
+    free(targets);
+    free(gets);
+    free(reverses);
+
+    return ok ? 0 : 1;
+}
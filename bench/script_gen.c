@@ -0,0 +1,716 @@
+/** @file
+ * Generator skryptów poleceń do pomiarów wydajności programu phone_forward.
+ *
+ * Generator wypisuje na standardowe wyjście poprawny skrypt w interfejsie
+ * tekstowym, powtarzalny dla danego ziarna. Skrypt składa się z trzech faz:
+ * @p load (dodawanie przekierowań), @p mixed (polecenia w zadanych
+ * proporcjach) i @p teardown (usuwanie przekierowań i baz). Każda faza
+ * zaczyna się komentarzem @p $$ @p phase @p nazwa @p ops=n @p $$, na
+ * podstawie którego program phfwd_bench mierzy czas faz.
+ *
+ * Z opcją @p -o generator przygotowuje dane dla trybu @p --lookup: do
+ * podanego pliku zapisuje bazę przekierowań (po jednym @p num @p > @p num w
+ * wierszu), a na standardowe wyjście wypisuje strumień numerów zapytań. Ten
+ * strumień ma dwie fazy: pustą fazę @p load, której czas to wczytanie bazy,
+ * i fazę @p lookup z numerami. Znaczniki faz nie są numerami, więc tryb
+ * @p --lookup odpowiada na nie pustym wierszem, nie przerywając działania.
+ *
+ * Numery są losowane z puli wspólnych prefiksów (jak numery kierunkowe),
+ * więc przekierowania i zapytania trafiają we wspólne poddrzewa. Opcje:
+ *  - @p -s @p n   –  ziarno generatora (domyślnie 1);
+ *  - @p -l @p n   –  liczba przekierowań fazy @p load (domyślnie 100000);
+ *  - @p -n @p n   –  liczba poleceń fazy @p mixed (domyślnie 100000);
+ *  - @p -m @p mix –  wagi poleceń fazy @p mixed w postaci
+ *                    @p nazwa:waga,... dla nazw @p new, @p deldb, @p add,
+ *                    @p del, @p get, @p rev, @p ntc
+ *                    (domyślnie @p new:1,deldb:1,add:30,del:3,get:50,rev:10,ntc:1);
+ *  - @p -b @p n   –  maksymalna liczba baz (domyślnie 4);
+ *  - @p -k @p n   –  maksymalna długość numeru (domyślnie 12, co najwyżej
+ *                    65536);
+ *  - @p -d @p cyfry –  cyfry, z których składane są numery
+ *                    (domyślnie 0123456789);
+ *  - @p -e @p silnik –  silnik tworzonych baz (domyślnie silnik domyślny);
+ *  - @p -c @p n   –  liczba komentarzy na tysiąc tokenów (domyślnie 20);
+ *  - @p -w @p n   –  liczba nietypowych odstępów na tysiąc tokenów
+ *                    (domyślnie 100);
+ *  - @p -t @p n   –  liczba przekierowań na tysiąc, które prowadzą na jeden
+ *                    wspólny numer, i zapytań odwrotnych o ten numer
+ *                    (domyślnie 0);
+ *  - @p -x @p n   –  tryb obciążeniowy z numerami długości do @p n: ustawia
+ *                    @p -k @p n, @p -t @p 500 i
+ *                    @p -m @p add:40,del:1,get:30,rev:30; późniejsze opcje
+ *                    nadpisują te wartości;
+ *  - @p -o @p plik –  tryb @p --lookup: plik bazy przekierowań; wtedy
+ *                    @p -l to liczba przekierowań bazy, a @p -n liczba
+ *                    numerów zapytań.
+ *
+ * Tryb obciążeniowy odtwarza przypadki skrajne: bardzo długie numery tworzą
+ * długie ścieżki w drzewie, a zapytanie odwrotne o wspólny numer zwraca
+ * wszystkie przekierowania na niego, czyli przy dużym @p -l miliony numerów.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GEN_AREAS 64         ///< Liczba prefiksów kierunkowych w puli.
+#define GEN_RECENT 1024      ///< Liczba zapamiętanych dodanych numerów.
+#define GEN_MAX_LENGTH 65536 ///< Największa dozwolona wartość opcji @p -k.
+#define GEN_QUERY_EXTRA 3    ///< Maksymalna liczba cyfr dopisywanych w zapytaniu.
+#define GEN_MAX_DTBS 26      ///< Maksymalna liczba baz.
+#define GEN_TEARDOWN_DELS 64 ///< Liczba usunięć numerów w fazie teardown.
+
+/** Rodzaje poleceń fazy @p mixed.
+ */
+enum genOp {
+    GEN_NEW,   ///< Polecenie @p NEW @p id.
+    GEN_DELDB, ///< Polecenie @p DEL @p id.
+    GEN_ADD,   ///< Polecenie @p num @p > @p num.
+    GEN_DEL,   ///< Polecenie @p DEL @p num.
+    GEN_GET,   ///< Polecenie @p num @p ?.
+    GEN_REV,   ///< Polecenie @p ? @p num.
+    GEN_NTC,   ///< Polecenie @p @ @p num.
+    GEN_OPS    ///< Liczba rodzajów poleceń.
+};
+
+/** Nazwy rodzajów poleceń w opcji @p -m. */
+static const char* const opNames[GEN_OPS] = {
+    "new", "deldb", "add", "del", "get", "rev", "ntc"
+};
+
+/** Stan generatora.
+ */
+struct generator {
+    uint64_t state;                          ///< Stan generatora liczb losowych.
+    const char* digits;                      ///< Dozwolone cyfry.
+    size_t digitCount;                       ///< Liczba dozwolonych cyfr.
+    size_t maxLength;                        ///< Maksymalna długość numeru.
+    const char* engine;                      ///< Silnik baz lub NULL.
+    unsigned comments;                       ///< Komentarze na tysiąc tokenów.
+    unsigned noise;                          ///< Odstępy na tysiąc tokenów.
+    char areas[GEN_AREAS][8];                ///< Prefiksy kierunkowe.
+    char* recent;                            /**< Ostatnio dodane numery, każdy
+                                                  w komórce długości
+                                                  @p maxLength + 1. */
+    size_t recentCount;                      ///< Liczba zapamiętanych numerów.
+    unsigned fanIn;                          /**< Przekierowania na wspólny
+                                                  numer na tysiąc. */
+    char* hot;                               ///< Wspólny numer docelowy.
+    char* num1;                              ///< Bufor na pierwszy numer.
+    char* num2;                              ///< Bufor na drugi numer.
+    bool alive[GEN_MAX_DTBS];                ///< Które bazy istnieją.
+    size_t maxDtbs;                          ///< Maksymalna liczba baz.
+    int current;                             ///< Bieżąca baza lub -1.
+};
+
+/** @brief Losuje kolejną liczbę (xorshift64*).
+ * Wynik nie zależy od platformy, więc skrypt jest powtarzalny.
+ * @param[in,out] g  –  Wskaźnik na stan generatora.
+ * @return Losowa liczba 64-bitowa.
+ */
+static uint64_t genNext (struct generator* g) {
+    g->state ^= g->state >> 12;
+    g->state ^= g->state << 25;
+    g->state ^= g->state >> 27;
+
+    return g->state * UINT64_C(2685821657736338717);
+}
+
+/** Losuje liczbę z przedziału [0, @p bound).
+ * @param[in,out] g  –  Wskaźnik na stan generatora;
+ * @param[in] bound  –  Dodatnie ograniczenie.
+ * @return Losowa liczba.
+ */
+static size_t genBelow (struct generator* g, size_t bound) {
+    return (size_t)(genNext(g) % bound);
+}
+
+/** Sprawdza zdarzenie o prawdopodobieństwie @p permille / 1000.
+ * @param[in,out] g    –  Wskaźnik na stan generatora;
+ * @param[in] permille –  Prawdopodobieństwo w promilach.
+ * @return Wartość @p true, jeśli zdarzenie zaszło.
+ */
+static bool genChance (struct generator* g, unsigned permille) {
+    return genBelow(g, 1000) < permille;
+}
+
+/** Dopisuje losowe cyfry do numeru.
+ * @param[in,out] g  –  Wskaźnik na stan generatora;
+ * @param[out] num   –  Wskaźnik na koniec numeru;
+ * @param[in] count  –  Liczba cyfr.
+ */
+static void genDigits (struct generator* g, char* num, size_t count) {
+    for (size_t i = 0; i < count; i++)
+        num[i] = g->digits[genBelow(g, g->digitCount)];
+
+    num[count] = '\0';
+}
+
+/** @brief Losuje numer z prefiksem kierunkowym.
+ * @param[in,out] g  –  Wskaźnik na stan generatora;
+ * @param[out] num   –  Wskaźnik na bufor o rozmiarze co najmniej
+ *                      @p maxLength + 1.
+ */
+static void genNumber (struct generator* g, char* num) {
+    const char* area = g->areas[genBelow(g, GEN_AREAS)];
+    size_t areaLength = strlen(area);
+    size_t length = areaLength;
+
+    if (g->maxLength > areaLength)
+        length += genBelow(g, g->maxLength - areaLength + 1);
+
+    strcpy(num, area);
+    genDigits(g, num + areaLength, length - areaLength);
+}
+
+/** @brief Losuje numer zapytania.
+ * Zwykle jest to przedłużenie ostatnio dodanego numeru, więc zapytanie
+ * trafia w istniejące przekierowanie.
+ * @param[in,out] g  –  Wskaźnik na stan generatora;
+ * @param[out] num   –  Wskaźnik na bufor o rozmiarze co najmniej
+ *                      @p maxLength + @p GEN_QUERY_EXTRA + 1.
+ */
+static void genQuery (struct generator* g, char* num) {
+    if (g->recentCount == 0 || genChance(g, 300)) {
+        genNumber(g, num);
+        return;
+    }
+
+    strcpy(num, g->recent + genBelow(g, g->recentCount) * (g->maxLength + 1));
+
+    size_t length = strlen(num);
+
+    genDigits(g, num + length, genBelow(g, GEN_QUERY_EXTRA + 1));
+}
+
+/** Wypisuje komentarz, który nie jest znacznikiem fazy.
+ * @param[in,out] g  –  Wskaźnik na stan generatora.
+ */
+static void emitComment (struct generator* g) {
+    static const char* const words[] = {
+        "note", "TODO", "checked", "x > y ?", "@ DEL NEW", "$ single"
+    };
+
+    printf("$$ %s %zu $$", words[genBelow(g, sizeof(words) / sizeof(words[0]))],
+           genBelow(g, 100000));
+}
+
+/** @brief Wypisuje odstęp między tokenami.
+ * @param[in,out] g     –  Wskaźnik na stan generatora;
+ * @param[in] required  –  Czy odstęp musi być niepusty.
+ */
+static void emitGap (struct generator* g, bool required) {
+    static const char spaces[] = " \t\n\r";
+
+    if (genChance(g, g->comments)) {
+        putchar(' ');
+        emitComment(g);
+        putchar(' ');
+    }
+
+    else if (genChance(g, g->noise)) {
+        size_t count = 1 + genBelow(g, 3);
+
+        for (size_t i = 0; i < count; i++)
+            putchar(spaces[genBelow(g, sizeof(spaces) - 1)]);
+    }
+
+    else if (required || genChance(g, 500))
+        putchar(' ');
+}
+
+/** Wypisuje koniec polecenia.
+ * @param[in,out] g  –  Wskaźnik na stan generatora.
+ */
+static void emitEnd (struct generator* g) {
+    if (genChance(g, g->comments)) {
+        putchar(' ');
+        emitComment(g);
+    }
+
+    putchar('\n');
+}
+
+/** Zapamiętuje dodany numer do późniejszych zapytań.
+ * @param[in,out] g  –  Wskaźnik na stan generatora;
+ * @param[in] num    –  Wskaźnik na numer.
+ */
+static void rememberNumber (struct generator* g, const char* num) {
+    size_t index = g->recentCount < GEN_RECENT ? g->recentCount++ :
+                                                 genBelow(g, GEN_RECENT);
+
+    strcpy(g->recent + index * (g->maxLength + 1), num);
+}
+
+/** Wypisuje polecenie @p NEW dla bazy o danym numerze.
+ * @param[in,out] g  –  Wskaźnik na stan generatora;
+ * @param[in] dtb    –  Numer bazy.
+ */
+static void emitNew (struct generator* g, int dtb) {
+    printf("NEW");
+    emitGap(g, true);
+    printf("dtb%c", 'A' + dtb);
+
+    if (g->engine != NULL)
+        printf(" %s", g->engine);
+
+    emitEnd(g);
+
+    g->alive[dtb] = true;
+    g->current = dtb;
+}
+
+/** @brief Losuje przekierowanie.
+ * Przekierowywany numer jest zapamiętywany do późniejszych zapytań. Część
+ * przekierowań (zob. opcja @p -t) prowadzi na wspólny numer.
+ * @param[in,out] g  –  Wskaźnik na stan generatora;
+ * @param[out] num1  –  Wskaźnik na bufor na przekierowywany numer;
+ * @param[out] num2  –  Wskaźnik na bufor na numer docelowy, różny od
+ *                      @p num1.
+ */
+static void genForward (struct generator* g, char* num1, char* num2) {
+    genNumber(g, num1);
+
+    // Bez opcji -t nie losujemy, więc skrypty pozostają takie same.
+    if (g->fanIn > 0 && genChance(g, g->fanIn) && strcmp(num1, g->hot) != 0)
+        strcpy(num2, g->hot);
+
+    else {
+        do {
+            genNumber(g, num2);
+        } while (strcmp(num1, num2) == 0);
+    }
+
+    rememberNumber(g, num1);
+}
+
+/** Wypisuje polecenie @p num @p > @p num.
+ * @param[in,out] g  –  Wskaźnik na stan generatora.
+ */
+static void emitAdd (struct generator* g) {
+    genForward(g, g->num1, g->num2);
+
+    printf("%s", g->num1);
+    emitGap(g, false);
+    putchar('>');
+    emitGap(g, false);
+    printf("%s", g->num2);
+    emitEnd(g);
+}
+
+/** Wypisuje polecenie @p DEL @p num.
+ * @param[in,out] g  –  Wskaźnik na stan generatora.
+ */
+static void emitDel (struct generator* g) {
+    genQuery(g, g->num1);
+
+    printf("DEL");
+    emitGap(g, true);
+    printf("%s", g->num1);
+    emitEnd(g);
+}
+
+/** Wypisuje polecenie @p num @p ? lub @p ? @p num.
+ * Część zapytań odwrotnych (zob. opcja @p -t) dotyczy wspólnego numeru.
+ * @param[in,out] g     –  Wskaźnik na stan generatora;
+ * @param[in] reverse  –  Czy polecenie ma być odwrotne.
+ */
+static void emitQuery (struct generator* g, bool reverse) {
+    char* num = g->num1;
+
+    if (reverse && g->fanIn > 0 && genChance(g, g->fanIn))
+        strcpy(num, g->hot);
+    else
+        genQuery(g, num);
+
+    if (reverse) {
+        putchar('?');
+        emitGap(g, false);
+        printf("%s", num);
+    }
+
+    else {
+        printf("%s", num);
+        emitGap(g, false);
+        putchar('?');
+    }
+
+    emitEnd(g);
+}
+
+/** Wypisuje polecenie @p @ @p num.
+ * Numer zawiera wszystkie dozwolone cyfry i ma długość co najwyżej 14.
+ * @param[in,out] g  –  Wskaźnik na stan generatora.
+ */
+static void emitNtc (struct generator* g) {
+    char num[15];
+    size_t length = 12 + genBelow(g, 3);
+
+    for (size_t i = 0; i < length; i++)
+        num[i] = g->digits[i % g->digitCount];
+
+    num[length] = '\0';
+
+    putchar('@');
+    emitGap(g, false);
+    printf("%s", num);
+    emitEnd(g);
+}
+
+/** Wypisuje polecenie @p DEL @p id dla bazy o danym numerze.
+ * @param[in,out] g  –  Wskaźnik na stan generatora;
+ * @param[in] dtb    –  Numer istniejącej bazy.
+ */
+static void emitDelDtb (struct generator* g, int dtb) {
+    printf("DEL");
+    emitGap(g, true);
+    printf("dtb%c", 'A' + dtb);
+    emitEnd(g);
+
+    g->alive[dtb] = false;
+
+    if (g->current == dtb)
+        g->current = -1;
+}
+
+/** Losuje numer istniejącej bazy.
+ * @param[in,out] g  –  Wskaźnik na stan generatora.
+ * @return Numer bazy lub -1, jeśli nie ma żadnej.
+ */
+static int pickAlive (struct generator* g) {
+    int count = 0;
+
+    for (size_t i = 0; i < g->maxDtbs; i++)
+        count += g->alive[i] ? 1 : 0;
+
+    if (count == 0)
+        return -1;
+
+    int skip = (int)genBelow(g, (size_t)count);
+
+    for (size_t i = 0; i < g->maxDtbs; i++) {
+        if (g->alive[i] && skip-- == 0)
+            return (int)i;
+    }
+
+    return -1;
+}
+
+/** @brief Wypisuje losowe polecenie fazy @p mixed.
+ * Polecenia na numerach wymagają bieżącej bazy, więc gdy jej nie ma,
+ * najpierw wypisywane jest polecenie @p NEW.
+ * @param[in,out] g     –  Wskaźnik na stan generatora;
+ * @param[in] weights  –  Wagi rodzajów poleceń;
+ * @param[in] total    –  Suma wag.
+ */
+static void emitMixed (struct generator* g, const unsigned* weights,
+                       unsigned total) {
+    size_t roll = genBelow(g, total);
+    int op = 0;
+
+    while (roll >= weights[op]) {
+        roll -= weights[op];
+        op++;
+    }
+
+    if (op == GEN_NEW || (g->current < 0 && op != GEN_DELDB)) {
+        emitNew(g, (int)genBelow(g, g->maxDtbs));
+        return;
+    }
+
+    if (op == GEN_DELDB) {
+        int dtb = pickAlive(g);
+
+        if (dtb < 0)
+            emitNew(g, (int)genBelow(g, g->maxDtbs));
+        else
+            emitDelDtb(g, dtb);
+    }
+
+    else if (op == GEN_ADD)
+        emitAdd(g);
+
+    else if (op == GEN_DEL)
+        emitDel(g);
+
+    else if (op == GEN_GET || op == GEN_REV)
+        emitQuery(g, op == GEN_REV);
+
+    else
+        emitNtc(g);
+}
+
+/** @brief Wczytuje wagi poleceń z opcji @p -m.
+ * Nie podane rodzaje poleceń mają wagę 0.
+ * @param[in] mix       –  Wskaźnik na napis @p nazwa:waga,...;
+ * @param[out] weights  –  Wskaźnik na tablicę wag.
+ * @return Wartość @p true, jeśli napis jest poprawny i suma wag jest dodatnia.
+ */
+static bool parseMix (const char* mix, unsigned* weights) {
+    unsigned total = 0;
+
+    for (int i = 0; i < GEN_OPS; i++)
+        weights[i] = 0;
+
+    while (*mix != '\0') {
+        const char* colon = strchr(mix, ':');
+
+        if (colon == NULL)
+            return false;
+
+        int op = 0;
+
+        while (op < GEN_OPS && (strlen(opNames[op]) != (size_t)(colon - mix) ||
+               strncmp(opNames[op], mix, (size_t)(colon - mix)) != 0))
+            op++;
+
+        char* end;
+        unsigned long weight = strtoul(colon + 1, &end, 10);
+
+        if (op == GEN_OPS || end == colon + 1 || weight > 1000000 ||
+            (*end != ',' && *end != '\0'))
+            return false;
+
+        weights[op] = (unsigned)weight;
+        total += (unsigned)weight;
+        mix = *end == ',' ? end + 1 : end;
+    }
+
+    return total > 0;
+}
+
+/** @brief Przygotowuje dane dla trybu @p --lookup.
+ * Zapisuje bazę przekierowań do pliku i wypisuje strumień numerów zapytań.
+ * @param[in,out] g  –  Wskaźnik na stan generatora;
+ * @param[in] path   –  Wskaźnik na ścieżkę pliku bazy;
+ * @param[in] load   –  Liczba przekierowań bazy;
+ * @param[in] ops    –  Liczba numerów zapytań.
+ * @return Wartość @p true, jeśli zapisano bazę. Wartość @p false, jeśli
+ *         wystąpił błąd zapisu pliku.
+ */
+static bool emitLookup (struct generator* g, const char* path,
+                        unsigned long load, unsigned long ops) {
+    FILE* database = fopen(path, "w");
+
+    if (database == NULL)
+        return false;
+
+    for (unsigned long i = 0; i < load; i++) {
+        genForward(g, g->num1, g->num2);
+        fprintf(database, "%s > %s\n", g->num1, g->num2);
+    }
+
+    bool ok = fclose(database) == 0;
+
+    // Prefiks kończący się na fazie load tylko wczytuje bazę.
+    printf("$$ phase load ops=%lu $$\n", load);
+    printf("$$ phase lookup ops=%lu $$\n", ops);
+
+    for (unsigned long i = 0; i < ops; i++) {
+        genQuery(g, g->num1);
+        printf("%s\n", g->num1);
+    }
+
+    return ok;
+}
+
+/** Zwalnia bufory generatora.
+ * @param[in,out] g  –  Wskaźnik na stan generatora.
+ */
+static void genFree (struct generator* g) {
+    free(g->recent);
+    free(g->hot);
+    free(g->num1);
+    free(g->num2);
+}
+
+/** Wypisuje sposób użycia programu.
+ * @param[in] name  –  Nazwa programu.
+ */
+static void usage (const char* name) {
+    fprintf(stderr, "usage: %s [-s seed] [-l load] [-n ops] [-m mix] [-b dtbs]"
+                    " [-k maxlen] [-d digits] [-e engine] [-c comments]"
+                    " [-w noise] [-t fanin] [-x stress] [-o database]\n", name);
+}
+
+/** Wypisuje skrypt zgodnie z opcjami.
+ * @param[in] argc  –  Liczba argumentów programu;
+ * @param[in] argv  –  Tablica argumentów programu.
+ * @return Wartość 0, gdy wypisano skrypt. Wartość 1, gdy opcje są niepoprawne,
+ *         nie udało się zaalokować pamięci lub zapisać bazy.
+ */
+int main (int argc, char* argv[]) {
+    static struct generator g;
+    unsigned long long seed = 1;
+    unsigned long load = 100000;
+    unsigned long ops = 100000;
+    unsigned weights[GEN_OPS];
+    const char* mix = "new:1,deldb:1,add:30,del:3,get:50,rev:10,ntc:1";
+    const char* database = NULL;
+    bool ok = true;
+
+    g.digits = "0123456789";
+    g.maxLength = 12;
+    g.maxDtbs = 4;
+    g.comments = 20;
+    g.noise = 100;
+    g.current = -1;
+
+    for (int i = 1; ok && i < argc; i++) {
+        if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0' ||
+            i + 1 == argc) {
+            ok = false;
+            break;
+        }
+
+        char option = argv[i][1];
+        const char* value = argv[++i];
+
+        if (option == 's')
+            seed = strtoull(value, NULL, 10);
+
+        else if (option == 'l')
+            load = strtoul(value, NULL, 10);
+
+        else if (option == 'n')
+            ops = strtoul(value, NULL, 10);
+
+        else if (option == 'm')
+            mix = value;
+
+        else if (option == 'b')
+            g.maxDtbs = strtoul(value, NULL, 10);
+
+        else if (option == 'k')
+            g.maxLength = strtoul(value, NULL, 10);
+
+        else if (option == 'd')
+            g.digits = value;
+
+        else if (option == 'e')
+            g.engine = value;
+
+        else if (option == 'c')
+            g.comments = (unsigned)strtoul(value, NULL, 10);
+
+        else if (option == 'w')
+            g.noise = (unsigned)strtoul(value, NULL, 10);
+
+        else if (option == 't')
+            g.fanIn = (unsigned)strtoul(value, NULL, 10);
+
+        else if (option == 'x') {
+            g.maxLength = strtoul(value, NULL, 10);
+            g.fanIn = 500;
+            mix = "add:40,del:1,get:30,rev:30";
+        }
+
+        else if (option == 'o')
+            database = value;
+
+        else
+            ok = false;
+    }
+
+    g.digitCount = strlen(g.digits);
+
+    for (size_t i = 0; ok && i < g.digitCount; i++)
+        ok = (g.digits[i] >= '0' && g.digits[i] <= '9') || g.digits[i] == ':' ||
+             g.digits[i] == ';';
+
+    if (!ok || !parseMix(mix, weights) || g.digitCount == 0 ||
+        g.maxDtbs == 0 || g.maxDtbs > GEN_MAX_DTBS || g.maxLength == 0 ||
+        g.maxLength > GEN_MAX_LENGTH || g.fanIn > 1000) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    size_t width = g.maxLength + GEN_QUERY_EXTRA + 1;
+
+    g.recent = malloc(GEN_RECENT * (g.maxLength + 1));
+    g.hot = malloc(width);
+    g.num1 = malloc(width);
+    g.num2 = malloc(width);
+
+    if (g.recent == NULL || g.hot == NULL || g.num1 == NULL || g.num2 == NULL) {
+        fprintf(stderr, "MEMORY ERROR\n");
+        genFree(&g);
+        return 1;
+    }
+
+    unsigned total = 0;
+
+    for (int i = 0; i < GEN_OPS; i++)
+        total += weights[i];
+
+    // Zerowe ziarno zatrzymałoby generator xorshift.
+    g.state = seed * UINT64_C(0x9E3779B97F4A7C15) + 1;
+
+    for (size_t i = 0; i < GEN_AREAS; i++) {
+        size_t length = 2 + genBelow(&g, 3);
+
+        if (length > g.maxLength)
+            length = g.maxLength;
+
+        genDigits(&g, g.areas[i], length);
+    }
+
+    if (g.fanIn > 0)
+        genNumber(&g, g.hot);
+
+    static char output[1 << 16];
+    setvbuf(stdout, output, _IOFBF, sizeof(output));
+
+    if (database != NULL) {
+        bool written = emitLookup(&g, database, load, ops);
+
+        genFree(&g);
+
+        if (!written) {
+            fprintf(stderr, "ERROR cannot write %s\n", database);
+            return 1;
+        }
+
+        return fflush(stdout) == 0 ? 0 : 1;
+    }
+
+    printf("$$ phase load ops=%lu $$\n", load + 1);
+    emitNew(&g, 0);
+
+    for (unsigned long i = 0; i < load; i++)
+        emitAdd(&g);
+
+    printf("$$ phase mixed ops=%lu $$\n", ops);
+
+    for (unsigned long i = 0; i < ops; i++)
+        emitMixed(&g, weights, total);
+
+    // Faza teardown: usuwamy część przekierowań, a potem wszystkie bazy.
+    bool reopen = g.current < 0;
+    size_t teardown = GEN_TEARDOWN_DELS + (reopen ? 1 : 0);
+
+    for (size_t i = 0; i < g.maxDtbs; i++)
+        teardown += g.alive[i] || (reopen && i == 0) ? 1 : 0;
+
+    printf("$$ phase teardown ops=%zu $$\n", teardown);
+
+    if (reopen)
+        emitNew(&g, 0);
+
+    for (size_t i = 0; i < GEN_TEARDOWN_DELS; i++)
+        emitDel(&g);
+
+    for (size_t i = 0; i < g.maxDtbs; i++) {
+        if (g.alive[i])
+            emitDelDtb(&g, (int)i);
+    }
+
+    genFree(&g);
+
+    return fflush(stdout) == 0 ? 0 : 1;
+}
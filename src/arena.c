@@ -0,0 +1,112 @@
+/** @file
+ * Implementacja areny, czyli alokatora przydzielającego pamięć kolejnymi
+ * kawałkami z dużych bloków, zwalnianych dopiero razem z całą areną.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#include "arena.h"
+#include <stdint.h>
+#include <string.h>
+
+/** Blok pamięci areny. Dane następują bezpośrednio po nagłówku.
+ */
+struct arenaChunk {
+    struct arenaChunk* next; ///< Wskaźnik na poprzednio zapełniany blok.
+    size_t size;             ///< Rozmiar obszaru danych.
+    size_t used;             ///< Liczba zajętych bajtów obszaru danych.
+};
+
+Arena arenaNew (size_t chunkSize) {
+    Arena a = malloc(sizeof(struct arena));
+
+    if (a != NULL) {
+        a->chunks = NULL;
+        a->chunkSize = chunkSize;
+        a->bytes = 0;
+        a->next = NULL;
+    }
+
+    return a;
+}
+
+void* arenaAlloc (Arena a, size_t size, size_t align) {
+    struct arenaChunk* chunk = a->chunks;
+
+    if (chunk != NULL) {
+        uintptr_t start = (uintptr_t)(chunk + 1);
+        uintptr_t ptr = (start + chunk->used + align - 1) & ~(uintptr_t)(align - 1);
+
+        if (ptr + size <= start + chunk->size) {
+            chunk->used = ptr + size - start;
+            return (void*)ptr;
+        }
+    }
+
+    // Brak miejsca w bieżącym bloku, więc alokujemy nowy.
+    size_t chunkSize = a->chunkSize;
+
+    if (chunkSize < size + align)
+        chunkSize = size + align;
+
+    chunk = malloc(sizeof(struct arenaChunk) + chunkSize);
+
+    if (chunk == NULL)
+        return NULL;
+
+    chunk->next = a->chunks;
+    chunk->size = chunkSize;
+    chunk->used = 0;
+    a->chunks = chunk;
+    a->bytes += chunkSize;
+
+    return arenaAlloc(a, size, align);
+}
+
+char* arenaCopyString (Arena a, const char* str, size_t length) {
+    char* copy = arenaAlloc(a, length + 1, 1);
+
+    if (copy != NULL) {
+        memcpy(copy, str, length);
+        copy[length] = '\0';
+    }
+
+    return copy;
+}
+
+void arenaDelete (Arena a) {
+    if (a != NULL) {
+        struct arenaChunk* chunk = a->chunks;
+
+        while (chunk != NULL) {
+            struct arenaChunk* next = chunk->next;
+            free(chunk);
+            chunk = next;
+        }
+
+        free(a);
+    }
+}
+
+Arena arenaListConcat (Arena first, Arena second) {
+    if (first == NULL)
+        return second;
+
+    Arena last = first;
+
+    while (last->next != NULL)
+        last = last->next;
+
+    last->next = second;
+
+    return first;
+}
+
+void arenaListDelete (Arena a) {
+    while (a != NULL) {
+        Arena next = a->next;
+        arenaDelete(a);
+        a = next;
+    }
+}
@@ -0,0 +1,80 @@
+/** @file
+ * Specyfikacja areny, czyli alokatora przydzielającego pamięć kolejnymi
+ * kawałkami z dużych bloków, zwalnianych dopiero razem z całą areną.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#ifndef TELEFONY_ARENA_H
+#define TELEFONY_ARENA_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+struct arenaChunk;
+
+/** @brief Arena pamięci.
+ * Pamięć przydzielana jest kolejno z bloków o rozmiarze co najmniej
+ * @p chunkSize, więc obiekty alokowane jeden po drugim leżą obok siebie.
+ * Pojedynczych obiektów nie można zwolnić. Areny można łączyć w listę.
+ */
+struct arena {
+    struct arenaChunk* chunks; ///< Lista bloków; pierwszy jest aktualnie zapełniany.
+    size_t chunkSize;          ///< Domyślny rozmiar nowego bloku.
+    size_t bytes;              ///< Łączny rozmiar wszystkich bloków.
+    struct arena* next;        ///< Wskaźnik na następną arenę na liście.
+};
+
+/** Skrócona nazwa na wskaźnik na strukturę @p arena.
+ */
+typedef struct arena* Arena;
+
+/** @brief Tworzy nową, pustą arenę.
+ * Arenę trzeba potem zwolnić używając funkcji @ref arenaDelete.
+ * @param[in] chunkSize  –  Domyślny rozmiar bloku w bajtach.
+ * @return Wskaźnik na nową arenę lub NULL, jeśli nie udało się zaalokować
+ *         pamięci.
+ */
+Arena arenaNew (size_t chunkSize);
+
+/** @brief Przydziela pamięć z areny.
+ * Jeśli w bieżącym bloku brakuje miejsca, alokuje nowy blok.
+ * @param[in,out] a   –  Wskaźnik na arenę;
+ * @param[in] size    –  Rozmiar przydzielanego obszaru w bajtach;
+ * @param[in] align   –  Wymagane wyrównanie (potęga dwójki).
+ * @return Wskaźnik na przydzielony obszar lub NULL, jeśli nie udało się
+ *         zaalokować pamięci.
+ */
+void* arenaAlloc (Arena a, size_t size, size_t align);
+
+/** @brief Kopiuje napis do areny.
+ * @param[in,out] a   –  Wskaźnik na arenę;
+ * @param[in] str     –  Wskaźnik na kopiowany napis;
+ * @param[in] length  –  Długość napisu.
+ * @return Wskaźnik na kopię napisu zakończoną znakiem '\0' lub NULL, jeśli
+ *         nie udało się zaalokować pamięci.
+ */
+char* arenaCopyString (Arena a, const char* str, size_t length);
+
+/** @brief Usuwa arenę.
+ * Zwalnia wszystkie bloki areny i samą strukturę. Nic nie robi, jeśli
+ * wskaźnik ma wartość NULL. Nie usuwa aren dalej na liście.
+ * @param[in] a  –  Wskaźnik na arenę.
+ */
+void arenaDelete (Arena a);
+
+/** @brief Łączy dwie listy aren.
+ * @param[in,out] first  –  Wskaźnik na pierwszą arenę pierwszej listy lub NULL;
+ * @param[in] second     –  Wskaźnik na pierwszą arenę drugiej listy lub NULL.
+ * @return Wskaźnik na pierwszą arenę listy złożonej z aren pierwszej listy,
+ *         po których następują areny drugiej listy.
+ */
+Arena arenaListConcat (Arena first, Arena second);
+
+/** @brief Usuwa listę aren.
+ * @param[in] a  –  Wskaźnik na pierwszą arenę na liście.
+ */
+void arenaListDelete (Arena a);
+
+#endif //TELEFONY_ARENA_H
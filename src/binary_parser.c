@@ -0,0 +1,373 @@
+/** @file
+ * Implementacja parsera binarnego protokołu operacji na numerach telefonów.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#include "binary_parser.h"
+#include "phfwd_engine.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <string.h>
+
+/** Rozmiar porcji, w których wczytywany jest argument polecenia. */
+#define BINARY_ARG_CHUNK 65536
+
+/** Kody poleceń binarnego protokołu.
+ */
+enum binaryOpcode {
+    BINARY_NEW = 'N',     ///< Polecenie @p NEW @p id [@p silnik].
+    BINARY_DEL = 'D',     ///< Polecenie @p DEL @p id lub @p DEL @p num.
+    BINARY_ADD = '>',     ///< Polecenie @p num @p > @p num.
+    BINARY_GET = '?',     ///< Polecenie @p num @p ?.
+    BINARY_REVERSE = 'R', ///< Polecenie @p ? @p num.
+    BINARY_NTC = '@'      ///< Polecenie @p @ @p num.
+};
+
+/** @brief Wczytuje 32-bitową liczbę zapisaną w kolejności little-endian.
+ * Jeśli dane wejściowe się skończą, wypisuje błąd.
+ * @param[in,out] pos  –  Liczba przetworzonych bajtów wejścia;
+ * @param[out] value   –  Wskaźnik na wczytaną liczbę.
+ * @return Wartość @p true, jeśli udało się wczytać liczbę.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool readU32 (size_t* pos, uint32_t* value) {
+    unsigned char bytes[4];
+
+    if (fread(bytes, 1, 4, stdin) != 4) {
+        fprintf(stderr, "ERROR EOF\n");
+        return false;
+    }
+
+    *pos += 4;
+    *value = (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 |
+             (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+
+    return true;
+}
+
+/** @brief Wczytuje argument polecenia do bufora.
+ * Napis w buforze jest zakończony znakiem '\0'. Długość argumentu pochodzi
+ * z wejścia, więc argument wczytywany jest porcjami, a bufor rośnie dopiero
+ * wraz z wczytanymi danymi. Uszkodzona długość kończy się zatem błędem
+ * końca danych, a nie próbą zaalokowania pamięci na cały argument. Jeśli
+ * dane wejściowe się skończą lub nie uda się zaalokować pamięci, wypisuje
+ * błąd.
+ * @param[in,out] pos     –  Liczba przetworzonych bajtów wejścia;
+ * @param[in,out] buffer  –  Wskaźnik na bufor danych typu @p dynamicString.
+ * @return Wartość @p true, jeśli udało się wczytać argument.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool readArg (size_t* pos, dynStr buffer) {
+    uint32_t length;
+
+    if (!readU32(pos, &length))
+        return false;
+
+    size_t done = 0;
+
+    while (done < length) {
+        size_t step = length - done < BINARY_ARG_CHUNK ? length - done :
+                                                         BINARY_ARG_CHUNK;
+        size_t reserve = 2 * buffer->size;
+
+        // Bufor podwajamy, żeby długi argument nie był wiele razy kopiowany.
+        if (reserve > length)
+            reserve = length;
+
+        if (reserve < done + step)
+            reserve = done + step;
+
+        if (done + step >= buffer->size && !dynStrReserve(buffer, reserve)) {
+            fprintf(stderr, "MEMORY ERROR\n");
+            return false;
+        }
+
+        if (fread(buffer->str + done, 1, step, stdin) != step) {
+            fprintf(stderr, "ERROR EOF\n");
+            return false;
+        }
+
+        done += step;
+    }
+
+    if (!dynStrReserve(buffer, length)) {
+        fprintf(stderr, "MEMORY ERROR\n");
+        return false;
+    }
+
+    *pos += length;
+    buffer->str[length] = '\0';
+    buffer->used = (size_t)length + 1;
+
+    return true;
+}
+
+/** Sprawdza, czy napis w buforze jest niepustym numerem.
+ * @param[in] buffer  –  Wskaźnik na bufor danych typu @p dynamicString.
+ * @return Wartość @p true, jeśli napis jest numerem.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool isNumArg (dynStr buffer) {
+    for (size_t i = 0; i + 1 < buffer->used; i++)
+        if (!isValidDigit(buffer->str[i]))
+            return false;
+
+    return buffer->used > 1;
+}
+
+/** Sprawdza, czy napis w buforze jest identyfikatorem bazy, tzn. niepustym
+ * napisem alfanumerycznym zaczynającym się od litery.
+ * @param[in] buffer  –  Wskaźnik na bufor danych typu @p dynamicString.
+ * @return Wartość @p true, jeśli napis jest identyfikatorem.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool isIdArg (dynStr buffer) {
+    for (size_t i = 0; i + 1 < buffer->used; i++)
+        if (isalnum((unsigned char)buffer->str[i]) == 0)
+            return false;
+
+    return buffer->used > 1 && isalpha((unsigned char)buffer->str[0]) != 0;
+}
+
+/** Zapisuje 32-bitową liczbę w kolejności little-endian na standardowe wyjście.
+ * @param[in] value  –  Zapisywana liczba.
+ */
+static void writeU32 (uint32_t value) {
+    unsigned char bytes[4] = {(unsigned char)value,
+                              (unsigned char)(value >> 8),
+                              (unsigned char)(value >> 16),
+                              (unsigned char)(value >> 24)};
+
+    fwrite(bytes, 1, 4, stdout);
+}
+
+/** @brief Zapisuje numer jako element odpowiedzi typu lista.
+ * Funkcja typu @ref PhoneNumCallback.
+ * @param[in] ctx  –  Nieużywany.
+ * @param[in] num  –  Wskaźnik na napis reprezentujący numer.
+ * @return Zawsze wartość @p true.
+ */
+static bool writeNumber (void* ctx, const char* num) {
+    (void)ctx;
+    size_t length = strlen(num);
+
+    writeU32((uint32_t)length);
+    fwrite(num, 1, length, stdout);
+
+    return true;
+}
+
+/** Wypisuje błąd wykonania polecenia.
+ * @param[in] framePos  –  Numer pierwszego bajtu ramki;
+ * @param[in] op        –  Wskaźnik na napis reprezentujący operator.
+ */
+static void binaryExecError (size_t framePos, const char* op) {
+    fprintf(stderr, "ERROR %s %zu\n", op, framePos);
+}
+
+/** @brief Wykonuje polecenie NEW.
+ * Działa tak jak polecenie NEW interfejsu tekstowego; pusty silnik oznacza
+ * silnik domyślny.
+ * @param[in] id           –  Wskaźnik na bufor z identyfikatorem bazy;
+ * @param[in] engine       –  Wskaźnik na bufor z nazwą silnika;
+ * @param[in] framePos     –  Numer pierwszego bajtu ramki;
+ * @param[in,out] dtblist  –  Wskaźnik na pierwszą komórkę listy baz przekierowań;
+ * @param[in,out] current  –  Wskaźnik na aktualnie używaną bazę przekierowań.
+ * @return Wartość @p true, jeśli udało się wykonać polecenie.
+ *         Wartość @p false, jeśli gdzieś wystąpił błąd.
+ */
+static bool binaryNew (dynStr id, dynStr engine, size_t framePos,
+                       dtbList* dtblist, dtbList* current) {
+    bool explicitEngine = engine->used > 1;
+    const char* name = explicitEngine ? engine->str : PHFWD_DEFAULT_ENGINE;
+
+    if (!isIdArg(id)) {
+        fprintf(stderr, "ERROR %zu\n", framePos);
+        return false;
+    }
+
+    if (!phfwdEngineExists(name)) {
+        binaryExecError(framePos, "NEW");
+        return false;
+    }
+
+    dtbList dtb = getDtb(*dtblist, id->str);
+
+    if (dtb != NULL) {
+        // Jawnie podany silnik musi się zgadzać z silnikiem bazy.
+        if (explicitEngine && strcmp(phfwdEngineName(dtb->database), name) != 0) {
+            binaryExecError(framePos, "NEW");
+            return false;
+        }
+
+        *current = dtb;
+        return true;
+    }
+
+    dtb = addDtb(dtblist, id->str, name);
+
+    if (dtb == NULL) {
+        fprintf(stderr, "MEMORY ERROR\n");
+        return false;
+    }
+
+    *current = dtb;
+    return true;
+}
+
+/** @brief Wyznacza rodzaj polecenia o danym kodzie.
+ * Polecenie @p DEL traktowane jest jak @p DEL @p id, dopóki argument nie
+ * okaże się numerem.
+ * @param[in] opcode  –  Kod polecenia.
+ * @return Rodzaj polecenia lub @p COMMAND_NONE dla nieznanego kodu.
+ */
+static enum commandType opcodeCommand (int opcode) {
+    if (opcode == BINARY_NEW)
+        return COMMAND_NEW;
+
+    else if (opcode == BINARY_DEL)
+        return COMMAND_DEL_ID;
+
+    else if (opcode == BINARY_ADD)
+        return COMMAND_ADD;
+
+    else if (opcode == BINARY_GET)
+        return COMMAND_GET;
+
+    else if (opcode == BINARY_REVERSE)
+        return COMMAND_REVERSE;
+
+    else if (opcode == BINARY_NTC)
+        return COMMAND_NTC;
+
+    return COMMAND_NONE;
+}
+
+bool parseBinary (size_t* pos, dynStr buffer, dynStr scratch,
+                  dtbList* dtblist, dtbList* current,
+                  enum commandType* command) {
+    size_t framePos = *pos + 1;
+    int c = getchar();
+    (*pos)++;
+
+    *command = opcodeCommand(c);
+
+    if (c == EOF) {
+        fprintf(stderr, "ERROR EOF\n");
+        return false;
+    }
+
+    if (c == BINARY_NEW)
+        return readArg(pos, buffer) && readArg(pos, scratch) &&
+               binaryNew(buffer, scratch, framePos, dtblist, current);
+
+    else if (c == BINARY_DEL) {
+        if (!readArg(pos, buffer))
+            return false;
+
+        // Tak jak w interfejsie tekstowym, cyfra rozpoczyna numer.
+        if (isNumArg(buffer)) {
+            *command = COMMAND_DEL_NUM;
+
+            if (*current == NULL) {
+                binaryExecError(framePos, "DEL");
+                return false;
+            }
+
+            phfwdRemove((*current)->database, buffer->str);
+            return true;
+        }
+
+        if (!isIdArg(buffer)) {
+            fprintf(stderr, "ERROR %zu\n", framePos);
+            return false;
+        }
+
+        if (*current != NULL && strcmp(buffer->str, (*current)->id) == 0)
+            *current = NULL;
+
+        if (!removeDtb(dtblist, buffer->str)) {
+            binaryExecError(framePos, "DEL");
+            return false;
+        }
+
+        return true;
+    }
+
+    else if (c == BINARY_ADD) {
+        if (!readArg(pos, buffer) || !readArg(pos, scratch))
+            return false;
+
+        if (!isNumArg(buffer) || !isNumArg(scratch)) {
+            fprintf(stderr, "ERROR %zu\n", framePos);
+            return false;
+        }
+
+        if (*current == NULL ||
+            !phfwdAdd((*current)->database, buffer->str, scratch->str)) {
+            binaryExecError(framePos, ">");
+            return false;
+        }
+
+        return true;
+    }
+
+    else if (c == BINARY_GET || c == BINARY_REVERSE || c == BINARY_NTC) {
+        const char* op = c == BINARY_NTC ? "@" : "?";
+
+        if (!readArg(pos, buffer))
+            return false;
+
+        if (!isNumArg(buffer)) {
+            fprintf(stderr, "ERROR %zu\n", framePos);
+            return false;
+        }
+
+        /* Wszelkie operacje na numerach przy nieustawionej bazie przekierowań
+         * są błędne. */
+        if (*current == NULL) {
+            binaryExecError(framePos, op);
+            return false;
+        }
+
+        if (c == BINARY_GET) {
+            const PhoneNum* phfwd = phfwdGet((*current)->database, buffer->str);
+
+            if (phfwd == NULL) {
+                binaryExecError(framePos, op);
+                return false;
+            }
+
+            writeNumber(NULL, phnumGet(phfwd, 0));
+            phnumDelete(phfwd);
+        }
+
+        else if (c == BINARY_REVERSE) {
+            if (!phfwdReverseEach((*current)->database, buffer->str,
+                                  writeNumber, NULL)) {
+                binaryExecError(framePos, op);
+                return false;
+            }
+        }
+
+        else {
+            // Długość numeru wyznaczana jest tak jak w interfejsie tekstowym.
+            size_t len = buffer->used - 1 < 12 ? 0 : buffer->used - 1 - 12;
+            uint64_t count = phfwdNonTrivialCount((*current)->database,
+                                                  buffer->str, len);
+
+            writeU32((uint32_t)count);
+            writeU32((uint32_t)(count >> 32));
+            return true;
+        }
+
+        writeU32(0);
+        return true;
+    }
+
+    fprintf(stderr, "ERROR %zu\n", framePos);
+    return false;
+}
@@ -0,0 +1,57 @@
+/** @file
+ * Specyfikacja parsera binarnego protokołu operacji na numerach telefonów.
+ *
+ * Protokół wybierany jest opcją @p --binary i udostępnia te same operacje co
+ * interfejs tekstowy, bez białych znaków i komentarzy. Liczby zapisywane są
+ * w kolejności little-endian. Ramka polecenia to bajt kodu polecenia, po
+ * którym następują jego argumenty; każdy argument to 32-bitowa długość i
+ * tyle bajtów napisu (bez znaku '\0').
+ *
+ * Polecenie            | Kod | Argumenty                   | Odpowiedź
+ * -------------------- | --- | --------------------------- | ---------
+ * @p NEW @p id         | 'N' | id, silnik (może być pusty) | brak
+ * @p DEL @p id lub num | 'D' | id lub numer                | brak
+ * @p num @p > @p num   | '>' | numer, numer                | brak
+ * @p num @p ?          | '?' | numer                       | lista
+ * @p ? @p num          | 'R' | numer                       | lista
+ * @p @ @p num          | '@' | numer                       | 64-bitowa liczba
+ *
+ * Odpowiedź typu lista to kolejne napisy zapisane jak argumenty, zakończone
+ * 32-bitowym zerem (numery nie są puste).
+ * Błędy wypisywane są na wyjście diagnostyczne tak jak w interfejsie
+ * tekstowym, a pozycją błędu jest numer (od 1) pierwszego bajtu ramki.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+#ifndef TELEFONY_BINARY_PARSER_H
+#define TELEFONY_BINARY_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "dynamic_string.h"
+#include "phfwd_database_list.h"
+#include "parser.h"
+
+/** @brief Funkcja przetwarzająca jedną ramkę binarnego protokołu.
+ * Wczytuje ze standardowego wejścia jedną ramkę polecenia, wykonuje je i
+ * zapisuje odpowiedź na standardowe wyjście. Jeśli ramka jest niepoprawna,
+ * urwana lub nie udało się wykonać polecenia, wypisuje błąd.
+ * @param[in,out] pos      –  Wskaźnik na zmienną zawierającą liczbę
+ *                            przetworzonych bajtów wejścia.
+ * @param[in,out] buffer   –  Wskaźnik na strukturę @p dynamicString będącą
+ *                            buforem na pierwszy argument.
+ * @param[in,out] scratch  –  Wskaźnik na strukturę @p dynamicString będącą
+ *                            buforem na drugi argument.
+ * @param[in,out] dtblist  –  Wskaźnik na pierwszą komórkę listy baz przekierowań.
+ * @param[in,out] current  –  Wskaźnik na aktualnie używaną bazę przekierowań.
+ * @param[out] command     –  Wskaźnik na zmienną, w której zapisywany jest
+ *                            rodzaj polecenia ramki.
+ * @return Wartość @p true, jeśli udało się wykonać polecenie.
+ *         Wartość @p false, jeśli gdzieś wystąpił błąd.
+ */
+bool parseBinary (size_t* pos, dynStr buffer, dynStr scratch,
+                  dtbList* dtblist, dtbList* current,
+                  enum commandType* command);
+
+#endif //TELEFONY_BINARY_PARSER_H
@@ -0,0 +1,679 @@
+/** @file
+ * Implementacja zapisu i odtwarzania strumienia poleceń.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "command_trace.h"
+#include "binary_parser.h"
+#include "read_all.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TRACE_MAGIC "PHFWDTR1"       ///< Napis rozpoczynający plik zapisu.
+#define TRACE_MAGIC_LENGTH 8         ///< Długość napisu @ref TRACE_MAGIC.
+#define TRACE_CHUNK (1 << 16)        ///< Rozmiar porcji czytanego wejścia.
+#define TRACE_COMMANDS (COMMAND_MERGE + 1) ///< Liczba rodzajów poleceń.
+
+/** Nazwy rodzajów poleceń w podsumowaniu odtwarzania. */
+static const char* const commandNames[TRACE_COMMANDS] = {
+    "none", "reverse", "ntc", "add", "get", "new", "del_num", "del_id",
+    "stats", "jump", "compact", "freeze", "resolve", "getall", "reverseall",
+    "add_range", "count", "diff", "merge"
+};
+
+/** Struktura zapisu poleceń.
+ * Pola @p log, @p logStart, @p logUsed, @p logCapacity i @p readerFailed
+ * współdzielone są z wątkiem czytającym wejście i chronione przez @p lock.
+ */
+struct commandTrace {
+    FILE* file;             ///< Plik zapisu.
+    pthread_t reader;       ///< Wątek przepisujący wejście do łącza.
+    pthread_mutex_t lock;   ///< Blokada kopii wejścia.
+    int source;             ///< Deskryptor pierwotnego standardowego wejścia.
+    int sink;               ///< Deskryptor końca łącza do zapisu.
+    char* chunk;            ///< Bufor wątku czytającego wejście.
+    char* log;              ///< Wczytane, jeszcze niezapisane bajty wejścia.
+    size_t logStart;        ///< Pozycja w wejściu pierwszego bajtu @p log.
+    size_t logUsed;         ///< Liczba bajtów @p log.
+    size_t logCapacity;     ///< Rozmiar tablicy @p log.
+    bool readerFailed;      ///< Czy wątkowi zabrakło pamięci.
+    size_t begin;           ///< Pozycja początku bieżącego polecenia.
+    uint64_t beginTime;     ///< Czas nadejścia bieżącego polecenia.
+    uint64_t lastTime;      ///< Czas nadejścia poprzedniego polecenia.
+    dynStr dtb;             ///< Baza bieżąca polecenia (pusta, jeśli brak).
+    dynStr lastDtb;         ///< Baza bieżąca poprzedniego polecenia.
+    bool dtbFailed;         ///< Czy zabrakło pamięci na identyfikator bazy.
+    bool first;             ///< Czy nie zapisano jeszcze żadnego polecenia.
+};
+
+/** Zwraca czas zegara monotonicznego.
+ * @return Czas w nanosekundach.
+ */
+static uint64_t traceClock (void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * UINT64_C(1000000000) + (uint64_t)now.tv_nsec;
+}
+
+/** Zapisuje liczbę w kodowaniu LEB128 bez znaku.
+ * @param[in,out] file  –  Wskaźnik na plik;
+ * @param[in] value     –  Liczba.
+ */
+static void putVarint (FILE* file, uint64_t value) {
+    while (value >= 0x80) {
+        putc((int)(value & 0x7F) | 0x80, file);
+        value >>= 7;
+    }
+
+    putc((int)value, file);
+}
+
+/** @brief Odczytuje liczbę w kodowaniu LEB128 bez znaku.
+ * @param[in,out] p  –  Wskaźnik na wskaźnik na bieżący bajt danych;
+ * @param[in] end    –  Wskaźnik za koniec danych;
+ * @param[out] value –  Wskaźnik na odczytaną liczbę.
+ * @return Wartość @p true, jeśli udało się odczytać liczbę.
+ *         Wartość @p false, jeśli dane się skończyły lub liczba jest za duża.
+ */
+static bool getVarint (const unsigned char** p, const unsigned char* end,
+                       uint64_t* value) {
+    *value = 0;
+
+    for (unsigned shift = 0; *p < end && shift < 64; shift += 7) {
+        unsigned char byte = *(*p)++;
+
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+/** @brief Dopisuje porcję wejścia do kopii wejścia.
+ * Wywoływana z założoną blokadą.
+ * @param[in,out] trace  –  Wskaźnik na strukturę zapisu;
+ * @param[in] length     –  Liczba bajtów porcji w @p chunk.
+ * @return Wartość @p true, jeśli dopisano porcję.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool traceLogAppend (cmdTrace trace, size_t length) {
+    if (trace->logUsed + length > trace->logCapacity) {
+        size_t capacity = 2 * trace->logCapacity;
+
+        while (trace->logUsed + length > capacity)
+            capacity *= 2;
+
+        char* bigger = realloc(trace->log, capacity);
+
+        if (bigger == NULL)
+            return false;
+
+        trace->log = bigger;
+        trace->logCapacity = capacity;
+    }
+
+    memcpy(trace->log + trace->logUsed, trace->chunk, length);
+    trace->logUsed += length;
+
+    return true;
+}
+
+/** @brief Przepisuje pierwotne wejście do łącza.
+ * Każda porcja jest najpierw dopisywana do kopii wejścia, a dopiero potem do
+ * łącza, więc bajty wczytane przez parser są już w kopii.
+ * @param[in,out] arg  –  Wskaźnik na strukturę zapisu.
+ * @return Zawsze NULL.
+ */
+static void* traceReader (void* arg) {
+    cmdTrace trace = arg;
+    bool ok = true;
+
+    while (ok) {
+        ssize_t got = read(trace->source, trace->chunk, TRACE_CHUNK);
+
+        if (got < 0 && errno == EINTR)
+            continue;
+
+        if (got <= 0)
+            break;
+
+        pthread_mutex_lock(&trace->lock);
+        ok = traceLogAppend(trace, (size_t)got);
+        trace->readerFailed = !ok;
+        pthread_mutex_unlock(&trace->lock);
+
+        size_t written = 0;
+
+        while (ok && written < (size_t)got) {
+            ssize_t put = write(trace->sink, trace->chunk + written,
+                                (size_t)got - written);
+
+            if (put < 0 && errno != EINTR)
+                ok = false;
+
+            else if (put > 0)
+                written += (size_t)put;
+        }
+    }
+
+    // Zamknięcie łącza oznacza dla parsera koniec danych wejściowych.
+    close(trace->sink);
+    trace->sink = -1;
+
+    return NULL;
+}
+
+cmdTrace traceOpen (const char* path, bool binary) {
+    cmdTrace trace = calloc(1, sizeof(struct commandTrace));
+
+    if (trace == NULL) {
+        fprintf(stderr, "MEMORY ERROR\n");
+        return NULL;
+    }
+
+    trace->file = fopen(path, "wb");
+    trace->chunk = malloc(TRACE_CHUNK);
+    trace->log = malloc(TRACE_CHUNK);
+    trace->logCapacity = TRACE_CHUNK;
+    trace->dtb = dynStrInit();
+    trace->lastDtb = dynStrInit();
+    trace->first = true;
+    trace->source = -1;
+    trace->sink = -1;
+
+    int fds[2] = {-1, -1};
+    bool ok = trace->file != NULL;
+
+    if (!ok)
+        fprintf(stderr, "ERROR cannot open %s\n", path);
+
+    else if (trace->chunk == NULL || trace->log == NULL || trace->dtb == NULL ||
+             trace->lastDtb == NULL) {
+        fprintf(stderr, "MEMORY ERROR\n");
+        ok = false;
+    }
+
+    // Podmieniamy standardowe wejście na łącze zasilane przez wątek.
+    else if (pipe(fds) != 0 || (trace->source = dup(STDIN_FILENO)) < 0 ||
+             dup2(fds[0], STDIN_FILENO) < 0) {
+        fprintf(stderr, "ERROR cannot redirect input\n");
+        ok = false;
+    }
+
+    if (ok) {
+        close(fds[0]);
+        fds[0] = -1;
+        trace->sink = fds[1];
+
+        fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LENGTH, trace->file);
+        putc(binary ? 'b' : 't', trace->file);
+
+        pthread_mutex_init(&trace->lock, NULL);
+        trace->lastTime = traceClock();
+
+        if (pthread_create(&trace->reader, NULL, traceReader, trace) != 0) {
+            fprintf(stderr, "ERROR cannot start reader\n");
+            pthread_mutex_destroy(&trace->lock);
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        if (trace->source >= 0) {
+            dup2(trace->source, STDIN_FILENO);
+            close(trace->source);
+        }
+
+        if (fds[0] >= 0) {
+            close(fds[0]);
+            close(fds[1]);
+        }
+
+        else if (trace->sink >= 0)
+            close(trace->sink);
+
+        if (trace->file != NULL)
+            fclose(trace->file);
+
+        free(trace->chunk);
+        free(trace->log);
+        dynStrDelete(trace->dtb);
+        dynStrDelete(trace->lastDtb);
+        free(trace);
+
+        return NULL;
+    }
+
+    return trace;
+}
+
+void traceCommandBegin (cmdTrace trace, size_t pos, const char* dtbId) {
+    size_t length = dtbId == NULL ? 0 : strlen(dtbId);
+
+    trace->begin = pos;
+    trace->beginTime = traceClock();
+
+    dynStrReset(trace->dtb);
+
+    // Brak pamięci na identyfikator zgłosi traceCommandEnd.
+    trace->dtbFailed = !dynStrReserve(trace->dtb, length);
+
+    if (!trace->dtbFailed) {
+        memcpy(trace->dtb->str, dtbId == NULL ? "" : dtbId, length + 1);
+        trace->dtb->used = length + 1;
+    }
+}
+
+bool traceCommandEnd (cmdTrace trace, size_t pos, enum commandType command,
+                      bool ok) {
+    uint64_t now = traceClock();
+    FILE* file = trace->file;
+
+    putVarint(file, trace->beginTime - trace->lastTime);
+    putVarint(file, now - trace->beginTime);
+    putVarint(file, 2 * (uint64_t)command + (ok ? 1 : 0));
+
+    size_t dtbLength = trace->dtb->used - 1;
+
+    if (!trace->first && strcmp(trace->dtb->str, trace->lastDtb->str) == 0)
+        putVarint(file, 0);
+
+    else if (dtbLength == 0)
+        putVarint(file, 1);
+
+    else {
+        putVarint(file, dtbLength + 2);
+        fwrite(trace->dtb->str, 1, dtbLength, file);
+    }
+
+    dynStrSwap(trace->dtb, trace->lastDtb);
+    trace->lastTime = trace->beginTime;
+    trace->first = false;
+
+    pthread_mutex_lock(&trace->lock);
+
+    /* Parser mógł doliczyć do pozycji koniec danych, którego nie ma w kopii
+     * wejścia. */
+    size_t available = trace->logStart + trace->logUsed;
+    size_t begin = trace->begin < available ? trace->begin : available;
+    size_t end = pos < available ? pos : available;
+
+    if (begin < trace->logStart)
+        begin = trace->logStart;
+
+    if (end < begin)
+        end = begin;
+
+    putVarint(file, end - begin);
+    fwrite(trace->log + (begin - trace->logStart), 1, end - begin, file);
+
+    // Zapisane bajty usuwamy z kopii; zostaje tylko wczytana nadwyżka.
+    memmove(trace->log, trace->log + (end - trace->logStart),
+            available - end);
+    trace->logUsed = available - end;
+    trace->logStart = end;
+
+    bool failed = trace->readerFailed;
+    pthread_mutex_unlock(&trace->lock);
+
+    if (failed || trace->dtbFailed) {
+        fprintf(stderr, "MEMORY ERROR\n");
+        return false;
+    }
+
+    if (ferror(file) != 0) {
+        fprintf(stderr, "ERROR cannot write trace\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool traceClose (cmdTrace trace) {
+    if (trace == NULL)
+        return true;
+
+    /* Wątek może czekać na dane, których parser już nie przeczyta; read i
+     * write są punktami anulowania. */
+    pthread_cancel(trace->reader);
+    pthread_join(trace->reader, NULL);
+    pthread_mutex_destroy(&trace->lock);
+
+    bool ok = !trace->readerFailed;
+
+    if (!ok)
+        fprintf(stderr, "MEMORY ERROR\n");
+
+    if (trace->sink >= 0)
+        close(trace->sink);
+
+    close(trace->source);
+
+    if (fclose(trace->file) != 0) {
+        fprintf(stderr, "ERROR cannot write trace\n");
+        ok = false;
+    }
+
+    free(trace->chunk);
+    free(trace->log);
+    dynStrDelete(trace->dtb);
+    dynStrDelete(trace->lastDtb);
+    free(trace);
+
+    return ok;
+}
+
+/** Zapisane polecenie.
+ */
+struct traceRecord {
+    uint64_t arrival;        ///< Czas nadejścia od początku zapisu.
+    uint64_t duration;       ///< Zapisany czas wykonania.
+    enum commandType command; ///< Rodzaj polecenia.
+    bool ok;                 ///< Czy polecenie się powiodło.
+    bool hasDtb;             ///< Czy była baza bieżąca.
+    const char* dtb;         ///< Identyfikator bazy bieżącej (bez '\0').
+    size_t dtbLength;        ///< Długość identyfikatora.
+};
+
+/** @brief Dekoduje rekordy pliku zapisu.
+ * Bajty wejścia poleceń zapisywane są kolejno do pliku @p input.
+ * @param[in] p        –  Wskaźnik na pierwszy rekord;
+ * @param[in] end      –  Wskaźnik za koniec danych;
+ * @param[out] records –  Wskaźnik na tablicę rekordów o wystarczającym
+ *                        rozmiarze;
+ * @param[out] input   –  Wskaźnik na plik wejścia poleceń.
+ * @return Liczba rekordów lub @p SIZE_MAX, jeśli dane są niepoprawne.
+ */
+static size_t decodeRecords (const unsigned char* p, const unsigned char* end,
+                             struct traceRecord* records, FILE* input) {
+    size_t count = 0;
+    uint64_t arrival = 0;
+    const char* dtb = NULL;
+    size_t dtbLength = 0;
+
+    while (p < end) {
+        struct traceRecord* record = &records[count];
+        uint64_t delta, kind, context, length;
+
+        if (!getVarint(&p, end, &delta) ||
+            !getVarint(&p, end, &record->duration) ||
+            !getVarint(&p, end, &kind) || kind / 2 >= TRACE_COMMANDS ||
+            !getVarint(&p, end, &context) ||
+            (context >= 2 && context - 2 > (uint64_t)(end - p)))
+            return SIZE_MAX;
+
+        if (context == 1)
+            dtb = NULL;
+
+        else if (context >= 2) {
+            dtb = (const char*)p;
+            dtbLength = (size_t)(context - 2);
+            p += dtbLength;
+        }
+
+        if (!getVarint(&p, end, &length) || length > (uint64_t)(end - p))
+            return SIZE_MAX;
+
+        fwrite(p, 1, (size_t)length, input);
+        p += length;
+
+        arrival += delta;
+        record->arrival = arrival;
+        record->command = (enum commandType)(kind / 2);
+        record->ok = kind % 2 == 1;
+        record->hasDtb = dtb != NULL;
+        record->dtb = dtb;
+        record->dtbLength = dtbLength;
+        count++;
+    }
+
+    return count;
+}
+
+/** Porównuje czasy do sortowania funkcją @p qsort.
+ * @param[in] a  –  Wskaźnik na pierwszy czas;
+ * @param[in] b  –  Wskaźnik na drugi czas.
+ * @return Liczba ujemna, zero lub dodatnia, gdy pierwszy czas jest mniejszy,
+ *         równy lub większy.
+ */
+static int compareTimes (const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+/** @brief Wyznacza indeks percentyla metodą najbliższej rangi.
+ * Percentyl @p p to najmniejsza wartość, od której nie jest większe
+ * co najmniej @p p procent wartości, czyli wartość o randze
+ * ⌈@p p · @p n / 100⌉.
+ * @param[in] n  –  Dodatnia liczba posortowanych wartości;
+ * @param[in] p  –  Percentyl z przedziału [1, 100].
+ * @return Indeks percentyla w posortowanej tablicy.
+ */
+static size_t percentileIndex (size_t n, size_t p) {
+    return (n * p + 99) / 100 - 1;
+}
+
+/** @brief Wypisuje rozkład czasów poleceń każdego rodzaju.
+ * @param[in] records  –  Wskaźnik na tablicę rekordów;
+ * @param[in] times    –  Wskaźnik na tablicę czasów odtworzenia;
+ * @param[in] count    –  Liczba odtworzonych rekordów;
+ * @param[out] sorted  –  Wskaźnik na tablicę pomocniczą rozmiaru @p count.
+ */
+static void printLatencies (const struct traceRecord* records,
+                            const uint64_t* times, size_t count,
+                            uint64_t* sorted) {
+    fprintf(stderr, "%-12s %10s %10s %10s %10s %10s %10s\n", "command", "count",
+            "p50_us", "p90_us", "p99_us", "max_us", "rec_p50_us");
+
+    for (int type = 0; type < TRACE_COMMANDS; type++) {
+        size_t n = 0;
+
+        for (size_t i = 0; i < count; i++) {
+            if (records[i].command == (enum commandType)type)
+                sorted[n++] = records[i].duration;
+        }
+
+        if (n == 0)
+            continue;
+
+        qsort(sorted, n, sizeof(uint64_t), compareTimes);
+        double recorded = (double)sorted[percentileIndex(n, 50)] / 1e3;
+
+        n = 0;
+
+        for (size_t i = 0; i < count; i++) {
+            if (records[i].command == (enum commandType)type)
+                sorted[n++] = times[i];
+        }
+
+        qsort(sorted, n, sizeof(uint64_t), compareTimes);
+
+        fprintf(stderr, "%-12s %10zu %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+                commandNames[type], n,
+                (double)sorted[percentileIndex(n, 50)] / 1e3,
+                (double)sorted[percentileIndex(n, 90)] / 1e3,
+                (double)sorted[percentileIndex(n, 99)] / 1e3,
+                (double)sorted[n - 1] / 1e3, recorded);
+    }
+}
+
+/** @brief Czeka do danej chwili zegara monotonicznego.
+ * @param[in] target  –  Czas w nanosekundach.
+ */
+static void sleepUntil (uint64_t target) {
+    uint64_t now = traceClock();
+
+    while (now < target) {
+        struct timespec delay;
+        delay.tv_sec = (time_t)((target - now) / UINT64_C(1000000000));
+        delay.tv_nsec = (long)((target - now) % UINT64_C(1000000000));
+
+        nanosleep(&delay, NULL);
+        now = traceClock();
+    }
+}
+
+/** @brief Wykonuje zapisane polecenia.
+ * @param[in] records  –  Wskaźnik na tablicę rekordów;
+ * @param[in] count    –  Liczba rekordów;
+ * @param[in] binary   –  Czy polecenia są w binarnym protokole;
+ * @param[in] paced    –  Czy zachować zapisane odstępy między poleceniami;
+ * @param[in] budget   –  Liczba wierzchołków przetwarzanych w tle po każdym
+ *                        poleceniu;
+ * @param[out] times   –  Wskaźnik na tablicę czasów wykonania.
+ * @return Liczba wykonanych poleceń lub @p SIZE_MAX, jeśli nie udało się
+ *         zaalokować pamięci.
+ */
+static size_t replayRecords (const struct traceRecord* records, size_t count,
+                             bool binary, bool paced, size_t budget,
+                             uint64_t* times) {
+    size_t position = 0;
+    dynStr buffer = dynStrInit();
+    dynStr scratch = dynStrInit();
+    dtbList dtb = NULL;
+    dtbList current = NULL;
+    size_t contextMismatches = 0;
+    size_t resultMismatches = 0;
+    size_t done = 0;
+
+    if (buffer == NULL || scratch == NULL) {
+        dynStrDelete(buffer);
+        dynStrDelete(scratch);
+        return SIZE_MAX;
+    }
+
+    uint64_t start = traceClock();
+    uint64_t firstArrival = count > 0 ? records[0].arrival : 0;
+
+    while (done < count) {
+        const struct traceRecord* record = &records[done];
+        enum commandType command;
+
+        if (paced)
+            sleepUntil(start + (record->arrival - firstArrival));
+
+        // Baza bieżąca wynika z poprzednich poleceń; sprawdzamy ją z zapisem.
+        if (record->hasDtb != (current != NULL) ||
+            (current != NULL && (strlen(current->id) != record->dtbLength ||
+             memcmp(current->id, record->dtb, record->dtbLength) != 0)))
+            contextMismatches++;
+
+        uint64_t begin = traceClock();
+        bool ok = binary ?
+                  parseBinary(&position, buffer, scratch, &dtb, &current,
+                              &command) :
+                  parseExpression(&position, buffer, scratch, &dtb, &current,
+                                  &command);
+        times[done++] = traceClock() - begin;
+
+        if (ok != record->ok || command != record->command)
+            resultMismatches++;
+
+        if (!ok)
+            break;
+
+        maintainDtbList(&dtb, current, budget);
+    }
+
+    fflush(stdout);
+    fprintf(stderr, "replayed %zu of %zu commands in %.3f s\n", done, count,
+            (double)(traceClock() - start) / 1e9);
+
+    if (contextMismatches > 0 || resultMismatches > 0)
+        fprintf(stderr, "mismatches: %zu database, %zu result\n",
+                contextMismatches, resultMismatches);
+
+    dynStrDelete(buffer);
+    dynStrDelete(scratch);
+    removeDtbList(dtb);
+
+    return done;
+}
+
+bool traceReplay (const char* path, bool paced, size_t budget) {
+    size_t length = 0;
+    FILE* file = fopen(path, "rb");
+    unsigned char* data = NULL;
+
+    if (file != NULL) {
+        data = (unsigned char*)readAll(file, &length);
+        fclose(file);
+    }
+
+    if (data == NULL) {
+        fprintf(stderr, "ERROR cannot read %s\n", path);
+        return false;
+    }
+
+    if (length < TRACE_MAGIC_LENGTH + 1 ||
+        memcmp(data, TRACE_MAGIC, TRACE_MAGIC_LENGTH) != 0 ||
+        (data[TRACE_MAGIC_LENGTH] != 't' && data[TRACE_MAGIC_LENGTH] != 'b')) {
+        fprintf(stderr, "ERROR %s is not a trace\n", path);
+        free(data);
+        return false;
+    }
+
+    bool binary = data[TRACE_MAGIC_LENGTH] == 'b';
+    const unsigned char* p = data + TRACE_MAGIC_LENGTH + 1;
+
+    // Każdy rekord zajmuje co najmniej 5 bajtów.
+    size_t maxRecords = (length - TRACE_MAGIC_LENGTH - 1) / 5 + 1;
+    struct traceRecord* records = malloc(maxRecords * sizeof(struct traceRecord));
+    uint64_t* times = malloc(2 * maxRecords * sizeof(uint64_t));
+    FILE* input = tmpfile();
+    bool ok = records != NULL && times != NULL && input != NULL;
+
+    if (!ok)
+        fprintf(stderr, "MEMORY ERROR\n");
+
+    size_t count = ok ? decodeRecords(p, data + length, records, input) : 0;
+
+    if (ok && count == SIZE_MAX) {
+        fprintf(stderr, "ERROR %s is corrupted\n", path);
+        ok = false;
+    }
+
+    // Wejście poleceń podstawiamy jako standardowe wejście parsera.
+    if (ok && (fflush(input) != 0 || dup2(fileno(input), STDIN_FILENO) < 0 ||
+               lseek(STDIN_FILENO, 0, SEEK_SET) != 0)) {
+        fprintf(stderr, "ERROR cannot redirect input\n");
+        ok = false;
+    }
+
+    if (ok) {
+        size_t done = replayRecords(records, count, binary, paced, budget,
+                                    times);
+
+        if (done == SIZE_MAX) {
+            fprintf(stderr, "MEMORY ERROR\n");
+            ok = false;
+        }
+
+        else
+            printLatencies(records, times, done, times + maxRecords);
+    }
+
+    if (input != NULL)
+        fclose(input);
+
+    free(times);
+    free(records);
+    free(data);
+
+    return ok;
+}
@@ -0,0 +1,96 @@
+/** @file
+ * Specyfikacja zapisu i odtwarzania strumienia poleceń.
+ *
+ * Z opcją @p --record @p plik program zapisuje do pliku przetworzone
+ * polecenia (w interfejsie tekstowym lub binarnym protokole) razem z czasem
+ * ich nadejścia, czasem wykonania i bazą bieżącą w chwili nadejścia. Opcja
+ * @p --replay @p plik wykonuje zapisane polecenia ponownie, tak szybko jak to
+ * możliwe lub (z opcją @p --paced) w zapisanych odstępach czasu, i wypisuje
+ * na wyjście diagnostyczne rozkład czasów wykonania poleceń każdego rodzaju.
+ *
+ * Plik zaczyna się napisem @p PHFWDTR1 i bajtem trybu ('t' dla interfejsu
+ * tekstowego, 'b' dla binarnego protokołu). Każdy rekord polecenia to
+ * kolejno, z liczbami zapisanymi jako LEB128 bez znaku:
+ *  - odstęp od nadejścia poprzedniego polecenia w nanosekundach;
+ *  - czas wykonania polecenia w nanosekundach (razem z oczekiwaniem parsera
+ *    na kolejny znak wejścia, gdy polecenie kończy się dopiero na nim);
+ *  - 2 * rodzaj polecenia (@ref commandType) + 1, jeśli polecenie się
+ *    powiodło;
+ *  - baza bieżąca: 0, jeśli się nie zmieniła, 1, jeśli jej nie ma, a w
+ *    przeciwnym wypadku długość jej identyfikatora plus 2 i identyfikator;
+ *  - długość i bajty wejścia polecenia (razem z poprzedzającymi je białymi
+ *    znakami i komentarzami).
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+#ifndef TELEFONY_COMMAND_TRACE_H
+#define TELEFONY_COMMAND_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "parser.h"
+
+/** Struktura zapisu poleceń.
+ */
+struct commandTrace;
+
+typedef struct commandTrace* cmdTrace; /**< Skrócona nazwa dla wskaźnika na
+                                            strukturę @p commandTrace. */
+
+/** @brief Rozpoczyna zapis poleceń do pliku.
+ * Standardowe wejście zastępowane jest łączem, do którego osobny wątek
+ * przepisuje dane wejściowe, zachowując ich kopię do zapisu. Funkcję trzeba
+ * wywołać przed wczytaniem czegokolwiek ze standardowego wejścia.
+ * @param[in] path    –  Wskaźnik na napis ze ścieżką pliku zapisu;
+ * @param[in] binary  –  Czy polecenia są w binarnym protokole.
+ * @return Wskaźnik na strukturę zapisu lub NULL, jeśli nie udało się
+ *         utworzyć pliku lub zaalokować pamięci; wtedy wypisywany jest błąd.
+ */
+cmdTrace traceOpen (const char* path, bool binary);
+
+/** @brief Zapamiętuje nadejście polecenia.
+ * @param[in,out] trace  –  Wskaźnik na strukturę zapisu;
+ * @param[in] pos        –  Liczba przetworzonych dotąd znaków wejścia;
+ * @param[in] dtbId      –  Wskaźnik na identyfikator bazy bieżącej lub NULL.
+ */
+void traceCommandBegin (cmdTrace trace, size_t pos, const char* dtbId);
+
+/** @brief Zapisuje polecenie rozpoczęte przez @ref traceCommandBegin.
+ * @param[in,out] trace  –  Wskaźnik na strukturę zapisu;
+ * @param[in] pos        –  Liczba przetworzonych znaków wejścia po poleceniu;
+ * @param[in] command    –  Rodzaj polecenia;
+ * @param[in] ok         –  Czy polecenie się powiodło.
+ * @return Wartość @p true, jeśli zapisano polecenie.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci lub
+ *         zapisać pliku; wtedy wypisywany jest błąd.
+ */
+bool traceCommandEnd (cmdTrace trace, size_t pos, enum commandType command,
+                      bool ok);
+
+/** @brief Kończy zapis poleceń i zwalnia strukturę zapisu.
+ * Nic nie robi, jeśli wskaźnik ma wartość NULL.
+ * @param[in,out] trace  –  Wskaźnik na strukturę zapisu.
+ * @return Wartość @p true, jeśli plik został poprawnie zapisany.
+ *         Wartość @p false w przeciwnym wypadku; wtedy wypisywany jest błąd.
+ */
+bool traceClose (cmdTrace trace);
+
+/** @brief Odtwarza zapisane polecenia.
+ * Wyniki poleceń wypisywane są na standardowe wyjście, a podsumowanie (liczba
+ * poleceń oraz mediana, 90. i 99. percentyl i maksimum czasu wykonania
+ * poleceń każdego rodzaju, a także mediana zapisanego czasu) na wyjście
+ * diagnostyczne. Zgłaszane są też polecenia, które wykonały się z inną bazą
+ * bieżącą lub innym wynikiem niż w zapisie.
+ * @param[in] path    –  Wskaźnik na napis ze ścieżką pliku zapisu;
+ * @param[in] paced   –  Czy zachować zapisane odstępy między poleceniami;
+ * @param[in] budget  –  Liczba wierzchołków przetwarzanych w tle po każdym
+ *                       poleceniu (zob. @ref maintainDtbList).
+ * @return Wartość @p true, jeśli odtworzono zapis (odtwarzanie kończy się na
+ *         pierwszym poleceniu, które zakończyło się błędem).
+ *         Wartość @p false, jeśli plik jest niepoprawny lub nie udało się
+ *         zaalokować pamięci; wtedy wypisywany jest błąd.
+ */
+bool traceReplay (const char* path, bool paced, size_t budget);
+
+#endif //TELEFONY_COMMAND_TRACE_H
@@ -13,8 +13,10 @@ dynStr dynStrInit (void) {
     if (newDynStr != NULL) {
         newDynStr->str = malloc(sizeof(char));
 
-        if (newDynStr->str == NULL)
+        if (newDynStr->str == NULL) {
+            free(newDynStr);
             return NULL;
+        }
 
         newDynStr->str[0] = '\0';
         newDynStr->size = 1;
@@ -40,17 +42,34 @@ bool dynStrAdd (dynStr str, char c) {
     return true;
 }
 
+bool dynStrReserve (dynStr str, size_t length) {
+    if (length >= str->size) {
+        void *strNew = realloc(str->str, length + 1);
+
+        if (strNew == NULL)
+            return false;
+
+        str->str = strNew;
+        str->size = length + 1;
+    }
+
+    return true;
+}
+
 void dynStrReset (dynStr str) {
     if (str != NULL) {
-        free(str->str);
-        str->str = malloc(sizeof(char));
-
         str->str[0] = '\0';
-        str->size = 1;
         str->used = 1;
     }
 }
 
+void dynStrSwap (dynStr a, dynStr b) {
+    struct dynamicString tmp = *a;
+
+    *a = *b;
+    *b = tmp;
+}
+
 void dynStrDelete (dynStr str) {
     if (str != NULL) {
         free(str->str);
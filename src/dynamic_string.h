@@ -43,14 +43,31 @@ dynStr dynStrInit (void);
  */
 bool dynStrAdd (dynStr str, char c);
 
+/** @brief Zapewnia miejsce na napis danej długości.
+ * Jeśli tablica jest za mała, realokuje ją tak, żeby mieściła @p length
+ * znaków i kończący znak '\0'. Nie zmienia przechowywanego napisu.
+ * @param[in,out] str  –  Wskaźnik na strukturę @p dynamicString;
+ * @param[in] length   –  Długość napisu.
+ * @return Wartość @p true, jeśli tablica ma wystarczający rozmiar.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+bool dynStrReserve (dynStr str, size_t length);
+
 /** @brief Resetuje tablicę do początkowego stanu.
- * Zwalnia całą pamięć przeznaczoną na przechowywanie znaków i alokuje obszar
- * potrzebny na przechowanie jednego znaku. Resetuje liczniki @p size i @p used
- * do wartości 1. Nic nie robi, jeśli wskaźnik ma wartość NULL.
+ * Opróżnia napis i ustawia licznik @p used na 1. Zaalokowany obszar jest
+ * zachowywany, żeby kolejne napisy nie wymagały ponownych alokacji. Nic nie
+ * robi, jeśli wskaźnik ma wartość NULL.
  * @param[in] str  –  Wskaźnik na strukturę @p dynamicString.
  */
 void dynStrReset (dynStr str);
 
+/** @brief Zamienia zawartości dwóch tablic.
+ * Zamienia tylko wskaźniki i liczniki, bez kopiowania znaków.
+ * @param[in,out] a  –  Wskaźnik na pierwszą strukturę @p dynamicString;
+ * @param[in,out] b  –  Wskaźnik na drugą strukturę @p dynamicString.
+ */
+void dynStrSwap (dynStr a, dynStr b);
+
 /** @brief Usuwa strukturę.
  * Usuwa strukturę wskazywaną przez @p str. Nic nie robi, jeśli wskaźnik ma
  * wartość NULL.
@@ -0,0 +1,435 @@
+/** @file
+ * Implementacja trybu strumieniowego wyznaczania przekierowań.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#include "lookup_stream.h"
+#include "phone_forward.h"
+#include "read_all.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define LOOKUP_BLOCK_SIZE (1 << 16)  ///< Początkowy rozmiar bloku wejścia.
+#define LOOKUP_OUTPUT_SIZE (1 << 16) ///< Rozmiar bufora wyjścia.
+#define LOOKUP_BATCH 4096            ///< Maksymalna liczba numerów w porcji.
+#define LOOKUP_CHUNK_LINES 65536     /**< Najmniejsza liczba wierszy pliku bazy
+                                          na wątek odczytujący. */
+
+/** Bufor wyjścia zapisywany na standardowe wyjście w całości.
+ */
+struct outputBuffer {
+    char data[LOOKUP_OUTPUT_SIZE]; ///< Zapisane, jeszcze niewypisane znaki.
+    size_t used;                   ///< Liczba zajętych bajtów @p data.
+};
+
+/** Wypisuje zawartość bufora wyjścia.
+ * @param[in,out] out  –  Wskaźnik na bufor wyjścia.
+ */
+static void outputFlush (struct outputBuffer* out) {
+    fwrite(out->data, 1, out->used, stdout);
+    out->used = 0;
+}
+
+/** @brief Dopisuje numer i znak nowej linii do bufora wyjścia.
+ * Funkcja typu @ref PhoneNumCallback.
+ * @param[in,out] ctx  –  Wskaźnik na bufor wyjścia;
+ * @param[in] num      –  Wskaźnik na napis reprezentujący numer.
+ * @return Zawsze wartość @p true.
+ */
+static bool outputNumber (void* ctx, const char* num) {
+    struct outputBuffer* out = ctx;
+    size_t length = strlen(num);
+
+    if (out->used + length + 1 > LOOKUP_OUTPUT_SIZE) {
+        outputFlush(out);
+
+        // Numer dłuższy niż bufor wypisujemy bezpośrednio.
+        if (length + 1 > LOOKUP_OUTPUT_SIZE) {
+            fwrite(num, 1, length, stdout);
+            putchar('\n');
+            return true;
+        }
+    }
+
+    memcpy(out->data + out->used, num, length);
+    out->used += length;
+    out->data[out->used++] = '\n';
+
+    return true;
+}
+
+/** Pomija białe znaki w wierszu.
+ * @param[in] p  –  Wskaźnik na znak wiersza.
+ * @return Wskaźnik na pierwszy znak niebędący białym znakiem.
+ */
+static char* skipSpaces (char* p) {
+    while (*p != '\0' && isspace((unsigned char)*p) != 0)
+        p++;
+
+    return p;
+}
+
+/** @brief Odczytuje przekierowanie opisane wierszem pliku bazy.
+ * Wiersz modyfikowany jest w miejscu, a napisy przekierowania wskazują na
+ * jego fragmenty.
+ * @param[in,out] line   –  Wskaźnik na wiersz zakończony znakiem '\0';
+ * @param[out] record    –  Wskaźnik na przekierowanie; dla pustego wiersza
+ *                          pole @p num ma wartość NULL.
+ * @return Wartość @p true, jeśli wiersz jest pusty lub opisuje przekierowanie.
+ *         Wartość @p false, jeśli wiersz jest niepoprawny.
+ */
+static bool parseLine (char* line, struct PhoneForwardRecord* record) {
+    char* num1 = skipSpaces(line);
+    char* p = num1;
+
+    record->num = NULL;
+
+    if (*p == '\0')
+        return true;
+
+    while (isValidDigit(*p))
+        p++;
+
+    char* num1End = p;
+    p = skipSpaces(p);
+
+    if (*p != '>' || num1End == num1)
+        return false;
+
+    char* num2 = skipSpaces(p + 1);
+    p = num2;
+
+    while (isValidDigit(*p))
+        p++;
+
+    char* num2End = p;
+
+    if (*skipSpaces(p) != '\0' || num2End == num2)
+        return false;
+
+    *num1End = '\0';
+    *num2End = '\0';
+
+    // Tak jak w phfwdAdd, numer nie może być przekierowany na siebie.
+    if (strcmp(num1, num2) == 0)
+        return false;
+
+    record->num = num1;
+    record->fwd = num2;
+
+    return true;
+}
+
+/** Fragment pliku bazy odczytywany przez jeden wątek.
+ */
+struct loadChunk {
+    char* begin;     ///< Wskaźnik na początek pierwszego wiersza fragmentu.
+    char* end;       ///< Wskaźnik za koniec ostatniego wiersza fragmentu.
+    struct PhoneForwardRecord* records; /**< Miejsce na przekierowania
+                                             fragmentu, po jednym na wiersz. */
+    size_t count;    ///< Liczba odczytanych przekierowań.
+    size_t lines;    ///< Liczba przetworzonych wierszy.
+    bool invalid;    ///< Czy ostatni przetworzony wiersz jest niepoprawny.
+};
+
+/** Stan równoległego odczytywania pliku bazy.
+ */
+struct loadJob {
+    struct loadChunk* chunks; ///< Fragmenty pliku.
+    size_t count;             ///< Liczba fragmentów.
+    atomic_size_t next;       ///< Indeks kolejnego fragmentu do odczytania.
+};
+
+/** @brief Funkcja wątku odczytującego fragmenty pliku bazy.
+ * Odczytuje fragment do pierwszego niepoprawnego wiersza.
+ * @param[in,out] arg  –  Wskaźnik na strukturę @ref loadJob.
+ * @return Zawsze NULL.
+ */
+static void* loadWorker (void* arg) {
+    struct loadJob* job = arg;
+    size_t i;
+
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->count) {
+        struct loadChunk* chunk = &job->chunks[i];
+        char* line = chunk->begin;
+
+        while (!chunk->invalid && line < chunk->end) {
+            char* end = memchr(line, '\n', (size_t)(chunk->end - line));
+            struct PhoneForwardRecord* record = &chunk->records[chunk->count];
+
+            *end = '\0';
+            chunk->lines++;
+            chunk->invalid = !parseLine(line, record);
+
+            if (!chunk->invalid && record->num != NULL)
+                chunk->count++;
+
+            line = end + 1;
+        }
+    }
+
+    return NULL;
+}
+
+/** @brief Odczytuje przekierowania z pliku bazy równolegle.
+ * Plik dzielony jest na fragmenty o równej liczbie wierszy, odczytywane
+ * przez pulę wątków. Przekierowania fragmentów są potem sklejane w
+ * kolejności z pliku.
+ * @param[in,out] data  –  Wskaźnik na zawartość pliku zakończoną znakiem
+ *                         nowej linii; wiersze modyfikowane są w miejscu;
+ * @param[in] length    –  Długość zawartości pliku;
+ * @param[out] records  –  Wskaźnik na tablicę przekierowań, którą trzeba
+ *                         zwolnić;
+ * @param[out] count    –  Wskaźnik na liczbę przekierowań.
+ * @return Wartość @p true, jeśli plik jest poprawny.
+ *         Wartość @p false w przeciwnym wypadku; wtedy wypisywany jest błąd.
+ */
+static bool parseDatabase (char* data, size_t length,
+                           struct PhoneForwardRecord** records, size_t* count) {
+    size_t lines = 0;
+    char* p = data;
+
+    while ((p = memchr(p, '\n', length - (size_t)(p - data))) != NULL) {
+        lines++;
+        p++;
+    }
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t threads = online > 0 ? (size_t)online : 1;
+
+    if (threads > lines / LOOKUP_CHUNK_LINES + 1)
+        threads = lines / LOOKUP_CHUNK_LINES + 1;
+
+    struct loadChunk* chunks = calloc(threads, sizeof(struct loadChunk));
+    pthread_t* pool = malloc(threads * sizeof(pthread_t));
+
+    *records = malloc((lines + 1) * sizeof(struct PhoneForwardRecord));
+    *count = 0;
+
+    if (chunks == NULL || pool == NULL || *records == NULL) {
+        fprintf(stderr, "MEMORY ERROR\n");
+        free(chunks);
+        free(pool);
+        free(*records);
+        *records = NULL;
+        return false;
+    }
+
+    // Fragment i zaczyna się wierszem numer i * lines / threads.
+    size_t line = 0;
+
+    p = data;
+
+    for (size_t i = 0; i < threads; i++) {
+        chunks[i].begin = p;
+        chunks[i].records = *records + line;
+
+        for (; line < (i + 1) * lines / threads; line++)
+            p = (char*)memchr(p, '\n', length - (size_t)(p - data)) + 1;
+
+        chunks[i].end = p;
+    }
+
+    struct loadJob job = {chunks, threads, 0};
+    size_t started = 0;
+
+    // Bieżący wątek też odczytuje fragmenty, więc uruchamiamy o jeden mniej.
+    while (started + 1 < threads &&
+           pthread_create(&pool[started], NULL, loadWorker, &job) == 0)
+        started++;
+
+    loadWorker(&job);
+
+    for (size_t i = 0; i < started; i++)
+        pthread_join(pool[i], NULL);
+
+    bool ok = true;
+    line = 0;
+
+    for (size_t i = 0; ok && i < threads; i++) {
+        line += chunks[i].lines;
+
+        if (chunks[i].invalid) {
+            fprintf(stderr, "ERROR %zu\n", line);
+            ok = false;
+        }
+
+        // Przekierowania fragmentu przesuwamy za przekierowania poprzednich.
+        else {
+            memmove(*records + *count, chunks[i].records,
+                    chunks[i].count * sizeof(struct PhoneForwardRecord));
+            *count += chunks[i].count;
+        }
+    }
+
+    free(chunks);
+    free(pool);
+
+    if (!ok) {
+        free(*records);
+        *records = NULL;
+    }
+
+    return ok;
+}
+
+/** @brief Wczytuje bazę przekierowań z pliku.
+ * Plik odczytywany jest równolegle, a przekierowania dodawane funkcją
+ * @ref phfwdAddAll, która dla dużej bazy buduje drzewo w wielu wątkach.
+ * @param[in] path  –  Wskaźnik na napis ze ścieżką pliku bazy.
+ * @return Wskaźnik na strukturę z przekierowaniami lub NULL, jeśli nie udało
+ *         się otworzyć pliku, plik jest niepoprawny lub nie udało się
+ *         zaalokować pamięci; wtedy wypisywany jest błąd.
+ */
+static PhoneFwd loadDatabase (const char* path) {
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL) {
+        fprintf(stderr, "ERROR cannot open %s\n", path);
+        return NULL;
+    }
+
+    size_t length;
+    char* data = readAll(file, &length);
+    struct PhoneForwardRecord* records = NULL;
+    size_t count = 0;
+    PhoneFwd pf = NULL;
+
+    fclose(file);
+
+    // Ostatni wiersz może nie kończyć się znakiem nowej linii.
+    if (data != NULL && length > 0 && data[length - 1] != '\n')
+        data[length++] = '\n';
+
+    if (data == NULL)
+        fprintf(stderr, "ERROR cannot read %s\n", path);
+
+    else if (parseDatabase(data, length, &records, &count)) {
+        pf = phfwdNew();
+
+        if (pf == NULL || !phfwdAddAll(pf, records, count, 0)) {
+            fprintf(stderr, "MEMORY ERROR\n");
+            phfwdDelete(pf);
+            pf = NULL;
+        }
+    }
+
+    free(records);
+    free(data);
+
+    return pf;
+}
+
+/** @brief Wyznacza przekierowania porcji numerów i dopisuje je do wyjścia.
+ * @param[in] pf       –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] nums     –  Wskaźnik na tablicę wskaźników na numery;
+ * @param[in] count    –  Liczba numerów;
+ * @param[in,out] out  –  Wskaźnik na bufor wyjścia.
+ * @return Wartość @p true, jeśli wyznaczono wszystkie przekierowania.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool lookupBatch (PhoneFwd pf, const char* const* nums, size_t count,
+                         struct outputBuffer* out) {
+    if (!phfwdGetEach(pf, nums, count, outputNumber, out)) {
+        fprintf(stderr, "MEMORY ERROR\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool lookupStream (const char* path) {
+    PhoneFwd pf = loadDatabase(path);
+
+    if (pf == NULL)
+        return false;
+
+    /* Zamrożona reprezentacja jest najszybsza do wyszukiwania. Między
+     * wyszukiwaniami nie ma przerw na prace w tle, więc drzewo wskaźnikowe
+     * i jego areny zwalniamy od razu. */
+    if (phfwdFreeze(pf))
+        phfwdMaintain(pf, SIZE_MAX);
+
+    size_t capacity = LOOKUP_BLOCK_SIZE;
+    char* block = malloc(capacity + 1);
+    const char** nums = malloc(LOOKUP_BATCH * sizeof(char*));
+    struct outputBuffer* out = malloc(sizeof(struct outputBuffer));
+    size_t used = 0;
+    bool ok = block != NULL && nums != NULL && out != NULL;
+    bool eof = false;
+
+    if (!ok)
+        fprintf(stderr, "MEMORY ERROR\n");
+
+    else
+        out->used = 0;
+
+    while (ok && !eof) {
+        size_t got = fread(block + used, 1, capacity - used, stdin);
+
+        used += got;
+        eof = got == 0;
+
+        // Ostatni wiersz może nie kończyć się znakiem nowej linii.
+        if (eof && used > 0)
+            block[used++] = '\n';
+
+        size_t start = 0;
+        size_t count = 0;
+        char* end;
+
+        while (ok && (end = memchr(block + start, '\n', used - start)) != NULL) {
+            *end = '\0';
+
+            if (end > block + start && end[-1] == '\r')
+                end[-1] = '\0';
+
+            nums[count++] = block + start;
+            start = (size_t)(end - block) + 1;
+
+            if (count == LOOKUP_BATCH) {
+                ok = lookupBatch(pf, nums, count, out);
+                count = 0;
+            }
+        }
+
+        if (ok && count > 0)
+            ok = lookupBatch(pf, nums, count, out);
+
+        // Niepełny wiersz przenosimy na początek bloku.
+        memmove(block, block + start, used - start);
+        used -= start;
+
+        if (ok && used == capacity) {
+            char* bigger = realloc(block, 2 * capacity + 1);
+
+            if (bigger == NULL) {
+                fprintf(stderr, "MEMORY ERROR\n");
+                ok = false;
+            }
+
+            else {
+                block = bigger;
+                capacity *= 2;
+            }
+        }
+    }
+
+    if (out != NULL)
+        outputFlush(out);
+
+    free(out);
+    free(nums);
+    free(block);
+    phfwdDelete(pf);
+
+    return ok;
+}
@@ -0,0 +1,32 @@
+/** @file
+ * Specyfikacja trybu strumieniowego wyznaczania przekierowań.
+ *
+ * Tryb wybierany jest opcją @p --lookup @p plik. Plik bazy zawiera
+ * przekierowania, po jednym w wierszu, w postaci @p num @p > @p num (puste
+ * wiersze są pomijane). Plik odczytywany jest w wielu wątkach, a duża baza
+ * budowana równolegle (zob. @ref phfwdAddAll); przy powtórzonym prefiksie
+ * obowiązuje ostatni wiersz. Po wczytaniu baza jest zamrażana, a ze
+ * standardowego wejścia czytane są numery, po jednym w wierszu. Dla każdego
+ * wiersza wypisywany jest wiersz z przekierowaniem numeru lub pusty wiersz,
+ * jeśli wiersz nie jest numerem.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+#ifndef TELEFONY_LOOKUP_STREAM_H
+#define TELEFONY_LOOKUP_STREAM_H
+
+#include <stdbool.h>
+
+/** @brief Wyznacza przekierowania numerów ze standardowego wejścia.
+ * Wejście czytane jest dużymi blokami, numery przekazywane są porcjami do
+ * @ref phfwdGetEach, a wyniki zapisywane przez własny bufor wyjścia.
+ * Błędy wypisywane są na wyjście diagnostyczne: @p ERROR @p n dla
+ * niepoprawnego @p n-tego wiersza pliku bazy.
+ * @param[in] path  –  Wskaźnik na napis ze ścieżką pliku bazy.
+ * @return Wartość @p true, jeśli bezbłędnie przetworzono całe wejście.
+ *         Wartość @p false, jeśli gdzieś wystąpił błąd.
+ */
+bool lookupStream (const char* path);
+
+#endif //TELEFONY_LOOKUP_STREAM_H
@@ -0,0 +1,59 @@
+/** @file
+ * Implementacja upakowanego zapisu numerów.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#include "packed_digits.h"
+#include <stdint.h>
+#include <string.h>
+
+#define WORD_BYTES sizeof(uint64_t) ///< Liczba bajtów (po 2 cyfry) w słowie.
+
+void packDigits (unsigned char* dst, const char* src, size_t length) {
+    size_t i = 0;
+
+    for (; i + 1 < length; i += 2)
+        dst[i / 2] = (unsigned char)(((src[i] - '0') << 4) | (src[i + 1] - '0'));
+
+    if (i < length)
+        dst[i / 2] = (unsigned char)(((src[i] - '0') << 4) | PACKED_PAD);
+}
+
+void unpackDigits (char* dst, const unsigned char* src, size_t length) {
+    size_t i = 0;
+
+    for (; i + 1 < length; i += 2) {
+        dst[i] = (char)('0' + (src[i / 2] >> 4));
+        dst[i + 1] = (char)('0' + (src[i / 2] & 0xF));
+    }
+
+    if (i < length)
+        dst[i] = (char)('0' + (src[i / 2] >> 4));
+}
+
+bool packedIsPrefix (const unsigned char* prefix, size_t prefixLength,
+                     const unsigned char* str, size_t strLength) {
+    if (prefixLength > strLength)
+        return false;
+
+    size_t bytes = prefixLength / 2;
+    size_t i = 0;
+
+    // Po 16 cyfr naraz; memcpy nie wymaga wyrównania wskaźników.
+    for (; i + WORD_BYTES <= bytes; i += WORD_BYTES) {
+        uint64_t x, y;
+
+        memcpy(&x, prefix + i, WORD_BYTES);
+        memcpy(&y, str + i, WORD_BYTES);
+
+        if (x != y)
+            return false;
+    }
+
+    if (memcmp(prefix + i, str + i, bytes - i) != 0)
+        return false;
+
+    return prefixLength % 2 == 0 || (prefix[bytes] >> 4) == (str[bytes] >> 4);
+}
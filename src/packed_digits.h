@@ -0,0 +1,56 @@
+/** @file
+ * Specyfikacja upakowanego zapisu numerów: każda cyfra alfabetu
+ * 0,1,...,9,:,; zajmuje 4 bity. Pierwsza cyfra bajtu leży w starszej
+ * połówce, więc porządek bajtów zgadza się z porządkiem leksykograficznym
+ * numerów. Numer nieparzystej długości dopełniany jest połówką
+ * @ref PACKED_PAD. Sprawdzanie prefiksu przetwarza po 16 cyfr w jednym
+ * 64-bitowym słowie.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#ifndef TELEFONY_PACKED_DIGITS_H
+#define TELEFONY_PACKED_DIGITS_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define PACKED_PAD 0xF ///< Połówka bajtu dopełniająca numer nieparzystej długości.
+
+/** Wyznacza rozmiar upakowanego numeru.
+ * @param[in] length  –  Liczba cyfr.
+ * @return Liczba bajtów potrzebnych na upakowanie @p length cyfr.
+ */
+static inline size_t packedSize (size_t length) {
+    return (length + 1) / 2;
+}
+
+/** @brief Pakuje numer.
+ * @param[out] dst    –  Wskaźnik na bufor o rozmiarze co najmniej
+ *                       packedSize(@p length);
+ * @param[in] src     –  Wskaźnik na cyfry, niekoniecznie zakończone '\0';
+ * @param[in] length  –  Liczba cyfr.
+ */
+void packDigits (unsigned char* dst, const char* src, size_t length);
+
+/** @brief Rozpakowuje numer.
+ * Nie dopisuje znaku '\0'.
+ * @param[out] dst    –  Wskaźnik na bufor o rozmiarze co najmniej @p length;
+ * @param[in] src     –  Wskaźnik na upakowany numer;
+ * @param[in] length  –  Liczba cyfr.
+ */
+void unpackDigits (char* dst, const unsigned char* src, size_t length);
+
+/** @brief Sprawdza, czy upakowany numer jest prefiksem innego.
+ * @param[in] prefix        –  Wskaźnik na upakowany kandydat na prefiks;
+ * @param[in] prefixLength  –  Liczba cyfr kandydata;
+ * @param[in] str           –  Wskaźnik na upakowany numer;
+ * @param[in] strLength     –  Liczba cyfr numeru.
+ * @return Wartość @p true, jeśli @p prefix jest prefiksem @p str.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+bool packedIsPrefix (const unsigned char* prefix, size_t prefixLength,
+                     const unsigned char* str, size_t strLength);
+
+#endif //TELEFONY_PACKED_DIGITS_H
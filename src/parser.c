@@ -6,10 +6,17 @@
  */
 
 #include "parser.h"
+#include "phfwd_trace.h"
+#include "phfwd_engine.h"
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
 
+#define RESOLVE_MAX_HOPS 64 ///< Limit przekierowań polecenia RESOLVE.
+#define ENGINE_NAME_LENGTH 16 ///< Maksymalna długość nazwy silnika w poleceniu NEW.
+/** Liczba wątków poleceń GETALL i REVERSEALL; 0 oznacza liczbę procesorów. */
+#define QUERY_ALL_THREADS 0
+
 /* WSZYSTKIE FUNKCJE NA BIEŻĄCO AKTUALIZUJĄ PARAMETR POS, W KTÓRYM PRZECHOWYWANY *
  * JEST NUMER AKTUALNIE PRZETWARZANEGO ZNAKU.                                    */
 
@@ -86,14 +93,53 @@ bool skipComment (size_t* pos) {
     }
 }
 
-/** Funkcja parsująca token odpowiadający operatorowi NEW lub DEL.
+/** Słowa kluczowe interfejsu tekstowego.
+ */
+enum keyword {
+    KEYWORD_NONE,  ///< Token nie jest słowem kluczowym.
+    KEYWORD_NEW,   ///< Operator NEW.
+    KEYWORD_DEL,   ///< Operator DEL.
+    KEYWORD_STATS, ///< Operator STATS.
+    KEYWORD_JUMP,  ///< Operator JUMP.
+    KEYWORD_COMPACT, ///< Operator COMPACT.
+    KEYWORD_FREEZE,  ///< Operator FREEZE.
+    KEYWORD_RESOLVE, ///< Operator RESOLVE.
+    KEYWORD_GETALL,  ///< Operator GETALL.
+    KEYWORD_REVERSEALL, ///< Operator REVERSEALL.
+    KEYWORD_COUNT,   ///< Operator COUNT.
+    KEYWORD_DIFF,    ///< Operator DIFF.
+    KEYWORD_MERGE    ///< Operator MERGE.
+};
+
+/** Napisy odpowiadające kolejnym wartościom typu @ref keyword.
+ */
+static const char* const keywordNames[] = {"", "NEW", "DEL", "STATS", "JUMP",
+                                               "COMPACT", "FREEZE", "RESOLVE",
+                                               "GETALL", "REVERSEALL", "COUNT",
+                                               "DIFF", "MERGE"};
+
+/** Sprawdza, czy dany napis jest słowem kluczowym.
+ * @param[in] str  –  Wskaźnik na napis do sprawdzenia.
+ * @return Słowo kluczowe odpowiadające napisowi lub @p KEYWORD_NONE.
+ */
+static enum keyword findKeyword (const char* str) {
+    for (size_t i = 1; i < sizeof(keywordNames) / sizeof(keywordNames[0]); i++)
+        if (strcmp(str, keywordNames[i]) == 0)
+            return (enum keyword)i;
+
+    return KEYWORD_NONE;
+}
+
+/** @brief Funkcja parsująca token odpowiadający słowu kluczowemu.
+ * Najpierw wczytywane są trzy znaki (operatory NEW i DEL), a jeśli nie
+ * tworzą one żadnego z tych operatorów, dalsze znaki alfanumeryczne
+ * dłuższych słów kluczowych.
  * @param[in,out] pos     –  Aktualny numer znaku na którym stanęło przetwarzanie danych.
  * @param[in,out] buffer  –  Wskaźnik na bufor danych typu @p dynamicString.
- * @return Wartość 0, jeśli napotkano jakikolwiek błąd.
- *         Wartość 1, jeśli sparsowany token odpowiada operatorowi NEW.
- *         Wartość 2, jeśli sparsowany token odpowiada operatorowi DEL.
+ * @return Sparsowane słowo kluczowe lub @p KEYWORD_NONE, jeśli napotkano
+ *         jakikolwiek błąd.
  */
-int validNEWorDEL (size_t* pos, dynStr buffer) {
+static enum keyword validKeyword (size_t* pos, dynStr buffer) {
     size_t startPos = *pos + 1;
     dynStrReset(buffer);
     char c = (char)getchar();
@@ -102,12 +148,12 @@ int validNEWorDEL (size_t* pos, dynStr buffer) {
     while (c != EOF && buffer->used < 4) {
         if (c == '$') {
             syntaxError(startPos);
-            return 0;
+            return KEYWORD_NONE;
         }
 
         if (!dynStrAdd(buffer, c)) {
             fprintf(stderr, "MEMORY ERROR\n");
-            return false;
+            return KEYWORD_NONE;
         }
 
         c = (char)getchar();
@@ -116,22 +162,31 @@ int validNEWorDEL (size_t* pos, dynStr buffer) {
 
     if (buffer->used < 4) {
         syntaxError(startPos);
-        return 0;
+        return KEYWORD_NONE;
+    }
+
+    if (strcmp(buffer->str, "NEW") != 0 && strcmp(buffer->str, "DEL") != 0 &&
+        isalnum(buffer->str[1]) != 0 && isalnum(buffer->str[2]) != 0) {
+        while (isalnum(c) != 0) {
+            if (!dynStrAdd(buffer, c)) {
+                fprintf(stderr, "MEMORY ERROR\n");
+                return KEYWORD_NONE;
+            }
+
+            c = (char)getchar();
+            (*pos)++;
+        }
     }
 
     ungetc(c, stdin);
     (*pos)--;
 
-    if (strcmp(buffer->str, "NEW") == 0)
-        return 1;
-
-    else if (strcmp(buffer->str, "DEL") == 0)
-        return 2;
+    enum keyword res = findKeyword(buffer->str);
 
-    else {
+    if (res == KEYWORD_NONE)
         syntaxError(startPos);
-        return 0;
-    }
+
+    return res;
 }
 
 
@@ -215,6 +270,75 @@ bool getNum (size_t* pos, dynStr buffer) {
     return true;
 }
 
+/** @brief Wypisuje numer na standardowe wyjście.
+ * Funkcja typu @ref PhoneNumCallback.
+ * @param[in] ctx  –  Nieużywany.
+ * @param[in] num  –  Wskaźnik na napis reprezentujący numer.
+ * @return Zawsze wartość @p true.
+ */
+static bool printNumber (void* ctx, const char* num) {
+    (void)ctx;
+    printf("%s\n", num);
+
+    return true;
+}
+
+/** @brief Wypisuje różnicę między bazami na standardowe wyjście.
+ * Przekierowanie dodane wypisywane jest jako @p + @p num @p fwd, usunięte
+ * jako @p - @p num @p fwd, a zmienione jako @p ~ @p num @p stare @p nowe.
+ * Funkcja typu @ref PhoneDiffCallback.
+ * @param[in] ctx     –  Nieużywany;
+ * @param[in] kind    –  Rodzaj różnicy;
+ * @param[in] num     –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] oldFwd  –  Wskaźnik na poprzednie przekierowanie lub NULL;
+ * @param[in] newFwd  –  Wskaźnik na nowe przekierowanie lub NULL.
+ * @return Zawsze wartość @p true.
+ */
+static bool printDiff (void* ctx, enum PhoneDiffKind kind, const char* num,
+                       const char* oldFwd, const char* newFwd) {
+    (void)ctx;
+
+    if (kind == PHFWD_DIFF_ADDED)
+        printf("+ %s %s\n", num, newFwd);
+
+    else if (kind == PHFWD_DIFF_REMOVED)
+        printf("- %s %s\n", num, oldFwd);
+
+    else
+        printf("~ %s %s %s\n", num, oldFwd, newFwd);
+
+    return true;
+}
+
+/** @brief Funkcja wypisująca statystyki bazy przekierowań.
+ * Każda statystyka wypisywana jest w osobnym wierszu w postaci nazwy i
+ * wartości. Z histogramów wypisywane są tylko niezerowe przedziały.
+ * @param[in] stats  –  Wskaźnik na strukturę ze statystykami.
+ */
+static void printStats (const struct PhoneForwardStats* stats) {
+    printf("nodes %zu\n", stats->nodes);
+    printf("forwards %zu\n", stats->forwards);
+    printf("stringBytes %zu\n", stats->stringBytes);
+    printf("auxBytes %zu\n", stats->auxBytes);
+    printf("arenaBytes %zu\n", stats->arenaBytes);
+    printf("totalBytes %zu\n", stats->totalBytes);
+    printf("passThrough %zu %.4f\n", stats->passThroughNodes,
+           stats->passThroughRatio);
+
+    for (size_t i = 0; i < PHFWD_STATS_DEPTH_BUCKETS; i++)
+        if (stats->depthHistogram[i] != 0)
+            printf("depth %zu %zu\n", i, stats->depthHistogram[i]);
+
+    for (size_t i = 0; i <= NUMBER_ALPHABET_SIZE; i++)
+        if (stats->fanoutHistogram[i] != 0)
+            printf("fanout %zu %zu\n", i, stats->fanoutHistogram[i]);
+
+    printf("reclaimPending %zu\n", stats->reclaimPending);
+    printf("reclaimedNodes %zu\n", stats->reclaimedNodes);
+    printf("rangeNodes %zu\n", stats->rangeNodes);
+    printf("rangeForwards %zu\n", stats->rangeForwards);
+}
+
 /** Funkcja sprawdzająca czy kolejne dwa znaki są poprawnym początkiem komentarza.
  * @param[in,out] pos     –  Aktualny numer znaku na którym stanęło przetwarzanie danych.
  * @return Wartość -1, jeśli wystąpił dokładnie jeden znak '$' a po nim coś innego.
@@ -246,8 +370,24 @@ int isValidComment (size_t* pos) {
     }
 }
 
-bool parseExpression (size_t* pos, dynStr buffer,
-                      dtbList* dtblist, dtbList* current) {
+/** @brief Implementacja funkcji @ref parseExpression.
+ * @param[in,out] pos      –  Wskaźnik na zmienną zawierającą numer przetwarzanego
+ *                            znaku.
+ * @param[in,out] buffer   –  Wskaźnik na strukturę @p dynamicString będącą
+ *                            buforem danych.
+ * @param[in,out] scratch  –  Wskaźnik na strukturę @p dynamicString, w której
+ *                            przechowywany jest pierwszy numer polecenia,
+ *                            gdy w @p buffer wczytywany jest drugi.
+ * @param[in,out] dtblist  –  Wskaźnik na pierwszą komórkę listy baz przekierowań.
+ * @param[in,out] current  –  Wskaźnik na aktualnie używaną bazę przekierowań.
+ * @param[out] command     –  Wskaźnik na zmienną, w której zapisywany jest
+ *                            rodzaj rozpoznanego polecenia.
+ * @return Wartość @p true, jeśli udało się poprawnie sparsować pewną operację.
+ *         Wartość @p false, jeśli gdzieś wystąpił błąd.
+ */
+static bool parseCommand (size_t* pos, dynStr buffer, dynStr scratch,
+                          dtbList* dtblist, dtbList* current,
+                          enum commandType* command) {
 
     size_t startPos;
     int c, flag;
@@ -286,6 +426,7 @@ bool parseExpression (size_t* pos, dynStr buffer,
 
     if (c == '?') {
         size_t opPos = *pos;
+        *command = COMMAND_REVERSE;
 
         // Pomijamy wszelkie białe znaki i komentarze z początku wejścia.
         do {
@@ -314,24 +455,15 @@ bool parseExpression (size_t* pos, dynStr buffer,
                 return false;
             }
 
-            const PhoneNum* phfwds = phfwdReverse((*current)->database, buffer->str);
-
-            // Sprawdzenie czy nie udało się zaalokować pamięci.
-            if (phfwds == NULL) {
+            /* Numery wypisywane są w miarę wyznaczania, bez przechowywania
+             * całego wyniku. Sprawdzenie czy nie udało się zaalokować pamięci. */
+            if (!phfwdReverseEach((*current)->database, buffer->str,
+                                  printNumber, NULL)) {
                 execError(opPos, "?");
                 return false;
             }
 
-            else {
-                size_t id = 0;
-
-                while (phnumGet(phfwds, id) != NULL)
-                    printf("%s\n", phnumGet(phfwds, id++));
-
-                phnumDelete(phfwds);
-
-                return true;
-            }
+            return true;
         }
 
         else
@@ -340,6 +472,7 @@ bool parseExpression (size_t* pos, dynStr buffer,
 
     else if (c == '@') {
         size_t opPos = *pos;
+        *command = COMMAND_NTC;
 
         // Pomijamy wszelkie białe znaki i komentarze z początku wejścia.
         do {
@@ -394,8 +527,10 @@ bool parseExpression (size_t* pos, dynStr buffer,
         if (!getNum(pos, buffer))
             return false;
 
-        char num1[buffer->used];
-        strcpy(num1, buffer->str);
+        /* Pierwszy numer przenosimy do bufora pomocniczego bez kopiowania, bo
+         * bufor danych posłuży do wczytania drugiego. */
+        dynStrSwap(buffer, scratch);
+        const char* num1 = scratch->str;
 
         // Pomijamy wszelkie białe znaki i komentarze z początku wejścia.
         do {
@@ -421,9 +556,10 @@ bool parseExpression (size_t* pos, dynStr buffer,
             return false;
         }
 
-        // Po poprawnie wczytanym numerze musi nastąpić operator '>' lub '?'
+        // Po poprawnie wczytanym numerze musi nastąpić operator '>', '?' lub '-'
         if (c == '>') {
             size_t opPos = *pos;
+            *command = COMMAND_ADD;
 
             // Pomijamy wszelkie białe znaki i komentarze z początku wejścia.
             do {
@@ -444,9 +580,6 @@ bool parseExpression (size_t* pos, dynStr buffer,
             /* Po znaku '>' musi nastąpić pewna liczba białych znaków oraz
              * komentarzy, po czym poprawny numer. */
             if (getNum(pos, buffer)) {
-                char num2[buffer->used];
-                strcpy(num2, buffer->str);
-
                 /* Wszelkie operacje na numerach przy nieustawionej bazie przekierowań
                  * są błędne. */
                 if (*current == NULL) {
@@ -454,7 +587,7 @@ bool parseExpression (size_t* pos, dynStr buffer,
                     return false;
                 }
 
-                if (phfwdAdd((*current)->database, num1, num2))
+                if (phfwdAdd((*current)->database, num1, buffer->str))
                     return true;
 
                 else  {
@@ -468,6 +601,7 @@ bool parseExpression (size_t* pos, dynStr buffer,
         }
 
         else if (c == '?') {
+            *command = COMMAND_GET;
 
             /* Wszelkie operacje na numerach przy nieustawionej bazie przekierowań
              * są błędne. */
@@ -490,6 +624,104 @@ bool parseExpression (size_t* pos, dynStr buffer,
             }
         }
 
+        else if (c == '-') {
+            *command = COMMAND_ADD_RANGE;
+
+            // Pomijamy wszelkie białe znaki i komentarze z początku wejścia.
+            do {
+                startPos = *pos;
+                skipWhiteChars(pos);
+
+                flag = isValidComment(pos);
+
+                if (flag == 0) {
+                    if(!skipComment(pos))
+                        return false;
+                }
+
+                else if (flag == -1)
+                    return false;
+            } while ((*pos) != startPos);
+
+            // Po znaku '-' musi nastąpić koniec zakresu.
+            if (!getNum(pos, buffer))
+                return false;
+
+            /* Koniec zakresu dopisujemy do bufora pomocniczego za początkiem,
+             * bo bufor danych posłuży do wczytania przekierowania. */
+            size_t fromLength = scratch->used - 1;
+            bool stored = dynStrAdd(scratch, '\0');
+
+            for (size_t i = 0; stored && i + 1 < buffer->used; i++)
+                stored = dynStrAdd(scratch, buffer->str[i]);
+
+            if (!stored) {
+                fprintf(stderr, "MEMORY ERROR\n");
+                return false;
+            }
+
+            // Pomijamy wszelkie białe znaki i komentarze z początku wejścia.
+            do {
+                startPos = *pos;
+                skipWhiteChars(pos);
+
+                flag = isValidComment(pos);
+
+                if (flag == 0) {
+                    if(!skipComment(pos))
+                        return false;
+                }
+
+                else if (flag == -1)
+                    return false;
+            } while ((*pos) != startPos);
+
+            c = getchar();
+            (*pos)++;
+
+            if (c == EOF) {
+                eofError();
+                return false;
+            }
+
+            if (c != '>') {
+                syntaxError(*pos);
+                return false;
+            }
+
+            size_t opPos = *pos;
+
+            // Pomijamy wszelkie białe znaki i komentarze z początku wejścia.
+            do {
+                startPos = *pos;
+                skipWhiteChars(pos);
+
+                flag = isValidComment(pos);
+
+                if (flag == 0) {
+                    if(!skipComment(pos))
+                        return false;
+                }
+
+                else if (flag == -1)
+                    return false;
+            } while ((*pos) != startPos);
+
+            if (!getNum(pos, buffer))
+                return false;
+
+            /* Wszelkie operacje na numerach przy nieustawionej bazie przekierowań
+             * są błędne. */
+            if (*current == NULL ||
+                !phfwdAddRange((*current)->database, scratch->str,
+                               scratch->str + fromLength + 1, buffer->str)) {
+                execError(opPos, ">");
+                return false;
+            }
+
+            return true;
+        }
+
         else {
             syntaxError(*pos);
             return false;
@@ -500,11 +732,58 @@ bool parseExpression (size_t* pos, dynStr buffer,
     (*pos)--;
 
     /* Wejście nie zaczyna się operatorem ani cyfrą, więc jedyną poprawną opcją
-     * jest operator NEW lub DEL. */
-    int newOrDel = validNEWorDEL(pos, buffer);
+     * jest słowo kluczowe. */
+    enum keyword keyword = validKeyword(pos, buffer);
 
-    if (newOrDel != 0) {
+    if (keyword == KEYWORD_STATS) {
+        *command = COMMAND_STATS;
+
+        /* Wszelkie operacje na numerach przy nieustawionej bazie przekierowań
+         * są błędne. */
+        if (*current == NULL) {
+            execError((*pos) - 4, "STATS");
+            return false;
+        }
+
+        struct PhoneForwardStats stats;
+
+        if (!phfwdStats((*current)->database, &stats)) {
+            execError((*pos) - 4, "STATS");
+            return false;
+        }
+
+        printStats(&stats);
+
+        return true;
+    }
+
+    else if (keyword == KEYWORD_COMPACT) {
+        *command = COMMAND_COMPACT;
+
+        /* Kompaktowanie jest tylko rozpoczynane; kolejne porcje pracy
+         * wykonywane są między poleceniami. */
+        if (*current == NULL || !phfwdCompact((*current)->database)) {
+            execError((*pos) - 6, "COMPACT");
+            return false;
+        }
+
+        return true;
+    }
+
+    else if (keyword == KEYWORD_FREEZE) {
+        *command = COMMAND_FREEZE;
+
+        if (*current == NULL || !phfwdFreeze((*current)->database)) {
+            execError((*pos) - 5, "FREEZE");
+            return false;
+        }
+
+        return true;
+    }
+
+    else if (keyword != KEYWORD_NONE) {
         size_t oldPos = (*pos);
+        size_t keywordPos = oldPos + 1 - strlen(keywordNames[keyword]);
 
         // Pomijamy wszelkie białe znaki i komentarze z początku wejścia.
         do {
@@ -540,28 +819,89 @@ bool parseExpression (size_t* pos, dynStr buffer,
         ungetc(c, stdin);
         (*pos)--;
 
-        // Po operatorze NEW/DEL musi być spacja.
+        /* Po operatorze NEW, DEL, JUMP, RESOLVE, GETALL, REVERSEALL, COUNT,
+         * DIFF i MERGE musi być spacja. */
         if ((*pos) == oldPos) {
-            syntaxError((*pos) - 2);
+            syntaxError(keywordPos);
             return false;
         }
 
-        if (newOrDel == 1) {
+        if (keyword == KEYWORD_NEW) {
+            *command = COMMAND_NEW;
+
             if (getID(pos, buffer)) {
+                char engine[ENGINE_NAME_LENGTH + 1];
+                size_t engineLength = 0;
+
+                // Pomijamy białe znaki i komentarze przed nazwą silnika.
+                do {
+                    startPos = *pos;
+                    skipWhiteChars(pos);
+
+                    flag = isValidComment(pos);
+
+                    if (flag == 0) {
+                        if (!skipComment(pos))
+                            return false;
+                    }
+
+                    else if (flag == -1)
+                        return false;
+                } while ((*pos) != startPos);
+
+                c = getchar();
+                (*pos)++;
+
+                /* Żadne polecenie nie zaczyna się małą literą, więc mała
+                 * litera rozpoczyna nazwę silnika. */
+                while (islower(c) != 0 || (engineLength > 0 && isalnum(c) != 0)) {
+                    if (engineLength < ENGINE_NAME_LENGTH)
+                        engine[engineLength] = (char)c;
+
+                    engineLength++;
+                    c = getchar();
+                    (*pos)++;
+                }
+
+                ungetc(c, stdin);
+                (*pos)--;
+
+                if (engineLength == 0)
+                    strcpy(engine, PHFWD_DEFAULT_ENGINE);
+
+                else if (engineLength <= ENGINE_NAME_LENGTH)
+                    engine[engineLength] = '\0';
+
+                if (engineLength > ENGINE_NAME_LENGTH || !phfwdEngineExists(engine)) {
+                    execError(keywordPos, "NEW");
+                    return false;
+                }
+
                 // Jeśli dana baza istnieje, to zmieniamy na nią wskaźnik na aktualną.
                 if (dtbExists(*dtblist, buffer->str)) {
-                    *current = getDtb(*dtblist, buffer->str);
+                    dtbList dtb = getDtb(*dtblist, buffer->str);
+
+                    // Jawnie podany silnik musi się zgadzać z silnikiem bazy.
+                    if (engineLength > 0 &&
+                        strcmp(phfwdEngineName(dtb->database), engine) != 0) {
+                        execError(keywordPos, "NEW");
+                        return false;
+                    }
+
+                    *current = dtb;
                     return true;
                 }
 
                 // Jeśli nie, dodajemy ją i dopiero wtedy zmieniamy wskaźnik.
                 else {
-                    if (!addDtb(dtblist, buffer->str)) {
+                    dtbList dtb = addDtb(dtblist, buffer->str, engine);
+
+                    if (dtb == NULL) {
                         fprintf(stderr, "MEMORY ERROR\n");
                         return false;
                     }
 
-                    *current = *dtblist;
+                    *current = dtb;
                     return true;
                 }
             }
@@ -570,6 +910,142 @@ bool parseExpression (size_t* pos, dynStr buffer,
                 return false;
         }
 
+        else if (keyword == KEYWORD_JUMP) {
+            *command = COMMAND_JUMP;
+
+            if (!getNum(pos, buffer))
+                return false;
+
+            /* Wszelkie operacje na numerach przy nieustawionej bazie przekierowań
+             * są błędne. Głębokość musi być małą liczbą dziesiętną. */
+            if (*current == NULL || buffer->used > 3) {
+                execError(keywordPos, "JUMP");
+                return false;
+            }
+
+            size_t depth = 0;
+
+            for (size_t i = 0; buffer->str[i] != '\0'; i++) {
+                if (isdigit(buffer->str[i]) == 0) {
+                    execError(keywordPos, "JUMP");
+                    return false;
+                }
+
+                depth = depth * 10 + (size_t)(buffer->str[i] - '0');
+            }
+
+            if (!phfwdSetJumpDepth((*current)->database, depth)) {
+                execError(keywordPos, "JUMP");
+                return false;
+            }
+
+            return true;
+        }
+
+        else if (keyword == KEYWORD_RESOLVE) {
+            *command = COMMAND_RESOLVE;
+
+            if (!getNum(pos, buffer))
+                return false;
+
+            /* Wszelkie operacje na numerach przy nieustawionej bazie przekierowań
+             * są błędne. */
+            if (*current == NULL) {
+                execError(keywordPos, "RESOLVE");
+                return false;
+            }
+
+            const PhoneNum* phfwd = phfwdResolve((*current)->database,
+                                                 buffer->str, RESOLVE_MAX_HOPS,
+                                                 NULL);
+
+            // Sprawdzenie czy nie udało się zaalokować pamięci.
+            if (phfwd == NULL) {
+                execError(keywordPos, "RESOLVE");
+                return false;
+            }
+
+            /* Przy cyklu lub przekroczonym limicie wynik jest pusty i nic nie
+             * jest wypisywane. */
+            if (phnumGet(phfwd, 0) != NULL)
+                printf("%s\n", phnumGet(phfwd, 0));
+
+            phnumDelete(phfwd);
+
+            return true;
+        }
+
+        else if (keyword == KEYWORD_COUNT) {
+            *command = COMMAND_COUNT;
+
+            if (!getNum(pos, buffer))
+                return false;
+
+            /* Wszelkie operacje na numerach przy nieustawionej bazie przekierowań
+             * są błędne. */
+            if (*current == NULL) {
+                execError(keywordPos, "COUNT");
+                return false;
+            }
+
+            printf("%zu\n", phfwdCount((*current)->database, buffer->str));
+
+            return true;
+        }
+
+        else if (keyword == KEYWORD_DIFF || keyword == KEYWORD_MERGE) {
+            bool merge = keyword == KEYWORD_MERGE;
+            *command = merge ? COMMAND_MERGE : COMMAND_DIFF;
+
+            if (!getID(pos, buffer))
+                return false;
+
+            /* Bazę bieżącą porównujemy z bazą o podanym identyfikatorze, więc
+             * obie muszą istnieć. */
+            if (*current == NULL || !dtbExists(*dtblist, buffer->str)) {
+                execError(keywordPos, keywordNames[keyword]);
+                return false;
+            }
+
+            PhoneFwd other = getDtb(*dtblist, buffer->str)->database;
+            bool succeed = merge ? phfwdMerge((*current)->database, other) :
+                           phfwdDiff((*current)->database, other, printDiff,
+                                     NULL);
+
+            if (!succeed) {
+                execError(keywordPos, keywordNames[keyword]);
+                return false;
+            }
+
+            return true;
+        }
+
+        else if (keyword == KEYWORD_GETALL || keyword == KEYWORD_REVERSEALL) {
+            bool reverse = keyword == KEYWORD_REVERSEALL;
+            *command = reverse ? COMMAND_REVERSE_ALL : COMMAND_GET_ALL;
+
+            if (!getNum(pos, buffer))
+                return false;
+
+            struct dtbQueryResults results;
+
+            if (!queryAllDtb(*dtblist, buffer->str, reverse, QUERY_ALL_THREADS,
+                             &results)) {
+                execError(keywordPos, keywordNames[keyword]);
+                return false;
+            }
+
+            // Każdy numer poprzedzony jest identyfikatorem bazy.
+            for (size_t i = 0; i < results.count; i++)
+                for (size_t j = 0; phnumGet(results.results[i], j) != NULL; j++)
+                    printf("%s %s\n", results.ids[i],
+                           phnumGet(results.results[i], j));
+
+            dtbQueryResultsDelete(&results);
+
+            return true;
+        }
+
         else {
             c = getchar();
             (*pos)++;
@@ -583,6 +1059,7 @@ bool parseExpression (size_t* pos, dynStr buffer,
                 (*pos)--;
                 succeed = getNum(pos, buffer);
                 type = 1;
+                *command = COMMAND_DEL_NUM;
             }
 
             else if (isalpha(c) != 0) {
@@ -590,6 +1067,7 @@ bool parseExpression (size_t* pos, dynStr buffer,
                 (*pos)--;
                 succeed = getID(pos, buffer);
                 type = 2;
+                *command = COMMAND_DEL_ID;
             }
 
             else if (c == EOF) {
@@ -615,7 +1093,7 @@ bool parseExpression (size_t* pos, dynStr buffer,
                     /* Wszelkie operacje na numerach przy nieustawionej bazie przekierowań
                      * są błędne. */
                     else {
-                        execError(oldPos - 2, "DEL");
+                        execError(keywordPos, "DEL");
                         return false;
                     }
                 }
@@ -633,7 +1111,7 @@ bool parseExpression (size_t* pos, dynStr buffer,
                     }
 
                     else {
-                        execError(oldPos - 2, "DEL");
+                        execError(keywordPos, "DEL");
                         return false;
                     }
                 }
@@ -645,6 +1123,15 @@ bool parseExpression (size_t* pos, dynStr buffer,
         return false;
 }
 
+bool parseExpression (size_t* pos, dynStr buffer, dynStr scratch,
+                      dtbList* dtblist, dtbList* current,
+                      enum commandType* command) {
+    *command = COMMAND_NONE;
 
+    PHFWD_PROBE1(command__entry, *pos);
+    bool res = parseCommand(pos, buffer, scratch, dtblist, current,
+                            command);
+    PHFWD_PROBE3(command__return, *command, *pos, res);
 
-
+    return res;
+}
@@ -14,6 +14,30 @@
 #include "phfwd_database_list.h"
 #include "phone_forward.h"
 
+/** Rodzaje poleceń przekazywane do punktów śledzenia i zapisu poleceń.
+ */
+enum commandType {
+    COMMAND_NONE,    ///< Nie rozpoznano polecenia (koniec danych lub błąd).
+    COMMAND_REVERSE, ///< Polecenie @p ? @p num.
+    COMMAND_NTC,     ///< Polecenie @p @ @p num.
+    COMMAND_ADD,     ///< Polecenie @p num @p > @p num.
+    COMMAND_GET,     ///< Polecenie @p num @p ?.
+    COMMAND_NEW,     ///< Polecenie @p NEW @p id [@p silnik].
+    COMMAND_DEL_NUM, ///< Polecenie @p DEL @p num.
+    COMMAND_DEL_ID,  ///< Polecenie @p DEL @p id.
+    COMMAND_STATS,   ///< Polecenie @p STATS.
+    COMMAND_JUMP,    ///< Polecenie @p JUMP @p k.
+    COMMAND_COMPACT, ///< Polecenie @p COMPACT.
+    COMMAND_FREEZE,  ///< Polecenie @p FREEZE.
+    COMMAND_RESOLVE, ///< Polecenie @p RESOLVE @p num.
+    COMMAND_GET_ALL, ///< Polecenie @p GETALL @p num.
+    COMMAND_REVERSE_ALL, ///< Polecenie @p REVERSEALL @p num.
+    COMMAND_ADD_RANGE, ///< Polecenie @p num @p - @p num @p > @p num.
+    COMMAND_COUNT,   ///< Polecenie @p COUNT @p num.
+    COMMAND_DIFF,    ///< Polecenie @p DIFF @p id.
+    COMMAND_MERGE    ///< Polecenie @p MERGE @p id.
+};
+
 /** @brief Funkcja parsująca dane wejściowe poprzez standardowe wejście.
  * Funkcja przetwarza dane do pierwszej możliwej operacji i ją wykonuje,
  * lub pomija całe wejście jeśli do końca są tylko białe znaki. Jeśli
@@ -24,12 +48,18 @@
  *                            znaku.
  * @param[in,out] buffer   –  Wskaźnik na strukturę @p dynamicString będącą
  *                            buforem danych.
+ * @param[in,out] scratch  –  Wskaźnik na strukturę @p dynamicString, w której
+ *                            przechowywany jest pierwszy numer polecenia,
+ *                            gdy w @p buffer wczytywany jest drugi.
  * @param[in,out] dtblist  –  Wskaźnik na pierwszą komórkę listy baz przekierowań.
  * @param[in,out] current  –  Wskaźnik na aktualnie używaną bazę przekierowań.
+ * @param[out] command     –  Wskaźnik na zmienną, w której zapisywany jest
+ *                            rodzaj rozpoznanego polecenia.
  * @return Wartość @p true, jeśli udało się poprawnie sparsować pewną operację.
  *         Wartość @p false, jeśli gdzieś wystąpił błąd.
  */
-bool parseExpression (size_t* pos, dynStr buffer,
-                      dtbList* dtblist, dtbList* current);
+bool parseExpression (size_t* pos, dynStr buffer, dynStr scratch,
+                      dtbList* dtblist, dtbList* current,
+                      enum commandType* command);
 
 #endif //TELEFONY_PARSER_H
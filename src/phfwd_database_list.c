@@ -1,119 +1,426 @@
 /** @file
- * Implementacja jednokierunkowej listy baz przekierowań i funkcji z nią związanych.
+ * Implementacja dwukierunkowej listy baz przekierowań i funkcji z nią związanych.
  *
  * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
  * @date 01.06.2018
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "phfwd_database_list.h"
 #include "string.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+/** Najmniejsza liczba baz, dla której zapytanie rozdzielane jest między
+ * wątki puli; mniejsze zapytania bieżący wątek wykonuje sam. */
+#define DTB_POOL_MIN_DTBS 4
+
+/** @brief Wypina komórkę z listy.
+ * @param[in,out] l     –  Wskaźnik na wskaźnik na pierwszą komórkę listy;
+ * @param[in,out] cell  –  Wskaźnik na komórkę listy @p l.
+ */
+static void dtbUnlink (dtbList* l, dtbList cell) {
+    if (cell->prev != NULL)
+        cell->prev->next = cell->next;
+
+    else
+        *l = cell->next;
+
+    if (cell->next != NULL)
+        cell->next->prev = cell->prev;
 
-bool addDtb (dtbList* l, const char* id) {
+    cell->prev = cell->next = NULL;
+}
+
+/** @brief Wpina komórkę do listy.
+ * @param[in,out] l     –  Wskaźnik na wskaźnik na pierwszą komórkę listy;
+ * @param[in,out] prev  –  Wskaźnik na komórkę, za którą wpinamy, lub NULL,
+ *                         aby wpiąć komórkę na początek listy;
+ * @param[in,out] cell  –  Wskaźnik na wpinaną komórkę.
+ */
+static void dtbLinkAfter (dtbList* l, dtbList prev, dtbList cell) {
+    cell->prev = prev;
+    cell->next = prev == NULL ? *l : prev->next;
+
+    if (cell->next != NULL)
+        cell->next->prev = cell;
+
+    if (prev != NULL)
+        prev->next = cell;
+
+    else
+        *l = cell;
+}
+
+dtbList addDtb (dtbList* l, const char* id, const char* engine) {
     dtbList newElt = malloc(sizeof(struct phFwdDatabaseList));
 
     if (newElt == NULL)
-        return false;
+        return NULL;
 
     else {
-        newElt->next = *l;
         newElt->id = calloc(strlen(id) + 1, sizeof(char));
 
         if (newElt->id == NULL) {
             free(newElt);
-            return false;
+            return NULL;
         }
 
-        newElt->database = phfwdNew();
+        newElt->database = phfwdNewEngine(engine);
 
         if (newElt->database == NULL) {
             free(newElt->id);
             free(newElt);
-            return false;
+            return NULL;
         }
 
         strcpy(newElt->id, id);
+        newElt->pending = false;
     }
 
-    *l = newElt;
-    return true;
+    // Bazy z pracą w tle muszą zostać na początku listy.
+    dtbList prev = NULL;
+
+    for (dtbList head = *l; head != NULL && head->pending; head = head->next)
+        prev = head;
+
+    dtbLinkAfter(l, prev, newElt);
+    return newElt;
 }
 
 bool removeDtb (dtbList* l, const char* id) {
-    dtbList head = *l;
-    dtbList prev = *l;
+    dtbList head = getDtb(*l, id);
 
-    if (head != NULL) {
-        if (strcmp(head->id, id) == 0) {
-            free(head->id);
-            phfwdDelete(head->database);
+    if (head == NULL)
+        return false;
 
-            *l = head->next;
-            free(head);
+    /* Baza zostaje w liście bez identyfikatora, dopóki maintainDtbList nie
+     * zwolni porcjami jej drzewa. */
+    free(head->id);
+    head->id = NULL;
+    phfwdRetire(head->database);
+
+    if (!head->pending) {
+        dtbUnlink(l, head);
+        dtbLinkAfter(l, NULL, head);
+        head->pending = true;
+    }
 
+    return true;
+}
+
+bool dtbExists (dtbList l, const char* id) {
+    dtbList head = l;
+
+    while (head != NULL) {
+        if (head->id != NULL && strcmp(head->id, id) == 0)
             return true;
-        }
 
-        else {
-            head = head->next;
+        head = head->next;
+    }
+
+    return false;
+}
 
-            while (head != NULL) {
-                if (strcmp(head->id, id) == 0) {
-                    free(head->id);
-                    phfwdDelete(head->database);
+dtbList getDtb (dtbList l, const char* id) {
+    dtbList head = l;
+
+    while (head != NULL) {
+        if (head->id != NULL && strcmp(head->id, id) == 0)
+            return head;
 
-                    prev->next = head->next;
-                    free(head);
+        head = head->next;
+    }
 
-                    return true;
-                }
+    return NULL;
+}
 
-                else {
-                    prev = head;
-                    head = head->next;
+/** Stan zapytania wykonywanego równolegle we wszystkich bazach.
+ */
+struct dtbQuery {
+    dtbList* dtbs;                   ///< Bazy w kolejności wyników.
+    const char* num;                 ///< Wskaźnik na numer z zapytania.
+    bool reverse;                    ///< Czy wyznaczać przekierowania na numer.
+    struct dtbQueryResults* results; ///< Wskaźnik na wyniki.
+    atomic_size_t next;              ///< Indeks kolejnej bazy do obsłużenia.
+};
 
-                }
-            }
+/** @brief Funkcja wątku puli.
+ * Pobiera kolejne bazy, dopóki wszystkie nie zostaną obsłużone.
+ * @param[in,out] arg  –  Wskaźnik na strukturę @ref dtbQuery.
+ * @return Zawsze NULL.
+ */
+static void* dtbQueryWorker (void* arg) {
+    struct dtbQuery* query = arg;
+    size_t i;
 
-            return false;
-        }
+    while ((i = atomic_fetch_add(&query->next, 1)) < query->results->count) {
+        PhoneFwd pf = query->dtbs[i]->database;
+
+        query->results->results[i] = query->reverse ?
+                                     phfwdReverse(pf, query->num) :
+                                     phfwdGet(pf, query->num);
     }
 
-    else
-        return false;
+    return NULL;
 }
 
-bool dtbExists (dtbList l, const char* id) {
-    dtbList head = l;
+/** @brief Pula wątków zapytań wykonywanych we wszystkich bazach.
+ * Wątki uruchamiane są przy pierwszym zapytaniu obejmującym co najmniej
+ * DTB_POOL_MIN_DTBS baz i czekają na kolejne zapytania, aż
+ * @ref removeDtbList zatrzyma pulę.
+ */
+struct dtbPool {
+    pthread_mutex_t lock;      ///< Blokada stanu puli.
+    pthread_cond_t work;       ///< Sygnał nowego zapytania lub zatrzymania.
+    pthread_cond_t done;       ///< Sygnał zakończenia pracy wszystkich wątków.
+    pthread_t* workers;        ///< Wątki puli.
+    size_t size;               ///< Liczba uruchomionych wątków.
+    struct dtbQuery* query;    ///< Bieżące zapytanie.
+    unsigned long generation;  ///< Numer bieżącego zapytania.
+    size_t active;             ///< Liczba wątków pracujących nad zapytaniem.
+    bool started;              ///< Czy pula została uruchomiona.
+    bool stop;                 ///< Czy wątki mają się zakończyć.
+};
 
-    while (head != NULL) {
-        if (strcmp(head->id, id) == 0)
-            return true;
+/** Pula wątków baz przekierowań. */
+static struct dtbPool pool = {PTHREAD_MUTEX_INITIALIZER,
+                              PTHREAD_COND_INITIALIZER,
+                              PTHREAD_COND_INITIALIZER,
+                              NULL, 0, NULL, 0, 0, false, false};
 
-        head = head->next;
+/** @brief Funkcja wątku puli.
+ * Czeka na kolejne zapytania i obsługuje je razem z wątkiem zlecającym.
+ * @param[in] arg  –  Nieużywany.
+ * @return Zawsze NULL.
+ */
+static void* dtbPoolWorker (void* arg) {
+    unsigned long seen = 0;
+
+    (void)arg;
+    pthread_mutex_lock(&pool.lock);
+
+    while (true) {
+        while (!pool.stop && pool.generation == seen)
+            pthread_cond_wait(&pool.work, &pool.lock);
+
+        if (pool.stop)
+            break;
+
+        struct dtbQuery* query = pool.query;
+
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+        dtbQueryWorker(query);
+        pthread_mutex_lock(&pool.lock);
+
+        if (--pool.active == 0)
+            pthread_cond_signal(&pool.done);
     }
 
-    return false;
+    pthread_mutex_unlock(&pool.lock);
+
+    return NULL;
+}
+
+/** @brief Uruchamia wątki puli.
+ * Bieżący wątek też obsługuje bazy, więc uruchamia o jeden wątek mniej, niż
+ * wynosi @p threads. Jeśli nie udało się uruchomić wszystkich wątków, pula
+ * działa z tymi, które się uruchomiły.
+ * @param[in] threads  –  Liczba wątków obsługujących zapytania.
+ */
+static void dtbPoolStart (size_t threads) {
+    pool.started = true;
+    pool.workers = malloc(threads * sizeof(pthread_t));
+
+    while (pool.workers != NULL && pool.size + 1 < threads &&
+           pthread_create(&pool.workers[pool.size], NULL, dtbPoolWorker,
+                          NULL) == 0)
+        pool.size++;
+}
+
+/** @brief Zatrzymuje wątki puli.
+ * Kolejne zapytanie uruchomi pulę ponownie.
+ */
+static void dtbPoolStop (void) {
+    pthread_mutex_lock(&pool.lock);
+    pool.stop = true;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (size_t i = 0; i < pool.size; i++)
+        pthread_join(pool.workers[i], NULL);
+
+    free(pool.workers);
+    pool.workers = NULL;
+    pool.size = 0;
+    pool.started = false;
+    pool.stop = false;
+}
+
+/** @brief Wykonuje zapytanie wątkami puli.
+ * Wraca, gdy wszystkie bazy zostały obsłużone.
+ * @param[in,out] query  –  Wskaźnik na zapytanie.
+ */
+static void dtbPoolRun (struct dtbQuery* query) {
+    pthread_mutex_lock(&pool.lock);
+    pool.query = query;
+    pool.active = pool.size;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.lock);
+
+    dtbQueryWorker(query);
+
+    pthread_mutex_lock(&pool.lock);
+
+    while (pool.active > 0)
+        pthread_cond_wait(&pool.done, &pool.lock);
+
+    pthread_mutex_unlock(&pool.lock);
 }
 
 void removeDtbList (dtbList l) {
-    if (l != NULL) {
-        removeDtbList(l->next);
+    if (pool.started)
+        dtbPoolStop();
+
+    while (l != NULL) {
+        dtbList next = l->next;
+
         free(l->id);
         phfwdDelete(l->database);
         free(l);
+        l = next;
     }
 }
 
-dtbList getDtb (dtbList l, const char* id) {
-    dtbList head = l;
+/** Komparator baz. Porównuje identyfikatory leksykograficznie.
+ * @param p1  –  Wskaźnik na wskaźnik na pierwszą bazę;
+ * @param p2  –  Wskaźnik na wskaźnik na drugą bazę.
+ * @return Wynik porównania identyfikatorów, jak w funkcji strcmp.
+ */
+static int dtbCompare (const void* p1, const void* p2) {
+    const dtbList* d1 = p1;
+    const dtbList* d2 = p2;
 
-    while (head != NULL) {
-        if (strcmp(head->id, id) == 0)
-            return head;
+    return strcmp((*d1)->id, (*d2)->id);
+}
 
-        head = head->next;
+bool queryAllDtb (dtbList l, const char* num, bool reverse, size_t threads,
+                  struct dtbQueryResults* results) {
+    size_t count = 0;
+
+    for (dtbList head = l; head != NULL; head = head->next)
+        if (head->id != NULL)
+            count++;
+
+    dtbList* dtbs = malloc((count + 1) * sizeof(dtbList));
+
+    results->count = count;
+    results->ids = malloc((count + 1) * sizeof(char*));
+    results->results = calloc(count + 1, sizeof(PhoneNum*));
+
+    if (dtbs == NULL || results->ids == NULL || results->results == NULL) {
+        free(dtbs);
+        free(results->ids);
+        free(results->results);
+        return false;
     }
 
-    return NULL;
+    count = 0;
+
+    for (dtbList head = l; head != NULL; head = head->next)
+        if (head->id != NULL)
+            dtbs[count++] = head;
+
+    qsort(dtbs, count, sizeof(dtbList), dtbCompare);
+
+    for (size_t i = 0; i < count; i++)
+        results->ids[i] = dtbs[i]->id;
+
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (size_t)online : 1;
+    }
+
+    struct dtbQuery query = {dtbs, num, reverse, results, 0};
+
+    // Dla kilku baz przekazanie pracy wątkom trwałoby dłużej niż same zapytania.
+    if (count < DTB_POOL_MIN_DTBS || threads < 2)
+        dtbQueryWorker(&query);
+
+    else {
+        if (!pool.started)
+            dtbPoolStart(threads);
+
+        dtbPoolRun(&query);
+    }
+
+    free(dtbs);
+
+    for (size_t i = 0; i < count; i++) {
+        if (results->results[i] == NULL) {
+            dtbQueryResultsDelete(results);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void dtbQueryResultsDelete (struct dtbQueryResults* results) {
+    for (size_t i = 0; i < results->count; i++)
+        phnumDelete(results->results[i]);
+
+    free(results->ids);
+    free(results->results);
+    results->count = 0;
+    results->ids = NULL;
+    results->results = NULL;
 }
 
+void maintainDtbList (dtbList* l, dtbList current, size_t budget) {
+    // Zerowy budżet jedynie sprawdza, czy bieżąca baza ma pracę w tle.
+    if (current != NULL && !current->pending &&
+        phfwdMaintain(current->database, 0)) {
+        dtbUnlink(l, current);
+        dtbLinkAfter(l, NULL, current);
+        current->pending = true;
+    }
+
+    dtbList last = NULL;      // Ostatnia baza, która nadal ma pracę w tle.
+    dtbList finished = NULL;  // Bazy, którym nie zostało nic do zrobienia.
+    dtbList head = *l;
+
+    while (head != NULL && head->pending) {
+        dtbList next = head->next;
+
+        if (phfwdMaintain(head->database, budget))
+            last = head;
+
+        // Usuniętą bazę zwalniamy, gdy nie zostało już nic do zrobienia w tle.
+        else if (head->id == NULL) {
+            dtbUnlink(l, head);
+            phfwdDelete(head->database);
+            free(head);
+        }
+
+        else {
+            dtbUnlink(l, head);
+            head->pending = false;
+            head->next = finished;
+            finished = head;
+        }
+
+        head = next;
+    }
+
+    while (finished != NULL) {
+        dtbList next = finished->next;
+
+        dtbLinkAfter(l, last, finished);
+        finished = next;
+    }
+}
@@ -1,5 +1,5 @@
 /** @file
- * Specyfikacja jednokierunkowej listy baz przekierowań i funkcji z nią związanych.
+ * Specyfikacja dwukierunkowej listy baz przekierowań i funkcji z nią związanych.
  *
  * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
  * @date 01.06.2018
@@ -11,11 +11,16 @@
 #include "phone_forward.h"
 
 /** @brief Lista baz przekierowań.
- *  Lista jest jednokierunkowa.
+ *  Lista jest dwukierunkowa. Bazy z pracą w tle leżą na jej początku,
+ *  więc @ref maintainDtbList odwiedza tylko je.
  */
 struct phFwdDatabaseList {
-    char* id;                        ///< Wskaźnik na identyfikator tablicy.
+    char* id;                        /**< Wskaźnik na identyfikator tablicy
+                                          lub NULL dla usuniętej bazy
+                                          czekającej na zwolnienie. */
     PhoneFwd database;               ///< Wskaźnik na bazę przekierowań.
+    bool pending;                    ///< Czy baza ma pracę w tle.
+    struct phFwdDatabaseList* prev;  ///< Wskaźnik na poprzednią komórkę listy.
     struct phFwdDatabaseList* next;  ///< Wskaźnik na następną komórkę listy.
 };
 
@@ -24,18 +29,22 @@ struct phFwdDatabaseList {
 typedef struct phFwdDatabaseList* dtbList;
 
 /** @brief Dodaje bazę do listy.
- * Dodaje bazę o identyfikatorze @p id do listy @p l. Po dodaniu znajduje się
- * ona na czele listy. Funkcja ta nie sprawdza czy baza o danym identyfikatorze
+ * Dodaje bazę o identyfikatorze @p id do listy @p l, zaraz za bazami z pracą
+ * w tle. Funkcja ta nie sprawdza czy baza o danym identyfikatorze
  * jest już w liście.
  * @param[in,out] l  –  Wskaźnik na wskaźnik na pierwszą komórkę listy;
- * @param[in] id     –  Wskaźnik na napis reprezentujący identyfikator bazy.
- * @return Wartość @p true, jeśli baza została dodana.
- *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ * @param[in] id     –  Wskaźnik na napis reprezentujący identyfikator bazy;
+ * @param[in] engine –  Wskaźnik na nazwę istniejącego silnika bazy
+ *                      (zob. @ref phfwdNewEngine).
+ * @return Wskaźnik na komórkę dodanej bazy lub NULL, jeśli nie udało się
+ *         zaalokować pamięci.
  */
-bool addDtb (dtbList* l, const char* id);
+dtbList addDtb (dtbList* l, const char* id, const char* engine);
 
 /** @brief Usuwa bazę z listy.
- * Usuwa bazę o identyfikatorze @p id z listy @p l.
+ * Usuwa bazę o identyfikatorze @p id z listy @p l. Baza przestaje być
+ * widoczna od razu, ale jej pamięć zwalniana jest porcjami przez
+ * @ref maintainDtbList (zob. @ref phfwdRetire).
  * @param[in,out] l  –  Wskaźnik na wskaźnik na pierwszą komórkę listy;
  * @param[in] id     –  Wskaźnik na napis reprezentujący identyfikator bazy.
  * @return Wartość @p true, jeśli baza została poprawnie usunięta.
@@ -66,4 +75,56 @@ bool dtbExists (dtbList l, const char* id);
  */
 dtbList getDtb (dtbList l, const char* id);
 
+/** @brief Wyniki zapytania wykonanego we wszystkich bazach listy.
+ * Bazy uporządkowane są leksykograficznie według identyfikatorów.
+ */
+struct dtbQueryResults {
+    size_t count;              ///< Liczba baz.
+    const char** ids;          ///< Identyfikatory kolejnych baz.
+    const PhoneNum** results;  ///< Wyniki zapytania w kolejnych bazach.
+};
+
+/** @brief Wykonuje zapytanie we wszystkich bazach z listy równolegle.
+ * Dla każdej bazy wyznacza @ref phfwdGet lub @ref phfwdReverse numeru
+ * @p num. Bazy rozdzielane są między wątki puli, przy czym każda baza
+ * obsługiwana jest przez jeden wątek. Pula uruchamiana jest przy pierwszym
+ * zapytaniu obejmującym kilka baz i działa do wywołania
+ * @ref removeDtbList; przy mniejszej liczbie baz zapytanie wykonuje bieżący
+ * wątek. Wyniki nie zależą od liczby wątków.
+ * Identyfikatory w wyniku wskazują na identyfikatory baz z listy, więc są
+ * ważne, dopóki bazy nie zostaną usunięte.
+ * @param[in] l         –  Wskaźnik na pierwszą komórkę listy;
+ * @param[in] num       –  Wskaźnik na napis reprezentujący numer;
+ * @param[in] reverse   –  Czy wyznaczać przekierowania na numer zamiast
+ *                         przekierowania numeru;
+ * @param[in] threads   –  Liczba wątków puli lub 0, aby użyć tylu wątków,
+ *                         ile jest dostępnych procesorów; liczba ta
+ *                         ustalana jest przy uruchomieniu puli;
+ * @param[out] results  –  Wskaźnik na strukturę, do której zostaną zapisane
+ *                         wyniki; zwalnia je @ref dtbQueryResultsDelete.
+ * @return Wartość @p true, jeśli udało się wyznaczyć wszystkie wyniki.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci; wtedy
+ *         nie trzeba zwalniać wyników.
+ */
+bool queryAllDtb (dtbList l, const char* num, bool reverse, size_t threads,
+                  struct dtbQueryResults* results);
+
+/** Zwalnia wyniki zapytania wykonanego we wszystkich bazach.
+ * @param[in,out] results  –  Wskaźnik na strukturę z wynikami.
+ */
+void dtbQueryResultsDelete (struct dtbQueryResults* results);
+
+/** @brief Wykonuje porcję prac w tle w bazach, które ją mają.
+ * Polecenia zmieniają tylko bieżącą bazę, więc tylko ona może dostać nową
+ * pracę w tle; wtedy trafia na początek listy. Dla baz z początku listy
+ * wywołuje @ref phfwdMaintain z podanym budżetem. Bazy, którym nie zostało
+ * nic do zrobienia, przenosi za nie, a usunięte bazy, których pamięć została
+ * już zwolniona, wypina z listy. Koszt zależy od liczby baz z pracą w tle,
+ * a nie od długości listy.
+ * @param[in,out] l    –  Wskaźnik na wskaźnik na pierwszą komórkę listy;
+ * @param[in] current  –  Wskaźnik na komórkę bieżącej bazy lub NULL;
+ * @param[in] budget   –  Budżet pracy przypadający na jedną bazę.
+ */
+void maintainDtbList (dtbList* l, dtbList current, size_t budget);
+
 #endif //TELEFONY_PHFWD_DATABASE_LIST_H
@@ -0,0 +1,105 @@
+/** @file
+ * Interfejs silników przechowujących przekierowania numerów telefonicznych.
+ * Domyślnym silnikiem jest drzewo prefiksowe z pliku phone_forward.c; inne
+ * silniki udostępniają tablicę funkcji @p phfwdEngine, przez którą funkcje z
+ * pliku phone_forward.h wykonują podstawowe operacje. Pozostałe operacje
+ * (np. wyznaczanie przekierowań na numer) zbudowane są na przeglądaniu i
+ * wyszukiwaniu przekierowań, więc działają dla każdego silnika.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#ifndef TELEFONY_PHFWD_ENGINE_H
+#define TELEFONY_PHFWD_ENGINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "phone_forward.h"
+
+#define PHFWD_DEFAULT_ENGINE "trie" ///< Nazwa domyślnego silnika (drzewa prefiksowego).
+
+/** @brief Funkcja wywoływana dla kolejnych przekierowań.
+ * Napisy nie muszą być zakończone znakiem '\0'.
+ * @param[in,out] ctx     –  Wskaźnik na dane wywołującego;
+ * @param[in] num         –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] numLength   –  Długość prefiksu przekierowywanego;
+ * @param[in] fwd         –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength   –  Długość przekierowania.
+ * @return Wartość @p true, jeśli należy kontynuować przeglądanie.
+ *         Wartość @p false, jeśli należy je przerwać.
+ */
+typedef bool (*forwardCallback)(void* ctx, const char* num, size_t numLength,
+                                const char* fwd, size_t fwdLength);
+
+/** @brief Tablica funkcji silnika przechowującego przekierowania.
+ * Funkcje dostają stan silnika utworzony przez @p create. Numery przekazywane
+ * do @p add, @p remove i @p lookup są poprawne i niepuste, a przy dodawaniu
+ * różne od siebie.
+ */
+struct phfwdEngine {
+    const char* name;   ///< Nazwa silnika używana w poleceniu NEW.
+
+    /** Tworzy pusty stan silnika.
+     * @return Wskaźnik na stan lub NULL, jeśli nie udało się zaalokować pamięci.
+     */
+    void* (*create)(void);
+
+    /** Usuwa stan silnika.
+     * @param[in] data  –  Wskaźnik na stan silnika.
+     */
+    void (*destroy)(void* data);
+
+    /** Dodaje przekierowanie, działa jak @ref phfwdAdd.
+     * @param[in,out] data  –  Wskaźnik na stan silnika;
+     * @param[in] num1      –  Wskaźnik na prefiks przekierowywany;
+     * @param[in] num2      –  Wskaźnik na przekierowanie.
+     * @return Wartość @p true, jeśli przekierowanie zostało dodane.
+     *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+     */
+    bool (*add)(void* data, const char* num1, const char* num2);
+
+    /** Usuwa przekierowania, działa jak @ref phfwdRemove.
+     * @param[in,out] data  –  Wskaźnik na stan silnika;
+     * @param[in] num       –  Wskaźnik na prefiks numerów.
+     */
+    void (*remove)(void* data, const char* num);
+
+    /** Wyszukuje przekierowanie najdłuższego prefiksu numeru.
+     * @param[in,out] data      –  Wskaźnik na stan silnika;
+     * @param[in] num           –  Wskaźnik na numer;
+     * @param[in] keyLength     –  Długość numeru;
+     * @param[out] matchLength  –  Wskaźnik na długość dopasowanego prefiksu;
+     * @param[out] fwd          –  Wskaźnik na wskaźnik na jego przekierowanie;
+     * @param[out] fwdLength    –  Wskaźnik na długość przekierowania.
+     * @return Wartość @p true, jeśli któryś prefiks numeru ma przekierowanie.
+     *         Wartość @p false w przeciwnym wypadku; wtedy wyniki nie są
+     *         zapisywane.
+     */
+    bool (*lookup)(void* data, const char* num, size_t keyLength,
+                   size_t* matchLength, const char** fwd, size_t* fwdLength);
+
+    /** Przegląda przekierowania w porządku leksykograficznym prefiksów
+     * przekierowywanych.
+     * @param[in,out] data  –  Wskaźnik na stan silnika;
+     * @param[in] callback  –  Funkcja wywoływana dla każdego przekierowania;
+     * @param[in,out] ctx   –  Dane przekazywane funkcji @p callback.
+     * @return Wartość @p true, jeśli przejrzano wszystkie przekierowania.
+     *         Wartość @p false, jeśli przerwano przeglądanie lub nie udało się
+     *         zaalokować pamięci.
+     */
+    bool (*forEach)(void* data, forwardCallback callback, void* ctx);
+
+    /** Wyznacza statystyki, działa jak @ref phfwdStats.
+     * @param[in] data    –  Wskaźnik na stan silnika;
+     * @param[out] stats  –  Wskaźnik na wyzerowaną strukturę statystyk.
+     */
+    void (*stats)(void* data, struct PhoneForwardStats* stats);
+};
+
+/** Silnik przechowujący przekierowania w tablicach haszujących
+ * (zob. phfwd_hash.h).
+ */
+extern const struct phfwdEngine phfwdHashEngine;
+
+#endif //TELEFONY_PHFWD_ENGINE_H
@@ -0,0 +1,760 @@
+/** @file
+ * Implementacja struktury przechowującej przekierowania numerów
+ * telefonicznych w tablicach haszujących, po jednej dla każdej długości
+ * prefiksu.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#include "phfwd_hash.h"
+#include "phfwd_engine.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HASH_INITIAL_BUCKETS 16     ///< Początkowa liczba kubełków poziomu.
+#define HASH_PRIME 0x100000001b3ULL ///< Mnożnik funkcji haszującej.
+#define HASH_STACK_PREFIXES 64      /**< Długość numeru, do której skróty
+                                         prefiksów liczone są z góry. */
+#define HASH_MAX_PATH 64            /**< Ograniczenie długości ścieżki
+                                         wyszukiwania binarnego. */
+#define HASH_INITIAL_LENGTH 15      /**< Początkowa największa długość
+                                         prefiksu (postaci 2^k - 1). */
+
+/** @brief Element tablicy haszującej: prefiks z przekierowaniem lub znacznik.
+ */
+struct hashEntry {
+    struct hashEntry* next;       ///< Następny element w kubełku.
+    uint64_t hash;                ///< Skrót prefiksu.
+    char* num;                    ///< Prefiks zakończony znakiem '\0'.
+    char* numForward;             /**< Przekierowanie prefiksu lub NULL, jeśli
+                                       element jest tylko znacznikiem. */
+    size_t numForwardLength;      ///< Długość przekierowania.
+    size_t markers;               /**< Liczba dłuższych prefiksów, dla których
+                                       element jest znacznikiem. */
+    const struct hashEntry* bmp;  /**< Najdłuższy prefiks z przekierowaniem
+                                       będący prefiksem @p num (tylko dla
+                                       znaczników). */
+    unsigned long bmpEpoch;       /**< Wersja zbioru przekierowań, dla której
+                                       wyliczono @p bmp. */
+};
+
+/** @brief Poziom: tablica haszująca prefiksów jednej długości.
+ * Liczba kubełków jest potęgą dwójki; pusty poziom nie ma kubełków.
+ */
+struct hashLevel {
+    size_t length;              ///< Długość prefiksów na poziomie.
+    struct hashEntry** buckets; ///< Tablica kubełków.
+    size_t bucketCount;         ///< Liczba kubełków.
+    size_t size;                ///< Liczba elementów.
+    size_t forwards;            ///< Liczba elementów z przekierowaniem.
+};
+
+/** Rozszerza skrót prefiksu o kolejną cyfrę.
+ * @param[in] hash  –  Skrót prefiksu;
+ * @param[in] c     –  Kolejna cyfra.
+ * @return Skrót prefiksu dłuższego o cyfrę @p c.
+ */
+static inline uint64_t hashStep(uint64_t hash, char c) {
+    return (hash + (unsigned char)c) * HASH_PRIME;
+}
+
+/** Wyznacza skrót prefiksu napisu.
+ * @param[in] str     –  Wskaźnik na napis;
+ * @param[in] length  –  Długość prefiksu.
+ * @return Skrót prefiksu.
+ */
+static uint64_t hashString(const char* str, size_t length) {
+    uint64_t hash = 0;
+
+    for (size_t i = 0; i < length; i++)
+        hash = hashStep(hash, str[i]);
+
+    return hash;
+}
+
+/** Wyznacza kubełek dla skrótu.
+ * @param[in] hash   –  Skrót;
+ * @param[in] count  –  Liczba kubełków (potęga dwójki).
+ * @return Indeks kubełka.
+ */
+static inline size_t bucketIndex(uint64_t hash, size_t count) {
+    return (size_t)(hash ^ (hash >> 32)) & (count - 1);
+}
+
+/** Szuka prefiksu na poziomie.
+ * @param[in] level  –  Wskaźnik na poziom;
+ * @param[in] num    –  Wskaźnik na napis, którego prefiks jest szukany;
+ * @param[in] hash   –  Skrót prefiksu długości poziomu.
+ * @return Wskaźnik na element lub NULL, jeśli go nie ma.
+ */
+static struct hashEntry* levelFind(const struct hashLevel* level,
+                                   const char* num, uint64_t hash) {
+    if (level->bucketCount == 0)
+        return NULL;
+
+    struct hashEntry* e = level->buckets[bucketIndex(hash, level->bucketCount)];
+
+    for (; e != NULL; e = e->next)
+        if (e->hash == hash && memcmp(e->num, num, level->length) == 0)
+            return e;
+
+    return NULL;
+}
+
+/** Zwalnia element tablicy haszującej.
+ * @param[in] e  –  Wskaźnik na element.
+ */
+static void entryFree(struct hashEntry* e) {
+    free(e->num);
+    free(e->numForward);
+    free(e);
+}
+
+/** @brief Podwaja liczbę kubełków poziomu.
+ * Jeśli nie uda się zaalokować pamięci, poziom zostaje bez zmian.
+ * @param[in,out] level  –  Wskaźnik na poziom.
+ */
+static void levelGrow(struct hashLevel* level) {
+    size_t count = 2 * level->bucketCount;
+    struct hashEntry** buckets = calloc(count, sizeof(struct hashEntry*));
+
+    if (buckets == NULL)
+        return;
+
+    for (size_t i = 0; i < level->bucketCount; i++) {
+        struct hashEntry* e = level->buckets[i];
+
+        while (e != NULL) {
+            struct hashEntry* next = e->next;
+            size_t idx = bucketIndex(e->hash, count);
+
+            e->next = buckets[idx];
+            buckets[idx] = e;
+            e = next;
+        }
+    }
+
+    free(level->buckets);
+    level->buckets = buckets;
+    level->bucketCount = count;
+}
+
+/** @brief Wstawia nowy element na poziom.
+ * Prefiksu nie może być jeszcze na poziomie.
+ * @param[in,out] level  –  Wskaźnik na poziom;
+ * @param[in] num        –  Wskaźnik na napis, którego prefiks jest wstawiany;
+ * @param[in] hash       –  Skrót prefiksu długości poziomu.
+ * @return Wskaźnik na nowy element bez przekierowania i znaczników lub NULL,
+ *         jeśli nie udało się zaalokować pamięci.
+ */
+static struct hashEntry* levelInsert(struct hashLevel* level, const char* num,
+                                     uint64_t hash) {
+    if (level->bucketCount == 0) {
+        level->buckets = calloc(HASH_INITIAL_BUCKETS, sizeof(struct hashEntry*));
+
+        if (level->buckets == NULL)
+            return NULL;
+
+        level->bucketCount = HASH_INITIAL_BUCKETS;
+    }
+
+    struct hashEntry* e = malloc(sizeof(struct hashEntry));
+
+    if (e == NULL)
+        return NULL;
+
+    e->num = malloc(level->length + 1);
+
+    if (e->num == NULL) {
+        free(e);
+        return NULL;
+    }
+
+    memcpy(e->num, num, level->length);
+    e->num[level->length] = '\0';
+    e->hash = hash;
+    e->numForward = NULL;
+    e->numForwardLength = 0;
+    e->markers = 0;
+    e->bmp = NULL;
+    e->bmpEpoch = 0;
+
+    if (level->size >= level->bucketCount)
+        levelGrow(level);
+
+    size_t idx = bucketIndex(hash, level->bucketCount);
+
+    e->next = level->buckets[idx];
+    level->buckets[idx] = e;
+    level->size++;
+
+    return e;
+}
+
+/** @brief Usuwa element z poziomu i go zwalnia.
+ * Zwalnia też kubełki poziomu, który stał się pusty.
+ * @param[in,out] level  –  Wskaźnik na poziom;
+ * @param[in] e          –  Wskaźnik na usuwany element.
+ */
+static void levelUnlink(struct hashLevel* level, struct hashEntry* e) {
+    struct hashEntry** slot = &level->buckets[bucketIndex(e->hash,
+                                                          level->bucketCount)];
+
+    while (*slot != e)
+        slot = &(*slot)->next;
+
+    *slot = e->next;
+    level->size--;
+
+    if (e->numForward != NULL)
+        level->forwards--;
+
+    entryFree(e);
+
+    if (level->size == 0) {
+        free(level->buckets);
+        level->buckets = NULL;
+        level->bucketCount = 0;
+    }
+}
+
+/** Zwalnia wszystkie elementy i kubełki poziomu.
+ * @param[in,out] level  –  Wskaźnik na poziom.
+ */
+static void levelClear(struct hashLevel* level) {
+    for (size_t i = 0; i < level->bucketCount; i++) {
+        struct hashEntry* e = level->buckets[i];
+
+        while (e != NULL) {
+            struct hashEntry* next = e->next;
+
+            entryFree(e);
+            e = next;
+        }
+    }
+
+    free(level->buckets);
+}
+
+/** @brief Zwiększa największą długość prefiksu.
+ * Największa długość ma postać 2^k - 1, więc wyszukiwanie binarne po
+ * przedziale [1, 2^(k+1) - 1] zaczyna od długości 2^k, a dla krótszych
+ * prefiksów dalej przebiega tak samo jak po przedziale [1, 2^k - 1].
+ * Istniejące znaczniki pozostają więc poprawne.
+ * @param[in,out] pf  –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] length  –  Długość prefiksu, która ma zostać objęta.
+ * @return Wartość @p true, jeśli długość jest objęta wyszukiwaniem.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool levelsGrow(PhoneFwdHash pf, size_t length) {
+    size_t maxLength = pf->maxLength;
+
+    while (maxLength < length)
+        maxLength = 2 * maxLength + 1;
+
+    if (maxLength == pf->maxLength)
+        return true;
+
+    struct hashLevel* bigger = realloc(pf->levels, maxLength *
+                                       sizeof(struct hashLevel));
+
+    if (bigger == NULL)
+        return false;
+
+    for (size_t i = pf->maxLength; i < maxLength; i++)
+        bigger[i] = (struct hashLevel){i + 1, NULL, 0, 0, 0};
+
+    pf->levels = bigger;
+    pf->maxLength = maxLength;
+
+    return true;
+}
+
+/** @brief Wyznacza poziomy, na których prefiks potrzebuje znaczników.
+ * Są to długości krótsze od @p length odwiedzane przez wyszukiwanie
+ * binarne zmierzające do długości @p length.
+ * @param[in] pf      –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] length  –  Długość prefiksu;
+ * @param[out] path   –  Tablica, do której zapisywane są długości poziomów.
+ * @return Liczba poziomów.
+ */
+static size_t markersPath(PhoneFwdHash pf, size_t length, size_t* path) {
+    size_t lo = 1, hi = pf->maxLength;
+    size_t count = 0;
+
+    while (lo <= hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (mid == length)
+            break;
+
+        if (mid < length) {
+            path[count++] = mid;
+            lo = mid + 1;
+        }
+
+        else
+            hi = mid - 1;
+    }
+
+    return count;
+}
+
+/** @brief Zwalnia znacznik prefiksu na poziomie.
+ * Usuwa element, jeśli nie jest już potrzebny.
+ * @param[in,out] pf  –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] length  –  Długość poziomu znacznika;
+ * @param[in] num     –  Wskaźnik na prefiks, dla którego jest znacznik.
+ */
+static void markerRelease(PhoneFwdHash pf, size_t length, const char* num) {
+    struct hashLevel* level = &pf->levels[length - 1];
+    struct hashEntry* e = levelFind(level, num, hashString(num, length));
+
+    if (e != NULL && --e->markers == 0 && e->numForward == NULL)
+        levelUnlink(level, e);
+}
+
+/** @brief Dodaje znaczniki prefiksu.
+ * @param[in,out] pf  –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] num     –  Wskaźnik na prefiks;
+ * @param[in] length  –  Długość prefiksu.
+ * @return Wartość @p true, jeśli udało się dodać znaczniki.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci; wtedy
+ *         żaden znacznik nie zostaje dodany.
+ */
+static bool markersAdd(PhoneFwdHash pf, const char* num, size_t length) {
+    size_t path[HASH_MAX_PATH];
+    size_t count = markersPath(pf, length, path);
+
+    for (size_t i = 0; i < count; i++) {
+        struct hashLevel* level = &pf->levels[path[i] - 1];
+        uint64_t hash = hashString(num, path[i]);
+        struct hashEntry* e = levelFind(level, num, hash);
+
+        if (e == NULL)
+            e = levelInsert(level, num, hash);
+
+        if (e == NULL) {
+            while (i-- > 0)
+                markerRelease(pf, path[i], num);
+
+            return false;
+        }
+
+        e->markers++;
+    }
+
+    return true;
+}
+
+/** Usuwa znaczniki prefiksu.
+ * @param[in,out] pf  –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] num     –  Wskaźnik na prefiks;
+ * @param[in] length  –  Długość prefiksu.
+ */
+static void markersRemove(PhoneFwdHash pf, const char* num, size_t length) {
+    size_t path[HASH_MAX_PATH];
+    size_t count = markersPath(pf, length, path);
+
+    for (size_t i = 0; i < count; i++)
+        markerRelease(pf, path[i], num);
+}
+
+PhoneFwdHash phfwdHashNew(void) {
+    PhoneFwdHash pf = malloc(sizeof(struct PhoneForwardHash));
+
+    if (pf != NULL) {
+        pf->levels = NULL;
+        pf->maxLength = 0;
+        pf->forwards = 0;
+        pf->epoch = 1;
+
+        if (!levelsGrow(pf, HASH_INITIAL_LENGTH)) {
+            free(pf);
+            return NULL;
+        }
+    }
+
+    return pf;
+}
+
+void phfwdHashDelete(PhoneFwdHash pf) {
+    if (pf != NULL) {
+        for (size_t i = 0; i < pf->maxLength; i++)
+            levelClear(&pf->levels[i]);
+
+        free(pf->levels);
+        free(pf);
+    }
+}
+
+/** Sprawdza, czy napis reprezentuje niepusty numer.
+ * @param[in] num  –  Wskaźnik na napis lub NULL.
+ * @return Długość numeru lub 0, jeśli napis nie reprezentuje numeru.
+ */
+static size_t numberLength(const char* num) {
+    if (num == NULL)
+        return 0;
+
+    size_t length = 0;
+
+    while (num[length] != '\0')
+        if (!isValidDigit(num[length++]))
+            return 0;
+
+    return length;
+}
+
+bool phfwdHashAdd(PhoneFwdHash pf, const char* num1, const char* num2) {
+    size_t keyLength = numberLength(num1);
+    size_t valueLength = numberLength(num2);
+
+    if (pf == NULL || keyLength == 0 || valueLength == 0 ||
+        strcmp(num1, num2) == 0 || !levelsGrow(pf, keyLength))
+        return false;
+
+    char* value = malloc(valueLength + 1);
+
+    if (value == NULL)
+        return false;
+
+    memcpy(value, num2, valueLength + 1);
+
+    struct hashLevel* level = &pf->levels[keyLength - 1];
+    uint64_t hash = hashString(num1, keyLength);
+    struct hashEntry* e = levelFind(level, num1, hash);
+
+    // Zmiana przekierowania istniejącego prefiksu nie zmienia wartości bmp.
+    if (e != NULL && e->numForward != NULL) {
+        free(e->numForward);
+        e->numForward = value;
+        e->numForwardLength = valueLength;
+        return true;
+    }
+
+    if (!markersAdd(pf, num1, keyLength)) {
+        free(value);
+        return false;
+    }
+
+    if (e == NULL)
+        e = levelInsert(level, num1, hash);
+
+    if (e == NULL) {
+        markersRemove(pf, num1, keyLength);
+        free(value);
+        return false;
+    }
+
+    e->numForward = value;
+    e->numForwardLength = valueLength;
+    level->forwards++;
+    pf->forwards++;
+    pf->epoch++;
+
+    return true;
+}
+
+/** @brief Usuwa przekierowanie elementu.
+ * Element jest usuwany z poziomu, jeśli nie jest znacznikiem.
+ * @param[in,out] pf  –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] length  –  Długość poziomu elementu;
+ * @param[in,out] e   –  Wskaźnik na element z przekierowaniem.
+ */
+static void entryRemove(PhoneFwdHash pf, size_t length, struct hashEntry* e) {
+    struct hashLevel* level = &pf->levels[length - 1];
+
+    markersRemove(pf, e->num, length);
+    free(e->numForward);
+    e->numForward = NULL;
+    level->forwards--;
+    pf->forwards--;
+
+    if (e->markers == 0)
+        levelUnlink(level, e);
+}
+
+void phfwdHashRemove(PhoneFwdHash pf, const char* num) {
+    size_t keyLength = numberLength(num);
+
+    if (pf == NULL || keyLength == 0 || keyLength > pf->maxLength)
+        return;
+
+    size_t forwards = pf->forwards;
+
+    /* Znaczniki prefiksu leżą na krótszych poziomach, więc przeglądając
+     * poziomy od najdłuższego, nie zmieniamy jeszcze nieprzejrzanych
+     * przekierowań. Dłuższe prefiksy trzeba wyszukać w całych poziomach. */
+    for (size_t k = pf->maxLength; k > keyLength; k--) {
+        struct hashLevel* level = &pf->levels[k - 1];
+
+        for (size_t b = 0; level->forwards > 0 && b < level->bucketCount; b++) {
+            struct hashEntry* e = level->buckets[b];
+
+            while (e != NULL) {
+                struct hashEntry* next = e->next;
+
+                if (e->numForward != NULL && memcmp(e->num, num, keyLength) == 0)
+                    entryRemove(pf, k, e);
+
+                e = next;
+            }
+        }
+    }
+
+    // Sam prefiks wystarczy wyszukać w tablicy haszującej.
+    struct hashEntry* e = levelFind(&pf->levels[keyLength - 1], num,
+                                    hashString(num, keyLength));
+
+    if (e != NULL && e->numForward != NULL)
+        entryRemove(pf, keyLength, e);
+
+    if (pf->forwards != forwards)
+        pf->epoch++;
+}
+
+/** @brief Wyszukuje przekierowanie najdłuższego prefiksu numeru.
+ * Wyszukuje binarnie po długościach: znaleziony element oznacza, że dłuższy
+ * pasujący prefiks może istnieć, a jego brak, że nie istnieje. Wynikiem jest
+ * wartość bmp ostatniego znalezionego elementu. Jeśli jest to znacznik z
+ * nieaktualną wartością bmp, wyszukiwanie jest powtarzane dla prefiksów
+ * krótszych od znacznika, a wynik zapamiętywany w znacznikach. Zmiana
+ * przekierowań unieważnia zatem tylko wartości bmp, które są potem
+ * wyznaczane tym samym wyszukiwaniem binarnym, a nie przeglądaniem
+ * wszystkich krótszych poziomów.
+ * @param[in,out] pf      –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] num         –  Wskaźnik na poprawny napis reprezentujący numer;
+ * @param[in] keyLength   –  Długość numeru.
+ * @return Wskaźnik na element z przekierowaniem lub NULL, jeśli żaden prefiks
+ *         numeru nie ma przekierowania.
+ */
+static const struct hashEntry* lookup(PhoneFwdHash pf, const char* num,
+                                      size_t keyLength) {
+    uint64_t prefixHash[HASH_STACK_PREFIXES + 1];
+    bool precomputed = keyLength <= HASH_STACK_PREFIXES;
+    struct hashEntry* stale[HASH_MAX_PATH];
+    size_t staleCount = 0;
+    const struct hashEntry* best = NULL;
+    size_t limit = keyLength;
+
+    // Skróty wszystkich prefiksów liczymy jednym przejściem po numerze.
+    if (precomputed) {
+        prefixHash[0] = 0;
+
+        for (size_t i = 0; i < keyLength; i++)
+            prefixHash[i + 1] = hashStep(prefixHash[i], num[i]);
+    }
+
+    while (limit > 0) {
+        struct hashEntry* hit = NULL;
+        size_t hitLength = 0;
+        size_t lo = 1, hi = pf->maxLength;
+
+        while (lo <= hi) {
+            size_t mid = lo + (hi - lo) / 2;
+
+            if (mid > limit) {
+                hi = mid - 1;
+                continue;
+            }
+
+            uint64_t hash = precomputed ? prefixHash[mid] : hashString(num, mid);
+            struct hashEntry* e = levelFind(&pf->levels[mid - 1], num, hash);
+
+            if (e != NULL) {
+                hit = e;
+                hitLength = mid;
+                lo = mid + 1;
+            }
+
+            else
+                hi = mid - 1;
+        }
+
+        if (hit == NULL)
+            break;
+
+        if (hit->numForward != NULL || hit->bmpEpoch == pf->epoch) {
+            best = hit->numForward != NULL ? hit : hit->bmp;
+            break;
+        }
+
+        // Wartość bmp znacznika to wynik dla prefiksów krótszych od niego.
+        if (staleCount < HASH_MAX_PATH)
+            stale[staleCount++] = hit;
+
+        limit = hitLength - 1;
+    }
+
+    for (size_t i = 0; i < staleCount; i++) {
+        stale[i]->bmp = best;
+        stale[i]->bmpEpoch = pf->epoch;
+    }
+
+    return best;
+}
+
+/** Tworzy stan silnika haszującego.
+ * @return Wskaźnik na nową strukturę lub NULL, jeśli nie udało się
+ *         zaalokować pamięci.
+ */
+static void* engineCreate(void) {
+    return phfwdHashNew();
+}
+
+/** Usuwa stan silnika haszującego.
+ * @param[in] data  –  Wskaźnik na strukturę.
+ */
+static void engineDestroy(void* data) {
+    phfwdHashDelete(data);
+}
+
+/** Dodaje przekierowanie do silnika haszującego.
+ * @param[in,out] data  –  Wskaźnik na strukturę;
+ * @param[in] num1      –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] num2      –  Wskaźnik na przekierowanie.
+ * @return Wynik funkcji @ref phfwdHashAdd.
+ */
+static bool engineAdd(void* data, const char* num1, const char* num2) {
+    return phfwdHashAdd(data, num1, num2);
+}
+
+/** Usuwa przekierowania z silnika haszującego.
+ * @param[in,out] data  –  Wskaźnik na strukturę;
+ * @param[in] num       –  Wskaźnik na prefiks numerów.
+ */
+static void engineRemove(void* data, const char* num) {
+    phfwdHashRemove(data, num);
+}
+
+/** Wyszukuje przekierowanie najdłuższego prefiksu numeru.
+ * @param[in,out] data      –  Wskaźnik na strukturę;
+ * @param[in] num           –  Wskaźnik na numer;
+ * @param[in] keyLength     –  Długość numeru;
+ * @param[out] matchLength  –  Wskaźnik na długość dopasowanego prefiksu;
+ * @param[out] fwd          –  Wskaźnik na wskaźnik na jego przekierowanie;
+ * @param[out] fwdLength    –  Wskaźnik na długość przekierowania.
+ * @return Wartość @p true, jeśli któryś prefiks numeru ma przekierowanie.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool engineLookup(void* data, const char* num, size_t keyLength,
+                         size_t* matchLength, const char** fwd,
+                         size_t* fwdLength) {
+    const struct hashEntry* best = lookup(data, num, keyLength);
+
+    if (best == NULL)
+        return false;
+
+    *matchLength = strlen(best->num);
+    *fwd = best->numForward;
+    *fwdLength = best->numForwardLength;
+
+    return true;
+}
+
+/** Komparator elementów tablic haszujących. Porównuje prefiksy.
+ * @param p1  –  Wskaźnik na wskaźnik na pierwszy element;
+ * @param p2  –  Wskaźnik na wskaźnik na drugi element.
+ * @return Wynik porównania prefiksów, jak w funkcji strcmp.
+ */
+static int entryCompare(const void* p1, const void* p2) {
+    const struct hashEntry* const* e1 = p1;
+    const struct hashEntry* const* e2 = p2;
+
+    return strcmp((*e1)->num, (*e2)->num);
+}
+
+/** @brief Przegląda przekierowania silnika haszującego.
+ * Elementy z przekierowaniem są zbierane i sortowane po prefiksach.
+ * @param[in,out] data  –  Wskaźnik na strukturę;
+ * @param[in] callback  –  Funkcja wywoływana dla każdego przekierowania;
+ * @param[in,out] ctx   –  Dane przekazywane funkcji @p callback.
+ * @return Wartość @p true, jeśli przejrzano wszystkie przekierowania.
+ *         Wartość @p false, jeśli przerwano przeglądanie lub nie udało się
+ *         zaalokować pamięci.
+ */
+static bool engineForEach(void* data, forwardCallback callback, void* ctx) {
+    PhoneFwdHash pf = data;
+
+    if (pf->forwards == 0)
+        return true;
+
+    const struct hashEntry** entries = malloc(pf->forwards *
+                                              sizeof(struct hashEntry*));
+
+    if (entries == NULL)
+        return false;
+
+    size_t count = 0;
+
+    for (size_t k = 0; k < pf->maxLength; k++) {
+        struct hashLevel* level = &pf->levels[k];
+
+        for (size_t b = 0; level->forwards > 0 && b < level->bucketCount; b++)
+            for (struct hashEntry* e = level->buckets[b]; e != NULL; e = e->next)
+                if (e->numForward != NULL)
+                    entries[count++] = e;
+    }
+
+    qsort(entries, count, sizeof(struct hashEntry*), entryCompare);
+
+    bool ok = true;
+
+    for (size_t i = 0; i < count && ok; i++)
+        ok = callback(ctx, entries[i]->num, strlen(entries[i]->num),
+                      entries[i]->numForward, entries[i]->numForwardLength);
+
+    free(entries);
+
+    return ok;
+}
+
+/** @brief Wyznacza statystyki silnika haszującego.
+ * Wierzchołkami są elementy tablic haszujących, razem ze znacznikami;
+ * głębokością elementu jest długość jego prefiksu.
+ * @param[in] data    –  Wskaźnik na strukturę;
+ * @param[out] stats  –  Wskaźnik na wyzerowaną strukturę statystyk.
+ */
+static void engineStats(void* data, struct PhoneForwardStats* stats) {
+    PhoneFwdHash pf = data;
+
+    stats->auxBytes = sizeof(struct PhoneForwardHash) +
+                      pf->maxLength * sizeof(struct hashLevel);
+
+    for (size_t k = 0; k < pf->maxLength; k++) {
+        struct hashLevel* level = &pf->levels[k];
+        size_t depth = level->length < PHFWD_STATS_DEPTH_BUCKETS ?
+                       level->length : PHFWD_STATS_DEPTH_BUCKETS - 1;
+
+        stats->nodes += level->size;
+        stats->depthHistogram[depth] += level->size;
+        stats->auxBytes += level->bucketCount * sizeof(struct hashEntry*);
+
+        for (size_t b = 0; b < level->bucketCount; b++) {
+            for (struct hashEntry* e = level->buckets[b]; e != NULL; e = e->next) {
+                stats->stringBytes += level->length + 1;
+
+                if (e->numForward != NULL) {
+                    stats->forwards++;
+                    stats->stringBytes += e->numForwardLength + 1;
+                }
+            }
+        }
+    }
+
+    stats->totalBytes = stats->nodes * sizeof(struct hashEntry) +
+                        stats->stringBytes + stats->auxBytes;
+}
+
+const struct phfwdEngine phfwdHashEngine = {
+    "hash",
+    engineCreate,
+    engineDestroy,
+    engineAdd,
+    engineRemove,
+    engineLookup,
+    engineForEach,
+    engineStats
+};
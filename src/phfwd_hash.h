@@ -0,0 +1,80 @@
+/** @file
+ * Interfejs struktury przechowującej przekierowania numerów telefonicznych
+ * w tablicach haszujących, po jednej dla każdej długości prefiksu.
+ * Najdłuższy pasujący prefiks wyszukiwany jest binarnie po długościach
+ * (metoda Waldvogla ze znacznikami), więc wyznaczenie przekierowania
+ * wymaga O(log L) zapytań do tablic, gdzie L to największa długość
+ * prefiksu. Semantyka operacji jest taka sama jak w pliku phone_forward.h.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#ifndef TELEFONY_PHFWD_HASH_H
+#define TELEFONY_PHFWD_HASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "phone_forward.h"
+
+struct hashLevel;
+
+/** @brief Struktura przechowująca przekierowania w tablicach haszujących.
+ * Każdy poziom to tablica haszująca prefiksów jednej długości; jest po
+ * jednym poziomie dla każdej długości od 1 do @p maxLength. Wyszukiwanie
+ * binarne przebiega po stałym drzewie długości, więc nowa długość prefiksu
+ * nie zmienia ścieżek istniejących prefiksów. Oprócz prefiksów z
+ * przekierowaniem poziomy zawierają znaczniki, które prowadzą wyszukiwanie
+ * binarne w stronę dłuższych prefiksów. Znacznik pamięta najdłuższy prefiks
+ * z przekierowaniem, który jest jego prefiksem; wartość ta jest wyliczana
+ * leniwie i unieważniana przez zwiększenie @p epoch, gdy zmienia się zbiór
+ * prefiksów z przekierowaniem.
+ */
+struct PhoneForwardHash {
+    struct hashLevel* levels; ///< Poziomy; poziom k ma prefiksy długości k+1.
+    size_t maxLength;         /**< Największa długość prefiksu, postaci
+                                   2^k - 1. */
+    size_t forwards;          ///< Liczba przekierowań.
+    unsigned long epoch;      ///< Numer wersji zbioru przekierowań.
+};
+
+typedef struct PhoneForwardHash* PhoneFwdHash; /**< Skrócona nazwa dla wskaźnika
+                                                    na strukturę @p PhoneForwardHash. */
+
+/** @brief Tworzy nową strukturę.
+ * Tworzy nową strukturę niezawierającą żadnych przekierowań.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
+ *         zaalokować pamięci.
+ */
+PhoneFwdHash phfwdHashNew(void);
+
+/** @brief Usuwa strukturę.
+ * Nic nie robi, jeśli wskaźnik @p pf ma wartość NULL.
+ * @param[in] pf – wskaźnik na usuwaną strukturę.
+ */
+void phfwdHashDelete(PhoneFwdHash pf);
+
+/** @brief Dodaje przekierowanie.
+ * Działa jak @ref phfwdAdd.
+ * @param[in] pf   – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num1 – wskaźnik na napis reprezentujący prefiks numerów
+ *                   przekierowywanych;
+ * @param[in] num2 – wskaźnik na napis reprezentujący prefiks numerów, na które
+ *                   jest wykonywane przekierowanie.
+ * @return Wartość @p true, jeśli przekierowanie zostało dodane.
+ *         Wartość @p false, jeśli wystąpił błąd, np. podany napis nie
+ *         reprezentuje numeru, oba podane numery są identyczne lub nie udało
+ *         się zaalokować pamięci.
+ */
+bool phfwdHashAdd(PhoneFwdHash pf, const char* num1, const char* num2);
+
+/** @brief Usuwa przekierowania.
+ * Działa jak @ref phfwdRemove. Sam prefiks @p num wyszukuje w tablicy
+ * haszującej, a dłuższe prefiksy w poziomach dłuższych niż @p num, które
+ * mają przekierowania.
+ * @param[in] pf  – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num – wskaźnik na napis reprezentujący prefiks numerów.
+ */
+void phfwdHashRemove(PhoneFwdHash pf, const char* num);
+
+#endif //TELEFONY_PHFWD_HASH_H
@@ -0,0 +1,926 @@
+/** @file
+ * Implementacja drzewa przekierowań zakresów numerów.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#include "phfwd_range.h"
+#include <stdlib.h>
+#include <string.h>
+#include "phfwd_trace.h"
+
+#define RANGE_FULL_MASK ((1u << NUMBER_ALPHABET_SIZE) - 1) ///< Klasa wszystkich cyfr.
+
+#define RANGE_MARK_OWN 1     ///< Znacznik: przekierowanie wierzchołka jest przeglądane.
+#define RANGE_MARK_SUBTREE 2 ///< Znacznik: poddrzewo zawiera przeglądane przekierowanie.
+
+/** Element stosu przeglądania prefiksów drzewa.
+ */
+struct rangeFrame {
+    rangeNode node;  ///< Wierzchołek, do którego prowadzi bieżąca krawędź.
+    size_t consumed; ///< Liczba cyfr krawędzi należących już do prefiksu.
+    size_t depth;    ///< Długość prefiksu.
+    unsigned next;   ///< Najmniejsza cyfra, której jeszcze nie rozwinięto.
+};
+
+/** Zadanie wstawiania wzorca: wstawić sufiks wzorca od danej pozycji w
+ * poddrzewie danego wierzchołka.
+ */
+struct rangeTask {
+    rangeNode node; ///< Wierzchołek, od którego należy wstawiać.
+    size_t pos;     ///< Pozycja we wzorcu.
+};
+
+/** Element stosu kopiowania poddrzewa.
+ */
+struct rangeCopy {
+    rangeNode src; ///< Kopiowany wierzchołek.
+    rangeNode dst; ///< Jego kopia.
+};
+
+/** Element stosu przeglądania wzorców drzewa.
+ */
+struct rangePatternFrame {
+    rangeNode node; ///< Wierzchołek, do którego prowadzi krawędź.
+    size_t depth;   ///< Długość wzorca przed krawędzią.
+};
+
+/** Wyznacza maskę cyfry.
+ * @param[in] c  –  Znak reprezentujący cyfrę.
+ * @return Maska z ustawionym bitem cyfry @p c.
+ */
+static inline unsigned digitBit(char c) {
+    return 1u << (c - 48);
+}
+
+/** Tworzy wierzchołek bez przekierowania i bez synów.
+ * @param[in] mask  –  Klasa cyfr krawędzi;
+ * @param[in] run   –  Liczba cyfr krawędzi.
+ * @return Wskaźnik na wierzchołek lub NULL, jeśli nie udało się zaalokować
+ *         pamięci.
+ */
+static rangeNode rangeNodeNew(unsigned mask, size_t run) {
+    rangeNode node = malloc(sizeof(struct phfwdRangeNode));
+
+    if (node != NULL) {
+        node->mask = mask;
+        node->run = run;
+        node->forward = NULL;
+        node->forwardLength = 0;
+        node->marks = 0;
+        node->child = NULL;
+        node->sibling = NULL;
+    }
+
+    return node;
+}
+
+/** Ustawia przekierowanie wierzchołka, zastępując poprzednie.
+ * @param[in,out] node  –  Wskaźnik na wierzchołek;
+ * @param[in] fwd       –  Wskaźnik na przekierowanie;
+ * @param[in] length    –  Długość przekierowania.
+ * @return Wartość @p true, jeśli ustawiono przekierowanie.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool rangeSetForward(rangeNode node, const char* fwd, size_t length) {
+    char* copy = malloc(length + 1);
+
+    if (copy == NULL)
+        return false;
+
+    memcpy(copy, fwd, length + 1);
+    free(node->forward);
+    node->forward = copy;
+    node->forwardLength = length;
+
+    return true;
+}
+
+rangeNode rangeTreeNew(void) {
+    return rangeNodeNew(0, 0);
+}
+
+void rangeTreeDelete(rangeNode root) {
+    /* Listy synów i braci tworzą drzewo binarne, więc rotujemy je tak, żeby
+     * zawsze zwalniać wierzchołek bez synów. */
+    while (root != NULL) {
+        if (root->child != NULL) {
+            rangeNode child = root->child;
+
+            root->child = child->sibling;
+            child->sibling = root;
+            root = child;
+        }
+
+        else {
+            rangeNode next = root->sibling;
+
+            free(root->forward);
+            free(root);
+            root = next;
+        }
+    }
+}
+
+/** @brief Kopiuje poddrzewo.
+ * Kopiowany jest wierzchołek z synami, ale bez braci.
+ * @param[in] src  –  Wskaźnik na kopiowany wierzchołek.
+ * @return Wskaźnik na kopię lub NULL, jeśli nie udało się zaalokować pamięci.
+ */
+static rangeNode rangeClone(rangeNode src) {
+    rangeNode copy = rangeNodeNew(src->mask, src->run);
+    size_t capacity = 16, top = 0;
+    struct rangeCopy* stack = malloc(capacity * sizeof(struct rangeCopy));
+    bool ok = copy != NULL && stack != NULL;
+
+    if (ok && src->forward != NULL)
+        ok = rangeSetForward(copy, src->forward, src->forwardLength);
+
+    if (ok)
+        stack[top++] = (struct rangeCopy){src, copy};
+
+    while (ok && top > 0) {
+        struct rangeCopy frame = stack[--top];
+        rangeNode* link = &frame.dst->child;
+
+        for (rangeNode c = frame.src->child; c != NULL && ok; c = c->sibling) {
+            rangeNode cc = rangeNodeNew(c->mask, c->run);
+
+            if (cc == NULL) {
+                ok = false;
+                break;
+            }
+
+            *link = cc;
+            link = &cc->sibling;
+
+            if (c->forward != NULL && !rangeSetForward(cc, c->forward,
+                                                       c->forwardLength)) {
+                ok = false;
+                break;
+            }
+
+            if (top == capacity) {
+                struct rangeCopy* bigger = realloc(stack, 2 * capacity *
+                                                   sizeof(struct rangeCopy));
+
+                if (bigger == NULL) {
+                    ok = false;
+                    break;
+                }
+
+                stack = bigger;
+                capacity *= 2;
+            }
+
+            stack[top++] = (struct rangeCopy){c, cc};
+        }
+    }
+
+    free(stack);
+
+    if (!ok) {
+        rangeTreeDelete(copy);
+        return NULL;
+    }
+
+    return copy;
+}
+
+/** @brief Dzieli krawędź prowadzącą do wierzchołka po danej liczbie cyfr.
+ * Wierzchołek zachowuje pierwsze @p j cyfr krawędzi, a jego przekierowanie
+ * i synowie przechodzą do nowego syna z pozostałymi cyframi.
+ * @param[in,out] node  –  Wskaźnik na wierzchołek;
+ * @param[in] j         –  Liczba cyfr, 0 < @p j < @p node->run.
+ * @return Wartość @p true, jeśli podzielono krawędź.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool rangeBreak(rangeNode node, size_t j) {
+    rangeNode rest = rangeNodeNew(node->mask, node->run - j);
+
+    if (rest == NULL)
+        return false;
+
+    rest->forward = node->forward;
+    rest->forwardLength = node->forwardLength;
+    rest->child = node->child;
+    node->forward = NULL;
+    node->forwardLength = 0;
+    node->child = rest;
+    node->run = j;
+
+    return true;
+}
+
+/** @brief Wydziela z klasy krawędzi jednocyfrowej jej podzbiór.
+ * Kopia poddrzewa z klasą @p part staje się kolejnym bratem wierzchołka, a
+ * wierzchołek zachowuje pozostałe cyfry klasy.
+ * @param[in,out] node  –  Wskaźnik na wierzchołek z krawędzią długości 1;
+ * @param[in] part      –  Niepusty właściwy podzbiór klasy krawędzi.
+ * @return Wskaźnik na kopię lub NULL, jeśli nie udało się zaalokować pamięci.
+ */
+static rangeNode rangeSplit(rangeNode node, unsigned part) {
+    rangeNode copy = rangeClone(node);
+
+    if (copy == NULL)
+        return NULL;
+
+    copy->mask = part;
+    node->mask &= ~part;
+    copy->sibling = node->sibling;
+    node->sibling = copy;
+
+    return copy;
+}
+
+/** @brief Dopisuje nowego syna ze ścieżką sufiksu wzorca.
+ * Kolejne pozycje o tej samej klasie łączone są w jedną krawędź.
+ * @param[in,out] parent  –  Wskaźnik na wierzchołek;
+ * @param[in] masks       –  Wskaźnik na klasy kolejnych pozycji wzorca;
+ * @param[in] pos         –  Pierwsza pozycja sufiksu;
+ * @param[in] length      –  Długość wzorca, większa od @p pos;
+ * @param[in] first       –  Klasa pierwszej pozycji sufiksu, rozłączna z
+ *                           klasami krawędzi wychodzących z @p parent;
+ * @param[in] fwd         –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength   –  Długość przekierowania.
+ * @return Wartość @p true, jeśli dopisano ścieżkę.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool rangeChain(rangeNode parent, const unsigned* masks, size_t pos,
+                       size_t length, unsigned first, const char* fwd,
+                       size_t fwdLength) {
+    rangeNode head = rangeNodeNew(first, 1);
+    rangeNode last = head;
+    bool ok = head != NULL;
+
+    for (size_t p = pos + 1; p < length && ok; p++) {
+        if (masks[p] == last->mask) {
+            last->run++;
+            continue;
+        }
+
+        last->child = rangeNodeNew(masks[p], 1);
+        last = last->child;
+        ok = last != NULL;
+    }
+
+    if (ok)
+        ok = rangeSetForward(last, fwd, fwdLength);
+
+    if (!ok) {
+        rangeTreeDelete(head);
+        return false;
+    }
+
+    head->sibling = parent->child;
+    parent->child = head;
+
+    return true;
+}
+
+/** @brief Wstawia wzorzec do drzewa.
+ * Krawędzie, których klasy tylko częściowo pokrywają się z wzorcem, są
+ * dzielone, tak żeby klasy braci pozostały rozłączne.
+ * @param[in,out] root   –  Wskaźnik na korzeń drzewa;
+ * @param[in] masks      –  Wskaźnik na niepuste klasy kolejnych pozycji wzorca;
+ * @param[in] length     –  Długość wzorca;
+ * @param[in] fwd        –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength  –  Długość przekierowania.
+ * @return Wartość @p true, jeśli wstawiono wzorzec.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool rangeInsert(rangeNode root, const unsigned* masks, size_t length,
+                        const char* fwd, size_t fwdLength) {
+    size_t capacity = 16, top = 0;
+    struct rangeTask* stack = malloc(capacity * sizeof(struct rangeTask));
+    bool ok = stack != NULL;
+
+    if (ok)
+        stack[top++] = (struct rangeTask){root, 0};
+
+    while (ok && top > 0) {
+        struct rangeTask task = stack[--top];
+
+        if (task.pos == length) {
+            ok = rangeSetForward(task.node, fwd, fwdLength);
+            continue;
+        }
+
+        unsigned remaining = masks[task.pos];
+
+        for (rangeNode e = task.node->child; e != NULL && remaining != 0 && ok;
+             e = e->sibling) {
+            unsigned common = e->mask & remaining;
+
+            if (common == 0)
+                continue;
+
+            remaining &= ~common;
+            rangeNode target = e;
+
+            if (common != e->mask) {
+                if (e->run > 1 && !rangeBreak(e, 1)) {
+                    ok = false;
+                    break;
+                }
+
+                target = rangeSplit(e, common);
+
+                if (target == NULL) {
+                    ok = false;
+                    break;
+                }
+            }
+
+            // Pozycje, na których wzorzec zgadza się z krawędzią, pomijamy.
+            size_t j = 1;
+
+            while (j < target->run && task.pos + j < length &&
+                   masks[task.pos + j] == target->mask)
+                j++;
+
+            if (j < target->run && !rangeBreak(target, j)) {
+                ok = false;
+                break;
+            }
+
+            if (top == capacity) {
+                struct rangeTask* bigger = realloc(stack, 2 * capacity *
+                                                   sizeof(struct rangeTask));
+
+                if (bigger == NULL) {
+                    ok = false;
+                    break;
+                }
+
+                stack = bigger;
+                capacity *= 2;
+            }
+
+            stack[top++] = (struct rangeTask){target, task.pos + j};
+        }
+
+        if (ok && remaining != 0)
+            ok = rangeChain(task.node, masks, task.pos, length, remaining, fwd,
+                            fwdLength);
+    }
+
+    free(stack);
+
+    return ok;
+}
+
+/** Wyznacza klasę cyfr z przedziału.
+ * @param[in] lo  –  Najmniejsza cyfra przedziału;
+ * @param[in] hi  –  Największa cyfra przedziału.
+ * @return Maska cyfr od @p lo do @p hi włącznie.
+ */
+static unsigned digitRange(unsigned lo, unsigned hi) {
+    return ((2u << hi) - 1) & ~((1u << lo) - 1);
+}
+
+/** @brief Wstawia wzorce jednej strony zakresu.
+ * Wstawia prefiksy zaczynające się od pierwszych @p c + 1 cyfr @p bound,
+ * nie mniejsze od @p bound (dla dolnej strony) lub nie większe od niego
+ * (dla górnej strony).
+ * @param[in,out] root   –  Wskaźnik na korzeń drzewa;
+ * @param[in,out] masks  –  Wskaźnik na klasy, których pierwsze @p c + 1
+ *                          pozycji jest już ustawionych;
+ * @param[in] bound      –  Wskaźnik na ograniczenie;
+ * @param[in] c          –  Pozycja, na której zakres się rozgałęzia;
+ * @param[in] length     –  Długość ograniczenia;
+ * @param[in] lower      –  Czy ograniczenie jest dolne;
+ * @param[in] fwd        –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength  –  Długość przekierowania.
+ * @return Wartość @p true, jeśli wstawiono wzorce.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool rangeInsertSide(rangeNode root, unsigned* masks, const char* bound,
+                            size_t c, size_t length, bool lower,
+                            const char* fwd, size_t fwdLength) {
+    unsigned extreme = lower ? 0 : NUMBER_ALPHABET_SIZE - 1;
+    size_t last = length - 1;
+
+    // Dalsze cyfry równe skrajnej cyfrze dopuszczają dowolny sufiks.
+    while (last > c && (unsigned)(bound[last] - 48) == extreme)
+        last--;
+
+    for (size_t i = c + 1; i <= last; i++) {
+        unsigned digit = (unsigned)(bound[i] - 48);
+        unsigned mask;
+
+        if (i == last)
+            mask = lower ? digitRange(digit, NUMBER_ALPHABET_SIZE - 1) :
+                           digitRange(0, digit);
+        else if (digit == (lower ? NUMBER_ALPHABET_SIZE - 1 : 0))
+            mask = 0;
+        else
+            mask = lower ? digitRange(digit + 1, NUMBER_ALPHABET_SIZE - 1) :
+                           digitRange(0, digit - 1);
+
+        if (mask != 0) {
+            masks[i] = mask;
+
+            for (size_t j = i + 1; j < length; j++)
+                masks[j] = RANGE_FULL_MASK;
+
+            if (!rangeInsert(root, masks, length, fwd, fwdLength))
+                return false;
+        }
+
+        masks[i] = digitBit(bound[i]);
+    }
+
+    return true;
+}
+
+bool rangeTreeAdd(rangeNode root, const char* from, const char* to,
+                  size_t length, const char* fwd) {
+    unsigned* masks = malloc(length * sizeof(unsigned));
+    size_t fwdLength = strlen(fwd);
+    size_t c = 0;
+
+    if (masks == NULL)
+        return false;
+
+    while (c < length && from[c] == to[c]) {
+        masks[c] = digitBit(from[c]);
+        c++;
+    }
+
+    if (c == length) {
+        bool res = rangeInsert(root, masks, length, fwd, fwdLength);
+
+        free(masks);
+        return res;
+    }
+
+    /* Jeśli dalsze cyfry ograniczenia są skrajne, to strona zakresu mieści
+     * się w środkowym wzorcu. */
+    bool lowerWhole = true, upperWhole = true;
+
+    for (size_t i = c + 1; i < length; i++) {
+        lowerWhole = lowerWhole && from[i] == '0';
+        upperWhole = upperWhole &&
+                     (unsigned)(to[i] - 48) == NUMBER_ALPHABET_SIZE - 1;
+    }
+
+    unsigned lo = (unsigned)(from[c] - 48) + (lowerWhole ? 0 : 1);
+    unsigned hi = (unsigned)(to[c] - 48) - (upperWhole ? 0 : 1);
+    bool ok = true;
+
+    if (lo <= hi) {
+        masks[c] = digitRange(lo, hi);
+
+        for (size_t i = c + 1; i < length; i++)
+            masks[i] = RANGE_FULL_MASK;
+
+        ok = rangeInsert(root, masks, length, fwd, fwdLength);
+    }
+
+    if (ok && !lowerWhole) {
+        masks[c] = digitBit(from[c]);
+        ok = rangeInsertSide(root, masks, from, c, length, true, fwd,
+                             fwdLength);
+    }
+
+    if (ok && !upperWhole) {
+        masks[c] = digitBit(to[c]);
+        ok = rangeInsertSide(root, masks, to, c, length, false, fwd,
+                             fwdLength);
+    }
+
+    free(masks);
+
+    return ok;
+}
+
+/** Wyszukuje syna, którego klasa zawiera cyfrę.
+ * @param[in] node  –  Wskaźnik na wierzchołek;
+ * @param[in] bit   –  Maska cyfry.
+ * @return Wskaźnik na wskaźnik na syna lub na wskaźnik o wartości NULL, jeśli
+ *         nie ma takiego syna.
+ */
+static rangeNode* rangeChildLink(rangeNode node, unsigned bit) {
+    rangeNode* link = &node->child;
+
+    while (*link != NULL && ((*link)->mask & bit) == 0)
+        link = &(*link)->sibling;
+
+    return link;
+}
+
+/** Sprawdza, czy jakiś wzorzec pasuje do prefiksu zaczynającego się od numeru.
+ * @param[in] root    –  Wskaźnik na korzeń drzewa;
+ * @param[in] num     –  Wskaźnik na poprawny numer;
+ * @param[in] length  –  Długość numeru.
+ * @return Wartość @p true, jeśli jakiś wzorzec ma prefiks zaczynający się od
+ *         @p num. Wartość @p false w przeciwnym wypadku.
+ */
+static bool rangeReaches(rangeNode root, const char* num, size_t length) {
+    rangeNode node = root;
+    size_t p = 0;
+
+    while (p < length) {
+        node = *rangeChildLink(node, digitBit(num[p]));
+
+        if (node == NULL)
+            return false;
+
+        for (size_t j = 1; j < node->run && p + j < length; j++)
+            if ((node->mask & digitBit(num[p + j])) == 0)
+                return false;
+
+        p += node->run;
+    }
+
+    return true;
+}
+
+/** @brief Usuwa wierzchołki bez przekierowań pozostałe po usuwaniu.
+ * Ścieżka numeru składa się po usuwaniu z krawędzi jednocyfrowych, więc
+ * wystarczy odciąć najwyższy wierzchołek, od którego zaczyna się ścieżka
+ * wierzchołków z jednym synem, bez przekierowań, zakończona liściem.
+ * @param[in,out] root  –  Wskaźnik na korzeń drzewa;
+ * @param[in] num       –  Wskaźnik na poprawny numer;
+ * @param[in] length    –  Długość numeru.
+ */
+static void rangePrune(rangeNode root, const char* num, size_t length) {
+    rangeNode node = root;
+    rangeNode* cut = NULL;
+
+    for (size_t p = 0; p < length; p++) {
+        rangeNode* link = rangeChildLink(node, digitBit(num[p]));
+
+        if (*link == NULL)
+            break;
+
+        if (node == root || node->forward != NULL || node->child != *link ||
+            (*link)->sibling != NULL)
+            cut = link;
+
+        node = *link;
+    }
+
+    if (cut != NULL && node != root && node->forward == NULL &&
+        node->child == NULL) {
+        rangeNode dead = *cut;
+
+        *cut = dead->sibling;
+        dead->sibling = NULL;
+        rangeTreeDelete(dead);
+    }
+}
+
+bool rangeTreeRemove(rangeNode root, const char* num, size_t length) {
+    // Bez pasującego wzorca nie dzielimy niepotrzebnie krawędzi.
+    if (!rangeReaches(root, num, length))
+        return true;
+
+    rangeNode node = root;
+
+    for (size_t p = 0; p < length; p++) {
+        unsigned bit = digitBit(num[p]);
+        rangeNode* link = rangeChildLink(node, bit);
+        rangeNode e = *link;
+
+        if (e->run > 1 && !rangeBreak(e, 1))
+            return false;
+
+        // Na ostatniej pozycji usuwamy cyfrę numeru z klasy krawędzi.
+        if (p + 1 == length) {
+            if (e->mask == bit) {
+                *link = e->sibling;
+                e->sibling = NULL;
+                rangeTreeDelete(e);
+            }
+
+            else
+                e->mask &= ~bit;
+
+            break;
+        }
+
+        if (e->mask != bit) {
+            e = rangeSplit(e, bit);
+
+            if (e == NULL)
+                return false;
+        }
+
+        node = e;
+    }
+
+    rangePrune(root, num, length);
+
+    return true;
+}
+
+bool rangeTreeLookup(rangeNode root, const char* num, size_t keyLength,
+                     size_t* matchLength, const char** fwd, size_t* fwdLength,
+                     size_t* visited) {
+    rangeNode node = root;
+    rangeNode best = NULL;
+    size_t bestLength = 0;
+    size_t p = 0;
+
+    while (p < keyLength) {
+        node = *rangeChildLink(node, digitBit(num[p]));
+
+        if (node == NULL)
+            break;
+
+        size_t j = 1;
+
+        while (j < node->run && p + j < keyLength &&
+               (node->mask & digitBit(num[p + j])) != 0)
+            j++;
+
+        if (j < node->run)
+            break;
+
+        p += node->run;
+        PHFWD_TRACE_COUNT(*visited, 1);
+
+        if (node->forward != NULL) {
+            best = node;
+            bestLength = p;
+        }
+    }
+
+    if (best == NULL)
+        return false;
+
+    *matchLength = bestLength;
+    *fwd = best->forward;
+    *fwdLength = best->forwardLength;
+
+    return true;
+}
+
+/** @brief Układa wierzchołki drzewa w kolejności przeszukiwania wszerz.
+ * Każdy wierzchołek leży w tablicy przed swoimi synami.
+ * @param[in] root    –  Wskaźnik na korzeń drzewa;
+ * @param[out] count  –  Wskaźnik na liczbę wierzchołków.
+ * @return Wskaźnik na tablicę wierzchołków do zwolnienia lub NULL, jeśli nie
+ *         udało się zaalokować pamięci.
+ */
+static rangeNode* rangeLevelOrder(rangeNode root, size_t* count) {
+    size_t capacity = 16, used = 0;
+    rangeNode* order = malloc(capacity * sizeof(rangeNode));
+
+    if (order == NULL)
+        return NULL;
+
+    order[used++] = root;
+
+    // Tablica służy jednocześnie za kolejkę.
+    for (size_t i = 0; i < used; i++) {
+        for (rangeNode c = order[i]->child; c != NULL; c = c->sibling) {
+            if (used == capacity) {
+                rangeNode* bigger = realloc(order, 2 * capacity *
+                                            sizeof(rangeNode));
+
+                if (bigger == NULL) {
+                    free(order);
+                    return NULL;
+                }
+
+                order = bigger;
+                capacity *= 2;
+            }
+
+            order[used++] = c;
+        }
+    }
+
+    *count = used;
+
+    return order;
+}
+
+bool rangeTreeForEachPattern(rangeNode root, rangePatternCallback callback,
+                             void* ctx) {
+    size_t capacity = 16, top = 0;
+    size_t maskCapacity = 16;
+    struct rangePatternFrame* stack = malloc(capacity *
+                                             sizeof(struct rangePatternFrame));
+    unsigned* masks = malloc(maskCapacity * sizeof(unsigned));
+    bool ok = stack != NULL && masks != NULL;
+
+    if (ok)
+        stack[top++] = (struct rangePatternFrame){root, 0};
+
+    /* Przeszukiwanie w głąb: klasy na pozycjach przed krawędzią wierzchołka
+     * zapisali jego przodkowie, a rodzeństwo zmienia tylko dalsze pozycje. */
+    while (ok && top > 0) {
+        struct rangePatternFrame frame = stack[--top];
+        rangeNode node = frame.node;
+        size_t length = frame.depth + node->run;
+
+        if (length > maskCapacity) {
+            while (length > maskCapacity)
+                maskCapacity *= 2;
+
+            unsigned* bigger = realloc(masks, maskCapacity * sizeof(unsigned));
+
+            if (bigger == NULL) {
+                ok = false;
+                break;
+            }
+
+            masks = bigger;
+        }
+
+        for (size_t i = frame.depth; i < length; i++)
+            masks[i] = node->mask;
+
+        if (node->forward != NULL &&
+            !callback(ctx, masks, length, node->forward, node->forwardLength)) {
+            ok = false;
+            break;
+        }
+
+        for (rangeNode c = node->child; c != NULL; c = c->sibling) {
+            if (top == capacity) {
+                struct rangePatternFrame* bigger =
+                    realloc(stack, 2 * capacity * sizeof(struct rangePatternFrame));
+
+                if (bigger == NULL) {
+                    ok = false;
+                    break;
+                }
+
+                stack = bigger;
+                capacity *= 2;
+            }
+
+            stack[top++] = (struct rangePatternFrame){c, length};
+        }
+    }
+
+    free(stack);
+    free(masks);
+
+    return ok;
+}
+
+bool rangeTreeSize(rangeNode root, size_t* nodes, size_t* forwards,
+                   size_t* bytes) {
+    size_t count;
+    rangeNode* order = rangeLevelOrder(root, &count);
+
+    if (order == NULL)
+        return false;
+
+    *nodes = count;
+    *forwards = 0;
+    *bytes = count * sizeof(struct phfwdRangeNode);
+
+    for (size_t i = 0; i < count; i++) {
+        if (order[i]->forward != NULL) {
+            (*forwards)++;
+            *bytes += order[i]->forwardLength + 1;
+        }
+    }
+
+    free(order);
+
+    return true;
+}
+
+/** @brief Odkłada element na stos przeglądania.
+ * Zapewnia też miejsce na prefiks długości @p frame.depth.
+ * @param[in,out] walk  –  Wskaźnik na stan przeglądania;
+ * @param[in] frame     –  Odkładany element.
+ * @return Wartość @p true, jeśli odłożono element.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool rangeWalkPush(struct rangeWalk* walk, struct rangeFrame frame) {
+    if (walk->top == walk->capacity) {
+        size_t capacity = walk->capacity == 0 ? 16 : 2 * walk->capacity;
+        struct rangeFrame* bigger = realloc(walk->stack, capacity *
+                                            sizeof(struct rangeFrame));
+
+        if (bigger == NULL)
+            return false;
+
+        walk->stack = bigger;
+        walk->capacity = capacity;
+    }
+
+    if (frame.depth >= walk->pathCapacity) {
+        size_t capacity = walk->pathCapacity == 0 ? 16 : 2 * walk->pathCapacity;
+        char* bigger = realloc(walk->path, capacity);
+
+        if (bigger == NULL)
+            return false;
+
+        walk->path = bigger;
+        walk->pathCapacity = capacity;
+    }
+
+    walk->stack[walk->top++] = frame;
+
+    return true;
+}
+
+void rangeWalkStart(struct rangeWalk* walk, rangeNode root, const char* num,
+                    size_t numLength, size_t* visited) {
+    size_t count;
+    rangeNode* order = rangeLevelOrder(root, &count);
+
+    walk->stack = NULL;
+    walk->top = walk->capacity = 0;
+    walk->path = NULL;
+    walk->pathCapacity = 0;
+    walk->ready = false;
+    walk->failed = order == NULL;
+
+    if (walk->failed)
+        return;
+
+    /* Synowie leżą w tablicy za ojcem, więc przechodząc ją od końca,
+     * wyznaczamy znaczniki poddrzew przed znacznikiem ojca. */
+    for (size_t i = count; i-- > 0;) {
+        rangeNode node = order[i];
+        bool own = node->forward != NULL &&
+                   (num == NULL || (node->forwardLength <= numLength &&
+                                    memcmp(node->forward, num,
+                                           node->forwardLength) == 0));
+
+        node->marks = own ? RANGE_MARK_OWN | RANGE_MARK_SUBTREE : 0;
+
+        for (rangeNode c = node->child; c != NULL; c = c->sibling)
+            node->marks |= c->marks & RANGE_MARK_SUBTREE;
+    }
+
+    free(order);
+
+    if ((root->marks & RANGE_MARK_SUBTREE) != 0) {
+        walk->failed = !rangeWalkPush(walk, (struct rangeFrame){root, 0, 0, 0});
+        rangeWalkNext(walk, visited);
+    }
+}
+
+void rangeWalkNext(struct rangeWalk* walk, size_t* visited) {
+    walk->ready = false;
+
+    while (!walk->failed && walk->top > 0) {
+        struct rangeFrame* frame = &walk->stack[walk->top - 1];
+        rangeNode node = frame->node;
+        bool inside = frame->consumed < node->run;
+        rangeNode next = node;
+        unsigned d = frame->next;
+
+        // Szukamy najmniejszej nierozwiniętej cyfry, od której jest przejście.
+        for (; d < NUMBER_ALPHABET_SIZE; d++) {
+            if (inside) {
+                if ((node->mask & (1u << d)) != 0)
+                    break;
+            }
+
+            else {
+                next = *rangeChildLink(node, 1u << d);
+
+                if (next != NULL && (next->marks & RANGE_MARK_SUBTREE) != 0)
+                    break;
+            }
+        }
+
+        if (d == NUMBER_ALPHABET_SIZE) {
+            walk->top--;
+            continue;
+        }
+
+        frame->next = d + 1;
+        PHFWD_TRACE_COUNT(*visited, 1);
+
+        struct rangeFrame child = {next, inside ? frame->consumed + 1 : 1,
+                                   frame->depth + 1, 0};
+
+        if (!rangeWalkPush(walk, child)) {
+            walk->failed = true;
+            return;
+        }
+
+        walk->path[child.depth - 1] = (char)('0' + d);
+
+        if (child.consumed == next->run && (next->marks & RANGE_MARK_OWN) != 0) {
+            walk->length = child.depth;
+            walk->forward = next->forward;
+            walk->forwardLength = next->forwardLength;
+            walk->ready = true;
+            return;
+        }
+    }
+}
+
+void rangeWalkEnd(struct rangeWalk* walk) {
+    free(walk->stack);
+    free(walk->path);
+    walk->stack = NULL;
+    walk->path = NULL;
+    walk->top = walk->capacity = walk->pathCapacity = 0;
+}
@@ -0,0 +1,182 @@
+/** @file
+ * Specyfikacja drzewa przekierowań zakresów numerów.
+ *
+ * Zakres [@p from, @p to] to wszystkie prefiksy długości @p n = |@p from| =
+ * |@p to|, które cyfra po cyfrze leżą między @p from i @p to. Zakres
+ * rozkładany jest na co najwyżej 2@p n wzorców, czyli ciągów klas cyfr
+ * zapisanych jako maski bitowe. Krawędź drzewa etykietowana jest klasą cyfr
+ * i liczbą jej kolejnych powtórzeń, więc zakres zajmuje O(@p n)
+ * wierzchołków niezależnie od liczby zawartych w nim prefiksów. Klasy
+ * krawędzi wychodzących z jednego wierzchołka są rozłączne, więc każdy numer
+ * ma w drzewie co najwyżej jedną ścieżkę.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#ifndef TELEFONY_PHFWD_RANGE_H
+#define TELEFONY_PHFWD_RANGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "phfwd_engine.h"
+
+/** @brief Wierzchołek drzewa przekierowań zakresów.
+ * Synowie wierzchołka tworzą listę jednokierunkową. Wierzchołek opisuje też
+ * krawędź, która do niego prowadzi: @p run kolejnych cyfr, z których każda
+ * należy do klasy @p mask. Korzeń ma pustą krawędź.
+ */
+struct phfwdRangeNode {
+    unsigned mask;                   ///< Klasa cyfr krawędzi (bit d oznacza cyfrę d).
+    size_t run;                      ///< Liczba cyfr krawędzi.
+    char* forward;                   /**< Przekierowanie wzorców kończących się
+                                          w wierzchołku lub NULL. */
+    size_t forwardLength;            ///< Długość przekierowania.
+    unsigned char marks;             ///< Znaczniki ustawiane przez przeglądanie.
+    struct phfwdRangeNode* child;    ///< Pierwszy syn lub NULL.
+    struct phfwdRangeNode* sibling;  ///< Następny brat lub NULL.
+};
+
+typedef struct phfwdRangeNode* rangeNode; /**< Skrócona nazwa dla wskaźnika
+                                               na strukturę @p phfwdRangeNode. */
+
+struct rangeFrame;
+
+/** @brief Stan przeglądania prefiksów drzewa przekierowań zakresów.
+ * Każdy wzorzec rozwijany jest we wszystkie pasujące do niego prefiksy, w
+ * porządku leksykograficznym. Po @ref rangeWalkStart i każdym
+ * @ref rangeWalkNext, jeśli @p ready ma wartość @p true, to @p path zawiera
+ * kolejny prefiks długości @p length, a @p forward jego przekierowanie.
+ */
+struct rangeWalk {
+    struct rangeFrame* stack; ///< Stos przeglądania.
+    size_t top;               ///< Liczba elementów na stosie.
+    size_t capacity;          ///< Rozmiar tablicy @p stack.
+    char* path;               ///< Bieżący prefiks (bez znaku '\0').
+    size_t pathCapacity;      ///< Rozmiar tablicy @p path.
+    size_t length;            ///< Długość bieżącego prefiksu.
+    const char* forward;      ///< Przekierowanie bieżącego prefiksu.
+    size_t forwardLength;     ///< Długość przekierowania.
+    bool ready;               ///< Czy jest kolejny prefiks.
+    bool failed;              ///< Czy nie udało się zaalokować pamięci.
+};
+
+/** @brief Tworzy puste drzewo przekierowań zakresów.
+ * @return Wskaźnik na korzeń lub NULL, jeśli nie udało się zaalokować pamięci.
+ */
+rangeNode rangeTreeNew (void);
+
+/** @brief Usuwa drzewo przekierowań zakresów.
+ * Działa iteracyjnie w stałej dodatkowej pamięci. Nic nie robi, jeśli
+ * wskaźnik ma wartość NULL.
+ * @param[in] root  –  Wskaźnik na korzeń drzewa (bez braci).
+ */
+void rangeTreeDelete (rangeNode root);
+
+/** @brief Dodaje przekierowanie zakresu.
+ * Prefiksy zakresu, które miały już przekierowanie zakresu, dostają nowe.
+ * @param[in,out] root  –  Wskaźnik na korzeń drzewa;
+ * @param[in] from      –  Wskaźnik na początek zakresu;
+ * @param[in] to        –  Wskaźnik na koniec zakresu, nie mniejszy niż
+ *                         @p from;
+ * @param[in] length    –  Wspólna długość napisów @p from i @p to;
+ * @param[in] fwd       –  Wskaźnik na przekierowanie.
+ * @return Wartość @p true, jeśli przekierowanie zostało dodane.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci; wtedy
+ *         przekierowanie mogło zostać dodane tylko dla części zakresu.
+ */
+bool rangeTreeAdd (rangeNode root, const char* from, const char* to,
+                   size_t length, const char* fwd);
+
+/** @brief Usuwa przekierowania zakresów prefiksów zaczynających się od numeru.
+ * Wzorce, które tylko częściowo zaczynają się od @p num, są zawężane.
+ * @param[in,out] root  –  Wskaźnik na korzeń drzewa;
+ * @param[in] num       –  Wskaźnik na poprawny numer;
+ * @param[in] length    –  Długość numeru.
+ * @return Wartość @p true, jeśli usunięto przekierowania.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci na
+ *         zawężone wzorce; wtedy część przekierowań mogła nie zostać usunięta.
+ */
+bool rangeTreeRemove (rangeNode root, const char* num, size_t length);
+
+/** @brief Wyszukuje przekierowanie zakresu najdłuższego prefiksu numeru.
+ * @param[in] root          –  Wskaźnik na korzeń drzewa;
+ * @param[in] num           –  Wskaźnik na poprawny numer;
+ * @param[in] keyLength     –  Długość numeru;
+ * @param[out] matchLength  –  Wskaźnik na długość dopasowanego prefiksu;
+ * @param[out] fwd          –  Wskaźnik na wskaźnik na jego przekierowanie;
+ * @param[out] fwdLength    –  Wskaźnik na długość przekierowania;
+ * @param[in,out] visited   –  Wskaźnik na licznik odwiedzonych wierzchołków.
+ * @return Wartość @p true, jeśli któryś prefiks numeru ma przekierowanie.
+ *         Wartość @p false w przeciwnym wypadku; wtedy wyniki nie są
+ *         zapisywane.
+ */
+bool rangeTreeLookup (rangeNode root, const char* num, size_t keyLength,
+                      size_t* matchLength, const char** fwd, size_t* fwdLength,
+                      size_t* visited);
+
+/** @brief Funkcja przyjmująca kolejne wzorce drzewa.
+ * @param[in,out] ctx    –  Dane wywołującego;
+ * @param[in] masks      –  Wskaźnik na tablicę klas kolejnych cyfr wzorca,
+ *                          ważną tylko do powrotu z funkcji;
+ * @param[in] length     –  Długość wzorca;
+ * @param[in] fwd        –  Wskaźnik na przekierowanie wzorca;
+ * @param[in] fwdLength  –  Długość przekierowania.
+ * @return Wartość @p true, jeśli należy kontynuować przeglądanie.
+ *         Wartość @p false, jeśli należy je przerwać.
+ */
+typedef bool (*rangePatternCallback)(void* ctx, const unsigned* masks,
+                                     size_t length, const char* fwd,
+                                     size_t fwdLength);
+
+/** @brief Przegląda wzorce drzewa bez ich rozwijania.
+ * Funkcja @p callback wywoływana jest raz dla każdego wierzchołka z
+ * przekierowaniem.
+ * @param[in] root      –  Wskaźnik na korzeń drzewa;
+ * @param[in] callback  –  Funkcja wywoływana dla każdego wzorca;
+ * @param[in,out] ctx   –  Dane przekazywane funkcji @p callback.
+ * @return Wartość @p true, jeśli przejrzano wszystkie wzorce.
+ *         Wartość @p false, jeśli przerwano przeglądanie lub nie udało się
+ *         zaalokować pamięci.
+ */
+bool rangeTreeForEachPattern (rangeNode root, rangePatternCallback callback,
+                              void* ctx);
+
+/** @brief Wyznacza rozmiar drzewa.
+ * @param[in] root       –  Wskaźnik na korzeń drzewa;
+ * @param[out] nodes     –  Wskaźnik na liczbę wierzchołków (razem z korzeniem);
+ * @param[out] forwards  –  Wskaźnik na liczbę przekierowań;
+ * @param[out] bytes     –  Wskaźnik na liczbę bajtów wierzchołków i napisów.
+ * @return Wartość @p true, jeśli udało się wyznaczyć rozmiar.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+bool rangeTreeSize (rangeNode root, size_t* nodes, size_t* forwards,
+                    size_t* bytes);
+
+/** @brief Rozpoczyna przeglądanie prefiksów drzewa.
+ * Jeśli podano numer, rozwijane są tylko wzorce, których przekierowanie jest
+ * prefiksem tego numeru; pozostałe poddrzewa są pomijane bez rozwijania.
+ * Przeglądanie zapisuje znaczniki w wierzchołkach, więc drzewa nie można
+ * równocześnie przeglądać dwukrotnie. Stan trzeba potem zwolnić funkcją
+ * @ref rangeWalkEnd.
+ * @param[out] walk        –  Wskaźnik na inicjowany stan przeglądania;
+ * @param[in,out] root     –  Wskaźnik na korzeń drzewa;
+ * @param[in] num          –  Wskaźnik na numer lub NULL;
+ * @param[in] numLength    –  Długość numeru;
+ * @param[in,out] visited  –  Wskaźnik na licznik odwiedzonych wierzchołków.
+ */
+void rangeWalkStart (struct rangeWalk* walk, rangeNode root, const char* num,
+                     size_t numLength, size_t* visited);
+
+/** @brief Przechodzi do kolejnego prefiksu drzewa.
+ * @param[in,out] walk     –  Wskaźnik na stan przeglądania;
+ * @param[in,out] visited  –  Wskaźnik na licznik odwiedzonych wierzchołków.
+ */
+void rangeWalkNext (struct rangeWalk* walk, size_t* visited);
+
+/** Zwalnia pamięć stanu przeglądania.
+ * @param[in,out] walk  –  Wskaźnik na stan przeglądania.
+ */
+void rangeWalkEnd (struct rangeWalk* walk);
+
+#endif //TELEFONY_PHFWD_RANGE_H
@@ -0,0 +1,45 @@
+/** @file
+ * Statyczne punkty śledzenia (USDT) w operacjach na przekierowaniach.
+ * Jeśli projekt skompilowano z opcją PHFWD_USDT i w systemie dostępny jest
+ * nagłówek <sys/sdt.h>, makra rozwijają się do punktów śledzenia dostawcy
+ * @p telefony, które można podpiąć np. narzędziami bpftrace lub perf.
+ * Niepodpięty punkt śledzenia to pojedyncza instrukcja nop. W przeciwnym
+ * wypadku makra jedynie wyliczają (i ignorują) swoje argumenty, a liczniki
+ * argumentów punktów śledzenia (np. liczba odwiedzonych wierzchołków) nie
+ * są zmieniane, więc pętle przeszukiwania drzewa nie płacą za ich
+ * aktualizację.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#ifndef TELEFONY_PHFWD_TRACE_H
+#define TELEFONY_PHFWD_TRACE_H
+
+#ifdef PHFWD_USDT
+
+#include <sys/sdt.h>
+
+/** Punkt śledzenia z jednym argumentem. */
+#define PHFWD_PROBE1(name, a1) DTRACE_PROBE1(telefony, name, a1)
+/** Punkt śledzenia z dwoma argumentami. */
+#define PHFWD_PROBE2(name, a1, a2) DTRACE_PROBE2(telefony, name, a1, a2)
+/** Punkt śledzenia z trzema argumentami. */
+#define PHFWD_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(telefony, name, a1, a2, a3)
+/** Zwiększa licznik przekazywany punktom śledzenia o @p n. */
+#define PHFWD_TRACE_COUNT(counter, n) ((counter) += (n))
+
+#else
+
+/** Punkt śledzenia z jednym argumentem (wyłączony). */
+#define PHFWD_PROBE1(name, a1) ((void)(a1))
+/** Punkt śledzenia z dwoma argumentami (wyłączony). */
+#define PHFWD_PROBE2(name, a1, a2) ((void)(a1), (void)(a2))
+/** Punkt śledzenia z trzema argumentami (wyłączony). */
+#define PHFWD_PROBE3(name, a1, a2, a3) ((void)(a1), (void)(a2), (void)(a3))
+/** Licznik przekazywany punktom śledzenia (wyłączony: nie jest zmieniany). */
+#define PHFWD_TRACE_COUNT(counter, n) ((void)(counter), (void)(n))
+
+#endif /* PHFWD_USDT */
+
+#endif //TELEFONY_PHFWD_TRACE_H
@@ -10,13 +10,169 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "phfwd_trace.h"
+#include "arena.h"
+#include "phfwd_engine.h"
+#include "packed_digits.h"
+#include "phfwd_range.h"
+
+#define NODE_IN_ARENA 1 ///< Flaga wierzchołka: wierzchołek leży w arenie.
+#define NUM_IN_ARENA 2  ///< Flaga wierzchołka: napis @p num leży w arenie.
+#define FWD_IN_ARENA 4  ///< Flaga wierzchołka: napis @p numForward leży w arenie.
+
+#define COMPACT_CHUNK_SIZE (1 << 16) ///< Rozmiar bloku areny kompaktowania.
+#define BULK_CHUNK_SIZE (1 << 20)    ///< Rozmiar bloku areny wątku wczytywania.
+#define BULK_MIN_RECORDS 4096        /**< Najmniejsza liczba przekierowań
+                                          wczytywanych równolegle. */
+#define BULK_MAX_DEPTH 4             /**< Maksymalna liczba pierwszych cyfr
+                                          wyznaczających kubełek. */
+
+#define MAINTAIN_STEP_BUDGET 64 /**< Stała część budżetu prac w tle
+                                     wykonywanych przy każdej zmianie drzewa. */
+
+#define RESOLVE_MEMO_SIZE 256 ///< Liczba komórek pamięci podręcznej łańcuchów.
+#define RESOLVE_MEMO_HOPS 64  ///< Maksymalna długość zapamiętywanego łańcucha.
+
+struct phfwdNode;
+struct phfwdJumpEntry;
+struct phfwdCompaction;
+struct phfwdFrozen;
+struct phfwdResolveMemo;
+
+/** @brief Struktura przechowująca przekierowania numerów telefonów.
+ * Przekierowania przechowywane są w drzewie prefiksowym dowolnej długości
+ * ciągów cyfr od 0,1,2,3,4,5,6,7,8,9,:,; (lub tylko 0,...,9, jeśli
+ * NUMBER_ALPHABET_SIZE to 10). Opcjonalnie struktura utrzymuje
+ * tablicę skoków indeksowaną pierwszymi @p jumpDepth cyframi numeru, która
+ * pozwala pominąć górne poziomy drzewa (zob. @ref phfwdSetJumpDepth).
+ * Wierzchołki mogą leżeć w arenach wypełnionych przez kompaktowanie
+ * (zob. @ref phfwdCompact) lub równoległe wczytywanie (zob.
+ * @ref phfwdAddAll); prace w tle wykonuje porcjami każda zmiana drzewa,
+ * a dodatkowo @ref phfwdMaintain.
+ * Strukturę można zamrozić (zob. @ref phfwdFreeze); wtedy zamiast drzewa
+ * przechowywana jest zwarta reprezentacja tylko do odczytu.
+ * Struktura utworzona z innym silnikiem (zob. @ref phfwdNewEngine) nie ma
+ * drzewa: podstawowe operacje wykonuje silnik, a pozostałe pola są puste.
+ * Przekierowania zakresów (zob. @ref phfwdAddRange) leżą w osobnym drzewie,
+ * niezależnym od silnika i reprezentacji.
+ */
+struct PhoneForward {
+    struct phfwdNode* root;           ///< Korzeń drzewa prefiksowego.
+    struct phfwdJumpEntry* jumpTable; /**< Tablica skoków o rozmiarze
+                                           NUMBER_ALPHABET_SIZE^jumpDepth
+                                           lub NULL, jeśli jest wyłączona. */
+    size_t jumpDepth;                 ///< Głębokość tablicy skoków.
+    struct arena* arena;              /**< Lista aren z wierzchołkami ułożonymi
+                                           przez ostatnie kompaktowanie lub
+                                           wczytanymi przez @ref phfwdAddAll
+                                           albo NULL. */
+    struct arena* retiredArenas;      /**< Lista aren do zwolnienia po
+                                           usunięciu wierzchołków z
+                                           @p reclaimStack. */
+    struct phfwdCompaction* compaction; /**< Stan trwającego kompaktowania
+                                             lub NULL. */
+    struct phfwdNode** reclaimStack;  ///< Stos odłączonych wierzchołków do zwolnienia.
+    size_t reclaimTop;                ///< Liczba wierzchołków na stosie @p reclaimStack.
+    size_t reclaimCapacity;           ///< Rozmiar tablicy @p reclaimStack.
+    size_t reclaimed;                 ///< Liczba wierzchołków zwolnionych porcjami.
+    struct phfwdNode** walkStack;     /**< Stos przeglądania drzewa zachowywany
+                                           między wywołaniami. */
+    size_t walkCapacity;              ///< Rozmiar tablicy @p walkStack.
+    struct phfwdFrozen* frozen;       /**< Zamrożona reprezentacja lub NULL.
+                                           Jeśli nie jest NULL, to @p root
+                                           ma wartość NULL. */
+    struct phfwdResolveMemo* resolveMemo; /**< Pamięć podręczna łańcuchów
+                                               przekierowań lub NULL. */
+    const struct phfwdEngine* engine; /**< Silnik przechowujący przekierowania
+                                           lub NULL dla drzewa prefiksowego. */
+    void* engineData;                 ///< Stan silnika @p engine.
+    struct phfwdRangeNode* ranges;    /**< Drzewo przekierowań zakresów lub
+                                           NULL, jeśli nie ma żadnego. */
+};
+
+/** @brief Wierzchołek drzewa prefiksowego przekierowań.
+ * Wierzchołek na głębokości l reprezentuje prefiks długości l. Liczniki
+ * poddrzewa obejmują sam wierzchołek i są aktualizowane na ścieżce od
+ * korzenia przy każdej zmianie, więc odpowiadają na pytania o prefiks w
+ * czasie proporcjonalnym do jego długości.
+ */
+struct phfwdNode {
+    struct phfwdNode* children[NUMBER_ALPHABET_SIZE]; /**< Tablica wskaźników na pochodne
+                                                           prefiksy dłuższe o jedną cyfrę. */
+    char* num;                         /**< Prefiks w tym wierzchołku.
+                                            Jeśli NULL, to temu prefiksowi
+                                            nie zostało przypisane
+                                            przekierowanie. */
+    char* numForward;                  ///< Przekierowanie prefiksu.
+    size_t numLength;                  ///< Długość prefiksu.
+    size_t numForwardLength;           ///< Długość przekierowania.
+    size_t subtreeForwards;            ///< Liczba przekierowań w poddrzewie.
+    size_t subtreeBytes;               /**< Liczba bajtów wierzchołków i napisów
+                                            poddrzewa (tak jak w phfwdStats). */
+    uint64_t subtreeHash;              /**< Suma skrótów przekierowań poddrzewa
+                                            (zob. @ref forwardHash). */
+    unsigned char flags;               /**< Flagi NODE_IN_ARENA, NUM_IN_ARENA
+                                            i FWD_IN_ARENA. */
+    unsigned char childCount;          ///< Liczba synów.
+};
+
+typedef struct phfwdNode* fwdNode; /**< Skrócona nazwa dla wskaźnika
+                                        na strukturę @p phfwdNode. */
+
+/** Komórka tablicy skoków.
+ */
+struct phfwdJumpEntry {
+    fwdNode node; /**< Wierzchołek reprezentujący prefiks długości jumpDepth
+                       lub NULL, jeśli takiego wierzchołka nie ma w drzewie. */
+    fwdNode best; /**< Najgłębszy wierzchołek z przekierowaniem na ścieżce
+                       od korzenia do @p node lub NULL, jeśli takiego nie ma. */
+};
+
+/** Element stosu kompaktowania.
+ */
+struct compactFrame {
+    fwdNode node;  ///< Wierzchołek do skopiowania.
+    fwdNode* slot; ///< Miejsce w nowym drzewie, w które trafi kopia.
+};
+
+/** @brief Stan trwającego kompaktowania.
+ * Nowe drzewo budowane jest w arenie w kolejności przeszukiwania w głąb.
+ */
+struct phfwdCompaction {
+    Arena arena;                ///< Arena, do której kopiowane są wierzchołki.
+    fwdNode root;               ///< Korzeń nowego drzewa.
+    struct compactFrame* stack; ///< Stos wierzchołków do skopiowania.
+    size_t top;                 ///< Liczba elementów na stosie.
+    size_t capacity;            ///< Rozmiar tablicy @p stack.
+};
+
+struct phfwdFrozen;
+struct phfwdResolveMemo;
 
-#define NUMBER_ALPHABET_SIZE 12 ///< Makro na rozmiar alfabetu znaków tworzących numer.
+static void frozenDelete(struct phfwdFrozen* fz);
+static void resolveMemoDelete(struct phfwdResolveMemo* memo);
+static bool baseHasKey(PhoneFwd pf, const char* num, size_t keyLength,
+                       size_t* visited);
+
+/** @brief Liczniki przekazywane do punktów śledzenia.
+ * Wypełniane przez wewnętrzne implementacje operacji i przekazywane jako
+ * argumenty punktów śledzenia przy wyjściu z funkcji publicznych. Licznik
+ * @p visited zmieniany jest tylko przez @ref PHFWD_TRACE_COUNT, więc bez
+ * punktów śledzenia pozostaje zerem.
+ */
+struct traceInfo {
+    size_t keyLength; ///< Długość numeru będącego kluczem operacji.
+    size_t visited;   ///< Liczba odwiedzonych wierzchołków drzewa.
+};
 
 
 bool isValidDigit (int c) {
-    return c >= 48 && c <= 59;
+    return c >= 48 && c < 48 + NUMBER_ALPHABET_SIZE;
 }
 
 /** Sprawdza, czy dany napis jest poprawny.
@@ -41,435 +197,4482 @@ bool isValidNumber(const char* num) {
         return false;
 }
 
+/** Funkcja implementująca szybkie potęgowanie liczb całkowitych nieujemnych.
+ * @param x  –  Podstawa.
+ * @param n  –  Wykładnik.
+ * @return Wynik x^n.
+ */
+static size_t fastPow(size_t x, size_t n) {
+    size_t res = 1;
+
+    while (n > 0) {
+        if (n & 1)
+            res = res * x;
+
+        x *= x;
+        n >>= 1;
+    }
+
+    return res;
+}
+
+/** Inicjuje wierzchołek drzewa bez synów i przekierowania.
+ * @param[out] node  –  Wskaźnik na inicjowany wierzchołek;
+ * @param[in] flags  –  Flagi wierzchołka.
+ */
+static void nodeInit(fwdNode node, unsigned char flags) {
+    for (size_t i = 0; i < NUMBER_ALPHABET_SIZE; i++)
+        (node->children)[i] = NULL;
+
+    node->num = NULL;
+    node->numForward = NULL;
+    node->numLength = 0;
+    node->numForwardLength = 0;
+    node->subtreeForwards = 0;
+    node->subtreeBytes = sizeof(struct phfwdNode);
+    node->subtreeHash = 0;
+    node->flags = flags;
+    node->childCount = 0;
+}
+
+/** Tworzy nowy wierzchołek drzewa bez synów i przekierowania.
+ * @return Wskaźnik na utworzony wierzchołek lub NULL, gdy nie udało się
+ *         zaalokować pamięci.
+ */
+static fwdNode nodeNew(void) {
+    fwdNode newNode = malloc(sizeof(struct phfwdNode));
+
+    if (newNode != NULL)
+        nodeInit(newNode, 0);
+
+    return newNode;
+}
+
+/** Tworzy w arenie nowy wierzchołek drzewa bez synów i przekierowania.
+ * @param[in,out] a  –  Wskaźnik na arenę.
+ * @return Wskaźnik na utworzony wierzchołek lub NULL, gdy nie udało się
+ *         zaalokować pamięci.
+ */
+static fwdNode arenaNodeNew(Arena a) {
+    fwdNode newNode = arenaAlloc(a, sizeof(struct phfwdNode),
+                                 _Alignof(struct phfwdNode));
+
+    if (newNode != NULL)
+        nodeInit(newNode, NODE_IN_ARENA);
+
+    return newNode;
+}
+
+/** Wyznacza liczbę bajtów samego wierzchołka i jego napisów.
+ * @param[in] node  –  Wskaźnik na wierzchołek.
+ * @return Liczba bajtów.
+ */
+static size_t nodeBytes(fwdNode node) {
+    size_t bytes = sizeof(struct phfwdNode);
+
+    if (node->numForward != NULL)
+        bytes += node->numLength + node->numForwardLength + 2;
+
+    return bytes;
+}
+
+/** @brief Wyznacza skrót przekierowania.
+ * Skrót poddrzewa to suma skrótów jego przekierowań modulo 2^64, więc
+ * zmiana przekierowania zmienia skróty wierzchołków ścieżki o stałą, a
+ * poddrzewa z tymi samymi przekierowaniami mają ten sam skrót niezależnie
+ * od kolejności ich dodawania. Wynik FNV-1a jest dodatkowo mieszany, żeby
+ * sumy skrótów podobnych przekierowań się nie znosiły.
+ * @param[in] num        –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] numLength  –  Długość prefiksu przekierowywanego;
+ * @param[in] fwd        –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength  –  Długość przekierowania.
+ * @return Skrót przekierowania.
+ */
+static uint64_t forwardHash(const char* num, size_t numLength, const char* fwd,
+                            size_t fwdLength) {
+    uint64_t hash = 14695981039346656037u;
+
+    for (size_t i = 0; i < numLength; i++) {
+        hash ^= (unsigned char)num[i];
+        hash *= 1099511628211u;
+    }
+
+    hash ^= '>';
+    hash *= 1099511628211u;
+
+    for (size_t i = 0; i < fwdLength; i++) {
+        hash ^= (unsigned char)fwd[i];
+        hash *= 1099511628211u;
+    }
+
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9u;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebu;
+    hash ^= hash >> 31;
+
+    return hash;
+}
+
+/** Wyznacza skrót przekierowania samego wierzchołka.
+ * @param[in] node  –  Wskaźnik na wierzchołek.
+ * @return Skrót przekierowania lub 0, jeśli wierzchołek go nie ma.
+ */
+static uint64_t nodeHash(fwdNode node) {
+    if (node->numForward == NULL)
+        return 0;
+
+    return forwardHash(node->num, node->numLength, node->numForward,
+                       node->numForwardLength);
+}
+
+/** @brief Aktualizuje liczniki poddrzew na ścieżce numeru.
+ * Zmienia liczniki wierzchołków reprezentujących prefiksy @p num długości od
+ * 0 do @p depth. Zmiany są liczone modulo SIZE_MAX + 1, więc zmniejszenie o
+ * @p k to dodanie (size_t)-k. Ostatnie @p created wierzchołków ścieżki są
+ * nowe: ich własne bajty są już policzone, a przodkowie dostają je w
+ * całości.
+ * @param[in,out] root  –  Wskaźnik na korzeń drzewa;
+ * @param[in] num       –  Wskaźnik na numer, którego prefiks długości
+ *                         @p depth jest w drzewie;
+ * @param[in] depth     –  Długość prefiksu;
+ * @param[in] created   –  Liczba nowych wierzchołków na końcu ścieżki;
+ * @param[in] forwards  –  Zmiana liczby przekierowań;
+ * @param[in] bytes     –  Zmiana liczby bajtów napisów i usuniętych
+ *                         wierzchołków;
+ * @param[in] hash      –  Zmiana skrótu poddrzewa.
+ */
+static void pathUpdate(fwdNode root, const char* num, size_t depth,
+                       size_t created, size_t forwards, size_t bytes,
+                       uint64_t hash) {
+    fwdNode node = root;
+
+    for (size_t i = 0; i <= depth; i++) {
+        size_t below = depth - i < created ? depth - i : created;
+
+        node->subtreeForwards += forwards;
+        node->subtreeBytes += bytes + below * sizeof(struct phfwdNode);
+        node->subtreeHash += hash;
+
+        if (i < depth)
+            node = node->children[num[i] - 48];
+    }
+}
+
+/** @brief Przelicza liczniki całego drzewa.
+ * Wierzchołki ustawiane są w kolejności przeszukiwania wszerz, a liczniki
+ * wyznaczane od końca, więc synowie są gotowi przed ojcem.
+ * @param[in,out] root  –  Wskaźnik na korzeń drzewa.
+ * @return Wartość @p true, jeśli przeliczono liczniki.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool treeRecount(fwdNode root) {
+    size_t capacity = 64;
+    size_t count = 1;
+    fwdNode* order = malloc(capacity * sizeof(fwdNode));
+
+    if (order == NULL)
+        return false;
+
+    order[0] = root;
+
+    for (size_t head = 0; head < count; head++) {
+        for (size_t i = 0; i < NUMBER_ALPHABET_SIZE; i++) {
+            if (order[head]->children[i] == NULL)
+                continue;
+
+            if (count == capacity) {
+                fwdNode* bigger = realloc(order, 2 * capacity * sizeof(fwdNode));
+
+                if (bigger == NULL) {
+                    free(order);
+                    return false;
+                }
+
+                order = bigger;
+                capacity *= 2;
+            }
+
+            order[count++] = order[head]->children[i];
+        }
+    }
+
+    while (count-- > 0) {
+        fwdNode node = order[count];
+
+        node->childCount = 0;
+        node->subtreeForwards = node->numForward != NULL ? 1 : 0;
+        node->subtreeBytes = nodeBytes(node);
+        node->subtreeHash = nodeHash(node);
+
+        for (size_t i = 0; i < NUMBER_ALPHABET_SIZE; i++) {
+            fwdNode child = node->children[i];
+
+            if (child != NULL) {
+                node->childCount++;
+                node->subtreeForwards += child->subtreeForwards;
+                node->subtreeBytes += child->subtreeBytes;
+                node->subtreeHash += child->subtreeHash;
+            }
+        }
+    }
+
+    free(order);
+
+    return true;
+}
+
+/** @brief Zwalnia pamięć pojedynczego wierzchołka.
+ * Nie zwalnia synów. Pomija pamięć leżącą w arenie.
+ * @param[in] node  –  Wskaźnik na zwalniany wierzchołek.
+ */
+static void nodeFree(fwdNode node) {
+    if (node->num != NULL && (node->flags & NUM_IN_ARENA) == 0)
+        free(node->num);
+
+    if (node->numForward != NULL && (node->flags & FWD_IN_ARENA) == 0)
+        free(node->numForward);
+
+    if ((node->flags & NODE_IN_ARENA) == 0)
+        free(node);
+}
+
+/** @brief Usuwa poddrzewo zaczepione w danym wierzchołku.
+ * Działa bez rekurencji i bez dodatkowej pamięci. Dopóki korzeń ma syna
+ * innego niż ostatni, syn ten zostaje korzeniem, a stary korzeń jego
+ * ostatnim synem (na miejsce którego trafia dotychczasowy ostatni syn).
+ * Korzeń mający co najwyżej ostatniego syna jest zwalniany. Każdy
+ * wierzchołek trafia na ścieżkę ostatnich synów co najwyżej raz, więc czas
+ * działania jest liniowy.
+ * @param[in] node  –  Wskaźnik na korzeń usuwanego poddrzewa.
+ */
+static void nodeDelete(fwdNode node) {
+    while (node != NULL) {
+        size_t i = 0;
+
+        while (i < NUMBER_ALPHABET_SIZE - 1 && node->children[i] == NULL)
+            i++;
+
+        if (i < NUMBER_ALPHABET_SIZE - 1) {
+            fwdNode child = node->children[i];
+
+            node->children[i] = child->children[NUMBER_ALPHABET_SIZE - 1];
+            child->children[NUMBER_ALPHABET_SIZE - 1] = node;
+            node = child;
+        }
+
+        else {
+            fwdNode next = node->children[NUMBER_ALPHABET_SIZE - 1];
+
+            nodeFree(node);
+            node = next;
+        }
+    }
+}
+
+/** Usuwa stan kompaktowania razem z częściowo zbudowanym drzewem.
+ * @param[in] c  –  Wskaźnik na stan kompaktowania.
+ */
+static void compactionDelete(struct phfwdCompaction* c) {
+    if (c != NULL) {
+        // Wszystkie wierzchołki i napisy nowego drzewa leżą w arenie.
+        arenaDelete(c->arena);
+        free(c->stack);
+        free(c);
+    }
+}
+
 PhoneFwd phfwdNew(void) {
     PhoneFwd newPhFwd = malloc(sizeof(struct PhoneForward));
 
     if (newPhFwd != NULL) {
-        for (size_t i = 0; i < NUMBER_ALPHABET_SIZE; i++)
-            (newPhFwd->children)[i] = NULL;
+        newPhFwd->root = nodeNew();
 
-        newPhFwd->num = NULL;
-        newPhFwd->numForward = NULL;
-        newPhFwd->numLength = 0;
-        newPhFwd->numForwardLength = 0;
+        if (newPhFwd->root == NULL) {
+            free(newPhFwd);
+            return NULL;
+        }
+
+        newPhFwd->jumpTable = NULL;
+        newPhFwd->jumpDepth = 0;
+        newPhFwd->arena = NULL;
+        newPhFwd->retiredArenas = NULL;
+        newPhFwd->compaction = NULL;
+        newPhFwd->reclaimStack = NULL;
+        newPhFwd->reclaimTop = 0;
+        newPhFwd->reclaimCapacity = 0;
+        newPhFwd->reclaimed = 0;
+        newPhFwd->walkStack = NULL;
+        newPhFwd->walkCapacity = 0;
+        newPhFwd->frozen = NULL;
+        newPhFwd->resolveMemo = NULL;
+        newPhFwd->engine = NULL;
+        newPhFwd->engineData = NULL;
+        newPhFwd->ranges = NULL;
     }
 
     return newPhFwd;
 }
 
-void phfwdDelete(PhoneFwd pf) {
-    if (pf != NULL) {
-        for (int i = 0; i < NUMBER_ALPHABET_SIZE; i++)
-            phfwdDelete(pf->children[i]);
+/** Silniki dostępne oprócz domyślnego drzewa prefiksowego.
+ */
+static const struct phfwdEngine* const engines[] = {&phfwdHashEngine};
+
+/** Wyszukuje silnik o danej nazwie.
+ * @param[in] name  –  Wskaźnik na napis z nazwą silnika.
+ * @return Wskaźnik na silnik lub NULL, jeśli nie ma silnika o takiej nazwie
+ *         (w tym dla drzewa prefiksowego).
+ */
+static const struct phfwdEngine* findEngine(const char* name) {
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++)
+        if (strcmp(engines[i]->name, name) == 0)
+            return engines[i];
+
+    return NULL;
+}
+
+bool phfwdEngineExists(const char* engine) {
+    return engine != NULL && (strcmp(engine, PHFWD_DEFAULT_ENGINE) == 0 ||
+                              findEngine(engine) != NULL);
+}
+
+PhoneFwd phfwdNewEngine(const char* engine) {
+    if (engine == NULL)
+        return NULL;
+
+    if (strcmp(engine, PHFWD_DEFAULT_ENGINE) == 0)
+        return phfwdNew();
+
+    const struct phfwdEngine* e = findEngine(engine);
 
-        if (pf->num != NULL)
-            free(pf->num);
+    if (e == NULL)
+        return NULL;
+
+    PhoneFwd newPhFwd = phfwdNew();
+
+    if (newPhFwd == NULL)
+        return NULL;
+
+    // Drzewo nie jest używane, więc od razu zwalniamy pusty korzeń.
+    nodeDelete(newPhFwd->root);
+    newPhFwd->root = NULL;
+    newPhFwd->engine = e;
+    newPhFwd->engineData = e->create();
+
+    if (newPhFwd->engineData == NULL) {
+        free(newPhFwd);
+        return NULL;
+    }
 
-        if (pf->numForward != NULL)
-            free(pf->numForward);
+    return newPhFwd;
+}
+
+const char* phfwdEngineName(PhoneFwd pf) {
+    if (pf == NULL)
+        return NULL;
+
+    return pf->engine != NULL ? pf->engine->name : PHFWD_DEFAULT_ENGINE;
+}
 
+void phfwdDelete(PhoneFwd pf) {
+    if (pf != NULL) {
+        if (pf->engine != NULL)
+            pf->engine->destroy(pf->engineData);
+
+        nodeDelete(pf->root);
+        frozenDelete(pf->frozen);
+        resolveMemoDelete(pf->resolveMemo);
+        compactionDelete(pf->compaction);
+
+        for (size_t i = 0; i < pf->reclaimTop; i++)
+            nodeDelete(pf->reclaimStack[i]);
+
+        free(pf->reclaimStack);
+        free(pf->walkStack);
+        rangeTreeDelete(pf->ranges);
+        arenaListDelete(pf->retiredArenas);
+        arenaListDelete(pf->arena);
+        free(pf->jumpTable);
         free(pf);
     }
 }
 
-bool phfwdAdd(PhoneFwd pf, const char* num1, const char* num2) {
-    if (pf == NULL || !isValidNumber(num1) || !isValidNumber(num2))
-        return false;
+/** Wyznacza indeks komórki tablicy skoków dla numeru.
+ * @param[in] num    –  Wskaźnik na numer długości co najmniej @p depth;
+ * @param[in] depth  –  Głębokość tablicy skoków.
+ * @return Indeks komórki odpowiadającej pierwszym @p depth cyfrom numeru.
+ */
+static size_t jumpIndex(const char* num, size_t depth) {
+    size_t idx = 0;
 
-    size_t keyLength = strlen(num1);
-    size_t valueLength = strlen(num2);
+    for (size_t i = 0; i < depth; i++)
+        idx = idx * NUMBER_ALPHABET_SIZE + (size_t)(num[i] - 48);
 
-    //Sprawdzenie czy napisy num1 i num2 są takie same.
-    if (keyLength == valueLength) {
-        bool equals = true;
+    return idx;
+}
 
-        for (size_t i = 0; i < keyLength; i++) {
-            if (num1[i] != num2[i]) {
-                equals = false;
-                break;
-            }
-        }
+/** @brief Odświeża komórki tablicy skoków o danym prefiksie.
+ * Odświeża wszystkie komórki, których indeks zaczyna się od pierwszych
+ * min(@p prefixLength, jumpDepth) cyfr numeru @p num. Nic nie robi, jeśli
+ * tablica skoków jest wyłączona.
+ * @param[in,out] pf        –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] num           –  Wskaźnik na napis zawierający prefiks;
+ * @param[in] prefixLength  –  Długość prefiksu.
+ */
+static void jumpRefresh(PhoneFwd pf, const char* num, size_t prefixLength) {
+    if (pf->jumpTable == NULL)
+        return;
 
-        if (equals == true)
-            return false;
+    if (prefixLength > pf->jumpDepth)
+        prefixLength = pf->jumpDepth;
+
+    fwdNode prefixNode = pf->root;
+    fwdNode prefixBest = NULL;
+
+    for (size_t i = 0; i < prefixLength && prefixNode != NULL; i++) {
+        prefixNode = prefixNode->children[num[i] - 48];
+
+        if (prefixNode != NULL && prefixNode->numForward != NULL)
+            prefixBest = prefixNode;
     }
 
-    PhoneFwd nextNode = pf; //Startowy wierzchołek drzewa prefiksowego.
+    size_t span = fastPow(NUMBER_ALPHABET_SIZE, pf->jumpDepth - prefixLength);
+    size_t base = jumpIndex(num, prefixLength) * span;
 
-    for (size_t i = 0; i < keyLength; i++) {
-        /* Sprawdzamy, czy w drzewie jest wierzchołek reprezentujący kolejny
-         * prefiks num1. Jeśli nie, dodajemy go. */
-        if (nextNode->children[num1[i] - 48] == NULL) {
-            nextNode->children[num1[i] - 48] = phfwdNew();
+    for (size_t j = 0; j < span; j++) {
+        fwdNode node = prefixNode;
+        fwdNode best = prefixBest;
+        size_t div = span;
 
-            if (nextNode->children[num1[i] - 48] == NULL)
-                return false;
+        // Schodzimy po pozostałych cyfrach indeksu, od najbardziej znaczącej.
+        while (div > 1 && node != NULL) {
+            div /= NUMBER_ALPHABET_SIZE;
+            node = node->children[(j / div) % NUMBER_ALPHABET_SIZE];
+
+            if (node != NULL && node->numForward != NULL)
+                best = node;
         }
 
-        nextNode = nextNode->children[num1[i] - 48];
+        pf->jumpTable[base + j].node = node;
+        pf->jumpTable[base + j].best = best;
     }
+}
 
-    /* Sprawdzamy, czy wierzchołek reprezentujący num1 zawiera jakieś
-     * przekierowanie. Jeśli tak, usuwamy je.
-     * Jeśli nie, uzupełniamy pole nextNode->num.
-     */
-    if (nextNode->numForward != NULL)
-        free(nextNode->numForward);
-
-    else {
-        nextNode->num = calloc(keyLength + 1, sizeof(char));
+bool phfwdSetJumpDepth(PhoneFwd pf, size_t depth) {
+    if (pf == NULL || pf->engine != NULL || depth > PHFWD_JUMP_MAX_DEPTH)
+        return false;
 
-        if (nextNode->num == NULL)
-            return false;
+    free(pf->jumpTable);
+    pf->jumpTable = NULL;
+    pf->jumpDepth = 0;
 
-        strcpy(nextNode->num, num1);
-        nextNode->numLength = keyLength;
+    // Zamrożona struktura zapamiętuje głębokość do czasu odmrożenia.
+    if (depth == 0 || pf->frozen != NULL) {
+        pf->jumpDepth = depth;
+        return true;
     }
 
-    nextNode->numForward = calloc(valueLength+1, sizeof(char));
+    pf->jumpTable = malloc(fastPow(NUMBER_ALPHABET_SIZE, depth) *
+                           sizeof(struct phfwdJumpEntry));
 
-    if (nextNode->numForward == NULL)
+    if (pf->jumpTable == NULL)
         return false;
 
-    strcpy(nextNode->numForward, num2);
-    nextNode->numForwardLength = valueLength;
+    pf->jumpDepth = depth;
+    jumpRefresh(pf, "", 0);
 
     return true;
 }
 
-void phfwdRemove(PhoneFwd pf, const char* num) {
-    if(!isValidNumber(num))
-        return;
+/** @brief Odkłada wierzchołek na stos wierzchołków do zwolnienia.
+ * Jeśli nie uda się powiększyć stosu, poddrzewo jest zwalniane od razu.
+ * @param[in,out] pf  –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] node    –  Wskaźnik na korzeń odłączonego poddrzewa.
+ */
+static void reclaimPush(PhoneFwd pf, fwdNode node) {
+    if (pf->reclaimTop == pf->reclaimCapacity) {
+        size_t capacity = pf->reclaimCapacity == 0 ? 64 : 2 * pf->reclaimCapacity;
+        fwdNode* bigger = realloc(pf->reclaimStack, capacity * sizeof(fwdNode));
+
+        // Stos kompaktowania może wskazywać na wierzchołki poddrzewa.
+        if (bigger == NULL) {
+            compactionDelete(pf->compaction);
+            pf->compaction = NULL;
+            nodeDelete(node);
+            return;
+        }
 
-    size_t keyLength = strlen(num);
-    PhoneFwd nextNode = pf;
+        pf->reclaimStack = bigger;
+        pf->reclaimCapacity = capacity;
+    }
 
-    /* Wierzchołek reprezentujący najdłuższy prefiks num, który musi zostać w
-     * drzewie, to jest najdłuższy taki, że jest prefiksem co najmniej jednego
-     * numeru w drzewie różnego od num. */
-    PhoneFwd lastToSave = pf;
+    pf->reclaimStack[pf->reclaimTop++] = node;
+}
 
-    /* Jeśli l to długość numeru reprezentowanego przez lastToSave, to
-     * lastToSaveNextIndex to l+1-wsza cyfra num. To jest, jeśli lastToSave
-     * ma zostać w drzewie, to należy usunąć poddrzewo
-     * lastToSave->children[num[lastToSaveNextIndex] - 48]. */
-    size_t lastToSaveNextIndex = 0;
-    size_t i; //iterator
+/** @brief Zwalnia porcję odłączonych wierzchołków.
+ * Gdy stos zostanie opróżniony, zwalnia też areny wycofane przez
+ * kompaktowanie, bo nie wskazuje już na nie żaden wierzchołek.
+ * @param[in,out] pf  –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] budget  –  Maksymalna liczba zwolnionych wierzchołków.
+ * @return Liczba zwolnionych wierzchołków.
+ */
+static size_t reclaimStep(PhoneFwd pf, size_t budget) {
+    size_t work = 0;
 
-    for (i = 0; i < keyLength; i++) {
-        // Jeśli NULL, to nie ma w drzewie wierzchołka reprezentującego num.
-        if (nextNode->children[num[i] - 48] == NULL)
-            return;
+    while (pf->reclaimTop > 0 && work < budget) {
+        fwdNode node = pf->reclaimStack[--pf->reclaimTop];
 
-        else {
-            for (size_t j = 0; j < (size_t)num[i] - 48; j++)
-                if (nextNode->children[j] != NULL) {
-                    lastToSave = nextNode;
-                    lastToSaveNextIndex = i;
-                    break;
-                }
+        for (size_t i = 0; i < NUMBER_ALPHABET_SIZE; i++)
+            if (node->children[i] != NULL)
+                reclaimPush(pf, node->children[i]);
 
-            for (size_t j = (size_t)num[i] - 48 + 1; j < NUMBER_ALPHABET_SIZE; j++) {
-                if (nextNode->children[j] != NULL) {
-                    lastToSave = nextNode;
-                    lastToSaveNextIndex = i;
-                    break;
-                }
-            }
+        nodeFree(node);
+        work++;
+    }
 
-            if (nextNode->numForward != NULL) {
-                lastToSave = nextNode;
-                lastToSaveNextIndex = i;
-            }
+    pf->reclaimed += work;
 
-            nextNode = nextNode->children[num[i] - 48];
-        }
+    if (pf->reclaimTop == 0) {
+        arenaListDelete(pf->retiredArenas);
+        pf->retiredArenas = NULL;
     }
 
-    phfwdDelete(lastToSave->children[num[lastToSaveNextIndex] - 48]);
-    lastToSave->children[num[lastToSaveNextIndex] - 48] = NULL;
+    return work;
 }
 
-PhoneNum* phnumNew(size_t len) {
-    PhoneNum* newPhNum = malloc(sizeof(struct PhoneNumbers));
+/** @brief Odkłada wierzchołek na stos kompaktowania.
+ * @param[in,out] c  –  Wskaźnik na stan kompaktowania;
+ * @param[in] node   –  Wskaźnik na wierzchołek do skopiowania;
+ * @param[in] slot   –  Miejsce w nowym drzewie, w które trafi kopia.
+ * @return Wartość @p true, jeśli udało się odłożyć wierzchołek.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool compactPush(struct phfwdCompaction* c, fwdNode node, fwdNode* slot) {
+    if (c->top == c->capacity) {
+        size_t capacity = c->capacity == 0 ? 64 : 2 * c->capacity;
+        struct compactFrame* bigger = realloc(c->stack, capacity *
+                                              sizeof(struct compactFrame));
 
-    if (newPhNum != NULL) {
-        newPhNum->length = len;
+        if (bigger == NULL)
+            return false;
+
+        c->stack = bigger;
+        c->capacity = capacity;
+    }
+
+    c->stack[c->top].node = node;
+    c->stack[c->top++].slot = slot;
+
+    return true;
+}
+
+/** @brief Rozpoczyna kopiowanie drzewa.
+ * Jeśli nie uda się zaalokować pamięci, porzuca kompaktowanie.
+ * @param[in,out] pf  –  Wskaźnik na strukturę przechowującą przekierowania.
+ */
+static void compactRestart(PhoneFwd pf) {
+    struct phfwdCompaction* c = pf->compaction;
+
+    arenaDelete(c->arena);
+    c->arena = arenaNew(COMPACT_CHUNK_SIZE);
+    c->root = NULL;
+    c->top = 0;
+
+    if (c->arena == NULL || !compactPush(c, pf->root, &c->root)) {
+        compactionDelete(c);
+        pf->compaction = NULL;
+    }
+}
+
+/** @brief Przepisuje pola wierzchołka do jego kopii.
+ * Synowie kopii nie są zmieniani. Napisy kopiowane są do areny tylko
+ * wtedy, gdy różnią się od napisów kopii.
+ * @param[in,out] c     –  Wskaźnik na stan kompaktowania;
+ * @param[in,out] copy  –  Wskaźnik na kopię w arenie;
+ * @param[in] old       –  Wskaźnik na wierzchołek drzewa.
+ * @return Wartość @p true, jeśli udało się przepisać pola.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool compactRefresh(struct phfwdCompaction* c, fwdNode copy,
+                           fwdNode old) {
+    struct phfwdNode prev = *copy;
+
+    *copy = *old;
+    memcpy(copy->children, prev.children, sizeof(prev.children));
+    copy->flags = NODE_IN_ARENA;
+
+    if (old->num == NULL)
+        return true;
+
+    copy->flags |= NUM_IN_ARENA | FWD_IN_ARENA;
+    copy->num = prev.num != NULL && strcmp(prev.num, old->num) == 0 ?
+                prev.num : arenaCopyString(c->arena, old->num, old->numLength);
+    copy->numForward = prev.numForward != NULL &&
+                       strcmp(prev.numForward, old->numForward) == 0 ?
+                       prev.numForward :
+                       arenaCopyString(c->arena, old->numForward,
+                                       old->numForwardLength);
+
+    return copy->num != NULL && copy->numForward != NULL;
+}
+
+/** @brief Uwzględnia w kopii zmianę drzewa na ścieżce numeru.
+ * Wywoływana po każdej zmianie drzewa w trakcie kompaktowania, dzięki czemu
+ * skopiowana część nie jest porzucana. Skopiowane wierzchołki ścieżki
+ * dostają aktualne pola, kopia usuniętego poddrzewa jest odpinana, a
+ * miejsce, którego wierzchołek nie został jeszcze skopiowany, dostaje
+ * aktualny wierzchołek na stosie (jego element jest wyszukiwany liniowo,
+ * ale stos przeszukiwania w głąb jest krótki). Jeśli nie uda się
+ * zaalokować pamięci, porzuca kompaktowanie.
+ * @param[in,out] pf     –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] num        –  Wskaźnik na cyfry zmienionej ścieżki;
+ * @param[in] keyLength  –  Długość zmienionej ścieżki.
+ */
+static void compactSync(PhoneFwd pf, const char* num, size_t keyLength) {
+    struct phfwdCompaction* c = pf->compaction;
+    fwdNode old = pf->root;
+    fwdNode* slot = &c->root;
+    bool ok = true;
+
+    for (size_t depth = 0; ok; depth++) {
+        if (*slot == NULL) {
+            size_t i = 0;
+
+            while (i < c->top && c->stack[i].slot != slot)
+                i++;
+
+            if (i < c->top)
+                c->stack[i].node = old;
+            else if (old != NULL)
+                ok = compactPush(c, old, slot);
+
+            break;
+        }
+
+        // Kopia usuniętego poddrzewa zostaje w arenie do końca kompaktowania.
+        if (old == NULL) {
+            *slot = NULL;
+            break;
+        }
+
+        ok = compactRefresh(c, *slot, old);
+
+        if (depth == keyLength)
+            break;
+
+        slot = &(*slot)->children[num[depth] - 48];
+        old = old->children[num[depth] - 48];
+    }
+
+    if (!ok) {
+        compactionDelete(c);
+        pf->compaction = NULL;
+    }
+}
+
+bool phfwdCompact(PhoneFwd pf) {
+    if (pf == NULL)
+        return false;
+
+    /* Zamrożona reprezentacja jest już ciągła, a inne silniki same
+     * zarządzają swoją pamięcią. */
+    if (pf->compaction != NULL || pf->frozen != NULL || pf->engine != NULL)
+        return true;
+
+    pf->compaction = calloc(1, sizeof(struct phfwdCompaction));
+
+    if (pf->compaction == NULL)
+        return false;
+
+    compactRestart(pf);
+
+    return pf->compaction != NULL;
+}
+
+/** @brief Kończy kompaktowanie.
+ * Podmienia drzewo na skopiowane, odkłada stare drzewo do zwolnienia i
+ * odświeża tablicę skoków, która wskazywała na stare wierzchołki.
+ * @param[in,out] pf  –  Wskaźnik na strukturę przechowującą przekierowania.
+ */
+static void compactFinish(PhoneFwd pf) {
+    struct phfwdCompaction* c = pf->compaction;
+    fwdNode oldRoot = pf->root;
+
+    pf->root = c->root;
+
+    pf->retiredArenas = arenaListConcat(pf->arena, pf->retiredArenas);
+    pf->arena = c->arena;
+    c->arena = NULL;
+    compactionDelete(c);
+    pf->compaction = NULL;
+
+    reclaimPush(pf, oldRoot);
+    jumpRefresh(pf, "", 0);
+}
+
+/** @brief Kopiuje porcję wierzchołków trwającego kompaktowania.
+ * Wierzchołek kopiowany jest razem ze swoimi napisami, a jego synowie
+ * odkładani są na stos w odwrotnej kolejności, dzięki czemu kopie leżą w
+ * arenie w porządku przeszukiwania w głąb.
+ * @param[in,out] pf  –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] budget  –  Maksymalna liczba skopiowanych wierzchołków.
+ * @return Liczba skopiowanych wierzchołków.
+ */
+static size_t compactStep(PhoneFwd pf, size_t budget) {
+    struct phfwdCompaction* c = pf->compaction;
+    size_t work = 0;
+
+    while (c->top > 0 && work < budget) {
+        struct compactFrame frame = c->stack[--c->top];
+        fwdNode old = frame.node;
+
+        // Wierzchołek usunięty przed skopiowaniem (zob. compactSync).
+        if (old == NULL)
+            continue;
+
+        fwdNode copy = arenaAlloc(c->arena, sizeof(struct phfwdNode),
+                                  _Alignof(struct phfwdNode));
+
+        if (copy == NULL) {
+            compactionDelete(c);
+            pf->compaction = NULL;
+            return work;
+        }
+
+        *copy = *old;
+        copy->flags = NODE_IN_ARENA;
+
+        if (old->num != NULL) {
+            copy->num = arenaCopyString(c->arena, old->num, old->numLength);
+            copy->numForward = arenaCopyString(c->arena, old->numForward,
+                                               old->numForwardLength);
+            copy->flags |= NUM_IN_ARENA | FWD_IN_ARENA;
+
+            if (copy->num == NULL || copy->numForward == NULL) {
+                compactionDelete(c);
+                pf->compaction = NULL;
+                return work;
+            }
+        }
+
+        *frame.slot = copy;
+
+        for (size_t i = NUMBER_ALPHABET_SIZE; i-- > 0;) {
+            copy->children[i] = NULL;
+
+            if (old->children[i] != NULL &&
+                !compactPush(c, old->children[i], &copy->children[i])) {
+                compactionDelete(c);
+                pf->compaction = NULL;
+                return work;
+            }
+        }
+
+        work++;
+    }
+
+    if (c->top == 0)
+        compactFinish(pf);
+
+    return work;
+}
+
+bool phfwdMaintain(PhoneFwd pf, size_t budget) {
+    if (pf == NULL)
+        return false;
+
+    size_t work = 0;
+
+    if (pf->compaction != NULL)
+        work = compactStep(pf, budget);
+
+    /* Odłączone wierzchołki zwalniamy dopiero po kompaktowaniu, bo jego stos
+     * może jeszcze wskazywać na wierzchołki usuniętych poddrzew. */
+    if (pf->compaction == NULL && work < budget)
+        reclaimStep(pf, budget - work);
+
+    return pf->compaction != NULL || pf->reclaimTop > 0
+           || pf->retiredArenas != NULL;
+}
+
+/** @brief Wykonuje ograniczoną porcję prac w tle po zmianie drzewa.
+ * Dzięki temu odłączone wierzchołki są zwalniane, a kompaktowanie postępuje,
+ * nawet gdy wywołujący nie używa @ref phfwdMaintain. Zmiana tworzy najwyżej
+ * tyle wierzchołków, ile wynosi długość numeru, więc dwukrotnie większy
+ * budżet nie pozwala, by zaległe prace rosły szybciej, niż są wykonywane.
+ * @param[in,out] pf     –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] keyLength  –  Długość zmienionego numeru.
+ */
+static void maintainStep(PhoneFwd pf, size_t keyLength) {
+    if (pf->compaction != NULL || pf->reclaimTop > 0
+        || pf->retiredArenas != NULL)
+        phfwdMaintain(pf, MAINTAIN_STEP_BUDGET + 2 * keyLength);
+}
+
+void phfwdRetire(PhoneFwd pf) {
+    if (pf == NULL)
+        return;
+
+    if (pf->engine != NULL) {
+        pf->engine->destroy(pf->engineData);
+        pf->engine = NULL;
+        pf->engineData = NULL;
+    }
+
+    frozenDelete(pf->frozen);
+    pf->frozen = NULL;
+    resolveMemoDelete(pf->resolveMemo);
+    pf->resolveMemo = NULL;
+    compactionDelete(pf->compaction);
+    pf->compaction = NULL;
+    free(pf->jumpTable);
+    pf->jumpTable = NULL;
+    pf->jumpDepth = 0;
+    free(pf->walkStack);
+    pf->walkStack = NULL;
+    pf->walkCapacity = 0;
+    rangeTreeDelete(pf->ranges);
+    pf->ranges = NULL;
+
+    // Wierzchołki z aren zwalniane są razem z nimi po opróżnieniu stosu.
+    pf->retiredArenas = arenaListConcat(pf->arena, pf->retiredArenas);
+    pf->arena = NULL;
+
+    if (pf->root != NULL) {
+        reclaimPush(pf, pf->root);
+        pf->root = NULL;
+    }
+
+    maintainStep(pf, 0);
+}
+
+/** @brief Zamrożona, tylko do odczytu reprezentacja drzewa przekierowań.
+ * Wierzchołki są ponumerowane w kolejności przeszukiwania wszerz. Synowie
+ * wierzchołka @p i mają kolejne numery od @p firstChild[i], a numer syna
+ * dla cyfry @p d to @p firstChild[i] plus liczba ustawionych bitów
+ * @p childMask[i] mniejszych niż @p d. Przekierowania wierzchołków z
+ * ustawionym bitem w @p hasForward leżą w @p targets w kolejności numerów
+ * wierzchołków; indeks przekierowania wyznacza rank na @p hasForward.
+ * Przekierowania są upakowane po dwie cyfry w bajcie (zob. packed_digits.h)
+ * i każde zaczyna się od początku bajtu.
+ */
+struct phfwdFrozen {
+    size_t nodes;            ///< Liczba wierzchołków.
+    size_t forwards;         ///< Liczba przekierowań.
+    uint16_t* childMask;     ///< Maski bitowe istniejących synów.
+    uint32_t* firstChild;    ///< Numer pierwszego syna każdego wierzchołka.
+    uint32_t* subtreeCount;  /**< Liczba przekierowań w poddrzewie każdego
+                                  wierzchołka. */
+    uint64_t* hasForward;    ///< Wektor bitowy wierzchołków z przekierowaniem.
+    uint32_t* forwardRank;   /**< Liczba przekierowań przed każdym
+                                  64-bitowym słowem @p hasForward. */
+    uint32_t* targetOffset;  /**< Początki przekierowań w @p targets w
+                                  bajtach (@p forwards + 1 elementów). */
+    unsigned char* targets;  ///< Sklejone upakowane przekierowania.
+    size_t maxTarget;        ///< Długość najdłuższego przekierowania.
+};
+
+/** Liczy ustawione bity w 64-bitowym słowie.
+ * @param[in] x  –  Słowo.
+ * @return Liczba ustawionych bitów.
+ */
+static inline unsigned popcount64(uint64_t x) {
+#if defined(__GNUC__)
+    return (unsigned)__builtin_popcountll(x);
+#else
+    unsigned res = 0;
+
+    while (x != 0) {
+        x &= x - 1;
+        res++;
+    }
+
+    return res;
+#endif
+}
+
+/** Usuwa zamrożoną reprezentację.
+ * @param[in] fz  –  Wskaźnik na zamrożoną reprezentację lub NULL.
+ */
+static void frozenDelete(struct phfwdFrozen* fz) {
+    if (fz != NULL) {
+        free(fz->childMask);
+        free(fz->firstChild);
+        free(fz->subtreeCount);
+        free(fz->hasForward);
+        free(fz->forwardRank);
+        free(fz->targetOffset);
+        free(fz->targets);
+        free(fz);
+    }
+}
+
+/** Wyznacza numer syna wierzchołka w zamrożonej reprezentacji.
+ * @param[in] fz     –  Wskaźnik na zamrożoną reprezentację;
+ * @param[in] idx    –  Numer wierzchołka;
+ * @param[in] digit  –  Cyfra syna.
+ * @return Numer syna lub SIZE_MAX, jeśli takiego syna nie ma.
+ */
+static inline size_t frozenChild(const struct phfwdFrozen* fz, size_t idx,
+                                 unsigned digit) {
+    unsigned mask = fz->childMask[idx];
+
+    if ((mask >> digit & 1) == 0)
+        return SIZE_MAX;
+
+    return fz->firstChild[idx] + popcount64(mask & ((1u << digit) - 1));
+}
+
+/** Wyznacza indeks przekierowania wierzchołka w zamrożonej reprezentacji.
+ * @param[in] fz   –  Wskaźnik na zamrożoną reprezentację;
+ * @param[in] idx  –  Numer wierzchołka.
+ * @return Indeks przekierowania lub SIZE_MAX, jeśli wierzchołek go nie ma.
+ */
+static inline size_t frozenForward(const struct phfwdFrozen* fz, size_t idx) {
+    uint64_t word = fz->hasForward[idx / 64];
+    uint64_t bit = (uint64_t)1 << (idx % 64);
+
+    if ((word & bit) == 0)
+        return SIZE_MAX;
+
+    return fz->forwardRank[idx / 64] + popcount64(word & (bit - 1));
+}
+
+/** Udostępnia upakowane przekierowanie w zamrożonej reprezentacji.
+ * @param[in] fz       –  Wskaźnik na zamrożoną reprezentację;
+ * @param[in] forward  –  Indeks przekierowania;
+ * @param[out] length  –  Wskaźnik na liczbę cyfr przekierowania.
+ * @return Wskaźnik na upakowane przekierowanie.
+ */
+static inline const unsigned char* frozenTarget(const struct phfwdFrozen* fz,
+                                                size_t forward, size_t* length) {
+    const unsigned char* target = fz->targets + fz->targetOffset[forward];
+    size_t bytes = fz->targetOffset[forward + 1] - fz->targetOffset[forward];
+
+    *length = 2 * bytes - ((target[bytes - 1] & 0xF) == PACKED_PAD);
+
+    return target;
+}
+
+/** @brief Buduje zamrożoną reprezentację drzewa.
+ * Numeruje wierzchołki przeszukiwaniem wszerz, używając tablicy wierzchołków
+ * jako kolejki.
+ * @param[in] root  –  Wskaźnik na korzeń drzewa.
+ * @return Wskaźnik na zamrożoną reprezentację lub NULL, jeśli nie udało się
+ *         zaalokować pamięci albo drzewo jest za duże.
+ */
+static struct phfwdFrozen* frozenBuild(fwdNode root) {
+    size_t capacity = 64;
+    size_t count = 1;
+    size_t targetBytes = 0;
+    size_t forwards = 0;
+    fwdNode* order = malloc(capacity * sizeof(fwdNode));
+
+    if (order == NULL)
+        return NULL;
+
+    order[0] = root;
+
+    for (size_t head = 0; head < count; head++) {
+        for (size_t i = 0; i < NUMBER_ALPHABET_SIZE; i++) {
+            if (order[head]->children[i] == NULL)
+                continue;
+
+            if (count == capacity) {
+                fwdNode* bigger = realloc(order, 2 * capacity * sizeof(fwdNode));
+
+                if (bigger == NULL) {
+                    free(order);
+                    return NULL;
+                }
+
+                order = bigger;
+                capacity *= 2;
+            }
+
+            order[count++] = order[head]->children[i];
+        }
+
+        if (order[head]->numForward != NULL) {
+            forwards++;
+            targetBytes += packedSize(order[head]->numForwardLength);
+        }
+    }
+
+    struct phfwdFrozen* fz = calloc(1, sizeof(struct phfwdFrozen));
+    size_t words = count / 64 + 1;
+
+    if (fz == NULL || count > UINT32_MAX || targetBytes > UINT32_MAX) {
+        free(order);
+        free(fz);
+        return NULL;
+    }
+
+    fz->nodes = count;
+    fz->forwards = forwards;
+    fz->childMask = malloc(count * sizeof(uint16_t));
+    fz->firstChild = malloc(count * sizeof(uint32_t));
+    fz->subtreeCount = malloc(count * sizeof(uint32_t));
+    fz->hasForward = calloc(words, sizeof(uint64_t));
+    fz->forwardRank = malloc(words * sizeof(uint32_t));
+    fz->targetOffset = malloc((forwards + 1) * sizeof(uint32_t));
+    fz->targets = malloc(targetBytes + 1);
+
+    if (fz->childMask == NULL || fz->firstChild == NULL ||
+        fz->subtreeCount == NULL || fz->hasForward == NULL ||
+        fz->forwardRank == NULL || fz->targetOffset == NULL ||
+        fz->targets == NULL) {
+        free(order);
+        frozenDelete(fz);
+        return NULL;
+    }
+
+    size_t next = 1;     // Numer pierwszego syna kolejnego wierzchołka.
+    size_t forward = 0;  // Indeks kolejnego przekierowania.
+    size_t offset = 0;   // Początek kolejnego przekierowania w targets.
+
+    for (size_t idx = 0; idx < count; idx++) {
+        fwdNode node = order[idx];
+        uint16_t mask = 0;
+
+        for (size_t i = 0; i < NUMBER_ALPHABET_SIZE; i++)
+            if (node->children[i] != NULL)
+                mask |= (uint16_t)(1u << i);
+
+        fz->childMask[idx] = mask;
+        fz->firstChild[idx] = (uint32_t)next;
+        fz->subtreeCount[idx] = (uint32_t)node->subtreeForwards;
+        next += popcount64(mask);
+
+        if (idx % 64 == 0)
+            fz->forwardRank[idx / 64] = (uint32_t)forward;
+
+        if (node->numForward != NULL) {
+            fz->hasForward[idx / 64] |= (uint64_t)1 << (idx % 64);
+            fz->targetOffset[forward++] = (uint32_t)offset;
+            packDigits(fz->targets + offset, node->numForward,
+                       node->numForwardLength);
+            offset += packedSize(node->numForwardLength);
+
+            if (node->numForwardLength > fz->maxTarget)
+                fz->maxTarget = node->numForwardLength;
+        }
+    }
+
+    fz->targetOffset[forward] = (uint32_t)offset;
+
+    // Słowo za ostatnim wierzchołkiem też potrzebuje poprawnego rangu.
+    if (count % 64 == 0)
+        fz->forwardRank[count / 64] = (uint32_t)forward;
+
+    free(order);
+
+    return fz;
+}
+
+/** Element stosu przeszukiwania zamrożonej reprezentacji w głąb.
+ */
+struct frozenFrame {
+    size_t idx;    ///< Numer wierzchołka.
+    size_t depth;  ///< Głębokość wierzchołka.
+    char digit;    ///< Ostatnia cyfra prefiksu wierzchołka.
+    fwdNode* slot; ///< Miejsce na wierzchołek przy odmrażaniu.
+};
+
+/** @brief Odkłada element na stos przeszukiwania zamrożonej reprezentacji.
+ * @param[in,out] stack     –  Wskaźnik na wskaźnik na stos;
+ * @param[in,out] top       –  Wskaźnik na liczbę elementów na stosie;
+ * @param[in,out] capacity  –  Wskaźnik na rozmiar stosu;
+ * @param[in] frame         –  Odkładany element.
+ * @return Wartość @p true, jeśli udało się odłożyć element.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool frozenPush(struct frozenFrame** stack, size_t* top,
+                       size_t* capacity, struct frozenFrame frame) {
+    if (*top == *capacity) {
+        size_t bigger = *capacity == 0 ? 64 : 2 * *capacity;
+        struct frozenFrame* newStack = realloc(*stack, bigger *
+                                               sizeof(struct frozenFrame));
+
+        if (newStack == NULL)
+            return false;
+
+        *stack = newStack;
+        *capacity = bigger;
+    }
+
+    (*stack)[(*top)++] = frame;
+
+    return true;
+}
+
+/** @brief Odtwarza drzewo wskaźnikowe z zamrożonej reprezentacji.
+ * @param[in] fz     –  Wskaźnik na zamrożoną reprezentację;
+ * @param[out] root  –  Wskaźnik na zmienną, do której zapisany zostanie
+ *                      korzeń odtworzonego drzewa.
+ * @return Wartość @p true, jeśli udało się odtworzyć drzewo.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci; wtedy
+ *         @p *root ma wartość NULL.
+ */
+static bool frozenThaw(const struct phfwdFrozen* fz, fwdNode* root) {
+    struct frozenFrame* stack = NULL;
+    size_t top = 0, capacity = 0;
+    size_t pathCapacity = 16;
+    char* path = malloc(pathCapacity);
+    struct frozenFrame start = {0, 0, 0, root};
+    bool ok = path != NULL && frozenPush(&stack, &top, &capacity, start);
+
+    *root = NULL;
+
+    while (ok && top > 0) {
+        struct frozenFrame frame = stack[--top];
+        fwdNode node = nodeNew();
+
+        if (node == NULL) {
+            ok = false;
+            break;
+        }
+
+        *frame.slot = node;
+
+        if (frame.depth > 0)
+            path[frame.depth - 1] = frame.digit;
+
+        size_t forward = frozenForward(fz, frame.idx);
+
+        if (forward != SIZE_MAX) {
+            size_t length;
+            const unsigned char* target = frozenTarget(fz, forward, &length);
+
+            node->num = malloc(frame.depth + 1);
+            node->numForward = malloc(length + 1);
+
+            if (node->num == NULL || node->numForward == NULL) {
+                free(node->num);
+                free(node->numForward);
+                node->num = node->numForward = NULL;
+                ok = false;
+                break;
+            }
+
+            memcpy(node->num, path, frame.depth);
+            node->num[frame.depth] = '\0';
+            node->numLength = frame.depth;
+            unpackDigits(node->numForward, target, length);
+            node->numForward[length] = '\0';
+            node->numForwardLength = length;
+        }
+
+        if (frame.depth + 1 >= pathCapacity) {
+            char* bigger = realloc(path, 2 * pathCapacity);
+
+            if (bigger == NULL) {
+                ok = false;
+                break;
+            }
+
+            path = bigger;
+            pathCapacity *= 2;
+        }
+
+        for (unsigned d = 0; d < NUMBER_ALPHABET_SIZE && ok; d++) {
+            size_t child = frozenChild(fz, frame.idx, d);
+
+            if (child != SIZE_MAX) {
+                struct frozenFrame next = {child, frame.depth + 1, (char)('0' + d),
+                                           &node->children[d]};
+                ok = frozenPush(&stack, &top, &capacity, next);
+            }
+        }
+    }
+
+    free(stack);
+    free(path);
+
+    if (ok)
+        ok = treeRecount(*root);
+
+    if (!ok) {
+        nodeDelete(*root);
+        *root = NULL;
+    }
+
+    return ok;
+}
+
+bool phfwdFreeze(PhoneFwd pf) {
+    if (pf == NULL || pf->engine != NULL)
+        return false;
+
+    if (pf->frozen != NULL)
+        return true;
+
+    pf->frozen = frozenBuild(pf->root);
+
+    if (pf->frozen == NULL)
+        return false;
+
+    compactionDelete(pf->compaction);
+    pf->compaction = NULL;
+    free(pf->jumpTable);
+    pf->jumpTable = NULL;
+
+    /* Drzewo wskaźnikowe zwalniane jest w tle przez phfwdMaintain, a areny
+     * jego wierzchołków i napisów razem z nim. */
+    pf->retiredArenas = arenaListConcat(pf->arena, pf->retiredArenas);
+    pf->arena = NULL;
+    reclaimPush(pf, pf->root);
+    pf->root = NULL;
+
+    return true;
+}
+
+/** @brief Odmraża strukturę.
+ * Odtwarza drzewo wskaźnikowe i tablicę skoków. Nic nie robi, jeśli
+ * struktura nie jest zamrożona.
+ * @param[in,out] pf  –  Wskaźnik na strukturę przechowującą przekierowania.
+ * @return Wartość @p true, jeśli struktura nie jest zamrożona.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool thaw(PhoneFwd pf) {
+    if (pf->frozen == NULL)
+        return true;
+
+    fwdNode root;
+
+    if (!frozenThaw(pf->frozen, &root))
+        return false;
+
+    frozenDelete(pf->frozen);
+    pf->frozen = NULL;
+    pf->root = root;
+
+    if (pf->jumpDepth > 0)
+        phfwdSetJumpDepth(pf, pf->jumpDepth);
+
+    return true;
+}
+
+/** @brief Numer, którego prefiksami mają być przeglądane przekierowania.
+ */
+struct forwardFilter {
+    unsigned char* packed; ///< Upakowany numer.
+    size_t length;         ///< Liczba cyfr numeru.
+    const char* num;       ///< Numer przed upakowaniem.
+};
+
+/** Tworzy filtr przekierowań będących prefiksami numeru.
+ * @param[out] filter  –  Wskaźnik na inicjowany filtr;
+ * @param[in] num      –  Wskaźnik na poprawny numer;
+ * @param[in] length   –  Długość numeru.
+ * @return Wartość @p true, jeśli udało się utworzyć filtr.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool filterInit(struct forwardFilter* filter, const char* num,
+                       size_t length) {
+    filter->packed = malloc(packedSize(length));
+    filter->length = length;
+    filter->num = num;
+
+    if (filter->packed == NULL)
+        return false;
+
+    packDigits(filter->packed, num, length);
+
+    return true;
+}
+
+/** @brief Przegląda przekierowania zamrożonej reprezentacji.
+ * Przekierowania są rozpakowywane przed wywołaniem funkcji @p callback.
+ * Jeśli podano filtr, to przekierowania niebędące prefiksami numeru z filtru
+ * są pomijane bez rozpakowywania, porównaniem po 16 cyfr naraz.
+ * @param[in] fz          –  Wskaźnik na zamrożoną reprezentację;
+ * @param[in] callback    –  Funkcja wywoływana dla każdego przekierowania;
+ * @param[in,out] ctx     –  Dane przekazywane funkcji @p callback;
+ * @param[in] filter      –  Wskaźnik na filtr lub NULL;
+ * @param[in,out] visited –  Wskaźnik na licznik odwiedzonych wierzchołków.
+ * @return Wartość @p true, jeśli przejrzano wszystkie przekierowania.
+ *         Wartość @p false, jeśli przerwano przeglądanie lub nie udało się
+ *         zaalokować pamięci.
+ */
+static bool frozenForEach(const struct phfwdFrozen* fz, forwardCallback callback,
+                          void* ctx, const struct forwardFilter* filter,
+                          size_t* visited) {
+    struct frozenFrame* stack = NULL;
+    size_t top = 0, capacity = 0;
+    size_t pathCapacity = 16;
+    char* path = malloc(pathCapacity);
+    char* fwd = malloc(fz->maxTarget + 1);
+    struct frozenFrame start = {0, 0, 0, NULL};
+    bool ok = path != NULL && fwd != NULL &&
+              frozenPush(&stack, &top, &capacity, start);
+
+    while (ok && top > 0) {
+        struct frozenFrame frame = stack[--top];
+        PHFWD_TRACE_COUNT(*visited, 1);
+
+        if (frame.depth > 0)
+            path[frame.depth - 1] = frame.digit;
+
+        size_t forward = frozenForward(fz, frame.idx);
+
+        if (forward != SIZE_MAX) {
+            size_t length;
+            const unsigned char* target = frozenTarget(fz, forward, &length);
+
+            if (filter == NULL || packedIsPrefix(target, length, filter->packed,
+                                                 filter->length)) {
+                unpackDigits(fwd, target, length);
+
+                if (!callback(ctx, path, frame.depth, fwd, length)) {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+
+        if (frame.depth + 1 >= pathCapacity) {
+            char* bigger = realloc(path, 2 * pathCapacity);
+
+            if (bigger == NULL) {
+                ok = false;
+                break;
+            }
+
+            path = bigger;
+            pathCapacity *= 2;
+        }
+
+        // Synów odkładamy od największej cyfry, żeby odwiedzić je rosnąco.
+        for (unsigned d = NUMBER_ALPHABET_SIZE; d-- > 0 && ok;) {
+            size_t child = frozenChild(fz, frame.idx, d);
+
+            if (child != SIZE_MAX) {
+                struct frozenFrame next = {child, frame.depth + 1,
+                                           (char)('0' + d), NULL};
+                ok = frozenPush(&stack, &top, &capacity, next);
+            }
+        }
+    }
+
+    free(stack);
+    free(path);
+    free(fwd);
+
+    return ok;
+}
+
+/** @brief Przegląda przekierowania struktury poza przekierowaniami zakresów.
+ * Przekierowania przeglądane są w porządku leksykograficznym prefiksów
+ * przekierowywanych, iteracyjnie, niezależnie od reprezentacji struktury.
+ * Filtr jest tylko wskazówką: przekierowania niebędące prefiksami numeru z
+ * filtru mogą zostać pominięte, ale nie muszą.
+ * @param[in] pf          –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] callback    –  Funkcja wywoływana dla każdego przekierowania;
+ * @param[in,out] ctx     –  Dane przekazywane funkcji @p callback;
+ * @param[in] filter      –  Wskaźnik na filtr lub NULL;
+ * @param[in,out] visited –  Wskaźnik na licznik odwiedzonych wierzchołków.
+ * @return Wartość @p true, jeśli przejrzano wszystkie przekierowania.
+ *         Wartość @p false, jeśli przerwano przeglądanie lub nie udało się
+ *         zaalokować pamięci.
+ */
+static bool baseForEach(PhoneFwd pf, forwardCallback callback, void* ctx,
+                        const struct forwardFilter* filter, size_t* visited) {
+    if (pf->engine != NULL)
+        return pf->engine->forEach(pf->engineData, callback, ctx);
+
+    if (pf->frozen != NULL)
+        return frozenForEach(pf->frozen, callback, ctx, filter, visited);
+
+    /* Stos jest zachowywany w strukturze między wywołaniami, więc przeglądanie
+     * alokuje pamięć tylko wtedy, gdy drzewo urosło. Funkcja callback nie może
+     * przeglądać tej samej struktury. */
+    size_t top = 0;
+
+    if (pf->walkCapacity == 0) {
+        pf->walkStack = malloc(64 * sizeof(fwdNode));
+
+        if (pf->walkStack == NULL)
+            return false;
+
+        pf->walkCapacity = 64;
+    }
+
+    pf->walkStack[top++] = pf->root;
+
+    while (top > 0) {
+        fwdNode node = pf->walkStack[--top];
+        PHFWD_TRACE_COUNT(*visited, 1);
+
+        if (node->numForward != NULL &&
+            !callback(ctx, node->num, node->numLength, node->numForward,
+                      node->numForwardLength))
+            return false;
+
+        // Synów odkładamy od największej cyfry, żeby odwiedzić je rosnąco.
+        for (size_t i = NUMBER_ALPHABET_SIZE; i-- > 0;) {
+            if (node->children[i] == NULL)
+                continue;
+
+            if (top == pf->walkCapacity) {
+                fwdNode* bigger = realloc(pf->walkStack, 2 * pf->walkCapacity *
+                                          sizeof(fwdNode));
+
+                if (bigger == NULL)
+                    return false;
+
+                pf->walkStack = bigger;
+                pf->walkCapacity *= 2;
+            }
+
+            pf->walkStack[top++] = node->children[i];
+        }
+    }
+
+    return true;
+}
+
+/** Porównuje leksykograficznie dwa napisy o podanych długościach.
+ * @param[in] s        –  Wskaźnik na pierwszy napis;
+ * @param[in] sLength  –  Długość pierwszego napisu;
+ * @param[in] t        –  Wskaźnik na drugi napis;
+ * @param[in] tLength  –  Długość drugiego napisu.
+ * @return Wartość ujemna, zero lub dodatnia, jak w funkcji strcmp.
+ */
+static int lengthCompare(const char* s, size_t sLength, const char* t,
+                         size_t tLength) {
+    int res = memcmp(s, t, sLength < tLength ? sLength : tLength);
+
+    if (res != 0 || sLength == tLength)
+        return res;
+
+    return sLength < tLength ? -1 : 1;
+}
+
+/** Dane przekazywane funkcji @ref mergeCallback.
+ */
+struct mergeCtx {
+    PhoneFwd pf;              ///< Przeglądana struktura.
+    forwardCallback callback; ///< Funkcja wywoływana dla każdego przekierowania.
+    void* ctx;                ///< Dane przekazywane funkcji @p callback.
+    struct rangeWalk walk;    ///< Stan przeglądania prefiksów zakresów.
+    size_t* visited;          ///< Wskaźnik na licznik odwiedzonych wierzchołków.
+};
+
+/** @brief Przekazuje prefiksy zakresów mniejsze od danego prefiksu.
+ * Pomija prefiksy, które mają też zwykłe przekierowanie, bo to ono
+ * obowiązuje. Sprawdzane jest to bezpośrednio w strukturze, bo filtr może
+ * ukrywać zwykłe przekierowania przed funkcją @ref mergeCallback.
+ * @param[in,out] merge     –  Wskaźnik na strukturę @ref mergeCtx;
+ * @param[in] bound         –  Wskaźnik na prefiks lub NULL, jeśli należy
+ *                             przekazać wszystkie pozostałe prefiksy;
+ * @param[in] boundLength   –  Długość prefiksu.
+ * @return Wartość @p true, jeśli należy kontynuować przeglądanie.
+ *         Wartość @p false, jeśli przerwano przeglądanie lub nie udało się
+ *         zaalokować pamięci.
+ */
+static bool mergeDrain(struct mergeCtx* merge, const char* bound,
+                       size_t boundLength) {
+    struct rangeWalk* walk = &merge->walk;
+
+    while (walk->ready && (bound == NULL ||
+                           lengthCompare(walk->path, walk->length, bound,
+                                         boundLength) < 0)) {
+        if (!baseHasKey(merge->pf, walk->path, walk->length, merge->visited) &&
+            !merge->callback(merge->ctx, walk->path, walk->length,
+                             walk->forward, walk->forwardLength))
+            return false;
+
+        rangeWalkNext(walk, merge->visited);
+    }
+
+    return !walk->failed;
+}
+
+/** @brief Przekazuje przekierowanie, poprzedzając je mniejszymi prefiksami
+ * zakresów.
+ * @param[in,out] ctx     –  Wskaźnik na strukturę @ref mergeCtx;
+ * @param[in] num         –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] numLength   –  Długość prefiksu przekierowywanego;
+ * @param[in] fwd         –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength   –  Długość przekierowania.
+ * @return Wartość @p true, jeśli należy kontynuować przeglądanie.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool mergeCallback(void* ctx, const char* num, size_t numLength,
+                          const char* fwd, size_t fwdLength) {
+    struct mergeCtx* merge = ctx;
+
+    return mergeDrain(merge, num, numLength) &&
+           merge->callback(merge->ctx, num, numLength, fwd, fwdLength);
+}
+
+/** @brief Przegląda wszystkie przekierowania struktury.
+ * Działa jak @ref baseForEach, ale przekierowania zakresów rozwijane są w
+ * pasujące do nich prefiksy i przeplatane z pozostałymi przekierowaniami
+ * tak, żeby zachować porządek leksykograficzny. Jeśli podano filtr,
+ * rozwijane są tylko zakresy, których przekierowanie jest prefiksem numeru
+ * z filtru.
+ * @param[in] pf          –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] callback    –  Funkcja wywoływana dla każdego przekierowania;
+ * @param[in,out] ctx     –  Dane przekazywane funkcji @p callback;
+ * @param[in] filter      –  Wskaźnik na filtr lub NULL;
+ * @param[in,out] visited –  Wskaźnik na licznik odwiedzonych wierzchołków.
+ * @return Wartość @p true, jeśli przejrzano wszystkie przekierowania.
+ *         Wartość @p false, jeśli przerwano przeglądanie lub nie udało się
+ *         zaalokować pamięci.
+ */
+static bool forEachForward(PhoneFwd pf, forwardCallback callback, void* ctx,
+                           const struct forwardFilter* filter, size_t* visited) {
+    if (pf->ranges == NULL)
+        return baseForEach(pf, callback, ctx, filter, visited);
+
+    struct mergeCtx merge = {pf, callback, ctx, {0}, visited};
+
+    rangeWalkStart(&merge.walk, pf->ranges, filter != NULL ? filter->num : NULL,
+                   filter != NULL ? filter->length : 0, visited);
+
+    bool ok = baseForEach(pf, mergeCallback, &merge, filter, visited) &&
+              mergeDrain(&merge, NULL, 0);
+
+    rangeWalkEnd(&merge.walk);
+
+    return ok;
+}
+
+/** @brief Zapamiętany łańcuch przekierowań.
+ * Dla każdego numeru łańcucha pamiętana jest długość prefiksu, którego
+ * przekierowanie zostało do niego zastosowane, co pozwala dokładnie
+ * stwierdzić, czy zmiana przekierowań wpływa na łańcuch.
+ */
+struct resolveEntry {
+    char* chain;          /**< Kolejne numery łańcucha zakończone znakami '\0';
+                               pierwszy jest numerem początkowym. NULL, jeśli
+                               komórka jest pusta. */
+    size_t* matchLength;  /**< Długości dopasowanych prefiksów kolejnych
+                               numerów; 0 oznacza brak przekierowania. */
+    size_t count;         ///< Liczba numerów łańcucha.
+    size_t maxHops;       ///< Limit przekierowań, z którym wyznaczono łańcuch.
+    enum PhoneResolveStatus status; ///< Wynik wyznaczania łańcucha.
+};
+
+/** Pamięć podręczna łańcuchów przekierowań, adresowana skrótem numeru.
+ */
+struct phfwdResolveMemo {
+    struct resolveEntry entries[RESOLVE_MEMO_SIZE]; ///< Komórki pamięci.
+};
+
+/** Opróżnia komórkę pamięci podręcznej łańcuchów.
+ * @param[in,out] entry  –  Wskaźnik na komórkę.
+ */
+static void resolveEntryClear(struct resolveEntry* entry) {
+    free(entry->chain);
+    free(entry->matchLength);
+    entry->chain = NULL;
+    entry->matchLength = NULL;
+    entry->count = 0;
+}
+
+/** Usuwa pamięć podręczną łańcuchów.
+ * @param[in] memo  –  Wskaźnik na pamięć podręczną lub NULL.
+ */
+static void resolveMemoDelete(struct phfwdResolveMemo* memo) {
+    if (memo != NULL) {
+        for (size_t i = 0; i < RESOLVE_MEMO_SIZE; i++)
+            resolveEntryClear(&memo->entries[i]);
+
+        free(memo);
+    }
+}
+
+/** @brief Unieważnia łańcuchy, na które wpływa zmiana przekierowań.
+ * Dodanie przekierowania prefiksu @p key zmienia wynik dla numeru, którego
+ * @p key jest prefiksem nie krótszym niż dotąd dopasowany. Usunięcie
+ * przekierowań o prefiksie @p key zmienia wynik dla numeru, którego
+ * dopasowany prefiks zaczyna się od @p key.
+ * @param[in,out] pf        –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] key           –  Wskaźnik na zmieniony prefiks;
+ * @param[in] keyLength     –  Długość prefiksu;
+ * @param[in] removed       –  Czy przekierowania zostały usunięte.
+ */
+static void resolveMemoInvalidate(PhoneFwd pf, const char* key, size_t keyLength,
+                                  bool removed) {
+    if (pf->resolveMemo == NULL)
+        return;
+
+    for (size_t e = 0; e < RESOLVE_MEMO_SIZE; e++) {
+        struct resolveEntry* entry = &pf->resolveMemo->entries[e];
+        const char* num = entry->chain;
+
+        for (size_t i = 0; i < entry->count; i++) {
+            size_t numLength = strlen(num);
+            bool affected = removed ? entry->matchLength[i] >= keyLength :
+                                      keyLength >= entry->matchLength[i];
+
+            if (affected && keyLength <= numLength &&
+                strncmp(num, key, keyLength) == 0) {
+                resolveEntryClear(entry);
+                break;
+            }
+
+            num += numLength + 1;
+        }
+    }
+}
+
+/** @brief Unieważnia łańcuchy, na które wpływa dodanie przekierowania zakresu.
+ * Działa tak jak @ref resolveMemoInvalidate dla dodania przekierowania
+ * każdego prefiksu zakresu.
+ * @param[in,out] pf        –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] from          –  Wskaźnik na początek zakresu;
+ * @param[in] to            –  Wskaźnik na koniec zakresu;
+ * @param[in] keyLength     –  Długość prefiksów zakresu.
+ */
+static void resolveMemoInvalidateRange(PhoneFwd pf, const char* from,
+                                       const char* to, size_t keyLength) {
+    if (pf->resolveMemo == NULL)
+        return;
+
+    for (size_t e = 0; e < RESOLVE_MEMO_SIZE; e++) {
+        struct resolveEntry* entry = &pf->resolveMemo->entries[e];
+        const char* num = entry->chain;
+
+        for (size_t i = 0; i < entry->count; i++) {
+            size_t numLength = strlen(num);
+
+            if (keyLength >= entry->matchLength[i] && keyLength <= numLength &&
+                memcmp(num, from, keyLength) >= 0 &&
+                memcmp(num, to, keyLength) <= 0) {
+                resolveEntryClear(entry);
+                break;
+            }
+
+            num += numLength + 1;
+        }
+    }
+}
+
+/** Wyznacza skrót numeru.
+ * @param[in] num  –  Wskaźnik na napis reprezentujący numer.
+ * @return Indeks komórki pamięci podręcznej łańcuchów.
+ */
+static size_t resolveHash(const char* num) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; num[i] != '\0'; i++) {
+        hash ^= (unsigned char)num[i];
+        hash *= 16777619u;
+    }
+
+    return hash % RESOLVE_MEMO_SIZE;
+}
+
+/** @brief Ustawia przekierowanie wierzchołka.
+ * Poprzednie przekierowanie wierzchołka jest usuwane. Liczniki poddrzew nie
+ * są zmieniane.
+ * @param[in,out] node  –  Wskaźnik na wierzchołek reprezentujący @p num1;
+ * @param[in] num1      –  Wskaźnik na poprawny napis reprezentujący prefiks
+ *                         numerów przekierowywanych;
+ * @param[in] num2      –  Wskaźnik na poprawny napis reprezentujący prefiks
+ *                         numerów, na które jest wykonywane przekierowanie;
+ * @param[in] keyLength –  Długość napisu @p num1.
+ * @return Wartość @p true, jeśli przekierowanie zostało ustawione.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci; wtedy
+ *         wierzchołek nie ma przekierowania.
+ */
+static bool nodeSetForward(fwdNode node, const char* num1, const char* num2,
+                           size_t keyLength) {
+    size_t valueLength = strlen(num2);
+
+    /* Sprawdzamy, czy wierzchołek reprezentujący num1 zawiera jakieś
+     * przekierowanie. Jeśli tak, usuwamy je.
+     * Jeśli nie, uzupełniamy pole node->num.
+     */
+    if (node->numForward != NULL) {
+        if ((node->flags & FWD_IN_ARENA) == 0)
+            free(node->numForward);
+
+        node->numForward = NULL;
+        node->flags &= ~FWD_IN_ARENA;
+    }
+
+    else {
+        node->num = calloc(keyLength + 1, sizeof(char));
+
+        if (node->num == NULL)
+            return false;
+
+        strcpy(node->num, num1);
+        node->numLength = keyLength;
+    }
+
+    node->numForward = calloc(valueLength+1, sizeof(char));
+
+    if (node->numForward == NULL) {
+        // Wierzchołek bez przekierowania nie może mieć ustawionego prefiksu.
+        if ((node->flags & NUM_IN_ARENA) == 0)
+            free(node->num);
+
+        node->num = NULL;
+        node->flags &= ~NUM_IN_ARENA;
+        return false;
+    }
+
+    strcpy(node->numForward, num2);
+    node->numForwardLength = valueLength;
+
+    return true;
+}
+
+/** @brief Wstawia przekierowanie do drzewa.
+ * Aktualizuje liczniki poddrzew na ścieżce @p num1.
+ * @param[in] root          –  Wskaźnik na korzeń drzewa;
+ * @param[in] num1          –  Wskaźnik na poprawny napis reprezentujący prefiks
+ *                             numerów przekierowywanych;
+ * @param[in] num2          –  Wskaźnik na poprawny napis reprezentujący prefiks
+ *                             numerów, na które jest wykonywane przekierowanie;
+ * @param[in] keyLength     –  Długość napisu @p num1;
+ * @param[out] created      –  Wskaźnik na zmienną, do której zapisywana jest
+ *                             głębokość pierwszego utworzonego wierzchołka;
+ * @param[in,out] trace     –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wartość @p true, jeśli przekierowanie zostało dodane.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool insertForward(fwdNode root, const char* num1, const char* num2,
+                          size_t keyLength, size_t* created,
+                          struct traceInfo* trace) {
+    fwdNode nextNode = root; //Startowy wierzchołek drzewa prefiksowego.
+    size_t depth = 0;
+    size_t fresh = 0; //Liczba wierzchołków utworzonych na końcu ścieżki.
+
+    while (depth < keyLength) {
+        size_t digit = (size_t)(num1[depth] - 48);
+
+        /* Sprawdzamy, czy w drzewie jest wierzchołek reprezentujący kolejny
+         * prefiks num1. Jeśli nie, dodajemy go. */
+        if (nextNode->children[digit] == NULL) {
+            fwdNode child = nodeNew();
+
+            if (child == NULL)
+                break;
+
+            nextNode->children[digit] = child;
+            nextNode->childCount++;
+            fresh++;
+
+            if (*created > depth + 1)
+                *created = depth + 1;
+        }
+
+        nextNode = nextNode->children[digit];
+        depth++;
+        PHFWD_TRACE_COUNT(trace->visited, 1);
+    }
+
+    // Utworzone wierzchołki zostają w drzewie także po błędzie alokacji.
+    if (depth < keyLength) {
+        pathUpdate(root, num1, depth, fresh, 0, 0, 0);
+        return false;
+    }
+
+    size_t oldForwards = nextNode->numForward != NULL ? 1 : 0;
+    size_t oldBytes = nodeBytes(nextNode);
+    uint64_t oldHash = nodeHash(nextNode);
+    bool res = nodeSetForward(nextNode, num1, num2, keyLength);
+    size_t newForwards = nextNode->numForward != NULL ? 1 : 0;
+
+    pathUpdate(root, num1, keyLength, fresh, newForwards - oldForwards,
+               nodeBytes(nextNode) - oldBytes, nodeHash(nextNode) - oldHash);
+
+    return res;
+}
+
+/** @brief Implementacja funkcji @ref phfwdAdd.
+ * @param[in] pf      –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num1    –  Wskaźnik na napis reprezentujący prefiks numerów
+ *                       przekierowywanych;
+ * @param[in] num2    –  Wskaźnik na napis reprezentujący prefiks numerów, na
+ *                       które jest wykonywane przekierowanie;
+ * @param[out] trace  –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wartość @p true, jeśli przekierowanie zostało dodane.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool addForward(PhoneFwd pf, const char* num1, const char* num2,
+                       struct traceInfo* trace) {
+    if (pf == NULL || !isValidNumber(num1) || !isValidNumber(num2))
+        return false;
+
+    size_t keyLength = strlen(num1);
+    trace->keyLength = keyLength;
+
+    //Sprawdzenie czy napisy num1 i num2 są takie same.
+    if (strcmp(num1, num2) == 0)
+        return false;
+
+    if (pf->engine != NULL) {
+        bool res = pf->engine->add(pf->engineData, num1, num2);
+
+        resolveMemoInvalidate(pf, num1, keyLength, false);
+        return res;
+    }
+
+    if (!thaw(pf))
+        return false;
+
+    size_t created = SIZE_MAX;
+    bool res = insertForward(pf->root, num1, num2, keyLength, &created,
+                             trace);
+
+    if (pf->compaction != NULL)
+        compactSync(pf, num1, keyLength);
+
+    /* Nieudane wstawienie mogło już usunąć poprzednie przekierowanie num1,
+     * więc łańcuchy unieważniamy w obu przypadkach. */
+    resolveMemoInvalidate(pf, num1, keyLength, false);
+
+    /* Tablica skoków zmienia się, jeśli przekierowanie leży w jej zasięgu
+     * lub powstały nowe wierzchołki na głębokości, którą obejmuje. */
+    if (keyLength <= pf->jumpDepth || created <= pf->jumpDepth)
+        jumpRefresh(pf, num1, keyLength);
+
+    maintainStep(pf, keyLength);
+
+    return res;
+}
+
+bool phfwdAdd(PhoneFwd pf, const char* num1, const char* num2) {
+    struct traceInfo trace = {0, 0};
+
+    PHFWD_PROBE2(add__entry, num1, num2);
+    bool res = addForward(pf, num1, num2, &trace);
+    PHFWD_PROBE3(add__return, trace.keyLength, trace.visited, res);
+
+    return res;
+}
+
+/** @brief Implementacja funkcji @ref phfwdAddRange.
+ * @param[in] pf      –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] from    –  Wskaźnik na napis reprezentujący początek zakresu;
+ * @param[in] to      –  Wskaźnik na napis reprezentujący koniec zakresu;
+ * @param[in] num     –  Wskaźnik na napis reprezentujący prefiks numerów, na
+ *                       które jest wykonywane przekierowanie;
+ * @param[out] trace  –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wartość @p true, jeśli przekierowanie zostało dodane.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool addRange(PhoneFwd pf, const char* from, const char* to,
+                     const char* num, struct traceInfo* trace) {
+    if (pf == NULL || !isValidNumber(from) || !isValidNumber(to) ||
+        !isValidNumber(num))
+        return false;
+
+    size_t keyLength = strlen(from);
+    trace->keyLength = keyLength;
+
+    if (strlen(to) != keyLength || strcmp(from, to) > 0)
+        return false;
+
+    // Tak jak w phfwdAdd, jeden prefiks nie może być przekierowany na siebie.
+    if (strcmp(from, to) == 0 && strcmp(from, num) == 0)
+        return false;
+
+    if (pf->ranges == NULL) {
+        pf->ranges = rangeTreeNew();
+
+        if (pf->ranges == NULL)
+            return false;
+    }
+
+    bool res = rangeTreeAdd(pf->ranges, from, to, keyLength, num);
+
+    // Nieudane wstawienie mogło już zmienić przekierowania części zakresu.
+    resolveMemoInvalidateRange(pf, from, to, keyLength);
+
+    return res;
+}
+
+bool phfwdAddRange(PhoneFwd pf, const char* from, const char* to,
+                   const char* num) {
+    struct traceInfo trace = {0, 0};
+
+    PHFWD_PROBE3(add_range__entry, from, to, num);
+    bool res = addRange(pf, from, to, num, &trace);
+    PHFWD_PROBE2(add_range__return, trace.keyLength, res);
+
+    return res;
+}
+
+/** Niepusty kubełek równoległego wczytywania.
+ */
+struct bulkBucket {
+    size_t size;  ///< Liczba przekierowań kubełka.
+    size_t index; ///< Numer kubełka.
+};
+
+/** @brief Stan równoległego wczytywania przekierowań.
+ * Kubełek o numerze @p b zawiera przekierowania, których pierwsze @p depth
+ * cyfr to zapis @p b w systemie o podstawie NUMBER_ALPHABET_SIZE. Kubełek o
+ * numerze @p buckets zawiera przekierowania krótszych prefiksów.
+ */
+struct bulkLoad {
+    const struct PhoneForwardRecord* records; ///< Wczytywane przekierowania.
+    size_t depth;              ///< Liczba cyfr wyznaczających kubełek.
+    size_t buckets;            ///< Liczba kubełków pełnej długości.
+    size_t* order;             /**< Numery przekierowań ułożone według
+                                    kubełków, w kolejności z @p records. */
+    size_t* bucketStart;       /**< Początki kubełków w @p order
+                                    (@p buckets + 2 elementów). */
+    struct bulkBucket* queue;  /**< Niepuste kubełki pełnej długości od
+                                    największego. */
+    size_t queued;             ///< Liczba kubełków w @p queue.
+    fwdNode* roots;            ///< Korzenie poddrzew zbudowanych dla kubełków.
+    atomic_size_t next;        ///< Indeks w @p queue kolejnego kubełka.
+    atomic_bool failed;        ///< Czy nie udało się zaalokować pamięci.
+};
+
+/** Wątek równoległego wczytywania przekierowań.
+ */
+struct bulkWorker {
+    struct bulkLoad* load; ///< Wskaźnik na wspólny stan wczytywania.
+    Arena arena;           ///< Arena, w której wątek buduje poddrzewa.
+};
+
+/** Komparator kubełków. Większe kubełki są wcześniej, równe według numerów.
+ * @param p1  –  Wskaźnik na pierwszy kubełek;
+ * @param p2  –  Wskaźnik na drugi kubełek.
+ * @return Liczba ujemna, zero lub dodatnia, jak w funkcji strcmp.
+ */
+static int bulkBucketCompare(const void* p1, const void* p2) {
+    const struct bulkBucket* b1 = p1;
+    const struct bulkBucket* b2 = p2;
+
+    if (b1->size != b2->size)
+        return b1->size > b2->size ? -1 : 1;
+
+    return b1->index < b2->index ? -1 : b1->index > b2->index;
+}
+
+/** @brief Buduje w arenie poddrzewo kubełka.
+ * Korzeń poddrzewa reprezentuje pierwsze @p depth cyfr przekierowań
+ * kubełka. Przekierowania wstawiane są w kolejności z @p records, więc przy
+ * powtórzonym prefiksie zostaje ostatnie; poprzednie zostaje w arenie
+ * nieużywane.
+ * @param[in,out] load  –  Wskaźnik na stan wczytywania;
+ * @param[in,out] arena –  Wskaźnik na arenę wątku;
+ * @param[in] bucket    –  Numer kubełka.
+ * @return Wartość @p true, jeśli zbudowano poddrzewo.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool bulkBuild(struct bulkLoad* load, Arena arena, size_t bucket) {
+    fwdNode root = arenaNodeNew(arena);
+
+    if (root == NULL)
+        return false;
+
+    for (size_t p = load->bucketStart[bucket];
+         p < load->bucketStart[bucket + 1]; p++) {
+        const struct PhoneForwardRecord* record = &load->records[load->order[p]];
+        fwdNode node = root;
+        size_t i = load->depth;
+
+        for (; record->num[i] != '\0'; i++) {
+            fwdNode* slot = &node->children[record->num[i] - 48];
+
+            if (*slot == NULL) {
+                *slot = arenaNodeNew(arena);
+
+                if (*slot == NULL)
+                    return false;
+            }
+
+            node = *slot;
+        }
+
+        size_t fwdLength = strlen(record->fwd);
+
+        if (node->num == NULL)
+            node->num = arenaCopyString(arena, record->num, i);
+
+        node->numForward = arenaCopyString(arena, record->fwd, fwdLength);
+
+        if (node->num == NULL || node->numForward == NULL)
+            return false;
+
+        node->numLength = i;
+        node->numForwardLength = fwdLength;
+        node->flags |= NUM_IN_ARENA | FWD_IN_ARENA;
+    }
+
+    load->roots[bucket] = root;
+
+    return treeRecount(root);
+}
+
+/** @brief Funkcja wątku wczytywania.
+ * Pobiera kolejne kubełki, od największego, dopóki wszystkie nie zostaną
+ * zbudowane lub któryś wątek nie zgłosi braku pamięci.
+ * @param[in,out] arg  –  Wskaźnik na strukturę @ref bulkWorker.
+ * @return Zawsze NULL.
+ */
+static void* bulkWorkerRun(void* arg) {
+    struct bulkWorker* worker = arg;
+    struct bulkLoad* load = worker->load;
+    size_t i;
+
+    while (!atomic_load(&load->failed) &&
+           (i = atomic_fetch_add(&load->next, 1)) < load->queued) {
+        if (!bulkBuild(load, worker->arena, load->queue[i].index))
+            atomic_store(&load->failed, true);
+    }
+
+    return NULL;
+}
+
+/** @brief Układa przekierowania według kubełków.
+ * Sortowanie kubełkowe jest stabilne, więc w każdym kubełku przekierowania
+ * zachowują kolejność z @p records. Wypełnia też kolejkę niepustych
+ * kubełków pełnej długości.
+ * @param[in,out] load  –  Wskaźnik na stan wczytywania;
+ * @param[in] count     –  Liczba przekierowań.
+ */
+static void bulkPartition(struct bulkLoad* load, size_t count) {
+    size_t* start = load->bucketStart;
+
+    for (size_t i = 0; i < count; i++) {
+        const char* num = load->records[i].num;
+        size_t b = strlen(num) >= load->depth ? jumpIndex(num, load->depth) :
+                                                load->buckets;
+
+        start[b + 1]++;
+    }
+
+    for (size_t b = 0; b < load->buckets; b++) {
+        if (start[b + 1] > 0) {
+            load->queue[load->queued].size = start[b + 1];
+            load->queue[load->queued++].index = b;
+        }
+    }
+
+    for (size_t b = 1; b <= load->buckets + 1; b++)
+        start[b] += start[b - 1];
+
+    // Po rozłożeniu start[b] wskazuje koniec kubełka b, więc przesuwamy.
+    for (size_t i = 0; i < count; i++) {
+        const char* num = load->records[i].num;
+        size_t b = strlen(num) >= load->depth ? jumpIndex(num, load->depth) :
+                                                load->buckets;
+
+        load->order[start[b]++] = i;
+    }
+
+    for (size_t b = load->buckets + 1; b > 0; b--)
+        start[b] = start[b - 1];
+
+    start[0] = 0;
+
+    qsort(load->queue, load->queued, sizeof(struct bulkBucket),
+          bulkBucketCompare);
+}
+
+/** @brief Podpina poddrzewo kubełka pod korzeń drzewa.
+ * Tworzy brakujące wierzchołki nad poddrzewem i aktualizuje liczniki na
+ * ścieżce od korzenia.
+ * @param[in,out] root  –  Wskaźnik na korzeń drzewa;
+ * @param[in] sub       –  Wskaźnik na korzeń poddrzewa;
+ * @param[in] prefix    –  Wskaźnik na cyfry kubełka;
+ * @param[in] depth     –  Liczba cyfr kubełka.
+ * @return Wartość @p true, jeśli podpięto poddrzewo.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool bulkAttach(fwdNode root, fwdNode sub, const char* prefix,
+                       size_t depth) {
+    fwdNode node = root;
+    size_t fresh = 0;
+
+    for (size_t i = 0; i + 1 < depth; i++) {
+        size_t digit = (size_t)(prefix[i] - 48);
+
+        if (node->children[digit] == NULL) {
+            fwdNode child = nodeNew();
+
+            if (child == NULL) {
+                pathUpdate(root, prefix, i, fresh, 0, 0, 0);
+                return false;
+            }
+
+            node->children[digit] = child;
+            node->childCount++;
+            fresh++;
+        }
+
+        node = node->children[digit];
+    }
+
+    node->children[prefix[depth - 1] - 48] = sub;
+    node->childCount++;
+    pathUpdate(root, prefix, depth - 1, fresh, sub->subtreeForwards,
+               sub->subtreeBytes, sub->subtreeHash);
+
+    return true;
+}
+
+/** @brief Wczytuje przekierowania równolegle do pustego drzewa.
+ * Przekierowania dzielone są na kubełki według pierwszych cyfr, a wątki
+ * budują poddrzewa kubełków niezależnie, każdy w swojej arenie. Zbudowane
+ * poddrzewa podpinane są pod korzeń, a areny dołączane do listy aren
+ * struktury. Przekierowania prefiksów krótszych niż kubełek dodawane są
+ * na końcu, jak w @ref phfwdAdd.
+ * @param[in,out] pf    –  Wskaźnik na strukturę z pustym drzewem;
+ * @param[in] records   –  Wskaźnik na tablicę poprawnych przekierowań;
+ * @param[in] count     –  Liczba przekierowań;
+ * @param[in] threads   –  Liczba wątków, co najmniej 2.
+ * @return Wartość @p true, jeśli wczytano wszystkie przekierowania.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool bulkLoad(PhoneFwd pf, const struct PhoneForwardRecord* records,
+                     size_t count, size_t threads) {
+    // Kubełków jest kilka razy więcej niż wątków, żeby wyrównać ich pracę.
+    size_t depth = 1;
+
+    while (depth < BULK_MAX_DEPTH &&
+           fastPow(NUMBER_ALPHABET_SIZE, depth) < 4 * threads)
+        depth++;
+
+    struct bulkLoad load;
+    load.records = records;
+    load.depth = depth;
+    load.buckets = fastPow(NUMBER_ALPHABET_SIZE, depth);
+    load.order = malloc(count * sizeof(size_t));
+    load.bucketStart = calloc(load.buckets + 2, sizeof(size_t));
+    load.queue = malloc(load.buckets * sizeof(struct bulkBucket));
+    load.queued = 0;
+    load.roots = calloc(load.buckets, sizeof(fwdNode));
+    atomic_init(&load.next, 0);
+    atomic_init(&load.failed, false);
+
+    struct bulkWorker* workers = calloc(threads, sizeof(struct bulkWorker));
+    pthread_t* pool = malloc(threads * sizeof(pthread_t));
+    bool ok = load.order != NULL && load.bucketStart != NULL &&
+              load.queue != NULL && load.roots != NULL && workers != NULL &&
+              pool != NULL;
+
+    for (size_t i = 0; ok && i < threads; i++) {
+        workers[i].load = &load;
+        workers[i].arena = arenaNew(BULK_CHUNK_SIZE);
+        ok = workers[i].arena != NULL;
+    }
+
+    if (ok) {
+        bulkPartition(&load, count);
+
+        size_t started = 0;
+
+        // Bieżący wątek też buduje poddrzewa, więc uruchamiamy o jeden mniej.
+        while (started + 1 < threads &&
+               pthread_create(&pool[started], NULL, bulkWorkerRun,
+                              &workers[started]) == 0)
+            started++;
+
+        bulkWorkerRun(&workers[started]);
+
+        for (size_t i = 0; i < started; i++)
+            pthread_join(pool[i], NULL);
+
+        ok = !atomic_load(&load.failed);
+    }
+
+    // Po błędzie budowania drzewo jest niezmienione, więc usuwamy areny.
+    for (size_t i = 0; workers != NULL && i < threads; i++) {
+        if (ok)
+            pf->arena = arenaListConcat(workers[i].arena, pf->arena);
+        else
+            arenaDelete(workers[i].arena);
+    }
+
+    if (ok) {
+        char prefix[BULK_MAX_DEPTH];
+
+        for (size_t b = 0; ok && b < load.buckets; b++) {
+            if (load.roots[b] == NULL)
+                continue;
+
+            size_t rest = b;
+
+            for (size_t i = depth; i-- > 0;) {
+                prefix[i] = (char)('0' + rest % NUMBER_ALPHABET_SIZE);
+                rest /= NUMBER_ALPHABET_SIZE;
+            }
+
+            ok = bulkAttach(pf->root, load.roots[b], prefix, depth);
+
+            if (pf->compaction != NULL)
+                compactSync(pf, prefix, depth);
+        }
+
+        // Zmieniło się całe drzewo, więc odświeżamy wszystko, co od niego zależy.
+        resolveMemoDelete(pf->resolveMemo);
+        pf->resolveMemo = NULL;
+        jumpRefresh(pf, "", 0);
+
+        struct traceInfo trace = {0, 0};
+
+        for (size_t p = load.bucketStart[load.buckets];
+             ok && p < load.bucketStart[load.buckets + 1]; p++) {
+            const struct PhoneForwardRecord* record = &records[load.order[p]];
+
+            ok = addForward(pf, record->num, record->fwd, &trace);
+        }
+    }
+
+    free(load.order);
+    free(load.bucketStart);
+    free(load.queue);
+    free(load.roots);
+    free(workers);
+    free(pool);
+
+    return ok;
+}
+
+/** @brief Implementacja funkcji @ref phfwdAddAll.
+ * @param[in] pf       –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] records  –  Wskaźnik na tablicę przekierowań;
+ * @param[in] count    –  Liczba przekierowań;
+ * @param[in] threads  –  Maksymalna liczba wątków lub 0.
+ * @return Wartość @p true, jeśli dodano wszystkie przekierowania.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool addAll(PhoneFwd pf, const struct PhoneForwardRecord* records,
+                   size_t count, size_t threads) {
+    if (pf == NULL || (records == NULL && count > 0))
+        return false;
+
+    for (size_t i = 0; i < count; i++) {
+        if (!isValidNumber(records[i].num) || !isValidNumber(records[i].fwd) ||
+            strcmp(records[i].num, records[i].fwd) == 0)
+            return false;
+    }
+
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (size_t)online : 1;
+    }
+
+    // Równolegle budowane poddrzewa można podpiąć tylko pod puste drzewo.
+    if (threads > 1 && count >= BULK_MIN_RECORDS && pf->engine == NULL &&
+        pf->frozen == NULL && pf->root->childCount == 0)
+        return bulkLoad(pf, records, count, threads);
+
+    struct traceInfo trace = {0, 0};
+
+    for (size_t i = 0; i < count; i++)
+        if (!addForward(pf, records[i].num, records[i].fwd, &trace))
+            return false;
+
+    return true;
+}
+
+bool phfwdAddAll(PhoneFwd pf, const struct PhoneForwardRecord* records,
+                 size_t count, size_t threads) {
+    PHFWD_PROBE2(add_all__entry, count, threads);
+    bool res = addAll(pf, records, count, threads);
+    PHFWD_PROBE2(add_all__return, count, res);
+
+    return res;
+}
+
+/** @brief Usuwa przekierowania zakresów prefiksów zaczynających się od numeru.
+ * Puste drzewo zakresów jest usuwane, żeby nie spowalniało wyszukiwania.
+ * @param[in,out] pf    –  Wskaźnik na strukturę z niepustym drzewem zakresów;
+ * @param[in] num       –  Wskaźnik na poprawny numer;
+ * @param[in] keyLength –  Długość numeru.
+ */
+static void removeRanges(PhoneFwd pf, const char* num, size_t keyLength) {
+    rangeTreeRemove(pf->ranges, num, keyLength);
+
+    if (pf->ranges->child == NULL) {
+        rangeTreeDelete(pf->ranges);
+        pf->ranges = NULL;
+    }
+
+    resolveMemoInvalidate(pf, num, keyLength, true);
+}
+
+/** @brief Odłącza od drzewa poddrzewo reprezentujące prefiks.
+ * Razem z poddrzewem odłączana jest najdłuższa ścieżka nad nim, na której
+ * nie ma przekierowań ani rozgałęzień. Nic nie robi, jeśli w drzewie nie ma
+ * wierzchołka reprezentującego @p num.
+ * @param[in,out] pf     –  Wskaźnik na strukturę z drzewem wskaźnikowym;
+ * @param[in] num        –  Wskaźnik na poprawny numer;
+ * @param[in] keyLength  –  Długość numeru;
+ * @param[in,out] trace  –  Wskaźnik na liczniki dla punktów śledzenia.
+ */
+static void treeCut(PhoneFwd pf, const char* num, size_t keyLength,
+                    struct traceInfo* trace) {
+    fwdNode nextNode = pf->root;
+
+    /* Wierzchołek reprezentujący najdłuższy prefiks num, który musi zostać w
+     * drzewie, to jest najdłuższy taki, że jest prefiksem co najmniej jednego
+     * numeru w drzewie różnego od num. Wystarcza do tego liczba synów, więc
+     * nie przeglądamy rodzeństwa wierzchołków ścieżki. */
+    fwdNode lastToSave = pf->root;
+
+    /* Jeśli l to długość numeru reprezentowanego przez lastToSave, to
+     * lastToSaveNextIndex to l+1-wsza cyfra num. To jest, jeśli lastToSave
+     * ma zostać w drzewie, to należy usunąć poddrzewo
+     * lastToSave->children[num[lastToSaveNextIndex] - 48]. */
+    size_t lastToSaveNextIndex = 0;
+
+    for (size_t i = 0; i < keyLength; i++) {
+        // Jeśli NULL, to nie ma w drzewie wierzchołka reprezentującego num.
+        if (nextNode->children[num[i] - 48] == NULL)
+            return;
+
+        if (nextNode->childCount > 1 || nextNode->numForward != NULL) {
+            lastToSave = nextNode;
+            lastToSaveNextIndex = i;
+        }
+
+        nextNode = nextNode->children[num[i] - 48];
+        PHFWD_TRACE_COUNT(trace->visited, 1);
+    }
+
+    /* Poddrzewo tylko odłączamy; zwalniane jest porcjami przez phfwdMaintain,
+     * więc usunięcie dużego prefiksu nie blokuje kolejnych operacji. */
+    fwdNode cut = lastToSave->children[num[lastToSaveNextIndex] - 48];
+
+    pathUpdate(pf->root, num, lastToSaveNextIndex, 0,
+               (size_t)0 - cut->subtreeForwards,
+               (size_t)0 - cut->subtreeBytes,
+               (uint64_t)0 - cut->subtreeHash);
+    lastToSave->childCount--;
+    reclaimPush(pf, cut);
+    lastToSave->children[num[lastToSaveNextIndex] - 48] = NULL;
+    resolveMemoInvalidate(pf, num, keyLength, true);
+
+    if (pf->compaction != NULL)
+        compactSync(pf, num, lastToSaveNextIndex + 1);
+
+    // Usunięte poddrzewo zaczyna się na głębokości lastToSaveNextIndex + 1.
+    if (lastToSaveNextIndex < pf->jumpDepth)
+        jumpRefresh(pf, num, lastToSaveNextIndex + 1);
+}
+
+/** @brief Implementacja funkcji @ref phfwdRemove.
+ * @param[in] pf      –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num     –  Wskaźnik na napis reprezentujący prefiks numerów;
+ * @param[out] trace  –  Wskaźnik na liczniki dla punktów śledzenia.
+ */
+static void removeForwards(PhoneFwd pf, const char* num, struct traceInfo* trace) {
+    if(pf == NULL || !isValidNumber(num))
+        return;
+
+    size_t keyLength = strlen(num);
+    trace->keyLength = keyLength;
+
+    if (pf->ranges != NULL)
+        removeRanges(pf, num, keyLength);
+
+    if (pf->engine != NULL) {
+        pf->engine->remove(pf->engineData, num);
+        resolveMemoInvalidate(pf, num, keyLength, true);
+        return;
+    }
+
+    if (!thaw(pf))
+        return;
+
+    treeCut(pf, num, keyLength, trace);
+    maintainStep(pf, keyLength);
+}
+
+void phfwdRemove(PhoneFwd pf, const char* num) {
+    struct traceInfo trace = {0, 0};
+
+    PHFWD_PROBE1(remove__entry, num);
+    removeForwards(pf, num, &trace);
+    PHFWD_PROBE2(remove__return, trace.keyLength, trace.visited);
+}
+
+/** Dane funkcji @ref countCallback.
+ */
+struct countCtx {
+    const char* prefix;  ///< Wskaźnik na prefiks.
+    size_t length;       ///< Długość prefiksu.
+    size_t count;        ///< Liczba dotąd znalezionych przekierowań.
+};
+
+/** @brief Zlicza przekierowania prefiksów zaczynających się od prefiksu.
+ * @param[in,out] ctx   –  Wskaźnik na strukturę @ref countCtx;
+ * @param[in] num       –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] numLength –  Długość prefiksu przekierowywanego;
+ * @param[in] fwd       –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength –  Długość przekierowania.
+ * @return Wartość @p true.
+ */
+static bool countCallback(void* ctx, const char* num, size_t numLength,
+                          const char* fwd, size_t fwdLength) {
+    struct countCtx* count = ctx;
+
+    (void)fwd;
+    (void)fwdLength;
+
+    if (numLength >= count->length &&
+        memcmp(num, count->prefix, count->length) == 0)
+        count->count++;
+
+    return true;
+}
+
+/** @brief Implementacja funkcji @ref phfwdCount.
+ * @param[in] pf      –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] prefix  –  Wskaźnik na napis reprezentujący prefiks numerów;
+ * @param[out] trace  –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Liczba przekierowań prefiksów zaczynających się od @p prefix.
+ */
+static size_t countForwards(PhoneFwd pf, const char* prefix,
+                            struct traceInfo* trace) {
+    if (pf == NULL || !isValidNumber(prefix))
+        return 0;
+
+    size_t keyLength = strlen(prefix);
+    trace->keyLength = keyLength;
+
+    // Silnik nie przechowuje liczników, więc przeglądamy wszystkie przekierowania.
+    if (pf->engine != NULL) {
+        struct countCtx ctx = {prefix, keyLength, 0};
+
+        baseForEach(pf, countCallback, &ctx, NULL, &trace->visited);
+
+        return ctx.count;
+    }
+
+    if (pf->frozen != NULL) {
+        size_t idx = 0;
+
+        for (size_t i = 0; i < keyLength && idx != SIZE_MAX; i++) {
+            idx = frozenChild(pf->frozen, idx, (unsigned)(prefix[i] - 48));
+            PHFWD_TRACE_COUNT(trace->visited, 1);
+        }
+
+        return idx == SIZE_MAX ? 0 : pf->frozen->subtreeCount[idx];
+    }
+
+    fwdNode nextNode = pf->root;
+    size_t i = 0;
+
+    if (pf->jumpTable != NULL && keyLength >= pf->jumpDepth) {
+        nextNode = pf->jumpTable[jumpIndex(prefix, pf->jumpDepth)].node;
+        i = pf->jumpDepth;
+        PHFWD_TRACE_COUNT(trace->visited, 1);
+    }
+
+    for (; i < keyLength && nextNode != NULL; i++) {
+        nextNode = nextNode->children[prefix[i] - 48];
+        PHFWD_TRACE_COUNT(trace->visited, 1);
+    }
+
+    return nextNode == NULL ? 0 : nextNode->subtreeForwards;
+}
+
+size_t phfwdCount(PhoneFwd pf, const char* prefix) {
+    struct traceInfo trace = {0, 0};
+
+    PHFWD_PROBE1(count__entry, prefix);
+    size_t res = countForwards(pf, prefix, &trace);
+    PHFWD_PROBE3(count__return, trace.keyLength, trace.visited, res);
+
+    return res;
+}
+
+/** Element stosu równoczesnego przechodzenia dwóch drzew.
+ */
+struct diffFrame {
+    fwdNode from; ///< Wierzchołek pierwszego drzewa lub NULL.
+    fwdNode to;   ///< Wierzchołek drugiego drzewa reprezentujący ten sam prefiks lub NULL.
+};
+
+/** @brief Wyznacza różnice między dwoma drzewami wskaźnikowymi.
+ * Przechodzi oba drzewa równocześnie, w porządku leksykograficznym
+ * prefiksów. Pary poddrzew o tej samej liczbie przekierowań i tym samym
+ * skrócie są pomijane bez schodzenia w głąb, więc odwiedzane są tylko
+ * ścieżki do różniących się przekierowań.
+ * @param[in] from         –  Wskaźnik na korzeń pierwszego drzewa;
+ * @param[in] to           –  Wskaźnik na korzeń drugiego drzewa;
+ * @param[in] callback     –  Funkcja wywoływana dla kolejnych różnic;
+ * @param[in,out] ctx      –  Dane przekazywane funkcji @p callback;
+ * @param[in,out] visited  –  Wskaźnik na licznik odwiedzonych wierzchołków.
+ * @return Wartość @p true, jeśli przekazano wszystkie różnice lub funkcja
+ *         @p callback przerwała przekazywanie.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool treeDiff(fwdNode from, fwdNode to, PhoneDiffCallback callback,
+                     void* ctx, size_t* visited) {
+    size_t capacity = 64;
+    size_t top = 0;
+    struct diffFrame* stack = malloc(capacity * sizeof(struct diffFrame));
+
+    if (stack == NULL)
+        return false;
+
+    stack[top].from = from;
+    stack[top++].to = to;
+
+    bool proceed = true;
+    bool ok = true;
+
+    while (proceed && ok && top > 0) {
+        struct diffFrame frame = stack[--top];
+        fwdNode a = frame.from;
+        fwdNode b = frame.to;
+
+        PHFWD_TRACE_COUNT(*visited, 1);
+
+        if (a != NULL && b != NULL && a->subtreeForwards == b->subtreeForwards &&
+            a->subtreeHash == b->subtreeHash)
+            continue;
+
+        const char* oldFwd = a != NULL ? a->numForward : NULL;
+        const char* newFwd = b != NULL ? b->numForward : NULL;
+
+        if (oldFwd != NULL && newFwd == NULL)
+            proceed = callback(ctx, PHFWD_DIFF_REMOVED, a->num, oldFwd, NULL);
+
+        else if (oldFwd == NULL && newFwd != NULL)
+            proceed = callback(ctx, PHFWD_DIFF_ADDED, b->num, NULL, newFwd);
+
+        else if (oldFwd != NULL && strcmp(oldFwd, newFwd) != 0)
+            proceed = callback(ctx, PHFWD_DIFF_CHANGED, a->num, oldFwd, newFwd);
+
+        // Synów odkładamy od ostatniego, żeby zdejmować je w kolejności cyfr.
+        for (size_t i = NUMBER_ALPHABET_SIZE; proceed && ok && i-- > 0;) {
+            fwdNode childA = a != NULL ? a->children[i] : NULL;
+            fwdNode childB = b != NULL ? b->children[i] : NULL;
+
+            // Poddrzewa bez przekierowań nie wnoszą różnic.
+            if ((childA == NULL || childA->subtreeForwards == 0) &&
+                (childB == NULL || childB->subtreeForwards == 0))
+                continue;
+
+            if (top == capacity) {
+                struct diffFrame* bigger = realloc(stack, 2 * capacity *
+                                                   sizeof(struct diffFrame));
+
+                if (bigger == NULL) {
+                    ok = false;
+                    break;
+                }
+
+                stack = bigger;
+                capacity *= 2;
+            }
+
+            stack[top].from = childA;
+            stack[top++].to = childB;
+        }
+    }
+
+    free(stack);
+
+    return ok;
+}
+
+/** Przekierowanie skopiowane przy wyznaczaniu różnic bez drzew.
+ */
+struct diffEntry {
+    char* num; /**< Prefiks przekierowywany; przekierowanie leży w tym samym
+                    bloku, za znakiem '\0'. */
+    char* fwd; ///< Przekierowanie.
+};
+
+/** Stan wyznaczania różnic między strukturami bez drzew wskaźnikowych.
+ */
+struct diffStream {
+    struct diffEntry* old;       ///< Przekierowania pierwszej struktury.
+    size_t count;                ///< Liczba przekierowań w @p old.
+    size_t capacity;             ///< Rozmiar tablicy @p old.
+    size_t next;                 ///< Indeks pierwszego nieporównanego w @p old.
+    PhoneDiffCallback callback;  ///< Funkcja wywoływana dla różnic.
+    void* ctx;                   ///< Dane przekazywane funkcji @p callback.
+    bool stopped;                ///< Czy @p callback przerwała przekazywanie.
+    bool failed;                 ///< Czy nie udało się zaalokować pamięci.
+};
+
+/** @brief Kopiuje przekierowanie do jednego bloku pamięci.
+ * @param[out] entry     –  Wskaźnik na wypełniane przekierowanie;
+ * @param[in] num        –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] numLength  –  Długość prefiksu przekierowywanego;
+ * @param[in] fwd        –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength  –  Długość przekierowania.
+ * @return Wartość @p true, jeśli skopiowano przekierowanie.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool diffEntryNew(struct diffEntry* entry, const char* num,
+                         size_t numLength, const char* fwd, size_t fwdLength) {
+    entry->num = malloc(numLength + fwdLength + 2);
+
+    if (entry->num == NULL)
+        return false;
+
+    memcpy(entry->num, num, numLength);
+    entry->num[numLength] = '\0';
+    entry->fwd = entry->num + numLength + 1;
+    memcpy(entry->fwd, fwd, fwdLength);
+    entry->fwd[fwdLength] = '\0';
+
+    return true;
+}
+
+/** @brief Zapamiętuje przekierowanie pierwszej struktury.
+ * Funkcja typu @ref forwardCallback.
+ * @param[in,out] ctx   –  Wskaźnik na strukturę @ref diffStream;
+ * @param[in] num       –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] numLength –  Długość prefiksu przekierowywanego;
+ * @param[in] fwd       –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength –  Długość przekierowania.
+ * @return Wartość @p true, jeśli zapamiętano przekierowanie.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool diffCollect(void* ctx, const char* num, size_t numLength,
+                        const char* fwd, size_t fwdLength) {
+    struct diffStream* ds = ctx;
+
+    if (ds->count == ds->capacity) {
+        size_t capacity = ds->capacity == 0 ? 64 : 2 * ds->capacity;
+        struct diffEntry* bigger = realloc(ds->old, capacity *
+                                           sizeof(struct diffEntry));
+
+        if (bigger == NULL) {
+            ds->failed = true;
+            return false;
+        }
+
+        ds->old = bigger;
+        ds->capacity = capacity;
+    }
+
+    if (!diffEntryNew(&ds->old[ds->count], num, numLength, fwd, fwdLength)) {
+        ds->failed = true;
+        return false;
+    }
+
+    ds->count++;
+
+    return true;
+}
+
+/** @brief Porównuje przekierowanie drugiej struktury z zapamiętanymi.
+ * Przekierowania obu struktur przychodzą w porządku leksykograficznym
+ * prefiksów, więc zapamiętane przekierowania mniejszych prefiksów zostały
+ * usunięte. Funkcja typu @ref forwardCallback.
+ * @param[in,out] ctx   –  Wskaźnik na strukturę @ref diffStream;
+ * @param[in] num       –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] numLength –  Długość prefiksu przekierowywanego;
+ * @param[in] fwd       –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength –  Długość przekierowania.
+ * @return Wartość @p true, jeśli należy kontynuować przeglądanie.
+ *         Wartość @p false, jeśli należy je przerwać.
+ */
+static bool diffCompare(void* ctx, const char* num, size_t numLength,
+                        const char* fwd, size_t fwdLength) {
+    struct diffStream* ds = ctx;
+    struct diffEntry entry;
+
+    if (!diffEntryNew(&entry, num, numLength, fwd, fwdLength)) {
+        ds->failed = true;
+        return false;
+    }
+
+    while (!ds->stopped && ds->next < ds->count &&
+           strcmp(ds->old[ds->next].num, entry.num) < 0) {
+        struct diffEntry* old = &ds->old[ds->next++];
+
+        ds->stopped = !ds->callback(ds->ctx, PHFWD_DIFF_REMOVED, old->num,
+                                    old->fwd, NULL);
+    }
+
+    if (!ds->stopped && ds->next < ds->count &&
+        strcmp(ds->old[ds->next].num, entry.num) == 0) {
+        struct diffEntry* old = &ds->old[ds->next++];
+
+        if (strcmp(old->fwd, entry.fwd) != 0)
+            ds->stopped = !ds->callback(ds->ctx, PHFWD_DIFF_CHANGED, entry.num,
+                                        old->fwd, entry.fwd);
+    }
+
+    else if (!ds->stopped)
+        ds->stopped = !ds->callback(ds->ctx, PHFWD_DIFF_ADDED, entry.num,
+                                    NULL, entry.fwd);
+
+    free(entry.num);
+
+    return !ds->stopped;
+}
+
+/** @brief Wyznacza różnice między strukturami bez drzew wskaźnikowych.
+ * Zapamiętuje wszystkie przekierowania pierwszej struktury i porównuje z
+ * nimi przekierowania drugiej, więc działa w czasie proporcjonalnym do
+ * rozmiaru obu struktur.
+ * @param[in] from      –  Wskaźnik na pierwszą strukturę;
+ * @param[in] to        –  Wskaźnik na drugą strukturę;
+ * @param[in] callback  –  Funkcja wywoływana dla kolejnych różnic;
+ * @param[in,out] ctx   –  Dane przekazywane funkcji @p callback;
+ * @param[in,out] trace –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wartość @p true, jeśli przekazano wszystkie różnice lub funkcja
+ *         @p callback przerwała przekazywanie.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool streamDiff(PhoneFwd from, PhoneFwd to, PhoneDiffCallback callback,
+                       void* ctx, struct traceInfo* trace) {
+    struct diffStream ds = {NULL, 0, 0, 0, callback, ctx, false, false};
+
+    baseForEach(from, diffCollect, &ds, NULL, &trace->visited);
+
+    if (!ds.failed)
+        baseForEach(to, diffCompare, &ds, NULL, &trace->visited);
+
+    while (!ds.failed && !ds.stopped && ds.next < ds.count) {
+        struct diffEntry* old = &ds.old[ds.next++];
+
+        ds.stopped = !callback(ctx, PHFWD_DIFF_REMOVED, old->num, old->fwd,
+                               NULL);
+    }
+
+    for (size_t i = 0; i < ds.count; i++)
+        free(ds.old[i].num);
+
+    free(ds.old);
+
+    return !ds.failed;
+}
+
+/** @brief Implementacja funkcji @ref phfwdDiff.
+ * @param[in] from      –  Wskaźnik na pierwszą strukturę;
+ * @param[in] to        –  Wskaźnik na drugą strukturę;
+ * @param[in] callback  –  Funkcja wywoływana dla kolejnych różnic;
+ * @param[in,out] ctx   –  Dane przekazywane funkcji @p callback;
+ * @param[out] trace    –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wartość @p true, jeśli przekazano wszystkie różnice lub funkcja
+ *         @p callback przerwała przekazywanie.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool diffForwards(PhoneFwd from, PhoneFwd to, PhoneDiffCallback callback,
+                         void* ctx, struct traceInfo* trace) {
+    if (from == NULL || to == NULL || callback == NULL)
+        return false;
+
+    if (from == to)
+        return true;
+
+    // Drzewo wskaźnikowe jest tylko w niezamrożonej strukturze bez silnika.
+    if (from->root != NULL && to->root != NULL)
+        return treeDiff(from->root, to->root, callback, ctx, &trace->visited);
+
+    return streamDiff(from, to, callback, ctx, trace);
+}
+
+bool phfwdDiff(PhoneFwd from, PhoneFwd to, PhoneDiffCallback callback,
+               void* ctx) {
+    struct traceInfo trace = {0, 0};
+
+    PHFWD_PROBE2(diff__entry, from, to);
+    bool res = diffForwards(from, to, callback, ctx, &trace);
+    PHFWD_PROBE2(diff__return, trace.visited, res);
+
+    return res;
+}
+
+/** @brief Usuwa przekierowanie dokładnie jednego prefiksu z drzewa.
+ * W przeciwieństwie do @ref phfwdRemove nie usuwa przekierowań dłuższych
+ * prefiksów. Wierzchołek z synami zostaje w drzewie, a liść jest odłączany
+ * razem ze ścieżką, która prowadzi tylko do niego.
+ * @param[in,out] pf     –  Wskaźnik na strukturę z drzewem wskaźnikowym;
+ * @param[in] num        –  Wskaźnik na poprawny numer;
+ * @param[in,out] trace  –  Wskaźnik na liczniki dla punktów śledzenia.
+ */
+static void treeRemoveOne(PhoneFwd pf, const char* num,
+                          struct traceInfo* trace) {
+    size_t keyLength = strlen(num);
+    fwdNode node = pf->root;
+
+    for (size_t i = 0; i < keyLength && node != NULL; i++) {
+        node = node->children[num[i] - 48];
+        PHFWD_TRACE_COUNT(trace->visited, 1);
+    }
+
+    if (node == NULL || node->numForward == NULL)
+        return;
+
+    if (node->childCount == 0) {
+        treeCut(pf, num, keyLength, trace);
+        maintainStep(pf, keyLength);
+        return;
+    }
+
+    size_t oldBytes = nodeBytes(node);
+    uint64_t oldHash = nodeHash(node);
+
+    if ((node->flags & NUM_IN_ARENA) == 0)
+        free(node->num);
+
+    if ((node->flags & FWD_IN_ARENA) == 0)
+        free(node->numForward);
+
+    node->num = node->numForward = NULL;
+    node->flags &= ~(NUM_IN_ARENA | FWD_IN_ARENA);
+
+    pathUpdate(pf->root, num, keyLength, 0, (size_t)0 - 1,
+               nodeBytes(node) - oldBytes, (uint64_t)0 - oldHash);
+    resolveMemoInvalidate(pf, num, keyLength, true);
+
+    if (pf->compaction != NULL)
+        compactSync(pf, num, keyLength);
+
+    if (keyLength <= pf->jumpDepth)
+        jumpRefresh(pf, num, keyLength);
+
+    maintainStep(pf, keyLength);
+}
+
+/** Zmiany zbierane przez @ref mergeCollect.
+ */
+struct mergeChanges {
+    struct diffEntry* changes; /**< Zmiany; przekierowanie ma wartość NULL,
+                                    jeśli należy je usunąć. */
+    size_t count;              ///< Liczba zmian.
+    size_t capacity;           ///< Rozmiar tablicy @p changes.
+    bool failed;               ///< Czy nie udało się zaalokować pamięci.
+};
+
+/** @brief Zapamiętuje zmianę do wprowadzenia.
+ * Funkcja typu @ref PhoneDiffCallback.
+ * @param[in,out] ctx  –  Wskaźnik na strukturę @ref mergeChanges;
+ * @param[in] kind     –  Rodzaj różnicy;
+ * @param[in] num      –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] oldFwd   –  Wskaźnik na poprzednie przekierowanie lub NULL;
+ * @param[in] newFwd   –  Wskaźnik na nowe przekierowanie lub NULL.
+ * @return Wartość @p true, jeśli zapamiętano zmianę.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool mergeCollect(void* ctx, enum PhoneDiffKind kind, const char* num,
+                         const char* oldFwd, const char* newFwd) {
+    struct mergeChanges* mc = ctx;
+
+    (void)oldFwd;
+
+    if (mc->count == mc->capacity) {
+        size_t capacity = mc->capacity == 0 ? 64 : 2 * mc->capacity;
+        struct diffEntry* bigger = realloc(mc->changes, capacity *
+                                           sizeof(struct diffEntry));
+
+        if (bigger == NULL) {
+            mc->failed = true;
+            return false;
+        }
+
+        mc->changes = bigger;
+        mc->capacity = capacity;
+    }
+
+    const char* fwd = kind == PHFWD_DIFF_REMOVED ? "" : newFwd;
+    struct diffEntry* change = &mc->changes[mc->count];
+
+    if (!diffEntryNew(change, num, strlen(num), fwd, strlen(fwd))) {
+        mc->failed = true;
+        return false;
+    }
+
+    if (kind == PHFWD_DIFF_REMOVED)
+        change->fwd = NULL;
+
+    mc->count++;
+
+    return true;
+}
+
+/** @brief Implementacja funkcji @ref phfwdMerge.
+ * Różnice zbierane są przed wprowadzeniem, bo zmiany drzewa w trakcie
+ * przechodzenia zmieniałyby porównywane skróty.
+ * @param[in,out] dst  –  Wskaźnik na strukturę zmienianą;
+ * @param[in] src      –  Wskaźnik na strukturę wzorcową;
+ * @param[out] trace   –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wartość @p true, jeśli wprowadzono wszystkie zmiany.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool mergeForwards(PhoneFwd dst, PhoneFwd src, struct traceInfo* trace) {
+    if (dst == NULL || src == NULL || dst->engine != NULL)
+        return false;
+
+    struct mergeChanges mc = {NULL, 0, 0, false};
+    bool ok = diffForwards(dst, src, mergeCollect, &mc, trace) && !mc.failed;
+
+    if (ok && mc.count > 0)
+        ok = thaw(dst);
+
+    for (size_t i = 0; ok && i < mc.count; i++) {
+        struct diffEntry* change = &mc.changes[i];
+
+        if (change->fwd != NULL)
+            ok = addForward(dst, change->num, change->fwd, trace);
+        else
+            treeRemoveOne(dst, change->num, trace);
+    }
+
+    for (size_t i = 0; i < mc.count; i++)
+        free(mc.changes[i].num);
+
+    free(mc.changes);
+    trace->keyLength = mc.count;
+
+    return ok;
+}
+
+bool phfwdMerge(PhoneFwd dst, PhoneFwd src) {
+    struct traceInfo trace = {0, 0};
+
+    PHFWD_PROBE2(merge__entry, dst, src);
+    bool res = mergeForwards(dst, src, &trace);
+    PHFWD_PROBE3(merge__return, trace.keyLength, trace.visited, res);
+
+    return res;
+}
+
+PhoneNum* phnumNew(size_t len) {
+    PhoneNum* newPhNum = malloc(sizeof(struct PhoneNumbers));
+
+    if (newPhNum != NULL) {
+        newPhNum->length = len;
+        newPhNum->pool = NULL;
+
+        if (len > 0) {
+            newPhNum->phNums = calloc(len, sizeof(char *));
+
+            if (newPhNum->phNums == NULL) {
+                free(newPhNum);
+                return NULL;
+            }
+        }
+
+        else
+            newPhNum->phNums = NULL;
+    }
+
+    return newPhNum;
+}
+
+PhoneNum* phnumNewFlat(size_t len, size_t bytes) {
+    PhoneNum* newPhNum = malloc(sizeof(struct PhoneNumbers) +
+                                len * sizeof(char*) + bytes);
+
+    if (newPhNum != NULL) {
+        newPhNum->length = len;
+        newPhNum->phNums = (char**)(newPhNum + 1);
+        newPhNum->pool = (char*)(newPhNum->phNums + len);
+
+        for (size_t i = 0; i < len; i++)
+            newPhNum->phNums[i] = NULL;
+    }
+
+    return newPhNum;
+}
+
+/** @brief Przekierowanie znalezione przez @ref lookupForward.
+ * Przekierowania zamrożonej reprezentacji są upakowane.
+ */
+struct forwardRef {
+    const char* str;             ///< Przekierowanie lub NULL, jeśli jest upakowane.
+    const unsigned char* packed; ///< Upakowane przekierowanie, jeśli @p str to NULL.
+    size_t length;               ///< Długość przekierowania.
+};
+
+/** Kopiuje przekierowanie, rozpakowując je w razie potrzeby.
+ * Nie dopisuje znaku '\0'.
+ * @param[out] dst  –  Wskaźnik na bufor o rozmiarze co najmniej @p fwd->length;
+ * @param[in] fwd   –  Wskaźnik na przekierowanie.
+ */
+static inline void forwardCopy(char* dst, const struct forwardRef* fwd) {
+    if (fwd->str != NULL)
+        memcpy(dst, fwd->str, fwd->length);
+    else
+        unpackDigits(dst, fwd->packed, fwd->length);
+}
+
+/** @brief Wyszukuje przekierowanie w zamrożonej reprezentacji.
+ * @param[in] fz            –  Wskaźnik na zamrożoną reprezentację;
+ * @param[in] num           –  Wskaźnik na poprawny napis reprezentujący numer;
+ * @param[in] keyLength     –  Długość numeru;
+ * @param[out] matchLength  –  Wskaźnik na długość dopasowanego prefiksu;
+ * @param[out] fwd          –  Wskaźnik na upakowane przekierowanie;
+ * @param[out] trace        –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wartość @p true, jeśli któryś prefiks numeru ma przekierowanie.
+ *         Wartość @p false w przeciwnym wypadku; wtedy wyniki nie są
+ *         zapisywane.
+ */
+static bool frozenLookup(const struct phfwdFrozen* fz, const char* num,
+                         size_t keyLength, size_t* matchLength,
+                         struct forwardRef* fwd, struct traceInfo* trace) {
+    size_t best = SIZE_MAX;
+    size_t bestLength = 0;
+    size_t idx = 0;
+
+    for (size_t i = 0; i < keyLength; i++) {
+        idx = frozenChild(fz, idx, (unsigned)(num[i] - 48));
+
+        if (idx == SIZE_MAX)
+            break;
+
+        PHFWD_TRACE_COUNT(trace->visited, 1);
+        size_t forward = frozenForward(fz, idx);
+
+        if (forward != SIZE_MAX) {
+            best = forward;
+            bestLength = i + 1;
+        }
+    }
+
+    if (best == SIZE_MAX)
+        return false;
+
+    *matchLength = bestLength;
+    fwd->str = NULL;
+    fwd->packed = frozenTarget(fz, best, &fwd->length);
+
+    return true;
+}
+
+/** @brief Wyszukuje przekierowanie najdłuższego prefiksu numeru poza
+ * przekierowaniami zakresów.
+ * Nie alokuje pamięci. Korzysta z tablicy skoków, jeśli jest włączona, lub
+ * z zamrożonej reprezentacji, jeśli struktura jest zamrożona.
+ * @param[in] pf            –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] num           –  Wskaźnik na poprawny napis reprezentujący numer;
+ * @param[in] keyLength     –  Długość numeru;
+ * @param[out] matchLength  –  Wskaźnik na długość dopasowanego prefiksu;
+ * @param[out] fwd          –  Wskaźnik na jego przekierowanie;
+ * @param[out] trace        –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wartość @p true, jeśli któryś prefiks numeru ma przekierowanie.
+ *         Wartość @p false w przeciwnym wypadku; wtedy wyniki nie są
+ *         zapisywane.
+ */
+static bool baseLookup(PhoneFwd pf, const char* num, size_t keyLength,
+                       size_t* matchLength, struct forwardRef* fwd,
+                       struct traceInfo* trace) {
+    if (pf->engine != NULL) {
+        const char* str;
+        size_t length;
+
+        if (!pf->engine->lookup(pf->engineData, num, keyLength, matchLength,
+                                &str, &length))
+            return false;
+
+        fwd->str = str;
+        fwd->packed = NULL;
+        fwd->length = length;
+
+        return true;
+    }
+
+    if (pf->frozen != NULL)
+        return frozenLookup(pf->frozen, num, keyLength, matchLength, fwd,
+                            trace);
+
+    // Wierzchołek z przekierowaniem najdłuższego prefiksu num.
+    fwdNode best = NULL;
+    fwdNode nextNode = pf->root;
+    size_t i = 0;
+
+    /* Jeśli numer jest dostatecznie długi, pomijamy górne poziomy drzewa,
+     * korzystając z tablicy skoków. */
+    if (pf->jumpTable != NULL && keyLength >= pf->jumpDepth) {
+        struct phfwdJumpEntry* entry = &pf->jumpTable[jumpIndex(num, pf->jumpDepth)];
+
+        nextNode = entry->node;
+        best = entry->best;
+        i = pf->jumpDepth;
+        PHFWD_TRACE_COUNT(trace->visited, 1);
+    }
+
+    for (; i < keyLength && nextNode != NULL; i++) {
+        nextNode = nextNode->children[num[i] - 48];
+
+        if (nextNode == NULL)
+            break;
+
+        PHFWD_TRACE_COUNT(trace->visited, 1);
+
+        if (nextNode->numForward != NULL)
+            best = nextNode;
+    }
+
+    if (best == NULL)
+        return false;
+
+    *matchLength = best->numLength;
+    fwd->str = best->numForward;
+    fwd->packed = NULL;
+    fwd->length = best->numForwardLength;
+
+    return true;
+}
+
+/** @brief Sprawdza, czy prefiks ma zwykłe przekierowanie.
+ * @param[in] pf           –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] num          –  Wskaźnik na poprawny numer (bez znaku '\0');
+ * @param[in] keyLength    –  Długość numeru;
+ * @param[in,out] visited  –  Wskaźnik na licznik odwiedzonych wierzchołków.
+ * @return Wartość @p true, jeśli dokładnie ten prefiks ma przekierowanie
+ *         poza przekierowaniami zakresów.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool baseHasKey(PhoneFwd pf, const char* num, size_t keyLength,
+                       size_t* visited) {
+    struct traceInfo trace = {0, 0};
+    struct forwardRef fwd;
+    size_t matchLength;
+    bool found = baseLookup(pf, num, keyLength, &matchLength, &fwd, &trace);
+
+    PHFWD_TRACE_COUNT(*visited, trace.visited);
+
+    return found && matchLength == keyLength;
+}
+
+/** @brief Wyszukuje przekierowanie najdłuższego prefiksu numeru.
+ * Nie alokuje pamięci. Porównuje wynik @ref baseLookup z przekierowaniem
+ * zakresu; przy równych długościach prefiksów pierwszeństwo ma zwykłe
+ * przekierowanie.
+ * @param[in] pf            –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] num           –  Wskaźnik na poprawny napis reprezentujący numer;
+ * @param[in] keyLength     –  Długość numeru;
+ * @param[out] matchLength  –  Wskaźnik na długość dopasowanego prefiksu;
+ * @param[out] fwd          –  Wskaźnik na jego przekierowanie;
+ * @param[out] trace        –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wartość @p true, jeśli któryś prefiks numeru ma przekierowanie.
+ *         Wartość @p false w przeciwnym wypadku; wtedy wyniki nie są
+ *         zapisywane.
+ */
+static bool lookupForward(PhoneFwd pf, const char* num, size_t keyLength,
+                          size_t* matchLength, struct forwardRef* fwd,
+                          struct traceInfo* trace) {
+    bool found = baseLookup(pf, num, keyLength, matchLength, fwd, trace);
+    size_t rangeLength;
+    const char* str;
+    size_t length;
+
+    if (pf->ranges != NULL &&
+        rangeTreeLookup(pf->ranges, num, keyLength, &rangeLength, &str,
+                        &length, &trace->visited) &&
+        (!found || rangeLength > *matchLength)) {
+        *matchLength = rangeLength;
+        fwd->str = str;
+        fwd->packed = NULL;
+        fwd->length = length;
+        found = true;
+    }
+
+    return found;
+}
+
+/** @brief Implementacja funkcji @ref phfwdGet.
+ * @param[in] pf      –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num     –  Wskaźnik na napis reprezentujący numer;
+ * @param[out] trace  –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+ *         udało się zaalokować pamięci.
+ */
+static const PhoneNum* getForward(PhoneFwd pf, const char* num,
+                                  struct traceInfo* trace) {
+    if (pf == NULL)
+        return NULL;
+
+    if (!isValidNumber(num))
+        return phnumNew(0);
+
+    size_t keyLength = strlen(num);
+    trace->keyLength = keyLength;
+
+    /* Jeśli żaden prefiks nie ma przekierowania, wynikiem jest sam numer,
+     * czyli pusty prefiks zamieniony na pusty prefiks. */
+    size_t matchLength = 0;
+    struct forwardRef fwd = {num, NULL, 0};
+
+    lookupForward(pf, num, keyLength, &matchLength, &fwd, trace);
+
+    PhoneNum* numFwd = phnumNewFlat(1, fwd.length + keyLength - matchLength + 1);
+
+    if (numFwd == NULL)
+        return NULL;
+
+    numFwd->phNums[0] = numFwd->pool;
+    forwardCopy(numFwd->phNums[0], &fwd);
+    strcpy(numFwd->phNums[0] + fwd.length, num + matchLength);
+
+    return numFwd;
+}
+
+const PhoneNum* phfwdGet(PhoneFwd pf, const char* num) {
+    struct traceInfo trace = {0, 0};
+
+    PHFWD_PROBE1(get__entry, num);
+    const PhoneNum* res = getForward(pf, num, &trace);
+    PHFWD_PROBE3(get__return, trace.keyLength, trace.visited,
+                 res != NULL ? res->length : 0);
+
+    return res;
+}
+
+/** @brief Zapewnia bufor co najmniej danego rozmiaru.
+ * @param[in,out] buf       –  Wskaźnik na wskaźnik na bufor;
+ * @param[in,out] capacity  –  Wskaźnik na rozmiar bufora;
+ * @param[in] needed        –  Wymagany rozmiar.
+ * @return Wartość @p true, jeśli bufor ma wymagany rozmiar.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool bufferReserve(char** buf, size_t* capacity, size_t needed) {
+    if (needed <= *capacity)
+        return true;
+
+    size_t bigger = *capacity == 0 ? 32 : *capacity;
+
+    while (bigger < needed)
+        bigger *= 2;
+
+    char* newBuf = realloc(*buf, bigger);
+
+    if (newBuf == NULL)
+        return false;
+
+    *buf = newBuf;
+    *capacity = bigger;
+
+    return true;
+}
+
+/** @brief Implementacja funkcji @ref phfwdGetEach.
+ * @param[in] pf        –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] nums      –  Wskaźnik na tablicę wskaźników na napisy;
+ * @param[in] count     –  Liczba napisów;
+ * @param[in] callback  –  Funkcja wywoływana dla kolejnych wyników;
+ * @param[in,out] ctx   –  Dane przekazywane funkcji @p callback;
+ * @param[out] trace    –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wartość @p true, jeśli przekazano wszystkie wyniki.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool getEach(PhoneFwd pf, const char* const* nums, size_t count,
+                    PhoneNumCallback callback, void* ctx,
+                    struct traceInfo* trace) {
+    if (pf == NULL || (nums == NULL && count > 0))
+        return false;
+
+    // Wszystkie wyniki składane są w jednym buforze, powiększanym w razie potrzeby.
+    char* buf = NULL;
+    size_t capacity = 0;
+    bool ok = true;
+
+    for (size_t q = 0; q < count && ok; q++) {
+        const char* num = nums[q];
+
+        if (!isValidNumber(num)) {
+            ok = callback(ctx, "");
+            continue;
+        }
+
+        size_t keyLength = strlen(num);
+        size_t matchLength = 0;
+        struct forwardRef fwd = {num, NULL, 0};
+
+        trace->keyLength += keyLength;
+        lookupForward(pf, num, keyLength, &matchLength, &fwd, trace);
+
+        ok = bufferReserve(&buf, &capacity,
+                           fwd.length + keyLength - matchLength + 1);
+
+        if (ok) {
+            forwardCopy(buf, &fwd);
+            memcpy(buf + fwd.length, num + matchLength,
+                   keyLength - matchLength + 1);
+            ok = callback(ctx, buf);
+        }
+    }
+
+    free(buf);
+
+    return ok;
+}
+
+bool phfwdGetEach(PhoneFwd pf, const char* const* nums, size_t count,
+                  PhoneNumCallback callback, void* ctx) {
+    struct traceInfo trace = {0, 0};
+
+    PHFWD_PROBE1(get_each__entry, count);
+    bool res = getEach(pf, nums, count, callback, ctx, &trace);
+    PHFWD_PROBE3(get_each__return, trace.keyLength, trace.visited, res);
+
+    return res;
+}
+
+/** Łańcuch przekierowań budowany w trakcie wyznaczania.
+ */
+struct resolveChain {
+    char* chain;          ///< Kolejne numery zakończone znakami '\0'.
+    size_t used;          ///< Liczba zajętych bajtów @p chain.
+    size_t capacity;      ///< Rozmiar @p chain.
+    size_t matchLength[RESOLVE_MEMO_HOPS + 1]; ///< Długości dopasowanych prefiksów.
+    size_t count;         ///< Liczba numerów łańcucha.
+    bool valid;           /**< Czy łańcuch nadaje się do zapamiętania, tzn.
+                               jest dość krótki i zmieścił się w pamięci. */
+};
+
+/** @brief Dopisuje numer do łańcucha przekierowań.
+ * Po przekroczeniu @ref RESOLVE_MEMO_HOPS przekierowań łańcuch przestaje
+ * być zapisywany.
+ * @param[in,out] rc        –  Wskaźnik na łańcuch;
+ * @param[in] num           –  Wskaźnik na napis reprezentujący numer;
+ * @param[in] numLength     –  Długość numeru;
+ * @param[in] matchLength   –  Długość dopasowanego prefiksu numeru.
+ */
+static void resolveChainAdd(struct resolveChain* rc, const char* num,
+                            size_t numLength, size_t matchLength) {
+    if (!rc->valid || rc->count > RESOLVE_MEMO_HOPS ||
+        !bufferReserve(&rc->chain, &rc->capacity, rc->used + numLength + 1)) {
+        rc->valid = false;
+        return;
+    }
+
+    memcpy(rc->chain + rc->used, num, numLength + 1);
+    rc->used += numLength + 1;
+    rc->matchLength[rc->count++] = matchLength;
+}
+
+/** @brief Zapamiętuje łańcuch przekierowań.
+ * Przejmuje bufor łańcucha. Jeśli nie uda się zaalokować pamięci, łańcuch
+ * nie jest zapamiętywany.
+ * @param[in,out] pf     –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in,out] rc     –  Wskaźnik na łańcuch;
+ * @param[in] maxHops    –  Limit przekierowań;
+ * @param[in] status     –  Wynik wyznaczania łańcucha.
+ */
+static void resolveMemoStore(PhoneFwd pf, struct resolveChain* rc,
+                             size_t maxHops, enum PhoneResolveStatus status) {
+    if (pf->resolveMemo == NULL)
+        pf->resolveMemo = calloc(1, sizeof(struct phfwdResolveMemo));
+
+    size_t* matchLength = malloc(rc->count * sizeof(size_t));
+
+    if (!rc->valid || pf->resolveMemo == NULL || matchLength == NULL) {
+        free(matchLength);
+        return;
+    }
+
+    struct resolveEntry* entry = &pf->resolveMemo->entries[resolveHash(rc->chain)];
+
+    resolveEntryClear(entry);
+    memcpy(matchLength, rc->matchLength, rc->count * sizeof(size_t));
+    entry->chain = rc->chain;
+    entry->matchLength = matchLength;
+    entry->count = rc->count;
+    entry->maxHops = maxHops;
+    entry->status = status;
+    rc->chain = NULL;
+}
+
+/** @brief Szuka zapamiętanego łańcucha przekierowań numeru.
+ * @param[in] pf       –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in] num      –  Wskaźnik na napis reprezentujący numer;
+ * @param[in] maxHops  –  Limit przekierowań.
+ * @return Wskaźnik na komórkę z łańcuchem, którego wynik nie zależy od
+ *         różnicy limitów, lub NULL, jeśli takiej nie ma.
+ */
+static struct resolveEntry* resolveMemoFind(PhoneFwd pf, const char* num,
+                                            size_t maxHops) {
+    if (pf->resolveMemo == NULL)
+        return NULL;
+
+    struct resolveEntry* entry = &pf->resolveMemo->entries[resolveHash(num)];
+
+    if (entry->chain == NULL || strcmp(entry->chain, num) != 0)
+        return NULL;
+
+    if (entry->maxHops == maxHops ||
+        (entry->status == PHFWD_RESOLVED && entry->count - 1 <= maxHops))
+        return entry;
+
+    return NULL;
+}
+
+/** @brief Implementacja funkcji @ref phfwdResolve.
+ * Cykl wykrywany jest algorytmem Brenta: numer porównywany jest z numerem
+ * zapamiętanym po ostatniej potędze dwójki przekierowań.
+ * @param[in] pf        –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num       –  Wskaźnik na napis reprezentujący numer;
+ * @param[in] maxHops   –  Maksymalna liczba zastosowanych przekierowań;
+ * @param[out] status   –  Wskaźnik na wynik wyznaczania;
+ * @param[out] hops     –  Wskaźnik na liczbę zastosowanych przekierowań;
+ * @param[out] trace    –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+ *         udało się zaalokować pamięci.
+ */
+static const PhoneNum* resolveForward(PhoneFwd pf, const char* num,
+                                      size_t maxHops,
+                                      enum PhoneResolveStatus* status,
+                                      size_t* hops, struct traceInfo* trace) {
+    if (pf == NULL)
+        return NULL;
+
+    *status = PHFWD_RESOLVED;
+
+    if (!isValidNumber(num))
+        return phnumNew(0);
+
+    size_t keyLength = strlen(num);
+    trace->keyLength = keyLength;
+
+    struct resolveEntry* entry = resolveMemoFind(pf, num, maxHops);
+
+    if (entry != NULL) {
+        *status = entry->status;
+        *hops = entry->status == PHFWD_RESOLVE_CYCLE ? entry->count :
+                                                       entry->count - 1;
+
+        if (entry->status != PHFWD_RESOLVED)
+            return phnumNew(0);
+
+        const char* final = entry->chain;
+
+        for (size_t i = 1; i < entry->count; i++)
+            final += strlen(final) + 1;
+
+        PhoneNum* res = phnumNewFlat(1, strlen(final) + 1);
+
+        if (res == NULL)
+            return NULL;
+
+        res->phNums[0] = res->pool;
+        strcpy(res->phNums[0], final);
+
+        return res;
+    }
+
+    char* hare = NULL;
+    char* tortoise = NULL;
+    char* scratch = NULL;
+    size_t hareCapacity = 0, tortoiseCapacity = 0, scratchCapacity = 0;
+    size_t hareLength = keyLength;
+    size_t power = 1, lam = 1;
+    struct resolveChain rc;
+    bool ok = bufferReserve(&hare, &hareCapacity, keyLength + 1) &&
+              bufferReserve(&tortoise, &tortoiseCapacity, keyLength + 1);
+
+    rc.chain = NULL;
+    rc.used = rc.capacity = rc.count = 0;
+    rc.valid = true;
+    *hops = 0;
+
+    if (ok) {
+        memcpy(hare, num, keyLength + 1);
+        memcpy(tortoise, num, keyLength + 1);
+    }
+
+    while (ok) {
+        size_t matchLength;
+        struct forwardRef fwd;
+
+        if (!lookupForward(pf, hare, hareLength, &matchLength, &fwd, trace)) {
+            resolveChainAdd(&rc, hare, hareLength, 0);
+            *status = PHFWD_RESOLVED;
+            break;
+        }
+
+        resolveChainAdd(&rc, hare, hareLength, matchLength);
+
+        if (*hops == maxHops) {
+            *status = PHFWD_RESOLVE_HOP_LIMIT;
+            break;
+        }
+
+        size_t nextLength = fwd.length + hareLength - matchLength;
+
+        if (!bufferReserve(&scratch, &scratchCapacity, nextLength + 1)) {
+            ok = false;
+            break;
+        }
+
+        forwardCopy(scratch, &fwd);
+        memcpy(scratch + fwd.length, hare + matchLength,
+               hareLength - matchLength + 1);
+
+        char* tmp = hare;
+        size_t tmpCapacity = hareCapacity;
+
+        hare = scratch;
+        hareCapacity = scratchCapacity;
+        hareLength = nextLength;
+        scratch = tmp;
+        scratchCapacity = tmpCapacity;
+        (*hops)++;
+
+        if (strcmp(hare, tortoise) == 0) {
+            *status = PHFWD_RESOLVE_CYCLE;
+            break;
+        }
+
+        if (power == lam) {
+            if (!bufferReserve(&tortoise, &tortoiseCapacity, hareLength + 1)) {
+                ok = false;
+                break;
+            }
+
+            memcpy(tortoise, hare, hareLength + 1);
+            power *= 2;
+            lam = 0;
+        }
+
+        lam++;
+    }
+
+    PhoneNum* res = NULL;
+
+    if (ok && *status == PHFWD_RESOLVED)
+        res = phnumNewFlat(1, hareLength + 1);
+
+    else if (ok)
+        res = phnumNew(0);
+
+    if (res != NULL && *status == PHFWD_RESOLVED) {
+        res->phNums[0] = res->pool;
+        memcpy(res->phNums[0], hare, hareLength + 1);
+    }
+
+    if (res != NULL)
+        resolveMemoStore(pf, &rc, maxHops, *status);
+
+    free(rc.chain);
+    free(hare);
+    free(tortoise);
+    free(scratch);
+
+    return res;
+}
+
+const PhoneNum* phfwdResolve(PhoneFwd pf, const char* num, size_t maxHops,
+                             enum PhoneResolveStatus* status) {
+    struct traceInfo trace = {0, 0};
+    enum PhoneResolveStatus resStatus = PHFWD_RESOLVED;
+    size_t hops = 0;
+
+    PHFWD_PROBE2(resolve__entry, num, maxHops);
+    const PhoneNum* res = resolveForward(pf, num, maxHops, &resStatus, &hops,
+                                         &trace);
+    PHFWD_PROBE3(resolve__return, trace.keyLength, trace.visited, hops);
+
+    if (status != NULL)
+        *status = resStatus;
+
+    return res;
+}
+
+/** @brief Dane przekazywane funkcji @ref reverseCallback.
+ * Znalezione numery sklejane są w jednym buforze, każdy zakończony znakiem
+ * '\0', więc ich zbieranie nie wymaga osobnej alokacji na każdy numer.
+ */
+struct reverseCtx {
+    const char* numb;  ///< Wskaźnik na napis reprezentujący numer.
+    size_t numbLength; ///< Długość numeru.
+    char* pool;        ///< Bufor ze sklejonymi numerami.
+    size_t used;       ///< Liczba zajętych bajtów bufora @p pool.
+    size_t capacity;   ///< Rozmiar bufora @p pool.
+    size_t howMany;    ///< Liczba znalezionych numerów.
+};
+
+/** @brief Dopisuje do bufora numer przekierowywany na dany numer.
+ * Jeśli przekierowanie jest prefiksem numeru z kontekstu, dopisuje numer,
+ * który jest na niego przekierowywany. Numery mogą się powtarzać.
+ * @param[in,out] ctx     –  Wskaźnik na strukturę @ref reverseCtx;
+ * @param[in] num         –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] numLength   –  Długość prefiksu przekierowywanego;
+ * @param[in] fwd         –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength   –  Długość przekierowania.
+ * @return Wartość @p true, jeśli udało się dopisać numer lub nie trzeba było
+ *         go dopisywać.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool reverseCallback(void* ctx, const char* num, size_t numLength,
+                            const char* fwd, size_t fwdLength) {
+    struct reverseCtx* rev = ctx;
+
+    // Sprawdzamy czy przekierowanie jest prefiksem numeru.
+    if (fwdLength > rev->numbLength || strncmp(rev->numb, fwd, fwdLength) != 0)
+        return true;
+
+    size_t restLength = rev->numbLength - fwdLength;
+
+    if (!bufferReserve(&rev->pool, &rev->capacity,
+                       rev->used + numLength + restLength + 1))
+        return false;
+
+    memcpy(rev->pool + rev->used, num, numLength);
+    memcpy(rev->pool + rev->used + numLength, rev->numb + fwdLength,
+           restLength + 1);
+    rev->used += numLength + restLength + 1;
+    rev->howMany++;
+
+    return true;
+}
+
+/** Komparator napisów. Używa porządku leksykograficznego.
+ * @param p1  –  Wskaźnik na pierwszy napis;
+ * @param p2  –  Wskaźnik na drugi napis.
+ * @return Wartość @p >0, jeśli pierwszy napis jest większy;
+ *         Wartość @p 0, jeśli oba napisy są równe;
+ *         Wartość @p <0, jeśli pierwszy napis jest mniejszy.
+ */
+int compare(const void* p1, const void* p2) {
+    char* const* s1 = p1;
+    char* const* s2 = p2;
+
+    return strcmp(*s1, *s2);
+}
+
+/** @brief Implementacja funkcji @ref phfwdReverse.
+ * @param[in] pf      –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num     –  Wskaźnik na napis reprezentujący numer;
+ * @param[out] trace  –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+ *         udało się zaalokować pamięci.
+ */
+static const PhoneNum* reverseForwards(PhoneFwd pf, const char* num,
+                                       struct traceInfo* trace) {
+    if (pf == NULL)
+        return NULL;
+
+    if (!isValidNumber(num))
+        return phnumNew(0);
+
+    size_t numLength = strlen(num);
+    trace->keyLength = numLength;
+    struct reverseCtx ctx = {num, numLength, NULL, 0, 0, 0};
+    struct forwardFilter filter = {NULL, 0, NULL};
+
+    // Sam numer jest swoim przekierowaniem z pustego prefiksu.
+    bool ok = reverseCallback(&ctx, "", 0, "", 0) &&
+              filterInit(&filter, num, numLength) &&
+              forEachForward(pf, reverseCallback, &ctx, &filter, &trace->visited);
+    char** nums = ok ? malloc(ctx.howMany * sizeof(char*)) : NULL;
+
+    free(filter.packed);
+
+    if (nums == NULL) {
+        free(ctx.pool);
+        return NULL;
+    }
+
+    char* str = ctx.pool;
+
+    for (size_t i = 0; i < ctx.howMany; i++) {
+        nums[i] = str;
+        str += strlen(str) + 1;
+    }
+
+    qsort(nums, ctx.howMany, sizeof(char*), compare);
+
+    // Usuwamy powtórzenia, licząc przy okazji miejsce na napisy wyniku.
+    size_t unique = 0;
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < ctx.howMany; i++) {
+        if (unique == 0 || strcmp(nums[unique - 1], nums[i]) != 0) {
+            nums[unique++] = nums[i];
+            bytes += strlen(nums[i]) + 1;
+        }
+    }
+
+    PhoneNum* revs = phnumNewFlat(unique, bytes);
+
+    if (revs != NULL) {
+        str = revs->pool;
+
+        for (size_t i = 0; i < unique; i++) {
+            size_t length = strlen(nums[i]);
+
+            memcpy(str, nums[i], length + 1);
+            revs->phNums[i] = str;
+            str += length + 1;
+        }
+    }
+
+    free(nums);
+    free(ctx.pool);
+
+    return revs;
+}
+
+const PhoneNum* phfwdReverse(PhoneFwd pf, const char* num) {
+    struct traceInfo trace = {0, 0};
+
+    PHFWD_PROBE1(reverse__entry, num);
+    const PhoneNum* res = reverseForwards(pf, num, &trace);
+    PHFWD_PROBE3(reverse__return, trace.keyLength, trace.visited,
+                 res != NULL ? res->length : 0);
+
+    return res;
+}
+
+/** Numer zapytania wsadowego razem z jego pozycją na liście zapytań.
+ */
+struct batchQuery {
+    const char* num; ///< Wskaźnik na napis reprezentujący numer.
+    size_t length;   ///< Długość numeru.
+    size_t query;    ///< Indeks zapytania.
+};
+
+/** @brief Wierzchołek drzewa prefiksowego zapytań wsadowych.
+ * Zapytania posortowane są leksykograficznie, więc numery przechodzące przez
+ * wierzchołek tworzą spójny przedział posortowanej tablicy.
+ */
+struct batchNode {
+    size_t children[NUMBER_ALPHABET_SIZE]; /**< Indeksy synów w tablicy
+                                                wierzchołków; 0 oznacza brak
+                                                syna (korzeń nie jest synem). */
+    size_t lo; ///< Początek przedziału zapytań w tym poddrzewie.
+    size_t hi; ///< Koniec (wyłącznie) przedziału zapytań w tym poddrzewie.
+};
+
+/** Znaleziony numer: indeks zapytania i położenie napisu w puli.
+ */
+struct batchMatch {
+    size_t query;    ///< Indeks zapytania.
+    size_t offset;   ///< Przesunięcie napisu w puli wyników.
+    const char* str; ///< Wskaźnik na napis, ustawiany po zakończeniu zbierania.
+};
+
+/** Dane przekazywane funkcji @ref batchCallback.
+ */
+struct batchCtx {
+    const struct batchQuery* queries; ///< Posortowane poprawne zapytania.
+    struct batchNode* nodes;          ///< Drzewo prefiksowe zapytań.
+    struct batchMatch* matches;       ///< Znalezione numery.
+    size_t matchCount;                ///< Liczba znalezionych numerów.
+    size_t matchCapacity;             ///< Rozmiar tablicy @p matches.
+    char* pool;                       ///< Pula napisów zakończonych znakiem '\0'.
+    size_t poolUsed;                  ///< Liczba zajętych bajtów puli.
+    size_t poolCapacity;              ///< Rozmiar puli.
+};
+
+/** Komparator zapytań. Używa porządku leksykograficznego numerów.
+ * @param p1  –  Wskaźnik na pierwsze zapytanie;
+ * @param p2  –  Wskaźnik na drugie zapytanie.
+ * @return Wynik porównania numerów, jak w funkcji strcmp.
+ */
+static int batchQueryCompare(const void* p1, const void* p2) {
+    const struct batchQuery* q1 = p1;
+    const struct batchQuery* q2 = p2;
+
+    return strcmp(q1->num, q2->num);
+}
+
+/** Komparator znalezionych numerów: najpierw indeks zapytania, potem napis.
+ * @param p1  –  Wskaźnik na pierwszy numer;
+ * @param p2  –  Wskaźnik na drugi numer.
+ * @return Wartość ujemna, zero lub dodatnia, jak w funkcji strcmp.
+ */
+static int batchMatchCompare(const void* p1, const void* p2) {
+    const struct batchMatch* m1 = p1;
+    const struct batchMatch* m2 = p2;
+
+    if (m1->query != m2->query)
+        return m1->query < m2->query ? -1 : 1;
+
+    return strcmp(m1->str, m2->str);
+}
+
+/** @brief Dodaje numer do wyników zapytania.
+ * Numer jest sklejeniem napisów @p head i @p tail.
+ * @param[in,out] ctx      –  Wskaźnik na dane zapytania wsadowego;
+ * @param[in] query        –  Indeks zapytania;
+ * @param[in] head         –  Wskaźnik na początek numeru;
+ * @param[in] headLength   –  Długość początku numeru;
+ * @param[in] tail         –  Wskaźnik na koniec numeru;
+ * @param[in] tailLength   –  Długość końca numeru.
+ * @return Wartość @p true, jeśli udało się dodać numer.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool batchAddMatch(struct batchCtx* ctx, size_t query,
+                          const char* head, size_t headLength,
+                          const char* tail, size_t tailLength) {
+    size_t needed = headLength + tailLength + 1;
+
+    if (ctx->matchCount == ctx->matchCapacity) {
+        size_t capacity = ctx->matchCapacity == 0 ? 64 : 2 * ctx->matchCapacity;
+        struct batchMatch* bigger = realloc(ctx->matches, capacity *
+                                            sizeof(struct batchMatch));
+
+        if (bigger == NULL)
+            return false;
+
+        ctx->matches = bigger;
+        ctx->matchCapacity = capacity;
+    }
+
+    if (ctx->poolUsed + needed > ctx->poolCapacity) {
+        size_t capacity = ctx->poolCapacity == 0 ? 1024 : 2 * ctx->poolCapacity;
+
+        while (capacity < ctx->poolUsed + needed)
+            capacity *= 2;
+
+        char* bigger = realloc(ctx->pool, capacity);
+
+        if (bigger == NULL)
+            return false;
+
+        ctx->pool = bigger;
+        ctx->poolCapacity = capacity;
+    }
+
+    memcpy(ctx->pool + ctx->poolUsed, head, headLength);
+    memcpy(ctx->pool + ctx->poolUsed + headLength, tail, tailLength);
+    ctx->pool[ctx->poolUsed + needed - 1] = '\0';
+
+    ctx->matches[ctx->matchCount].query = query;
+    ctx->matches[ctx->matchCount++].offset = ctx->poolUsed;
+    ctx->poolUsed += needed;
+
+    return true;
+}
+
+/** @brief Dopasowuje przekierowanie do wszystkich zapytań naraz.
+ * Schodzi po drzewie zapytań wzdłuż przekierowania; wszystkie zapytania w
+ * osiągniętym poddrzewie mają je za prefiks.
+ * @param[in,out] ctx     –  Wskaźnik na strukturę @ref batchCtx;
+ * @param[in] num         –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] numLength   –  Długość prefiksu przekierowywanego;
+ * @param[in] fwd         –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength   –  Długość przekierowania.
+ * @return Wartość @p true, jeśli udało się dodać znalezione numery.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool batchCallback(void* ctx, const char* num, size_t numLength,
+                          const char* fwd, size_t fwdLength) {
+    struct batchCtx* batch = ctx;
+    size_t node = 0;
+
+    for (size_t i = 0; i < fwdLength; i++) {
+        node = batch->nodes[node].children[fwd[i] - 48];
+
+        if (node == 0)
+            return true;
+    }
+
+    for (size_t p = batch->nodes[node].lo; p < batch->nodes[node].hi; p++) {
+        const struct batchQuery* q = &batch->queries[p];
+
+        if (!batchAddMatch(batch, q->query, num, numLength, q->num + fwdLength,
+                           q->length - fwdLength))
+            return false;
+    }
+
+    return true;
+}
+
+/** @brief Buduje drzewo prefiksowe posortowanych zapytań.
+ * @param[in] queries  –  Wskaźnik na posortowaną tablicę zapytań;
+ * @param[in] count    –  Liczba zapytań;
+ * @param[out] nodes   –  Wskaźnik na zmienną, do której zapisana zostanie
+ *                        tablica wierzchołków; korzeń ma indeks 0.
+ * @return Wartość @p true, jeśli udało się zbudować drzewo.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool batchTrieBuild(const struct batchQuery* queries, size_t count,
+                           struct batchNode** nodes) {
+    size_t capacity = 64;
+    size_t used = 1;
+    struct batchNode* res = calloc(capacity, sizeof(struct batchNode));
+
+    *nodes = NULL;
+
+    if (res == NULL)
+        return false;
+
+    for (size_t p = 0; p < count; p++) {
+        size_t node = 0;
+
+        res[node].hi = p + 1;
+
+        for (size_t i = 0; i < queries[p].length; i++) {
+            size_t digit = (size_t)(queries[p].num[i] - 48);
+
+            if (res[node].children[digit] == 0) {
+                if (used == capacity) {
+                    struct batchNode* bigger = realloc(res, 2 * capacity *
+                                                       sizeof(struct batchNode));
+
+                    if (bigger == NULL) {
+                        free(res);
+                        return false;
+                    }
+
+                    res = bigger;
+                    memset(res + capacity, 0, capacity * sizeof(struct batchNode));
+                    capacity *= 2;
+                }
+
+                res[used].lo = p;
+                res[node].children[digit] = used++;
+            }
+
+            node = res[node].children[digit];
+            res[node].hi = p + 1;
+        }
+    }
+
+    *nodes = res;
+
+    return true;
+}
+
+/** @brief Składa wynik zapytania wsadowego w jeden blok pamięci.
+ * Sortuje znalezione numery, usuwa powtórzenia i kopiuje je za nagłówkiem.
+ * @param[in,out] ctx  –  Wskaźnik na dane zapytania wsadowego;
+ * @param[in] count    –  Liczba zapytań.
+ * @return Wskaźnik na wynik lub NULL, gdy nie udało się zaalokować pamięci.
+ */
+static PhoneBatch* batchAssemble(struct batchCtx* ctx, size_t count) {
+    for (size_t i = 0; i < ctx->matchCount; i++)
+        ctx->matches[i].str = ctx->pool + ctx->matches[i].offset;
+
+    if (ctx->matchCount > 0)
+        qsort(ctx->matches, ctx->matchCount, sizeof(struct batchMatch),
+              batchMatchCompare);
+
+    size_t unique = 0;
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < ctx->matchCount; i++) {
+        if (i > 0 && ctx->matches[i].query == ctx->matches[i - 1].query &&
+            strcmp(ctx->matches[i].str, ctx->matches[i - 1].str) == 0)
+            continue;
+
+        unique++;
+        bytes += strlen(ctx->matches[i].str) + 1;
+    }
+
+    PhoneBatch* res = malloc(sizeof(PhoneBatch) + (count + 1) * sizeof(size_t) +
+                             unique * sizeof(char*) + bytes);
+
+    if (res == NULL)
+        return NULL;
+
+    res->queries = count;
+    res->first = (size_t*)(res + 1);
+    res->phNums = (char**)(res->first + count + 1);
+
+    char* pool = (char*)(res->phNums + unique);
+    size_t j = 0;
+    size_t query = 0;
+
+    for (size_t i = 0; i < ctx->matchCount; i++) {
+        if (i > 0 && ctx->matches[i].query == ctx->matches[i - 1].query &&
+            strcmp(ctx->matches[i].str, ctx->matches[i - 1].str) == 0)
+            continue;
+
+        while (query <= ctx->matches[i].query)
+            res->first[query++] = j;
+
+        size_t length = strlen(ctx->matches[i].str);
+
+        memcpy(pool, ctx->matches[i].str, length + 1);
+        res->phNums[j++] = pool;
+        pool += length + 1;
+    }
+
+    while (query <= count)
+        res->first[query++] = j;
+
+    return res;
+}
+
+/** @brief Implementacja funkcji @ref phfwdReverseBatch.
+ * @param[in] pf      –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] nums    –  Wskaźnik na tablicę wskaźników na numery;
+ * @param[in] count   –  Liczba numerów;
+ * @param[out] trace  –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wskaźnik na wynik lub NULL, gdy nie udało się zaalokować pamięci.
+ */
+static const PhoneBatch* reverseBatch(PhoneFwd pf, const char* const* nums,
+                                      size_t count, struct traceInfo* trace) {
+    if (pf == NULL || (nums == NULL && count > 0))
+        return NULL;
+
+    struct batchCtx ctx = {NULL, NULL, NULL, 0, 0, NULL, 0, 0};
+    struct batchQuery* queries = malloc((count + 1) * sizeof(struct batchQuery));
+    size_t valid = 0;
+    PhoneBatch* res = NULL;
+    bool ok = true;
+
+    if (queries == NULL)
+        return NULL;
+
+    // Każdy poprawny numer jest swoim własnym wynikiem.
+    for (size_t i = 0; i < count && ok; i++) {
+        if (!isValidNumber(nums[i]))
+            continue;
+
+        size_t length = strlen(nums[i]);
+
+        queries[valid].num = nums[i];
+        queries[valid].length = length;
+        queries[valid++].query = i;
+        trace->keyLength += length;
+        ok = batchAddMatch(&ctx, i, nums[i], length, "", 0);
+    }
+
+    if (ok) {
+        qsort(queries, valid, sizeof(struct batchQuery), batchQueryCompare);
+        ctx.queries = queries;
+        ok = batchTrieBuild(queries, valid, &ctx.nodes);
+    }
+
+    // Jedno przejście drzewa przekierowań obsługuje wszystkie zapytania.
+    if (ok && valid > 0)
+        ok = forEachForward(pf, batchCallback, &ctx, NULL, &trace->visited);
+
+    if (ok)
+        res = batchAssemble(&ctx, count);
+
+    free(queries);
+    free(ctx.nodes);
+    free(ctx.matches);
+    free(ctx.pool);
+
+    return res;
+}
+
+const PhoneBatch* phfwdReverseBatch(PhoneFwd pf, const char* const* nums,
+                                    size_t count) {
+    struct traceInfo trace = {0, 0};
+
+    PHFWD_PROBE1(reverse_batch__entry, count);
+    const PhoneBatch* res = reverseBatch(pf, nums, count, &trace);
+    PHFWD_PROBE3(reverse_batch__return, trace.keyLength, trace.visited,
+                 res != NULL ? res->first[count] : 0);
+
+    return res;
+}
+
+size_t phbatchLength(const PhoneBatch* pb, size_t query) {
+    if (pb == NULL || query >= pb->queries)
+        return 0;
+
+    return pb->first[query + 1] - pb->first[query];
+}
+
+const char* phbatchGet(const PhoneBatch* pb, size_t query, size_t idx) {
+    if (pb == NULL || idx >= phbatchLength(pb, query))
+        return NULL;
+
+    return pb->phNums[pb->first[query] + idx];
+}
+
+void phbatchDelete(const PhoneBatch* pb) {
+    free((void*)pb);
+}
+
+/** @brief Oczekujący numer strumieniowego wyznaczania przekierowań na numer.
+ * Bufor należy do miejsca w kopcu i jest używany ponownie przez kolejne
+ * numery, więc jest powiększany tylko dla dłuższego numeru.
+ */
+struct reversePending {
+    char* str;       ///< Wskaźnik na bufor z napisem reprezentującym numer.
+    size_t length;   ///< Długość numeru.
+    size_t capacity; ///< Rozmiar bufora @p str.
+};
+
+/** @brief Stan strumieniowego wyznaczania przekierowań na numer.
+ * Numery wypisywane są w porządku leksykograficznym. Numer powstały z
+ * przekierowania prefiksu @p p zaczyna się od @p p, więc po przejściu do
+ * wierzchołka @p q wszystkie kolejne numery są nie mniejsze niż @p q.
+ * Oczekujące numery są zatem numerami przodków bieżącego wierzchołka i jest
+ * ich co najwyżej tyle, ile wynosi jego głębokość plus jeden. Miejsca kopca
+ * za @p heapSize przechowują wolne bufory, dlatego liczba alokacji zależy od
+ * głębokości, a nie od liczby wypisanych numerów.
+ */
+struct reverseStream {
+    const char* numb;              ///< Wskaźnik na napis reprezentujący numer.
+    size_t numbLength;             ///< Długość numeru.
+    const char* after;             /**< Wypisywane są tylko numery większe
+                                        od tego napisu (NULL oznacza brak
+                                        ograniczenia). */
+    size_t limit;                  ///< Maksymalna liczba wypisanych numerów.
+    PhoneNumCallback callback;     /**< Funkcja wywoływana dla wypisanych
+                                        numerów lub NULL. */
+    void* callbackCtx;             ///< Dane przekazywane funkcji @p callback.
+    struct reversePending* heap;   ///< Kopiec oczekujących numerów.
+    size_t heapSize;               ///< Liczba oczekujących numerów.
+    size_t heapCapacity;           ///< Rozmiar tablicy @p heap.
+    char** page;                   /**< Tablica wypisanych numerów lub NULL,
+                                        jeśli numery nie są zapisywane. */
+    size_t pageCapacity;           ///< Rozmiar tablicy @p page.
+    struct reversePending last;    /**< Ostatni wypisany numer (@p str równe
+                                        NULL, jeśli nie ma takiego). */
+    size_t emitted;                ///< Liczba wypisanych numerów.
+    bool failed;                   ///< Czy nie udało się zaalokować pamięci.
+};
+
+/** @brief Wypisuje numer ze strumienia.
+ * Pomija numery nie większe od @p after oraz powtórzenia. Bufor wypisanego
+ * numeru zamieniany jest z buforem poprzednio wypisanego numeru, więc numer
+ * przekazany funkcji @p callback pozostaje ważny do kolejnego wypisania.
+ * @param[in,out] rs      –  Wskaźnik na stan strumienia;
+ * @param[in,out] popped  –  Wskaźnik na miejsce kopca ze zdjętym numerem.
+ */
+static void streamEmit(struct reverseStream* rs,
+                       struct reversePending* popped) {
+    if ((rs->after != NULL && strcmp(popped->str, rs->after) <= 0) ||
+        (rs->last.str != NULL && strcmp(popped->str, rs->last.str) == 0))
+        return;
+
+    if (rs->page == NULL) {
+        // Odmowa wywołującego kończy strumień jak osiągnięcie limitu.
+        if (rs->callback != NULL && !rs->callback(rs->callbackCtx, popped->str))
+            rs->limit = rs->emitted + 1;
+    }
+
+    else {
+        if (rs->emitted == rs->pageCapacity) {
+            size_t capacity = 2 * rs->pageCapacity;
+            char** bigger;
+
+            if (capacity > rs->limit)
+                capacity = rs->limit;
 
-        if (len > 0) {
-            newPhNum->phNums = calloc(len, sizeof(char *));
+            bigger = realloc(rs->page, capacity * sizeof(char*));
 
-            if (newPhNum->phNums == NULL) {
-                free(newPhNum);
-                return NULL;
+            if (bigger == NULL) {
+                rs->failed = true;
+                return;
             }
 
-            for (size_t i = 0; i < len; i++)
-                newPhNum->phNums[i] = NULL;
+            rs->page = bigger;
+            rs->pageCapacity = capacity;
         }
 
-        else
-            newPhNum->phNums = NULL;
-    }
-
-    return newPhNum;
-}
+        char* str = malloc(popped->length + 1);
 
-const PhoneNum* phfwdGet(PhoneFwd pf, const char* num) {
-    if (pf == NULL)
-        return NULL;
+        if (str == NULL) {
+            rs->failed = true;
+            return;
+        }
 
-    if (!isValidNumber(num))
-        return phnumNew(0);
+        memcpy(str, popped->str, popped->length + 1);
+        rs->page[rs->emitted] = str;
+    }
 
-    PhoneNum* numFwd = phnumNew(1);
+    struct reversePending tmp = rs->last;
+    rs->last = *popped;
+    *popped = tmp;
+    rs->emitted++;
+}
 
-    if (numFwd == NULL)
-        return NULL;
+/** @brief Zdejmuje z kopca najmniejszy oczekujący numer.
+ * Zdjęty numer trafia na miejsce tuż za kopcem, gdzie pozostaje do
+ * kolejnego dodania numeru.
+ * @param[in,out] rs  –  Wskaźnik na stan strumienia z niepustym kopcem.
+ * @return Wskaźnik na miejsce ze zdjętym numerem.
+ */
+static struct reversePending* streamPop(struct reverseStream* rs) {
+    struct reversePending* heap = rs->heap;
+    struct reversePending res = heap[0];
+    size_t i = 0;
 
-    size_t keyLength = strlen(num);
-    size_t longestPrefixLength = 0;
+    heap[0] = heap[--rs->heapSize];
+    heap[rs->heapSize] = res;
 
-    /* Wskaźnik na napis reprezentujący przekierowanie
-     * najdłuzszego prefiksu num. */
-    char** prefForward = NULL;
-    PhoneFwd nextNode = pf;
+    while (2 * i + 1 < rs->heapSize) {
+        size_t child = 2 * i + 1;
 
-    for (size_t i = 0; i<keyLength; i++) {
-        nextNode = nextNode->children[num[i] - 48];
+        if (child + 1 < rs->heapSize &&
+            strcmp(heap[child + 1].str, heap[child].str) < 0)
+            child++;
 
-        if (nextNode == NULL)
+        if (strcmp(heap[i].str, heap[child].str) <= 0)
             break;
 
-        else if (nextNode->numForward != NULL) {
-            longestPrefixLength = nextNode->numLength;
-            prefForward = &(nextNode->numForward);
-        }
+        struct reversePending tmp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = tmp;
+        i = child;
     }
 
-    if (longestPrefixLength == 0) {
-        numFwd->phNums[0] = calloc(keyLength + 1, sizeof(char));
+    return &heap[rs->heapSize];
+}
 
-        if (numFwd->phNums[0] == NULL) {
-            free(numFwd);
-            return NULL;
-        }
+/** @brief Dodaje oczekujący numer do kopca.
+ * Numer jest sklejeniem napisów @p head i @p tail i zapisywany jest w
+ * buforze pierwszego wolnego miejsca kopca.
+ * @param[in,out] rs       –  Wskaźnik na stan strumienia;
+ * @param[in] head         –  Wskaźnik na początek numeru;
+ * @param[in] headLength   –  Długość początku numeru;
+ * @param[in] tail         –  Wskaźnik na koniec numeru;
+ * @param[in] tailLength   –  Długość końca numeru.
+ * @return Wartość @p true, jeśli udało się dodać numer.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool streamPush(struct reverseStream* rs, const char* head,
+                       size_t headLength, const char* tail, size_t tailLength) {
+    if (rs->heapSize == rs->heapCapacity) {
+        size_t capacity = rs->heapCapacity == 0 ? 16 : 2 * rs->heapCapacity;
+        struct reversePending* bigger = realloc(rs->heap, capacity *
+                                                sizeof(struct reversePending));
+
+        if (bigger == NULL)
+            return false;
 
-        strcpy(numFwd->phNums[0], num);
+        for (size_t i = rs->heapCapacity; i < capacity; i++)
+            bigger[i] = (struct reversePending){NULL, 0, 0};
 
-        return numFwd;
+        rs->heap = bigger;
+        rs->heapCapacity = capacity;
     }
 
-    else {
-        size_t prefForwardLength = strlen(*prefForward);
-        size_t remainderLength = keyLength - longestPrefixLength;
+    struct reversePending* heap = rs->heap;
+    size_t i = rs->heapSize;
+    size_t length = headLength + tailLength;
 
-        numFwd->phNums[0] = calloc(prefForwardLength + remainderLength + 1, sizeof(char));
+    if (heap[i].capacity < length + 1) {
+        char* bigger = realloc(heap[i].str, length + 1);
 
-        if (numFwd->phNums[0] == NULL) {
-            free(numFwd);
-            return NULL;
-        }
+        if (bigger == NULL)
+            return false;
 
-        strcpy(numFwd->phNums[0], *prefForward);
-        strcpy(numFwd->phNums[0] + prefForwardLength, num + longestPrefixLength);
+        heap[i].str = bigger;
+        heap[i].capacity = length + 1;
+    }
 
-        return numFwd;
+    memcpy(heap[i].str, head, headLength);
+    memcpy(heap[i].str + headLength, tail, tailLength);
+    heap[i].str[length] = '\0';
+    heap[i].length = length;
+    rs->heapSize++;
+
+    while (i > 0 && strcmp(heap[i].str, heap[(i - 1) / 2].str) < 0) {
+        struct reversePending tmp = heap[i];
+        heap[i] = heap[(i - 1) / 2];
+        heap[(i - 1) / 2] = tmp;
+        i = (i - 1) / 2;
     }
+
+    return true;
 }
 
-/** Lista wskaźników na napisy.
+/** @brief Wypisuje oczekujące numery mniejsze od danego prefiksu.
+ * @param[in,out] rs        –  Wskaźnik na stan strumienia;
+ * @param[in] bound         –  Wskaźnik na prefiks bieżącego wierzchołka lub
+ *                             NULL, jeśli należy wypisać wszystkie numery;
+ * @param[in] boundLength   –  Długość prefiksu.
+ * @return Wartość @p true, jeśli należy kontynuować przeglądanie.
+ *         Wartość @p false, jeśli wypisano już @p limit numerów lub nie
+ *         udało się zaalokować pamięci.
  */
-struct strList {
-    char* num;             ///< Wskaźnik na napis.
-    struct strList* next;  ///< Wskaźnik na kolejny element listy (NULL jeśli to ostatni element listy).
-};
-
-typedef struct strList* List; ///< Skrócona nazwa na wskaźnik na strukturę @p strList.
+static bool streamDrain(struct reverseStream* rs, const char* bound,
+                        size_t boundLength) {
+    while (rs->heapSize > 0 && rs->emitted < rs->limit && !rs->failed &&
+           (bound == NULL || lengthCompare(rs->heap[0].str, rs->heap[0].length,
+                                           bound, boundLength) < 0))
+        streamEmit(rs, streamPop(rs));
+
+    return rs->emitted < rs->limit && !rs->failed;
+}
 
-/** @brief Dodaje napis do listy.
- * Wymagana jest informacja o długości napisu.
- * @param[in] l           –  Wskaźnik na wskaźnik na początek listy, do której ma być dodany napis.
- * @param[in] numb        –  Wskaźnik na napis, który ma być dodany do listy.
- * @param[in] numbLength  –  Długość napisu, który ma być dodany do listy.
- * @return Wartość @p true, jeśli napis został dodany.
- *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+/** @brief Przetwarza przekierowanie w strumieniowym wyznaczaniu przekierowań.
+ * @param[in,out] ctx     –  Wskaźnik na strukturę @ref reverseStream;
+ * @param[in] num         –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] numLength   –  Długość prefiksu przekierowywanego;
+ * @param[in] fwd         –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength   –  Długość przekierowania.
+ * @return Wartość @p true, jeśli należy kontynuować przeglądanie.
+ *         Wartość @p false w przeciwnym wypadku.
  */
-bool strListAdd(List *l, const char* numb, size_t numbLength) {
-    List newElt = malloc(sizeof(struct strList));
+static bool streamCallback(void* ctx, const char* num, size_t numLength,
+                           const char* fwd, size_t fwdLength) {
+    struct reverseStream* rs = ctx;
 
-    if (newElt == NULL)
+    if (!streamDrain(rs, num, numLength))
         return false;
 
-    else {
-        newElt->next = *l;
-        newElt->num = calloc(numbLength + 1, sizeof(char));
-
-        if(newElt->num == NULL)
-           return false;
+    if (fwdLength > rs->numbLength || strncmp(rs->numb, fwd, fwdLength) != 0)
+        return true;
 
-        strcpy(newElt->num, numb);
+    if (!streamPush(rs, num, numLength, rs->numb + fwdLength,
+                    rs->numbLength - fwdLength)) {
+        rs->failed = true;
+        return false;
     }
 
-    *l = newElt;
-
     return true;
 }
 
-/** Usuwa listę.
- * @param[in] l  –  Wskaźnik na początek listy do usunięcia.
- */
-void delStrList(List l) {
-    if (l != NULL) {
-        delStrList(l->next);
-        free(l->num);
-        free(l);
-    }
-}
-
-/** @brief Znajduje wszystkie przekierowania na dany numer.
- * Znajduje wszystkie przekierowania na dany numer i dodaje je do danej listy, używając funkcji @ref strListAdd.
- * Zlicza znalezione przekierowania. Przekierowania mogą się powtarzać.
- * @param[in] l           –  Wskaźnik na wskaźnik na pierwszy element listy.
- * @param[in] phFwd       –  Wskaźnik na strukturę przechowującą przekierowania;
- * @param[in] numb        –  Wskaźnik na napis reprezentujący numer;
- * @param[in] numbLength  –  Długość numeru;
- * @param[in] howMany     –  Wskaźnik na zmienną przechowującą liczbę znalezionych przekierowań.
- * @return Wartość @p true, jeśli udało się przeszukać całą strukturę przekierowań.
+/** @brief Wyznacza strumieniowo przekierowania na numer.
+ * @param[in] pf         –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[in,out] rs     –  Wskaźnik na zainicjowany stan strumienia;
+ * @param[in,out] trace  –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wartość @p true, jeśli udało się wyznaczyć numery.
  *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
  */
-bool goThroughTrie(List* l, PhoneFwd phFwd, const char* numb, size_t numbLength, size_t* howMany) {
-    if (phFwd != NULL) {
-        if (phFwd->num != NULL) {
-            // Sprawdzamy czy phFwd->num jest prefiksem num.
-            if (phFwd->numForwardLength <= numbLength &&
-                strncmp(numb, phFwd->numForward, phFwd->numForwardLength) == 0) {
-
-                    char res[phFwd->numLength + numbLength - phFwd->numForwardLength + 1];
+static bool reverseStreamRun(PhoneFwd pf, struct reverseStream* rs,
+                             struct traceInfo* trace) {
+    trace->keyLength = rs->numbLength;
 
-                    strcpy(res, phFwd->num);
-                    strcpy(res + phFwd->numLength, numb + phFwd->numForwardLength);
+    // Sam numer jest swoim przekierowaniem z pustego prefiksu.
+    if (!streamPush(rs, "", 0, rs->numb, rs->numbLength))
+        rs->failed = true;
 
-                    if (strListAdd(l, res, phFwd->numLength + numbLength - phFwd->numForwardLength))
-                        (*howMany)++;
+    struct forwardFilter filter;
 
-                    else
-                        return false;
-            }
-        }
+    if (!filterInit(&filter, rs->numb, rs->numbLength))
+        rs->failed = true;
 
-        for(size_t i = 0; i < NUMBER_ALPHABET_SIZE; i++)
-            if (!goThroughTrie(l, phFwd->children[i], numb, numbLength, howMany))
-                return false;
+    /* Pominięcie przekierowań spoza filtru jedynie opóźnia wypisywanie
+     * kandydatów do kolejnego wywołania streamDrain. */
+    if (!rs->failed) {
+        if (forEachForward(pf, streamCallback, rs, &filter, &trace->visited))
+            streamDrain(rs, NULL, 0);
 
-        return true;
+        // Przeglądanie przerwane bez osiągnięcia limitu to brak pamięci.
+        else if (rs->emitted < rs->limit)
+            rs->failed = true;
     }
 
-    return true;
+    free(filter.packed);
+
+    for (size_t i = 0; i < rs->heapCapacity; i++)
+        free(rs->heap[i].str);
+
+    free(rs->heap);
+    free(rs->last.str);
+
+    return !rs->failed;
 }
 
-/** Komparator napisów. Używa porządku leksykograficznego.
- * @param p1  –  Wskaźnik na pierwszy napis;
- * @param p2  –  Wskaźnik na drugi napis.
- * @return Wartość @p >0, jeśli pierwszy napis jest większy;
- *         Wartość @p 0, jeśli oba napisy są równe;
- *         Wartość @p <0, jeśli pierwszy napis jest mniejszy.
+/** @brief Implementacja funkcji @ref phfwdReverseCount.
+ * @param[in] pf      –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num     –  Wskaźnik na napis reprezentujący numer;
+ * @param[out] trace  –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Liczba różnych numerów przekierowywanych na @p num.
  */
-int compare(const void* p1, const void* p2) {
-    char* const* s1 = p1;
-    char* const* s2 = p2;
+static size_t reverseCount(PhoneFwd pf, const char* num,
+                           struct traceInfo* trace) {
+    if (pf == NULL || !isValidNumber(num))
+        return 0;
 
-    return strcmp(*s1, *s2);
+    struct reverseStream rs = {num, strlen(num), NULL, SIZE_MAX, NULL, NULL,
+                               NULL, 0, 0, NULL, 0, {NULL, 0, 0}, 0, false};
+
+    if (!reverseStreamRun(pf, &rs, trace))
+        return 0;
+
+    return rs.emitted;
 }
 
-const PhoneNum* phfwdReverse(PhoneFwd pf, const char* num) {
-    if (pf == NULL)
-        return NULL;
+size_t phfwdReverseCount(PhoneFwd pf, const char* num) {
+    struct traceInfo trace = {0, 0};
 
-    if (!isValidNumber(num))
-        return phnumNew(0);
+    PHFWD_PROBE1(reverse_count__entry, num);
+    size_t res = reverseCount(pf, num, &trace);
+    PHFWD_PROBE3(reverse_count__return, trace.keyLength, trace.visited, res);
 
-    size_t numLength = strlen(num);
-    PhoneNum* revs;
-    List revsList = NULL;
-    strListAdd(&revsList, num, numLength);
-    size_t numOfRevs = 1;
+    return res;
+}
 
-    if(!goThroughTrie(&revsList, pf, num, numLength, &numOfRevs)) {
-        delStrList(revsList);
+/** @brief Implementacja funkcji @ref phfwdReversePage.
+ * @param[in] pf      –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num     –  Wskaźnik na napis reprezentujący numer;
+ * @param[in] after   –  Wskaźnik na ostatni numer poprzedniej strony lub NULL;
+ * @param[in] limit   –  Maksymalna liczba numerów;
+ * @param[out] trace  –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+ *         udało się zaalokować pamięci.
+ */
+static const PhoneNum* reversePage(PhoneFwd pf, const char* num,
+                                   const char* after, size_t limit,
+                                   struct traceInfo* trace) {
+    if (pf == NULL)
         return NULL;
-    }
 
-    revs = phnumNew(numOfRevs);
-    List tempNode = revsList;
-    List nextNode = NULL;
+    if (!isValidNumber(num) || limit == 0)
+        return phnumNew(0);
 
-    /* Zrzucamy numery z listy do tablicy, usuwając przy okazji listę. */
-    for (size_t i = 0; i < revs->length; i++) {
-        revs->phNums[i] = tempNode->num;
+    PhoneNum* res = phnumNew(0);
+    size_t capacity = limit < 16 ? limit : 16;
+    struct reverseStream rs = {num, strlen(num), after, limit, NULL, NULL,
+                               NULL, 0, 0, malloc(capacity * sizeof(char*)),
+                               capacity, {NULL, 0, 0}, 0, false};
 
-        if (tempNode->next != NULL) {
-            nextNode = tempNode->next;
-        }
+    if (res == NULL || rs.page == NULL || !reverseStreamRun(pf, &rs, trace)) {
+        for (size_t i = 0; i < rs.emitted; i++)
+            free(rs.page[i]);
 
-        free(tempNode);
-        tempNode = nextNode;
+        free(rs.page);
+        free(res);
+        return NULL;
     }
 
-    qsort(revs->phNums, numOfRevs, sizeof(char*), compare);
-
-    size_t numOfRevsWithoutRepeat = 1;
+    if (rs.emitted == 0) {
+        free(rs.page);
+        rs.page = NULL;
+    }
 
-    char* previous = revs->phNums[0];
+    res->phNums = rs.page;
+    res->length = rs.emitted;
 
-    for (size_t i = 1; i < revs->length; i++)
-        if (strcmp(previous, revs->phNums[i]) != 0) {
-            numOfRevsWithoutRepeat++;
-            previous = revs->phNums[i];
-        }
+    return res;
+}
 
-    PhoneNum* revsFinal = phnumNew(numOfRevsWithoutRepeat);
+const PhoneNum* phfwdReversePage(PhoneFwd pf, const char* num,
+                                 const char* after, size_t limit) {
+    struct traceInfo trace = {0, 0};
 
-    revsFinal->phNums[0] = revs->phNums[0];
-    previous = revs->phNums[0];
-    size_t j = 1; //iterator dla revsFinal->phNums
+    PHFWD_PROBE3(reverse_page__entry, num, after, limit);
+    const PhoneNum* res = reversePage(pf, num, after, limit, &trace);
+    PHFWD_PROBE3(reverse_page__return, trace.keyLength, trace.visited,
+                 res != NULL ? res->length : 0);
 
+    return res;
+}
 
-    for (size_t i = 1; i < revs->length; i++) {
-        if (strcmp(previous, revs->phNums[i]) != 0) {
-            revsFinal->phNums[j] = revs->phNums[i];
-            previous = revs->phNums[j];
-            j++;
-        }
+/** @brief Implementacja funkcji @ref phfwdReverseEach.
+ * @param[in] pf        –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num       –  Wskaźnik na napis reprezentujący numer;
+ * @param[in] callback  –  Funkcja wywoływana dla kolejnych numerów;
+ * @param[in,out] ctx   –  Dane przekazywane funkcji @p callback;
+ * @param[out] emitted  –  Wskaźnik na liczbę przekazanych numerów;
+ * @param[out] trace    –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Wartość @p true, jeśli przekazano wszystkie numery lub wywołujący
+ *         przerwał przekazywanie.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool reverseEach(PhoneFwd pf, const char* num, PhoneNumCallback callback,
+                        void* ctx, size_t* emitted, struct traceInfo* trace) {
+    if (pf == NULL || callback == NULL)
+        return false;
 
+    if (!isValidNumber(num))
+        return true;
 
-        /* Jeśli napis się powtórzył, to usuwamy jego duplikat z tablicy, żeby
-         * można było potem bezpiecznie usunąć całą tablicę WSKAŹNIKÓW(!). */
-        else
-            free(revs->phNums[i]);
-    }
+    struct reverseStream rs = {num, strlen(num), NULL, SIZE_MAX, callback, ctx,
+                               NULL, 0, 0, NULL, 0, {NULL, 0, 0}, 0, false};
+    bool res = reverseStreamRun(pf, &rs, trace);
 
-    free(revs->phNums);
-    free(revs);
+    *emitted = rs.emitted;
 
-    return revsFinal;
+    return res;
 }
 
-/** Funkcja implementująca szybkie potęgowanie liczb całkowitych nieujemnych.
- * @param x  –  Podstawa.
- * @param n  –  Wykładnik.
- * @return Wynik x^n.
- */
-static size_t fastPow(size_t x, size_t n) {
-    size_t res = 1;
-
-    while (n > 0) {
-        if (n & 1)
-            res = res * x;
+bool phfwdReverseEach(PhoneFwd pf, const char* num, PhoneNumCallback callback,
+                      void* ctx) {
+    struct traceInfo trace = {0, 0};
+    size_t emitted = 0;
 
-        x *= x;
-        n >>= 1;
-    }
+    PHFWD_PROBE1(reverse__entry, num);
+    bool res = reverseEach(pf, num, callback, ctx, &emitted, &trace);
+    PHFWD_PROBE3(reverse__return, trace.keyLength, trace.visited, emitted);
 
     return res;
 }
@@ -481,6 +4684,7 @@ static size_t fastPow(size_t x, size_t n) {
 struct prefixTree {
     struct prefixTree* children[NUMBER_ALPHABET_SIZE]; /**< Tablica wskaźników na pochodne
                                                               prefiksy dłuższe o jedną cyfrę. */
+    struct prefixTree* parent; ///< Wskaźnik na ojca lub NULL dla korzenia.
     bool leaf;     ///< Czy dany węzeł reprezentuje prawdziwy prefiks.
     size_t length; ///< Długość prefiksu.
 };
@@ -498,6 +4702,7 @@ prefTree newPrefTree (void) {
         for (size_t i = 0; i < NUMBER_ALPHABET_SIZE; i++)
             t->children[i] = NULL;
 
+        t->parent = NULL;
         t->leaf = false;
         t->length = 0;
     }
@@ -506,14 +4711,14 @@ prefTree newPrefTree (void) {
 }
 
 /** Dodaje prefiks @p str do danego drzewa prefiksowego.
- * @param t    –  Wskaźnik na drzewo.
- * @param str  –  Wskaźnik na napis do dodania.
+ * @param t          –  Wskaźnik na drzewo.
+ * @param str        –  Wskaźnik na napis do dodania.
+ * @param keyLength  –  Długość napisu.
  * @return Wartość @p true, jeśli udało się dodać napis.
  *         Wartość @p false w przeciwnym wypadku.
  */
-bool prefTreeAdd (prefTree t, const char* str) {
+bool prefTreeAdd (prefTree t, const char* str, size_t keyLength) {
     prefTree nextNode = t;
-    size_t keyLength = strlen(str);
 
     for (size_t i = 0; i < keyLength; i++) {
         /* Sprawdzamy, czy w drzewie jest wierzchołek reprezentujący kolejny
@@ -523,6 +4728,8 @@ bool prefTreeAdd (prefTree t, const char* str) {
 
             if (nextNode->children[str[i] - 48] == NULL)
                 return false;
+
+            nextNode->children[str[i] - 48]->parent = nextNode;
         }
 
         else if (nextNode->children[str[i] - 48]->leaf)
@@ -539,6 +4746,8 @@ bool prefTreeAdd (prefTree t, const char* str) {
 
 /** @brief Funkcja zliczająca nietrywialne numery.
  * Zlicza na podstawie prefiksów z danego drzewa prefiksowego oraz parametrów.
+ * Przechodzi drzewo bez rekurencji i bez dodatkowej pamięci, wracając do
+ * ojców przez wskaźniki @p parent.
  * @param pf              –  Wskaźnik na drzewo prefiksowe.
  * @param cnt             –  Wskaźnik na zmienną przechowującą wynik.
  * @param maxLength       –  Długość nietrywialnego numeru.
@@ -546,86 +4755,203 @@ bool prefTreeAdd (prefTree t, const char* str) {
  */
 void prefTreeCount (prefTree pf, size_t* cnt, const size_t maxLength,
                     const size_t possibleDigits) {
-    if (pf != NULL) {
-        if (pf->leaf) {
-            size_t diff = maxLength - pf->length;
-            *cnt += fastPow(possibleDigits, diff);
+    prefTree node = pf;
+    size_t next = 0; // Indeks kolejnego syna do odwiedzenia.
+
+    while (node != NULL) {
+        // Prefiksy dłuższe od prawdziwego prefiksu nie są liczone.
+        if (next == 0 && node->leaf) {
+            *cnt += fastPow(possibleDigits, maxLength - node->length);
+            next = NUMBER_ALPHABET_SIZE;
+        }
 
-            return;
+        while (next < NUMBER_ALPHABET_SIZE && node->children[next] == NULL)
+            next++;
+
+        if (next < NUMBER_ALPHABET_SIZE) {
+            node = node->children[next];
+            next = 0;
         }
 
-        for (size_t i = 0; i < NUMBER_ALPHABET_SIZE; i++)
-            prefTreeCount(pf->children[i], cnt, maxLength, possibleDigits);
+        else if (node == pf) {
+            node = NULL;
+        }
+
+        else {
+            prefTree parent = node->parent;
+
+            next = 0;
+
+            while (parent->children[next] != node)
+                next++;
+
+            next++;
+            node = parent;
+        }
     }
 }
 
-/** Usuwa drzewo prefiksowe.
+/** @brief Usuwa drzewo prefiksowe.
+ * Działa bez rekurencji i bez dodatkowej pamięci, obracając drzewo tak jak
+ * funkcja @ref nodeDelete.
  * @param pf  –  Wskaźnik na drzewo prefiksowe.
  */
 void prefTreeDel (prefTree pf) {
-    if (pf != NULL) {
-        for (int i = 0; i < NUMBER_ALPHABET_SIZE; i++)
-            prefTreeDel(pf->children[i]);
+    while (pf != NULL) {
+        size_t i = 0;
 
-        free(pf);
+        while (i < NUMBER_ALPHABET_SIZE - 1 && pf->children[i] == NULL)
+            i++;
+
+        if (i < NUMBER_ALPHABET_SIZE - 1) {
+            prefTree child = pf->children[i];
+
+            pf->children[i] = child->children[NUMBER_ALPHABET_SIZE - 1];
+            child->children[NUMBER_ALPHABET_SIZE - 1] = pf;
+            pf = child;
+        }
+
+        else {
+            prefTree next = pf->children[NUMBER_ALPHABET_SIZE - 1];
+
+            free(pf);
+            pf = next;
+        }
     }
 }
 
-/** @brief Funkcja dodająca nietrywialne prefiksy do drzewa prefiksowego.
- * Przez nietrywialne prefiksy rozumiemy nietrywialne numery krótsze niż
- * dana długość.
- * @param pf              –  Wskaźnik na strukturę przechowującą przekierowania.
- * @param digits          –  Wskaźnik na tablicę przechowującą informację,
- *                           które cyfry są możliwe w nietrywialnych prefiksach.
- * @param maxLen          –  Długość nietrywialnego numeru.
- * @param possibleDigits  –  Moc zbioru możliwych liczb nietrywialnego numeru.
- * @param prefixes        –  Wskaźnik na drzewo prefiksowe.
+/** Dane przekazywane funkcji @ref ntcCallback.
  */
-void phfwdNTC (PhoneFwd pf, const bool* digits, size_t maxLen,
-               const size_t possibleDigits, prefTree prefixes) {
-    if (pf != NULL) {
-        if (pf->numForward != NULL) {
-            bool isValidNumber = true;
-            size_t i = 0;
+struct ntcCtx {
+    const bool* digits; /**< Wskaźnik na tablicę przechowującą informację,
+                             które cyfry są możliwe w nietrywialnych prefiksach. */
+    size_t maxLen;      ///< Długość nietrywialnego numeru.
+    prefTree prefixes;  ///< Wskaźnik na drzewo prefiksowe.
+    PhoneFwd pf;        ///< Przeglądana struktura.
+    size_t* visited;    ///< Wskaźnik na licznik odwiedzonych wierzchołków.
+};
 
-            while (pf->numForward[i] != 0 && i < maxLen) {
-                if (!digits[pf->numForward[i] - 48]) {
-                    isValidNumber = false;
-                    break;
-                }
+/** @brief Funkcja dodająca nietrywialny prefiks do drzewa prefiksowego.
+ * Przez nietrywialne prefiksy rozumiemy przekierowania nie dłuższe niż
+ * dana długość, złożone z możliwych cyfr.
+ * @param[in,out] ctx     –  Wskaźnik na strukturę @ref ntcCtx;
+ * @param[in] num         –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] numLength   –  Długość prefiksu przekierowywanego;
+ * @param[in] fwd         –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength   –  Długość przekierowania.
+ * @return Zawsze wartość @p true.
+ */
+static bool ntcCallback(void* ctx, const char* num, size_t numLength,
+                        const char* fwd, size_t fwdLength) {
+    struct ntcCtx* ntc = ctx;
+    (void)num;
+    (void)numLength;
 
-                i++;
-            }
+    if (fwdLength > ntc->maxLen)
+        return true;
+
+    for (size_t i = 0; i < fwdLength; i++)
+        if (!ntc->digits[fwd[i] - 48])
+            return true;
+
+    prefTreeAdd(ntc->prefixes, fwd, fwdLength);
+
+    return true;
+}
 
-            if (isValidNumber && pf->numForward[i] == 0) {
-                prefTreeAdd(prefixes, pf->numForward);
+/** Wyznacza najmniejszą cyfrę klasy nie mniejszą od danej.
+ * @param[in] mask   –  Klasa cyfr;
+ * @param[in] first  –  Najmniejsza dopuszczalna cyfra.
+ * @return Cyfra lub NUMBER_ALPHABET_SIZE, jeśli nie ma takiej cyfry.
+ */
+static unsigned maskNextDigit(unsigned mask, unsigned first) {
+    while (first < NUMBER_ALPHABET_SIZE && (mask & (1u << first)) == 0)
+        first++;
+
+    return first;
+}
+
+/** @brief Dodaje do drzewa prefiksowego przekierowanie wzorca zakresu.
+ * Przekierowanie nie jest dodawane, jeśli każdy prefiks wzorca ma zwykłe
+ * przekierowanie, które go przesłania. Prefiksy sprawdzane są do
+ * pierwszego nieprzesłoniętego, a przesłonięte prefiksy to różne zwykłe
+ * przekierowania, więc sprawdzanych prefiksów jest co najwyżej o jeden
+ * więcej niż zwykłych przekierowań. Funkcja typu @ref rangePatternCallback.
+ * @param[in,out] ctx    –  Wskaźnik na strukturę @ref ntcCtx;
+ * @param[in] masks      –  Wskaźnik na tablicę klas kolejnych cyfr wzorca;
+ * @param[in] length     –  Długość wzorca;
+ * @param[in] fwd        –  Wskaźnik na przekierowanie;
+ * @param[in] fwdLength  –  Długość przekierowania.
+ * @return Wartość @p true, jeśli należy kontynuować przeglądanie.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool ntcPatternCallback(void* ctx, const unsigned* masks, size_t length,
+                               const char* fwd, size_t fwdLength) {
+    struct ntcCtx* ntc = ctx;
+    char* prefix = malloc(length);
+
+    if (prefix == NULL)
+        return false;
+
+    for (size_t i = 0; i < length; i++)
+        prefix[i] = (char)('0' + maskNextDigit(masks[i], 0));
+
+    bool shadowed = true;
+    bool more = true;
+
+    while (shadowed && more) {
+        shadowed = baseHasKey(ntc->pf, prefix, length, ntc->visited);
+
+        // Przechodzimy do następnego prefiksu wzorca jak w liczniku.
+        size_t i = length;
+        more = false;
+
+        while (shadowed && !more && i-- > 0) {
+            unsigned d = maskNextDigit(masks[i], (unsigned)(prefix[i] - '0') + 1);
+
+            if (d < NUMBER_ALPHABET_SIZE) {
+                prefix[i] = (char)('0' + d);
+                more = true;
             }
-        }
 
-        for (size_t j = 0; j < NUMBER_ALPHABET_SIZE; j++)
-            phfwdNTC(pf->children[j], digits, maxLen, possibleDigits, prefixes);
+            else
+                prefix[i] = (char)('0' + maskNextDigit(masks[i], 0));
+        }
     }
+
+    free(prefix);
+
+    return shadowed || ntcCallback(ctx, "", 0, fwd, fwdLength);
 }
 
 
-size_t phfwdNonTrivialCount(PhoneFwd pf, const char* set, size_t len) {
+/** @brief Implementacja funkcji @ref phfwdNonTrivialCount.
+ * @param[in] pf      –  Wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] set     –  Wskaźnik na napis reprezentujący zbiór cyfr;
+ * @param[in] len     –  Długość numeru;
+ * @param[out] trace  –  Wskaźnik na liczniki dla punktów śledzenia.
+ * @return Liczba nietrywialnych numerów o podanej długości i zbiorze cyfr.
+ */
+static size_t nonTrivialCount(PhoneFwd pf, const char* set, size_t len,
+                              struct traceInfo* trace) {
     if (pf == NULL || set == NULL || len == 0)
         return 0;
 
     size_t setLen = strlen(set);
+    trace->keyLength = len;
 
     if (setLen == 0)
         return 0;
 
-    bool digits[12];
+    bool digits[NUMBER_ALPHABET_SIZE];
     size_t i = 0;
-    for (; i < 12; i++)
+    for (; i < NUMBER_ALPHABET_SIZE; i++)
         digits[i] = false;
 
     size_t digitsRead = 0; //Ile cyfr ze zbioru już wczytaliśmy.
     i = 0;
 
-    while (i < setLen && digitsRead < 13) {
+    while (i < setLen && digitsRead < NUMBER_ALPHABET_SIZE) {
         if (isValidDigit(set[i]) && !digits[set[i] - 48]) {
             digits[set[i] - 48] = true;
             digitsRead++;
@@ -637,20 +4963,217 @@ size_t phfwdNonTrivialCount(PhoneFwd pf, const char* set, size_t len) {
     size_t res = 0;
     prefTree prefixes = newPrefTree();
 
-    phfwdNTC(pf, digits, len, digitsRead, prefixes);
+    struct ntcCtx ctx = {digits, len, prefixes, pf, &trace->visited};
+
+    /* Liczą się tylko przekierowania, więc zakresów nie trzeba rozwijać;
+     * pomijamy tylko wzorce całkowicie przesłonięte zwykłymi
+     * przekierowaniami. */
+    baseForEach(pf, ntcCallback, &ctx, NULL, &trace->visited);
+
+    if (pf->ranges != NULL)
+        rangeTreeForEachPattern(pf->ranges, ntcPatternCallback, &ctx);
+
     prefTreeCount(prefixes, &res, len, digitsRead);
     prefTreeDel(prefixes);
 
     return res;
 }
 
+size_t phfwdNonTrivialCount(PhoneFwd pf, const char* set, size_t len) {
+    struct traceInfo trace = {0, 0};
+
+    PHFWD_PROBE2(ntc__entry, set, len);
+    size_t res = nonTrivialCount(pf, set, len, &trace);
+    PHFWD_PROBE3(ntc__return, trace.keyLength, trace.visited, res);
+
+    return res;
+}
+
+/** Element stosu używanego przy iteracyjnym przechodzeniu drzewa.
+ */
+struct statsFrame {
+    fwdNode node;  ///< Wskaźnik na wierzchołek do odwiedzenia.
+    size_t depth;  ///< Głębokość wierzchołka.
+};
+
+/** @brief Wyznacza statystyki zamrożonej reprezentacji.
+ * Wierzchołki leżą w kolejności przeszukiwania wszerz, więc kolejny poziom
+ * zaczyna się od pierwszego syna pierwszego wierzchołka poprzedniego poziomu.
+ * @param[in] fz      –  Wskaźnik na zamrożoną reprezentację;
+ * @param[out] stats  –  Wskaźnik na wyzerowaną strukturę statystyk.
+ */
+static void frozenStats(const struct phfwdFrozen* fz,
+                        struct PhoneForwardStats* stats) {
+    size_t depth = 0;
+    size_t levelEnd = 1;
+
+    for (size_t idx = 0; idx < fz->nodes; idx++) {
+        if (idx == levelEnd) {
+            depth++;
+            levelEnd = fz->firstChild[idx];
+        }
+
+        size_t children = popcount64(fz->childMask[idx]);
+
+        stats->fanoutHistogram[children]++;
+
+        if (depth < PHFWD_STATS_DEPTH_BUCKETS)
+            stats->depthHistogram[depth]++;
+        else
+            stats->depthHistogram[PHFWD_STATS_DEPTH_BUCKETS - 1]++;
+
+        if (children == 1 && frozenForward(fz, idx) == SIZE_MAX)
+            stats->passThroughNodes++;
+    }
+
+    size_t words = fz->nodes / 64 + 1;
+
+    stats->nodes = fz->nodes;
+    stats->forwards = fz->forwards;
+    stats->stringBytes = fz->targetOffset[fz->forwards];
+    stats->auxBytes = sizeof(struct phfwdFrozen) +
+                      fz->nodes * (sizeof(uint16_t) + 2 * sizeof(uint32_t)) +
+                      words * (sizeof(uint64_t) + sizeof(uint32_t)) +
+                      (fz->forwards + 1) * sizeof(uint32_t);
+}
+
+/** @brief Wyznacza statystyki drzewa wskaźnikowego.
+ * Przechodzi całe drzewo iteracyjnie, z jawnym stosem.
+ * @param[in] pf      –  Wskaźnik na strukturę przechowującą przekierowania;
+ * @param[out] stats  –  Wskaźnik na wyzerowaną strukturę statystyk.
+ * @return Wartość @p true, jeśli udało się wyznaczyć statystyki.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool treeStats(PhoneFwd pf, struct PhoneForwardStats* stats) {
+    size_t capacity = 64;
+    size_t top = 0;
+    struct statsFrame* stack = malloc(capacity * sizeof(struct statsFrame));
+
+    if (stack == NULL)
+        return false;
+
+    stack[top].node = pf->root;
+    stack[top++].depth = 0;
+
+    while (top > 0) {
+        struct statsFrame frame = stack[--top];
+        fwdNode node = frame.node;
+        size_t children = 0;
+
+        for (size_t i = 0; i < NUMBER_ALPHABET_SIZE; i++) {
+            if (node->children[i] == NULL)
+                continue;
+
+            children++;
+
+            if (top == capacity) {
+                struct statsFrame* bigger = realloc(stack, 2 * capacity *
+                                                    sizeof(struct statsFrame));
+
+                if (bigger == NULL) {
+                    free(stack);
+                    return false;
+                }
+
+                stack = bigger;
+                capacity *= 2;
+            }
+
+            stack[top].node = node->children[i];
+            stack[top++].depth = frame.depth + 1;
+        }
+
+        stats->nodes++;
+        stats->fanoutHistogram[children]++;
+
+        if (frame.depth < PHFWD_STATS_DEPTH_BUCKETS)
+            stats->depthHistogram[frame.depth]++;
+        else
+            stats->depthHistogram[PHFWD_STATS_DEPTH_BUCKETS - 1]++;
+
+        if (node->numForward != NULL) {
+            stats->forwards++;
+            stats->stringBytes += node->numLength + node->numForwardLength + 2;
+        }
+
+        else if (children == 1)
+            stats->passThroughNodes++;
+    }
+
+    free(stack);
+
+    if (pf->jumpTable != NULL)
+        stats->auxBytes = fastPow(NUMBER_ALPHABET_SIZE, pf->jumpDepth) *
+                          sizeof(struct phfwdJumpEntry);
+
+    return true;
+}
+
+bool phfwdStats(PhoneFwd pf, struct PhoneForwardStats* stats) {
+    if (pf == NULL || stats == NULL)
+        return false;
+
+    memset(stats, 0, sizeof(struct PhoneForwardStats));
+
+    size_t rangeBytes = 0;
+
+    if (pf->ranges != NULL &&
+        !rangeTreeSize(pf->ranges, &stats->rangeNodes, &stats->rangeForwards,
+                       &rangeBytes))
+        return false;
+
+    if (pf->engine != NULL) {
+        pf->engine->stats(pf->engineData, stats);
+        stats->totalBytes += sizeof(struct PhoneForward) + rangeBytes;
+
+        return true;
+    }
+
+    // Zamrożona reprezentacja nie ma osobnych wierzchołków ani tablicy skoków.
+    if (pf->frozen != NULL)
+        frozenStats(pf->frozen, stats);
+
+    else if (!treeStats(pf, stats))
+        return false;
+
+    for (Arena a = pf->arena; a != NULL; a = a->next)
+        stats->arenaBytes += a->bytes;
+
+    // Wycofane areny i kopia z kompaktowania nie są liczone w wierzchołkach.
+    size_t retainedBytes = 0;
+
+    for (Arena a = pf->retiredArenas; a != NULL; a = a->next)
+        retainedBytes += a->bytes;
+
+    if (pf->compaction != NULL)
+        retainedBytes += pf->compaction->arena->bytes;
+
+    stats->arenaBytes += retainedBytes;
+
+    stats->reclaimPending = pf->reclaimTop;
+    stats->reclaimedNodes = pf->reclaimed;
+
+    stats->totalBytes = sizeof(struct PhoneForward) +
+                        stats->nodes * (pf->frozen == NULL ?
+                                        sizeof(struct phfwdNode) : 0) +
+                        stats->stringBytes + stats->auxBytes + rangeBytes +
+                        retainedBytes;
+    stats->passThroughRatio = (double)stats->passThroughNodes /
+                              (double)stats->nodes;
+
+    return true;
+}
 
 void phnumDelete(const PhoneNum* pnum) {
     if (pnum != NULL) {
-        for (size_t i = 0; i < pnum->length; i++)
-            free(pnum->phNums[i]);
+        // Napisy struktury z phnumNewFlat leżą w tym samym bloku co ona.
+        if (pnum->pool == NULL) {
+            for (size_t i = 0; i < pnum->length; i++)
+                free(pnum->phNums[i]);
+
+            free(pnum->phNums);
+        }
 
-        free(pnum->phNums);
         free((void*)pnum);
     }
 }
@@ -13,39 +13,99 @@
 #include <stddef.h>
 #include <stdlib.h>
 
-#define NUMBER_ALPHABET_SIZE 12 ///< Makro na rozmiar alfabetu znaków tworzących numer.
+#ifndef PHFWD_ALPHABET_SIZE
+/** Rozmiar alfabetu wybierany przy budowaniu (opcja CMake PHFWD_ALPHABET_SIZE):
+ * 12 dla cyfr 0,...,9,:,; lub 10 dla samych cyfr dziesiętnych.
+ */
+#define PHFWD_ALPHABET_SIZE 12
+#endif
+
+#if PHFWD_ALPHABET_SIZE != 10 && PHFWD_ALPHABET_SIZE != 12
+#error "PHFWD_ALPHABET_SIZE must be 10 or 12"
+#endif
+
+#define NUMBER_ALPHABET_SIZE PHFWD_ALPHABET_SIZE ///< Makro na rozmiar alfabetu znaków tworzących numer.
+
+#define PHFWD_JUMP_MAX_DEPTH 6 ///< Makro na maksymalną głębokość tablicy skoków.
 
 /** @brief Struktura przechowująca przekierowania numerów telefonów.
- * Struktura jest w formie drzewa prefiksowego dowolnej długości ciągów
- * cyfr od 0,1,2,3,4,5,6,7,8,9,:,;.
- */
-struct PhoneForward {
-    struct PhoneForward* children[NUMBER_ALPHABET_SIZE]; /**< Tablica wskaźników na pochodne
-                                                              prefiksy dłuższe o jedną cyfrę. */
-    char* num;                         /**< Prefiks w tym wierzchołku.
-                                            Jeśli NULL, to temu prefiksowi
-                                            nie zostało przypisane
-                                            przekierowanie. */
-    char* numForward;                  ///< Przekierowanie prefiksu.
-    size_t numLength;                  ///< Długość prefiksu.
-    size_t numForwardLength;           ///< Długość przekierowania.
-};
+ * Struktura jest nieprzezroczysta: jej pola zna tylko phone_forward.c,
+ * a użytkownicy posługują się wskaźnikiem @ref PhoneFwd.
+ */
+struct PhoneForward;
 
 typedef struct PhoneForward* PhoneFwd; /**< Skrócona nazwa dla wskaźnika
                                             na strukturę @p PhoneForward. */
 
 
-/** Struktura przechowująca ciąg (w formie tablicy) numerów telefonów.
+/** @brief Struktura przechowująca ciąg (w formie tablicy) numerów telefonów.
+ * Struktura utworzona przez @ref phnumNewFlat leży w jednym bloku pamięci
+ * razem z tablicą @p phNums i sklejonymi napisami, więc jest zwalniana
+ * jednym wywołaniem free.
  */
 struct PhoneNumbers {
     char** phNums; ///< Tablica wskaźników na wskaźniki na napisy.
     size_t length; ///< Długość tablicy @p phNums.
+    char* pool;    /**< Obszar na sklejone napisy lub NULL, jeśli każdy
+                        napis zaalokowano osobno. */
 };
 
 /** Skrócona nazwa dla struktury @p PhoneNumbers.
  */
 typedef struct PhoneNumbers PhoneNum;
 
+/** @brief Wynik wsadowego wyznaczania przekierowań na numery.
+ * Cały wynik, razem z napisami, leży w jednym bloku pamięci zaraz za tą
+ * strukturą. Numery zapytania @p i to @p phNums[first[i]] do
+ * @p phNums[first[i + 1] - 1].
+ */
+struct PhoneNumbersBatch {
+    size_t queries; ///< Liczba zapytań.
+    size_t* first;  ///< Początki wyników kolejnych zapytań (@p queries + 1 elementów).
+    char** phNums;  ///< Tablica wskaźników na napisy wszystkich wyników.
+};
+
+/** Skrócona nazwa dla struktury @p PhoneNumbersBatch.
+ */
+typedef struct PhoneNumbersBatch PhoneBatch;
+
+#define PHFWD_STATS_DEPTH_BUCKETS 32 /**< Liczba przedziałów histogramu głębokości.
+                                          Ostatni przedział zlicza wszystkie
+                                          głębsze wierzchołki. */
+
+/** @brief Statystyki kształtu i zużycia pamięci struktury przekierowań.
+ * Wypełniana przez funkcję @ref phfwdStats. Rozmiary w bajtach nie
+ * uwzględniają narzutu alokatora.
+ */
+struct PhoneForwardStats {
+    size_t nodes;            ///< Liczba wierzchołków drzewa (razem z korzeniem).
+    size_t forwards;         ///< Liczba przekierowań.
+    size_t stringBytes;      ///< Liczba bajtów zajmowanych przez napisy.
+    size_t auxBytes;         /**< Liczba bajtów struktur pomocniczych, np.
+                                  tablicy skoków. */
+    size_t arenaBytes;       /**< Liczba bajtów zaalokowanych w arenach;
+                                  porównana z @p totalBytes pokazuje
+                                  fragmentację. */
+    size_t totalBytes;       /**< Łączna liczba bajtów wierzchołków, napisów,
+                                  struktur pomocniczych oraz aren czekających
+                                  na zwolnienie. */
+    size_t passThroughNodes; /**< Liczba wierzchołków przechodnich, tzn. bez
+                                  przekierowania i z dokładnie jednym synem. */
+    double passThroughRatio; ///< Stosunek @p passThroughNodes do @p nodes.
+    size_t depthHistogram[PHFWD_STATS_DEPTH_BUCKETS]; /**< Liczba wierzchołków
+                                                           na danej głębokości. */
+    size_t fanoutHistogram[NUMBER_ALPHABET_SIZE + 1]; /**< Liczba wierzchołków
+                                                           o danej liczbie synów. */
+    size_t reclaimPending;   /**< Liczba odłączonych poddrzew czekających na
+                                  zwolnienie. */
+    size_t reclaimedNodes;   /**< Łączna liczba wierzchołków zwolnionych
+                                  porcjami. */
+    size_t rangeNodes;       /**< Liczba wierzchołków drzewa przekierowań
+                                  zakresów (razem z korzeniem). */
+    size_t rangeForwards;    /**< Liczba wzorców, na które rozłożono
+                                  przekierowania zakresów. */
+};
+
 
 /** @brief Tworzy nową strukturę.
  * Tworzy nową strukturę niezawierającą żadnych przekierowań.
@@ -55,6 +115,34 @@ typedef struct PhoneNumbers PhoneNum;
 PhoneFwd phfwdNew(void);
 
 
+/** @brief Tworzy nową strukturę używającą danego silnika.
+ * Dostępne silniki to @p trie (drzewo prefiksowe, domyślny, tak jak
+ * @ref phfwdNew) oraz @p hash (tablice haszujące, zob. phfwd_hash.h).
+ * Funkcje specyficzne dla drzewa, tzn. @ref phfwdSetJumpDepth i
+ * @ref phfwdFreeze, nie są dostępne dla innych silników.
+ * @param[in] engine – wskaźnik na napis z nazwą silnika.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie ma silnika o
+ *         podanej nazwie lub nie udało się zaalokować pamięci.
+ */
+PhoneFwd phfwdNewEngine(const char* engine);
+
+
+/** @brief Sprawdza, czy istnieje silnik o danej nazwie.
+ * @param[in] engine – wskaźnik na napis z nazwą silnika.
+ * @return Wartość @p true, jeśli silnik istnieje.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+bool phfwdEngineExists(const char* engine);
+
+
+/** @brief Udostępnia nazwę silnika struktury.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania numerów.
+ * @return Wskaźnik na napis z nazwą silnika lub NULL, jeśli @p pf ma
+ *         wartość NULL.
+ */
+const char* phfwdEngineName(PhoneFwd pf);
+
+
 /** @brief Usuwa strukturę.
  * Usuwa strukturę wskazywaną przez @p pf. Nic nie robi, jeśli wskaźnik ten ma
  * wartość NULL.
@@ -81,10 +169,74 @@ void phfwdDelete(PhoneFwd pf);
 bool phfwdAdd(PhoneFwd pf, const char* num1, const char* num2);
 
 
+/** @brief Dodaje przekierowanie zakresu.
+ * Przekierowuje na @p num każdy prefiks @p p długości takiej jak @p from,
+ * który cyfra po cyfrze leży między @p from i @p to włącznie, jednym
+ * wywołaniem, w czasie i pamięci O(|@p from|) niezależnie od liczby
+ * prefiksów zakresu. Przy wyznaczaniu przekierowania wygrywa najdłuższy
+ * pasujący prefiks. Zwykłe przekierowanie (zob. @ref phfwdAdd) ma zawsze
+ * pierwszeństwo przed przekierowaniem zakresu tego samego prefiksu,
+ * niezależnie od kolejności dodania; prefiks przesłonięty w ten sposób nie
+ * jest też wynikiem @ref phfwdReverse. Ponowne dodanie zakresu zastępuje
+ * przekierowania zakresów jego prefiksów, a @ref phfwdRemove usuwa
+ * przekierowania zakresów tak, jakby były dodane osobno dla każdego
+ * prefiksu.
+ * @param[in] pf   – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] from – wskaźnik na napis reprezentujący początek zakresu;
+ * @param[in] to   – wskaźnik na napis reprezentujący koniec zakresu;
+ * @param[in] num  – wskaźnik na napis reprezentujący prefiks numerów, na
+ *                   które jest wykonywane przekierowanie.
+ * @return Wartość @p true, jeśli przekierowanie zostało dodane.
+ *         Wartość @p false, jeśli wystąpił błąd, np. któryś napis nie
+ *         reprezentuje numeru, @p from i @p to mają różne długości,
+ *         @p from jest większy od @p to, zakres to jeden prefiks równy
+ *         @p num lub nie udało się zaalokować pamięci.
+ */
+bool phfwdAddRange(PhoneFwd pf, const char* from, const char* to,
+                   const char* num);
+
+
+/** @brief Przekierowanie dodawane przez @ref phfwdAddAll.
+ */
+struct PhoneForwardRecord {
+    const char* num; ///< Wskaźnik na prefiks numerów przekierowywanych.
+    const char* fwd; ///< Wskaźnik na prefiks, na który jest przekierowanie.
+};
+
+
+/** @brief Dodaje wiele przekierowań naraz.
+ * Działa tak jak wywołania @ref phfwdAdd dla kolejnych przekierowań z
+ * tablicy @p records, więc przy powtórzonym prefiksie zostaje ostatnie
+ * przekierowanie. Jeśli struktura jest pustym drzewem prefiksowym, a
+ * przekierowań jest dużo, wczytywane są równolegle: przekierowania dzielone
+ * są na kubełki według pierwszych cyfr, każdy wątek buduje poddrzewa
+ * kolejnych kubełków, od największego, we własnej arenie, a na końcu
+ * poddrzewa podpinane są pod korzeń. W przeciwnym wypadku przekierowania
+ * dodawane są po kolei.
+ * @param[in] pf      – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] records – wskaźnik na tablicę przekierowań;
+ * @param[in] count   – liczba przekierowań;
+ * @param[in] threads – maksymalna liczba wątków lub 0, aby użyć tylu wątków,
+ *                      ile jest dostępnych procesorów.
+ * @return Wartość @p true, jeśli dodano wszystkie przekierowania.
+ *         Wartość @p false, jeśli @p pf ma wartość NULL, któreś
+ *         przekierowanie jest niepoprawne (wtedy nic nie jest dodawane) lub
+ *         nie udało się zaalokować pamięci (wtedy część przekierowań mogła
+ *         zostać dodana).
+ */
+bool phfwdAddAll(PhoneFwd pf, const struct PhoneForwardRecord* records,
+                 size_t count, size_t threads);
+
+
 /** @brief Usuwa przekierowania.
  * Usuwa wszystkie przekierowania, w których parametr @p num jest prefiksem
  * parametru @p num1 użytego przy dodawaniu. Jeśli nie ma takich przekierowań
- * lub napis nie reprezentuje numeru, nic nie robi.
+ * lub napis nie reprezentuje numeru, nic nie robi. Usuwane poddrzewo jest
+ * odłączane w czasie proporcjonalnym do długości @p num, a zwalniane porcjami
+ * przez kolejne zmiany struktury; każda z nich wykonuje ograniczoną liczbę
+ * kroków, proporcjonalną do długości zmienianego numeru. Wywołanie
+ * @ref phfwdMaintain jedynie przyspiesza zwalnianie.
  *
  * @param[in] pf  – wskaźnik na strukturę przechowującą przekierowania numerów;
  * @param[in] num – wskaźnik na napis reprezentujący prefiks numerów.
@@ -92,6 +244,90 @@ bool phfwdAdd(PhoneFwd pf, const char* num1, const char* num2);
 void phfwdRemove(PhoneFwd pf, const char* num);
 
 
+/** @brief Zlicza przekierowania o danym prefiksie.
+ * Wyznacza liczbę przekierowań dodanych funkcją @ref phfwdAdd, których
+ * parametr @p num1 zaczyna się od @p prefix, czyli tych, które usunęłoby
+ * wywołanie @ref phfwdRemove(@p pf, @p prefix). Drzewo przechowuje liczbę
+ * przekierowań każdego poddrzewa, więc wynik wyznaczany jest w czasie
+ * O(|@p prefix|); struktura z innym silnikiem niż @p trie przegląda
+ * wszystkie przekierowania. Przekierowania zakresów (zob.
+ * @ref phfwdAddRange) nie są liczone.
+ * @param[in] pf     – wskaźnik na strukturę przechowującą przekierowania
+ *                     numerów;
+ * @param[in] prefix – wskaźnik na napis reprezentujący prefiks numerów.
+ * @return Liczba przekierowań. Wartość 0, jeśli @p pf ma wartość NULL lub
+ *         napis nie reprezentuje numeru.
+ */
+size_t phfwdCount(PhoneFwd pf, const char* prefix);
+
+
+/** Rodzaje różnic między dwiema strukturami przekierowań.
+ */
+enum PhoneDiffKind {
+    PHFWD_DIFF_ADDED,   ///< Przekierowanie jest tylko w drugiej strukturze.
+    PHFWD_DIFF_REMOVED, ///< Przekierowanie jest tylko w pierwszej strukturze.
+    PHFWD_DIFF_CHANGED  ///< Ten sam prefiks jest przekierowany na inny numer.
+};
+
+
+/** @brief Funkcja przyjmująca kolejne różnice między strukturami.
+ * Napisy są ważne tylko do powrotu z funkcji.
+ * @param[in,out] ctx – dane wywołującego;
+ * @param[in] kind    – rodzaj różnicy;
+ * @param[in] num     – wskaźnik na napis reprezentujący prefiks
+ *                      przekierowywany;
+ * @param[in] oldFwd  – wskaźnik na przekierowanie w pierwszej strukturze lub
+ *                      NULL dla @ref PHFWD_DIFF_ADDED;
+ * @param[in] newFwd  – wskaźnik na przekierowanie w drugiej strukturze lub
+ *                      NULL dla @ref PHFWD_DIFF_REMOVED.
+ * @return Wartość @p true, jeśli należy przekazywać kolejne różnice.
+ *         Wartość @p false, jeśli należy przerwać przekazywanie.
+ */
+typedef bool (*PhoneDiffCallback)(void* ctx, enum PhoneDiffKind kind,
+                                  const char* num, const char* oldFwd,
+                                  const char* newFwd);
+
+
+/** @brief Przekazuje różnice między dwiema strukturami przekierowań.
+ * Przekazuje funkcji @p callback, w porządku leksykograficznym prefiksów,
+ * przekierowania dodane, usunięte i zmienione w @p to względem @p from.
+ * Drzewa obu struktur przechodzone są równocześnie, a każde poddrzewo
+ * przechowuje liczbę i sumę skrótów swoich przekierowań, więc identyczne
+ * poddrzewa są pomijane i czas zależy od liczby różnic, a nie od rozmiaru
+ * struktur. Jeśli któraś struktura jest zamrożona (zob. @ref phfwdFreeze)
+ * lub używa innego silnika niż @p trie, przeglądane są wszystkie
+ * przekierowania obu struktur. Przekierowania zakresów (zob.
+ * @ref phfwdAddRange) nie są porównywane.
+ * @param[in] from     – wskaźnik na pierwszą strukturę;
+ * @param[in] to       – wskaźnik na drugą strukturę;
+ * @param[in] callback – funkcja wywoływana dla kolejnych różnic;
+ * @param[in,out] ctx  – dane przekazywane funkcji @p callback.
+ * @return Wartość @p true, jeśli przekazano wszystkie różnice lub funkcja
+ *         @p callback przerwała przekazywanie.
+ *         Wartość @p false, jeśli któryś wskaźnik ma wartość NULL albo nie
+ *         udało się zaalokować pamięci; część różnic mogła już zostać
+ *         przekazana.
+ */
+bool phfwdDiff(PhoneFwd from, PhoneFwd to, PhoneDiffCallback callback,
+               void* ctx);
+
+
+/** @brief Uzgadnia przekierowania jednej struktury z drugą.
+ * Wprowadza do @p dst różnice wyznaczone przez @ref phfwdDiff(@p dst,
+ * @p src), tak że obie struktury mają te same przekierowania. Usuwane jest
+ * tylko przekierowanie danego prefiksu, bez przekierowań dłuższych
+ * prefiksów. Czas zależy od liczby różnic. Zamrożona struktura @p dst jest
+ * odmrażana. Przekierowania zakresów nie są zmieniane.
+ * @param[in,out] dst – wskaźnik na strukturę zmienianą;
+ * @param[in] src     – wskaźnik na strukturę wzorcową.
+ * @return Wartość @p true, jeśli struktury mają te same przekierowania.
+ *         Wartość @p false, jeśli któryś wskaźnik ma wartość NULL, @p dst
+ *         używa innego silnika niż @p trie lub nie udało się zaalokować
+ *         pamięci; część różnic mogła już zostać wprowadzona.
+ */
+bool phfwdMerge(PhoneFwd dst, PhoneFwd src);
+
+
 /** @brief Wyznacza przekierowanie numeru.
  * Wyznacza przekierowanie podanego numeru. Szuka najdłuższego pasującego
  * prefiksu. Wynikiem jest co najwyżej jeden numer. Jeśli dany numer nie został
@@ -106,6 +342,40 @@ void phfwdRemove(PhoneFwd pf, const char* num);
 const PhoneNum* phfwdGet(PhoneFwd pf, const char* num);
 
 
+/** Wynik wyznaczania docelowego numeru łańcucha przekierowań.
+ */
+enum PhoneResolveStatus {
+    PHFWD_RESOLVED,         ///< Osiągnięto numer bez przekierowania.
+    PHFWD_RESOLVE_CYCLE,    ///< Łańcuch przekierowań zawiera cykl.
+    PHFWD_RESOLVE_HOP_LIMIT ///< Przekroczono limit przekierowań.
+};
+
+
+/** @brief Wyznacza docelowy numer łańcucha przekierowań.
+ * Stosuje przekierowania tak jak @ref phfwdGet, dopóki numer ma
+ * przekierowanie, bez alokowania pamięci dla pośrednich numerów. Przerywa
+ * po @p maxHops przekierowaniach. Cykl wykrywany jest algorytmem Brenta
+ * najpóźniej po 2(μ + λ) przekierowaniach, gdzie μ to liczba numerów przed
+ * cyklem, a λ to długość cyklu; przy mniejszym limicie cykl może zostać
+ * zgłoszony jako przekroczenie limitu. Łańcuchy są
+ * zapamiętywane w strukturze i unieważniane tylko wtedy, gdy
+ * @ref phfwdAdd lub @ref phfwdRemove zmienia przekierowanie któregoś z ich
+ * numerów. Alokuje strukturę @p PhoneNumbers, która musi być zwolniona za
+ * pomocą funkcji @ref phnumDelete.
+ * @param[in] pf       – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num      – wskaźnik na napis reprezentujący numer;
+ * @param[in] maxHops  – maksymalna liczba zastosowanych przekierowań;
+ * @param[out] status  – wskaźnik na zmienną, do której zostanie zapisany
+ *                       wynik wyznaczania, lub NULL.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+ *         udało się zaalokować pamięci. Ciąg zawiera numer docelowy. Jest
+ *         pusty, jeśli wykryto cykl, przekroczono limit lub napis nie
+ *         reprezentuje numeru.
+ */
+const PhoneNum* phfwdResolve(PhoneFwd pf, const char* num, size_t maxHops,
+                             enum PhoneResolveStatus* status);
+
+
 /** @brief Wyznacza przekierowania na dany numer.
  * Wyznacza wszystkie przekierowania na podany numer. Wynikowy ciąg zawiera też
  * dany numer. Wynikowe numery są posortowane leksykograficznie i nie mogą się
@@ -120,6 +390,107 @@ const PhoneNum* phfwdGet(PhoneFwd pf, const char* num);
 const PhoneNum* phfwdReverse(PhoneFwd pf, const char* num);
 
 
+/** @brief Funkcja przyjmująca kolejne numery wyniku.
+ * @param[in,out] ctx – dane wywołującego;
+ * @param[in] num     – wskaźnik na napis reprezentujący numer, ważny tylko
+ *                      do powrotu z funkcji.
+ * @return Wartość @p true, jeśli należy przekazywać kolejne numery.
+ *         Wartość @p false, jeśli należy przerwać przekazywanie.
+ */
+typedef bool (*PhoneNumCallback)(void* ctx, const char* num);
+
+
+/** @brief Przekazuje przekierowania na dany numer do funkcji wywołującego.
+ * Przekazuje funkcji @p callback kolejno te same numery, które zwróciłaby
+ * funkcja @ref phfwdReverse, posortowane i bez powtórzeń, w miarę ich
+ * wyznaczania. Numery nie są przechowywane, więc zużycie pamięci zależy
+ * tylko od długości najdłuższego prefiksu w strukturze. Jeśli napis nie
+ * reprezentuje numeru, nie przekazuje żadnego numeru.
+ * @param[in] pf       – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num      – wskaźnik na napis reprezentujący numer;
+ * @param[in] callback – funkcja wywoływana dla kolejnych numerów;
+ * @param[in,out] ctx  – dane przekazywane funkcji @p callback.
+ * @return Wartość @p true, jeśli przekazano wszystkie numery lub funkcja
+ *         @p callback przerwała przekazywanie.
+ *         Wartość @p false, jeśli @p pf lub @p callback ma wartość NULL albo
+ *         nie udało się zaalokować pamięci; część numerów mogła już zostać
+ *         przekazana.
+ */
+bool phfwdReverseEach(PhoneFwd pf, const char* num, PhoneNumCallback callback,
+                      void* ctx);
+
+
+/** @brief Wyznacza przekierowania wielu numerów bez alokowania wyników.
+ * Dla kolejnych napisów z tablicy @p nums przekazuje funkcji @p callback
+ * numer, który zwróciłaby funkcja @ref phfwdGet, a dla napisu
+ * niereprezentującego numeru napis pusty. Wyniki składane są we wspólnym
+ * buforze, więc przekazany napis jest ważny tylko w trakcie wywołania
+ * funkcji @p callback.
+ * @param[in] pf       – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] nums     – wskaźnik na tablicę wskaźników na napisy;
+ * @param[in] count    – liczba napisów;
+ * @param[in] callback – funkcja wywoływana dla kolejnych wyników;
+ * @param[in,out] ctx  – dane przekazywane funkcji @p callback.
+ * @return Wartość @p true, jeśli przekazano wszystkie wyniki.
+ *         Wartość @p false, jeśli @p pf ma wartość NULL, funkcja
+ *         @p callback przerwała przekazywanie lub nie udało się zaalokować
+ *         pamięci.
+ */
+bool phfwdGetEach(PhoneFwd pf, const char* const* nums, size_t count,
+                  PhoneNumCallback callback, void* ctx);
+
+
+/** @brief Zlicza przekierowania na dany numer.
+ * Wyznacza liczbę numerów, które zwróciłaby funkcja @ref phfwdReverse, bez
+ * ich przechowywania. Numery są generowane w porządku leksykograficznym, a
+ * pamięć zależy tylko od długości najdłuższego prefiksu w strukturze.
+ * @param[in] pf  – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num – wskaźnik na napis reprezentujący numer.
+ * @return Liczba różnych numerów przekierowywanych na @p num, razem z nim
+ *         samym. Wartość 0, jeśli @p pf ma wartość NULL, napis nie
+ *         reprezentuje numeru lub nie udało się zaalokować pamięci.
+ */
+size_t phfwdReverseCount(PhoneFwd pf, const char* num);
+
+
+/** @brief Wyznacza stronę przekierowań na dany numer.
+ * Wyznacza co najwyżej @p limit pierwszych w porządku leksykograficznym
+ * numerów, które zwróciłaby funkcja @ref phfwdReverse, większych od
+ * @p after. Aby pobrać kolejną stronę, należy jako @p after podać ostatni
+ * numer bieżącej strony. Zużycie pamięci zależy od @p limit, a nie od
+ * liczby wszystkich wyników. Alokuje strukturę @p PhoneNumbers, która musi
+ * być zwolniona za pomocą funkcji @ref phnumDelete.
+ * @param[in] pf    – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num   – wskaźnik na napis reprezentujący numer;
+ * @param[in] after – wskaźnik na ostatni numer poprzedniej strony lub NULL,
+ *                    jeśli należy pobrać pierwszą stronę;
+ * @param[in] limit – maksymalna liczba numerów na stronie.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+ *         udało się zaalokować pamięci. Pusty ciąg oznacza koniec wyników.
+ */
+const PhoneNum* phfwdReversePage(PhoneFwd pf, const char* num,
+                                 const char* after, size_t limit);
+
+
+/** @brief Wyznacza przekierowania na wiele numerów naraz.
+ * Dla każdego numeru z tablicy @p nums wyznacza to samo co
+ * @ref phfwdReverse, ale wszystkie zapytania obsługuje jednym przejściem
+ * struktury przekierowań: zapytania układane są w posortowane drzewo
+ * prefiksowe, po którym schodzi się wzdłuż każdego przekierowania. Wynik
+ * zapytania, które nie reprezentuje numeru, jest pusty. Alokuje strukturę
+ * @p PhoneNumbersBatch, która musi być zwolniona za pomocą funkcji
+ * @ref phbatchDelete.
+ * @param[in] pf     – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] nums   – wskaźnik na tablicę wskaźników na napisy reprezentujące
+ *                     numery;
+ * @param[in] count  – liczba numerów.
+ * @return Wskaźnik na strukturę przechowującą wyniki lub NULL, gdy @p pf ma
+ *         wartość NULL lub nie udało się zaalokować pamięci.
+ */
+const PhoneBatch* phfwdReverseBatch(PhoneFwd pf, const char* const* nums,
+                                    size_t count);
+
+
 /** @brief Oblicza liczbę nietrywialnych numerów.
  * Oblicza liczbę nietrywialnych numerów długości @p len zawierających tylko
  * cyfry, które znajdują się w napisie @p set.
@@ -134,6 +505,97 @@ const PhoneNum* phfwdReverse(PhoneFwd pf, const char* num);
 size_t phfwdNonTrivialCount(PhoneFwd pf, const char* set, size_t len);
 
 
+/** @brief Ustawia głębokość tablicy skoków.
+ * Tablica skoków ma NUMBER_ALPHABET_SIZE^@p depth komórek indeksowanych
+ * pierwszymi @p depth cyframi numeru. Każda komórka wskazuje wierzchołek na
+ * głębokości @p depth oraz najdłuższe przekierowanie na ścieżce do niego, więc
+ * wyszukiwanie numeru co najmniej tak długiego pomija górne poziomy drzewa.
+ * Tablica jest aktualizowana przy dodawaniu i usuwaniu przekierowań.
+ * @param[in] pf     –  wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] depth  –  głębokość tablicy; wartość 0 wyłącza tablicę.
+ * @return Wartość @p true, jeśli ustawiono tablicę o podanej głębokości.
+ *         Wartość @p false, jeśli @p pf ma wartość NULL, struktura nie używa
+ *         drzewa prefiksowego, głębokość przekracza
+ *         @ref PHFWD_JUMP_MAX_DEPTH lub nie udało się zaalokować pamięci;
+ *         w ostatnim przypadku tablica zostaje wyłączona.
+ */
+bool phfwdSetJumpDepth(PhoneFwd pf, size_t depth);
+
+
+/** @brief Rozpoczyna kompaktowanie struktury.
+ * Kompaktowanie przepisuje wierzchołki i napisy do ciągłej pamięci w
+ * kolejności przeszukiwania w głąb, po czym podmienia drzewo i zwalnia starą
+ * pamięć. Praca wykonywana jest porcjami przy kolejnych zmianach struktury
+ * oraz przez @ref phfwdMaintain. Dodanie
+ * lub usunięcie przekierowania w trakcie kopiowania poprawia już skopiowaną
+ * ścieżkę, więc kopiowanie postępuje mimo kolejnych zmian.
+ * Dla silników innych niż drzewo prefiksowe nic nie robi.
+ * @param[in] pf  –  wskaźnik na strukturę przechowującą przekierowania numerów.
+ * @return Wartość @p true, jeśli kompaktowanie zostało rozpoczęte lub już trwa.
+ *         Wartość @p false, jeśli @p pf ma wartość NULL lub nie udało się
+ *         zaalokować pamięci.
+ */
+bool phfwdCompact(PhoneFwd pf);
+
+
+/** @brief Wykonuje porcję prac w tle.
+ * Kopiuje co najwyżej @p budget wierzchołków trwającego kompaktowania, a z
+ * pozostałego budżetu zwalnia odłączone wierzchołki. Odłączone wierzchołki
+ * zwalniane są dopiero po zakończeniu kompaktowania. Wywołanie jest
+ * opcjonalne: tę samą pracę ograniczonymi porcjami wykonują funkcje
+ * zmieniające strukturę; pozwala jednak wykonać ją szybciej, np. w czasie
+ * bezczynności.
+ * @param[in] pf      –  wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] budget  –  maksymalna liczba przetworzonych wierzchołków.
+ * @return Wartość @p true, jeśli pozostała jeszcze jakaś praca.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+bool phfwdMaintain(PhoneFwd pf, size_t budget);
+
+
+/** @brief Przygotowuje strukturę do usunięcia porcjami.
+ * Od razu zwalnia wszystko poza drzewem i pierwszą porcję drzewa, a resztę
+ * odkłada do zwolnienia przez @ref phfwdMaintain. Po wywołaniu na strukturze
+ * można wywoływać już tylko @ref phfwdMaintain i @ref phfwdDelete; ta
+ * druga jest tania, gdy @ref phfwdMaintain zwróci @p false. Pamięć innych
+ * silników niż drzewo prefiksowe zwalniana jest od razu. Nic nie robi,
+ * jeśli wskaźnik @p pf ma wartość NULL.
+ * @param[in] pf  –  wskaźnik na strukturę przechowującą przekierowania numerów.
+ */
+void phfwdRetire(PhoneFwd pf);
+
+
+/** @brief Zamraża strukturę.
+ * Zastępuje drzewo zwartą reprezentacją tylko do odczytu: wierzchołki
+ * ponumerowane wszerz opisane są maskami bitowymi synów, a przekierowania,
+ * upakowane po dwie cyfry w bajcie, sklejone są w jedną tablicę indeksowaną
+ * rangiem na wektorze bitowym.
+ * Funkcje @ref phfwdGet, @ref phfwdReverse i @ref phfwdNonTrivialCount
+ * działają bezpośrednio na tej reprezentacji. Dodanie lub usunięcie
+ * przekierowania najpierw odmraża strukturę. Trwające kompaktowanie jest
+ * porzucane, a stare drzewo zwalniane porcjami przez @ref phfwdMaintain.
+ * @param[in] pf  –  wskaźnik na strukturę przechowującą przekierowania numerów.
+ * @return Wartość @p true, jeśli struktura została zamrożona lub już była.
+ *         Wartość @p false, jeśli @p pf ma wartość NULL, struktura nie używa
+ *         drzewa prefiksowego lub nie udało się zaalokować pamięci; wtedy
+ *         struktura pozostaje niezmieniona.
+ */
+bool phfwdFreeze(PhoneFwd pf);
+
+
+/** @brief Wyznacza statystyki struktury przekierowań.
+ * Przechodzi całe drzewo iteracyjnie (bez rekurencji) i wypełnia strukturę
+ * wskazywaną przez @p stats.
+ * @param[in] pf      –  wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[out] stats  –  wskaźnik na strukturę, do której zostaną zapisane
+ *                       statystyki.
+ * @return Wartość @p true, jeśli udało się wyznaczyć statystyki.
+ *         Wartość @p false, jeśli któryś ze wskaźników ma wartość NULL lub
+ *         nie udało się zaalokować pamięci.
+ */
+bool phfwdStats(PhoneFwd pf, struct PhoneForwardStats* stats);
+
+
 /** @brief Tworzy nową strukturę typu @p PhoneNumbers.
  * Tworzy nową strukturę niezawierającą żadnych numerów.
  * @param[in] len  –  długość tablicy w tworzonej strukturze.
@@ -142,6 +604,18 @@ size_t phfwdNonTrivialCount(PhoneFwd pf, const char* set, size_t len);
  */
 PhoneNum* phnumNew(size_t len);
 
+
+/** @brief Tworzy nową strukturę typu @p PhoneNumbers w jednym bloku pamięci.
+ * Wskaźniki w tablicy @p phNums mają wartość NULL; napisy, razem z kończącymi
+ * je znakami '\0', należy umieścić w obszarze @p pool i ustawić na nie
+ * wskaźniki. Strukturę zwalnia @ref phnumDelete.
+ * @param[in] len    –  długość tablicy w tworzonej strukturze;
+ * @param[in] bytes  –  rozmiar obszaru na napisy.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
+ *         zaalokować pamięci.
+ */
+PhoneNum* phnumNewFlat(size_t len, size_t bytes);
+
 /** @brief Usuwa strukturę.
  * Usuwa strukturę wskazywaną przez @p pnum. Nic nie robi, jeśli wskaźnik ten ma
  * wartość NULL.
@@ -160,8 +634,31 @@ void phnumDelete(const PhoneNum* pnum);
  */
 const char* phnumGet(const PhoneNum* pnum, size_t idx);
 
+/** @brief Udostępnia liczbę wyników zapytania wsadowego.
+ * @param[in] pb     – wskaźnik na wynik zapytania wsadowego;
+ * @param[in] query  – indeks zapytania.
+ * @return Liczba numerów w wyniku zapytania. Wartość 0, jeśli wskaźnik @p pb
+ *         ma wartość NULL lub indeks ma za dużą wartość.
+ */
+size_t phbatchLength(const PhoneBatch* pb, size_t query);
+
+/** @brief Udostępnia numer z wyniku zapytania wsadowego.
+ * @param[in] pb     – wskaźnik na wynik zapytania wsadowego;
+ * @param[in] query  – indeks zapytania;
+ * @param[in] idx    – indeks numeru w wyniku zapytania.
+ * @return Wskaźnik na napis. Wartość NULL, jeśli wskaźnik @p pb ma wartość
+ *         NULL lub któryś z indeksów ma za dużą wartość.
+ */
+const char* phbatchGet(const PhoneBatch* pb, size_t query, size_t idx);
+
+/** @brief Usuwa wynik zapytania wsadowego.
+ * Nic nie robi, jeśli wskaźnik @p pb ma wartość NULL.
+ * @param[in] pb – wskaźnik na usuwaną strukturę.
+ */
+void phbatchDelete(const PhoneBatch* pb);
+
 /** @brief Sprawdza, czy c jest prawidłowym znakiem reprezentującym cyfrę.
- * Zależy od definicji cyfry.
+ * Cyframi jest pierwszych NUMBER_ALPHABET_SIZE znaków od '0'.
  * @param c  –  Znak do sprawdzenia.
  * @return Wartość @p true, jeśli podany znak jest cyfrą.
  *         Wartość @p false w przeciwnym wypadku.
@@ -10,18 +10,84 @@
 #include "phone_forward.h"
 #include "stdio.h"
 #include "parser.h"
+#include "binary_parser.h"
+#include "lookup_stream.h"
+#include "command_trace.h"
+
+/** Liczba wierzchołków przetwarzanych w tle w każdej bazie z pracą w tle po
+ * każdym poleceniu (zob. @ref maintainDtbList). */
+#define MAINTENANCE_BUDGET 4096
 
 
 /** Główna funkcja parsująca dane wejściowe.
+ * Z opcją @p --binary dane wejściowe przetwarzane są w binarnym protokole
+ * (zob. binary_parser.h), z opcją @p --lookup @p plik wyznaczane są
+ * przekierowania numerów z bazy w pliku (zob. lookup_stream.h), a w
+ * przeciwnym wypadku dane przetwarzane są w interfejsie tekstowym. Opcja
+ * @p --record @p plik zapisuje przetworzone polecenia do pliku, a opcja
+ * @p --replay @p plik [@p --paced] odtwarza je (zob. command_trace.h).
+ * @param[in] argc  –  Liczba argumentów programu;
+ * @param[in] argv  –  Tablica argumentów programu.
  * @return Wartość 0, gdy bezbłędnie przetworzono całe dane wejściowe.
  *         Wartość 1, gdy gdzieś wystąpił błąd.
  */
-int main (void) {
+int main (int argc, char* argv[]) {
+    bool binary = false;
+    bool paced = false;
+    bool invalid = false;
+    const char* lookupPath = NULL;
+    const char* recordPath = NULL;
+    const char* replayPath = NULL;
+
+    for (int i = 1; !invalid && i < argc; i++) {
+        if (strcmp(argv[i], "--binary") == 0)
+            binary = true;
+
+        else if (strcmp(argv[i], "--lookup") == 0 && i + 1 < argc)
+            lookupPath = argv[++i];
+
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replayPath = argv[++i];
+
+        else if (strcmp(argv[i], "--paced") == 0)
+            paced = true;
+
+        else
+            invalid = true;
+    }
+
+    // Tryby --lookup i --replay nie czytają poleceń ze standardowego wejścia.
+    if ((lookupPath != NULL || replayPath != NULL) &&
+        (binary || recordPath != NULL ||
+         (lookupPath != NULL && replayPath != NULL)))
+        invalid = true;
+
+    if (invalid || (paced && replayPath == NULL)) {
+        fprintf(stderr, "usage: %s [--binary] [--record FILE] | --lookup FILE |"
+                        " --replay FILE [--paced]\n", argv[0]);
+        return 1;
+    }
+
+    if (lookupPath != NULL)
+        return lookupStream(lookupPath) ? 0 : 1;
+
+    if (replayPath != NULL)
+        return traceReplay(replayPath, paced, MAINTENANCE_BUDGET) ? 0 : 1;
+
+    cmdTrace trace = NULL;
+
+    if (recordPath != NULL && (trace = traceOpen(recordPath, binary)) == NULL)
+        return 1;
+
     // INICJALIZACJA
     size_t position = 0;
     size_t* pos = &position;
 
     dynStr buffer = dynStrInit();
+    dynStr scratch = dynStrInit();
 
     dtbList dtb = NULL;
     dtbList* dtblist = &dtb;
@@ -39,18 +105,36 @@ int main (void) {
         ungetc(c, stdin);
         (*pos)--;
 
-        if (!parseExpression(pos, buffer, dtblist, current)) {
+        enum commandType command;
+
+        if (trace != NULL)
+            traceCommandBegin(trace, *pos, *current == NULL ? NULL : (*current)->id);
+
+        bool ok = binary ?
+                  parseBinary(pos, buffer, scratch, dtblist, current, &command) :
+                  parseExpression(pos, buffer, scratch, dtblist, current, &command);
+
+        if (trace != NULL && !traceCommandEnd(trace, *pos, command, ok))
+            ok = false;
+
+        if (!ok) {
             error = 1;
             break;
         }
 
+        maintainDtbList(dtblist, *current, MAINTENANCE_BUDGET);
+
         c = getchar();
         (*pos)++;
     }
 
     // DEALOKACJA PAMIĘCI
     dynStrDelete(buffer);
+    dynStrDelete(scratch);
     removeDtbList(dtb);
 
+    if (!traceClose(trace))
+        error = 1;
+
     return error;
 }
\ No newline at end of file
@@ -0,0 +1,45 @@
+/** @file
+ * Implementacja funkcji wczytującej cały plik do pamięci.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#include "read_all.h"
+
+#define READ_ALL_BLOCK_SIZE (1 << 16) ///< Początkowy rozmiar bufora.
+
+char* readAll (FILE* file, size_t* length) {
+    size_t capacity = READ_ALL_BLOCK_SIZE;
+    size_t used = 0;
+    char* data = malloc(capacity);
+
+    while (data != NULL) {
+        used += fread(data + used, 1, capacity - used, file);
+
+        // Pętla kończy się, gdy w buforze zostało miejsce na jeszcze jeden znak.
+        if (used < capacity)
+            break;
+
+        char* bigger = realloc(data, 2 * capacity);
+
+        if (bigger == NULL) {
+            free(data);
+            data = NULL;
+        }
+
+        else {
+            data = bigger;
+            capacity *= 2;
+        }
+    }
+
+    if (data != NULL && ferror(file) != 0) {
+        free(data);
+        data = NULL;
+    }
+
+    *length = used;
+
+    return data;
+}
@@ -0,0 +1,25 @@
+/** @file
+ * Specyfikacja funkcji wczytującej cały plik do pamięci.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#ifndef TELEFONY_READ_ALL_H
+#define TELEFONY_READ_ALL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/** @brief Wczytuje cały plik do pamięci.
+ * Czyta plik do końca do bufora podwajanego w miarę potrzeb. Za danymi
+ * zawsze zostaje co najmniej jeden wolny bajt, więc wywołujący może dopisać
+ * znak '\0' lub znak nowej linii bez realokacji.
+ * @param[in,out] file  –  Wskaźnik na plik otwarty do odczytu;
+ * @param[out] length   –  Wskaźnik na długość wczytanych danych.
+ * @return Wskaźnik na dane, które trzeba zwolnić, lub NULL, jeśli nie udało
+ *         się zaalokować pamięci lub wystąpił błąd odczytu.
+ */
+char* readAll (FILE* file, size_t* length);
+
+#endif //TELEFONY_READ_ALL_H
@@ -0,0 +1,478 @@
+/** @file
+ * Wspólny test zgodności silników przechowywania przekierowań.
+ *
+ * Każdy silnik (@p trie i @p hash) wykonuje ten sam ciąg operacji w kilku
+ * wariantach: bez dodatków, z tablicą skoków (@p JUMP), z kompaktowaniem w
+ * tle (@p COMPACT), z zamrażaniem (@p FREEZE) i ze wszystkimi naraz.
+ * Silniki, które nie obsługują danego dodatku, odrzucają go, a ich wyniki
+ * nie mogą się przez to zmienić. Najpierw sprawdzany jest krótki scenariusz
+ * z wypisanymi wynikami, a potem losowy ciąg operacji porównywany z
+ * prostym modelem: listą przekierowań przeglądaną w całości przy każdym
+ * zapytaniu.
+ *
+ * Program wypisuje wynik każdego wariantu i kończy się kodem 0, jeśli
+ * wszystkie warianty dały oczekiwane wyniki.
+ *
+ * @author Jan Kociniak <jk394348@students.mimuw.edu.pl>
+ * @date 01.06.2018
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/phone_forward.h"
+
+#define TEST_VARIANT_JUMP 1    ///< Wariant z tablicą skoków.
+#define TEST_VARIANT_COMPACT 2 ///< Wariant z kompaktowaniem w tle.
+#define TEST_VARIANT_FREEZE 4  ///< Wariant z zamrażaniem.
+
+#define TEST_OPERATIONS 4000   ///< Liczba losowych operacji w wariancie.
+#define TEST_MAX_FORWARDS 1024 ///< Maksymalna liczba przekierowań modelu.
+#define TEST_KEY_LENGTH 16     ///< Maksymalna długość numeru w modelu.
+#define TEST_DIGITS "0139"     ///< Cyfry losowanych numerów.
+#define TEST_NTC_LENGTH 4      ///< Maksymalna długość numerów NTC.
+
+/** Przekierowanie modelu.
+ */
+struct modelForward {
+    char num[TEST_KEY_LENGTH + 1]; ///< Prefiks przekierowywany.
+    char fwd[TEST_KEY_LENGTH + 1]; ///< Przekierowanie.
+};
+
+/** Model struktury przekierowań.
+ */
+struct model {
+    struct modelForward forwards[TEST_MAX_FORWARDS]; ///< Przekierowania.
+    size_t count;                                    ///< Liczba przekierowań.
+};
+
+/** Wariant testu.
+ */
+struct variant {
+    const char* engine; ///< Nazwa silnika.
+    unsigned flags;     ///< Dodatki, zob. TEST_VARIANT_*.
+    const char* name;   ///< Nazwa wariantu.
+};
+
+/** Testowane warianty. */
+static const struct variant variants[] = {
+    {"trie", 0, "plain"},
+    {"trie", TEST_VARIANT_JUMP, "jump"},
+    {"trie", TEST_VARIANT_COMPACT, "compact"},
+    {"trie", TEST_VARIANT_FREEZE, "freeze"},
+    {"trie", TEST_VARIANT_JUMP | TEST_VARIANT_COMPACT | TEST_VARIANT_FREEZE,
+     "all"},
+    {"hash", 0, "plain"},
+    {"hash", TEST_VARIANT_JUMP, "jump"},
+    {"hash", TEST_VARIANT_COMPACT, "compact"},
+    {"hash", TEST_VARIANT_FREEZE, "freeze"},
+    {"hash", TEST_VARIANT_JUMP | TEST_VARIANT_COMPACT | TEST_VARIANT_FREEZE,
+     "all"}
+};
+
+/** Stan generatora liczb pseudolosowych. */
+static uint64_t randomState;
+
+/** Losuje liczbę (xorshift64).
+ * @return Kolejna liczba pseudolosowa.
+ */
+static uint64_t randomNext (void) {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+
+    return randomState;
+}
+
+/** Losuje numer.
+ * @param[out] num      –  Wskaźnik na bufor o rozmiarze co najmniej
+ *                         @p maxLength + 1;
+ * @param[in] minLength –  Najmniejsza długość numeru;
+ * @param[in] maxLength –  Największa długość numeru.
+ */
+static void randomNumber (char* num, size_t minLength, size_t maxLength) {
+    size_t length = minLength + randomNext() % (maxLength - minLength + 1);
+
+    for (size_t i = 0; i < length; i++)
+        num[i] = TEST_DIGITS[randomNext() % (sizeof(TEST_DIGITS) - 1)];
+
+    num[length] = '\0';
+}
+
+/** Sprawdza, czy napis zaczyna się od danego prefiksu.
+ * @param[in] str     –  Wskaźnik na napis;
+ * @param[in] prefix  –  Wskaźnik na prefiks.
+ * @return Wartość @p true, jeśli @p prefix jest prefiksem @p str.
+ */
+static bool startsWith (const char* str, const char* prefix) {
+    return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+/** Dodaje przekierowanie do modelu.
+ * @param[in,out] m  –  Wskaźnik na model;
+ * @param[in] num    –  Wskaźnik na prefiks przekierowywany;
+ * @param[in] fwd    –  Wskaźnik na przekierowanie.
+ */
+static void modelAdd (struct model* m, const char* num, const char* fwd) {
+    size_t i = 0;
+
+    while (i < m->count && strcmp(m->forwards[i].num, num) != 0)
+        i++;
+
+    if (i == m->count)
+        strcpy(m->forwards[m->count++].num, num);
+
+    strcpy(m->forwards[i].fwd, fwd);
+}
+
+/** Usuwa z modelu przekierowania prefiksów zaczynających się od numeru.
+ * @param[in,out] m  –  Wskaźnik na model;
+ * @param[in] num    –  Wskaźnik na numer.
+ */
+static void modelRemove (struct model* m, const char* num) {
+    size_t i = 0;
+
+    while (i < m->count) {
+        if (startsWith(m->forwards[i].num, num))
+            m->forwards[i] = m->forwards[--m->count];
+        else
+            i++;
+    }
+}
+
+/** Wyznacza przekierowanie numeru w modelu.
+ * @param[in] m     –  Wskaźnik na model;
+ * @param[in] num   –  Wskaźnik na numer;
+ * @param[out] res  –  Wskaźnik na bufor na wynik.
+ */
+static void modelGet (const struct model* m, const char* num, char* res) {
+    const struct modelForward* best = NULL;
+
+    for (size_t i = 0; i < m->count; i++)
+        if (startsWith(num, m->forwards[i].num) &&
+            (best == NULL || strlen(m->forwards[i].num) > strlen(best->num)))
+            best = &m->forwards[i];
+
+    if (best == NULL)
+        strcpy(res, num);
+
+    else
+        sprintf(res, "%s%s", best->fwd, num + strlen(best->num));
+}
+
+/** Porównuje napisy dla funkcji qsort.
+ * @param[in] a  –  Wskaźnik na pierwszy napis;
+ * @param[in] b  –  Wskaźnik na drugi napis.
+ * @return Wynik funkcji strcmp.
+ */
+static int compareStrings (const void* a, const void* b) {
+    return strcmp((const char*)a, (const char*)b);
+}
+
+/** Wyznacza przekierowania na numer w modelu.
+ * @param[in] m      –  Wskaźnik na model;
+ * @param[in] num    –  Wskaźnik na numer;
+ * @param[out] res   –  Wskaźnik na tablicę wyników o rozmiarze co najmniej
+ *                      @p m->count + 1.
+ * @return Liczba różnych numerów, posortowanych w tablicy @p res.
+ */
+static size_t modelReverse (const struct model* m, const char* num,
+                            char (*res)[2 * TEST_KEY_LENGTH + 1]) {
+    size_t count = 0;
+
+    strcpy(res[count++], num);
+
+    for (size_t i = 0; i < m->count; i++)
+        if (startsWith(num, m->forwards[i].fwd))
+            sprintf(res[count++], "%s%s", m->forwards[i].num,
+                    num + strlen(m->forwards[i].fwd));
+
+    qsort(res, count, sizeof(res[0]), compareStrings);
+
+    size_t unique = 0;
+
+    for (size_t i = 0; i < count; i++)
+        if (unique == 0 || strcmp(res[unique - 1], res[i]) != 0)
+            memmove(res[unique++], res[i], sizeof(res[0]));
+
+    return unique;
+}
+
+/** Zlicza w modelu przekierowania prefiksów zaczynających się od numeru.
+ * @param[in] m    –  Wskaźnik na model;
+ * @param[in] num  –  Wskaźnik na numer.
+ * @return Liczba przekierowań.
+ */
+static size_t modelCount (const struct model* m, const char* num) {
+    size_t count = 0;
+
+    for (size_t i = 0; i < m->count; i++)
+        if (startsWith(m->forwards[i].num, num))
+            count++;
+
+    return count;
+}
+
+/** Wyznacza w modelu liczbę nietrywialnych numerów.
+ * @param[in] m       –  Wskaźnik na model;
+ * @param[in] set     –  Wskaźnik na napis z cyframi numerów;
+ * @param[in] length  –  Długość numerów, co najwyżej TEST_NTC_LENGTH.
+ * @return Liczba numerów długości @p length z cyfr @p set, które zaczynają
+ *         się od któregoś przekierowania.
+ */
+static size_t modelNonTrivial (const struct model* m, const char* set,
+                               size_t length) {
+    size_t setLength = strlen(set);
+    size_t total = 1;
+    size_t count = 0;
+    char num[TEST_NTC_LENGTH + 1];
+
+    for (size_t i = 0; i < length; i++)
+        total *= setLength;
+
+    for (size_t k = 0; k < total; k++) {
+        size_t code = k;
+
+        for (size_t i = 0; i < length; i++) {
+            num[i] = set[code % setLength];
+            code /= setLength;
+        }
+
+        num[length] = '\0';
+
+        for (size_t i = 0; i < m->count; i++) {
+            if (startsWith(num, m->forwards[i].fwd)) {
+                count++;
+                break;
+            }
+        }
+    }
+
+    return count;
+}
+
+/** Włącza dodatki wariantu.
+ * Silniki, które ich nie obsługują, mogą je odrzucić.
+ * @param[in,out] pf  –  Wskaźnik na strukturę;
+ * @param[in] flags   –  Dodatki wariantu.
+ */
+static void variantSetup (PhoneFwd pf, unsigned flags) {
+    if ((flags & TEST_VARIANT_JUMP) != 0)
+        phfwdSetJumpDepth(pf, 2);
+
+    if ((flags & TEST_VARIANT_COMPACT) != 0)
+        phfwdCompact(pf);
+
+    if ((flags & TEST_VARIANT_FREEZE) != 0)
+        phfwdFreeze(pf);
+}
+
+/** Wykonuje prace w tle i zamraża strukturę zgodnie z wariantem.
+ * @param[in,out] pf  –  Wskaźnik na strukturę;
+ * @param[in] flags   –  Dodatki wariantu;
+ * @param[in] step    –  Numer operacji.
+ */
+static void variantStep (PhoneFwd pf, unsigned flags, size_t step) {
+    phfwdMaintain(pf, 16);
+
+    if ((flags & TEST_VARIANT_COMPACT) != 0 && step % 97 == 0)
+        phfwdCompact(pf);
+
+    if ((flags & TEST_VARIANT_FREEZE) != 0 && step % 53 == 0)
+        phfwdFreeze(pf);
+}
+
+/** Sprawdza wynik zapytania o jeden numer.
+ * @param[in] res       –  Wskaźnik na wynik lub NULL;
+ * @param[in] expected  –  Wskaźnik na oczekiwany numer.
+ * @return Wartość @p true, jeśli wynik zawiera dokładnie oczekiwany numer.
+ */
+static bool checkSingle (const PhoneNum* res, const char* expected) {
+    bool ok = res != NULL && phnumGet(res, 0) != NULL &&
+              strcmp(phnumGet(res, 0), expected) == 0 &&
+              phnumGet(res, 1) == NULL;
+
+    phnumDelete(res);
+
+    return ok;
+}
+
+/** Wykonuje krótki scenariusz z wypisanymi wynikami.
+ * @param[in] v  –  Wskaźnik na wariant.
+ * @return Wartość @p true, jeśli wyniki są zgodne z oczekiwanymi.
+ */
+static bool runScenario (const struct variant* v) {
+    PhoneFwd pf = phfwdNewEngine(v->engine);
+    bool ok = pf != NULL;
+
+    if (ok) {
+        variantSetup(pf, v->flags);
+
+        ok = phfwdAdd(pf, "123", "9") && phfwdAdd(pf, "123456", "777777") &&
+             phfwdAdd(pf, "431", "432") && phfwdAdd(pf, "432", "433") &&
+             !phfwdAdd(pf, "12", "12") && !phfwdAdd(pf, "1a", "2");
+    }
+
+    variantSetup(pf, v->flags);
+
+    ok = ok && checkSingle(phfwdGet(pf, "12345"), "945") &&
+         checkSingle(phfwdGet(pf, "123456"), "777777") &&
+         checkSingle(phfwdGet(pf, "997"), "997") &&
+         checkSingle(phfwdGet(pf, "4311"), "4321") &&
+         checkSingle(phfwdReverse(pf, "434"), "434") &&
+         phfwdCount(pf, "1") == 2 && phfwdCount(pf, "43") == 2 &&
+         phfwdReverseCount(pf, "433") == 2;
+
+    if (ok) {
+        const PhoneNum* res = phfwdReverse(pf, "433");
+
+        ok = res != NULL && phnumGet(res, 0) != NULL &&
+             strcmp(phnumGet(res, 0), "432") == 0 &&
+             strcmp(phnumGet(res, 1), "433") == 0 && phnumGet(res, 2) == NULL;
+        phnumDelete(res);
+    }
+
+    if (ok) {
+        phfwdRemove(pf, "12");
+        variantSetup(pf, v->flags);
+
+        ok = checkSingle(phfwdGet(pf, "123456"), "123456") &&
+             phfwdCount(pf, "1") == 0 &&
+             phfwdNonTrivialCount(pf, "34", 3) == 1;
+    }
+
+    phfwdDelete(pf);
+
+    return ok;
+}
+
+/** Wykonuje losowy ciąg operacji i porównuje wyniki z modelem.
+ * Ciąg operacji zależy tylko od ziarna, więc jest ten sam dla każdego
+ * wariantu.
+ * @param[in] v     –  Wskaźnik na wariant;
+ * @param[in] seed  –  Ziarno generatora.
+ * @return Wartość @p true, jeśli wszystkie wyniki są zgodne z modelem.
+ */
+static bool runRandom (const struct variant* v, uint64_t seed) {
+    static struct model m;
+    static char reverse[TEST_MAX_FORWARDS + 1][2 * TEST_KEY_LENGTH + 1];
+    char num[2 * TEST_KEY_LENGTH + 1], fwd[TEST_KEY_LENGTH + 1];
+    PhoneFwd pf = phfwdNewEngine(v->engine);
+    bool ok = pf != NULL;
+
+    m.count = 0;
+    randomState = seed;
+
+    if (ok)
+        variantSetup(pf, v->flags);
+
+    for (size_t step = 1; ok && step <= TEST_OPERATIONS; step++) {
+        uint64_t op = randomNext() % 100;
+
+        variantStep(pf, v->flags, step);
+
+        if (op < 35) {
+            randomNumber(num, 1, 6);
+            randomNumber(fwd, 1, 4);
+
+            bool added = phfwdAdd(pf, num, fwd);
+            bool expected = strcmp(num, fwd) != 0;
+
+            if (added != expected || (expected && m.count == TEST_MAX_FORWARDS))
+                ok = false;
+
+            else if (added)
+                modelAdd(&m, num, fwd);
+        }
+
+        else if (op < 42) {
+            randomNumber(num, 1, 3);
+            phfwdRemove(pf, num);
+            modelRemove(&m, num);
+        }
+
+        else if (op < 67) {
+            char expected[2 * TEST_KEY_LENGTH + 1];
+
+            randomNumber(num, 1, 8);
+            modelGet(&m, num, expected);
+            ok = checkSingle(phfwdGet(pf, num), expected);
+        }
+
+        else if (op < 82) {
+            randomNumber(num, 1, 6);
+
+            size_t count = modelReverse(&m, num, reverse);
+            const PhoneNum* res = phfwdReverse(pf, num);
+
+            ok = res != NULL && phfwdReverseCount(pf, num) == count;
+
+            for (size_t i = 0; ok && i < count; i++)
+                ok = phnumGet(res, i) != NULL &&
+                     strcmp(phnumGet(res, i), reverse[i]) == 0;
+
+            ok = ok && phnumGet(res, count) == NULL;
+            phnumDelete(res);
+        }
+
+        else if (op < 95) {
+            randomNumber(num, 1, 3);
+            ok = phfwdCount(pf, num) == modelCount(&m, num);
+        }
+
+        else {
+            size_t length = 1 + randomNext() % TEST_NTC_LENGTH;
+            size_t setLength = 0;
+
+            // Zbiór cyfr bez powtórzeń, żeby model nie liczył numerów dwa razy.
+            for (size_t i = 0; i + 1 < sizeof(TEST_DIGITS); i++)
+                if (randomNext() % 2 == 0)
+                    num[setLength++] = TEST_DIGITS[i];
+
+            if (setLength == 0)
+                num[setLength++] = TEST_DIGITS[0];
+
+            num[setLength] = '\0';
+            ok = phfwdNonTrivialCount(pf, num, length) ==
+                 modelNonTrivial(&m, num, length);
+        }
+
+        if (!ok)
+            fprintf(stderr, "%s/%s: seed %llu step %zu operation %llu num %s\n",
+                    v->engine, v->name, (unsigned long long)seed, step,
+                    (unsigned long long)op, num);
+    }
+
+    struct PhoneForwardStats stats;
+
+    ok = ok && phfwdStats(pf, &stats) && stats.forwards == m.count;
+    phfwdDelete(pf);
+
+    return ok;
+}
+
+/** Uruchamia test zgodności wszystkich wariantów.
+ * @return Wartość 0, jeśli wszystkie warianty dały oczekiwane wyniki.
+ *         Wartość 1 w przeciwnym wypadku.
+ */
+int main (void) {
+    bool allOk = true;
+
+    for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+        const struct variant* v = &variants[i];
+        bool ok = runScenario(v);
+
+        if (!ok)
+            fprintf(stderr, "%s/%s: scenario failed\n", v->engine, v->name);
+
+        for (uint64_t seed = 1; ok && seed <= 3; seed++)
+            ok = runRandom(v, seed * 0x9E3779B97F4A7C15ull);
+
+        printf("%-6s %-8s %s\n", v->engine, v->name, ok ? "OK" : "FAILED");
+        allOk = allOk && ok;
+    }
+
+    return allOk ? 0 : 1;
+}